@@ -0,0 +1,68 @@
+#include "Bench.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+namespace RESTClient {
+namespace bench {
+
+double Latencies::percentile(double quantile) {
+  if (samples.empty())
+    return 0;
+  std::sort(samples.begin(), samples.end());
+  size_t index = static_cast<size_t>(quantile * (samples.size() - 1) + 0.5);
+  return samples[std::min(index, samples.size() - 1)];
+}
+
+double Latencies::mean() const {
+  if (samples.empty())
+    return 0;
+  return std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+}
+
+void Latencies::describe(std::map<std::string, double> &details) {
+  details["p50_us"] = percentile(0.5);
+  details["p90_us"] = percentile(0.9);
+  details["p99_us"] = percentile(0.99);
+  details["max_us"] = percentile(1);
+  details["mean_us"] = mean();
+}
+
+void Report::add(Result result) {
+  std::cout << std::left << std::setw(44) << result.name << std::right
+            << std::setw(14) << std::fixed << std::setprecision(2)
+            << result.value << " " << result.unit;
+  for (const auto &detail : result.details)
+    std::cout << "  " << detail.first << "=" << std::setprecision(1)
+              << detail.second;
+  std::cout << std::endl;
+  results.emplace_back(std::move(result));
+}
+
+void Report::writeJSON(std::ostream &out) const {
+  std::time_t now = std::time(nullptr);
+  char when[32];
+  std::strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+  out << "{\n  \"timestamp\": \"" << when << "\",\n";
+  for (const auto &note : notes)
+    out << "  \"" << note.first << "\": \"" << note.second << "\",\n";
+  out << "  \"results\": [";
+  bool first = true;
+  out << std::setprecision(6);
+  for (const auto &result : results) {
+    out << (first ? "\n" : ",\n") << "    {\"name\": \"" << result.name
+        << "\", \"value\": " << result.value << ", \"unit\": \""
+        << result.unit << "\"";
+    for (const auto &detail : result.details)
+      out << ", \"" << detail.first << "\": " << detail.second;
+    out << "}";
+    first = false;
+  }
+  out << "\n  ]\n}\n";
+}
+
+} /* bench */
+} /* RESTClient */
@@ -0,0 +1,59 @@
+/// Bits shared by the benchmarks: timing, statistics and the report
+#pragma once
+
+#include <RESTClient/base/clock.hpp>
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace RESTClient {
+namespace bench {
+
+/// One measurement
+struct Result {
+  /// eg. "small_get.jobrunner.c16"
+  std::string name;
+  double value;
+  /// eg. "requests/s", "MB/s", "us"
+  std::string unit;
+  /// Extra numbers about the same run, eg. latency percentiles
+  std::map<std::string, double> details;
+};
+
+/// Latency statistics, in microseconds
+struct Latencies {
+  std::vector<double> samples;
+  void add(Clock::duration d) {
+    samples.push_back(std::chrono::duration<double, std::micro>(d).count());
+  }
+  /// 'quantile' is 0 to 1
+  double percentile(double quantile);
+  double mean() const;
+  /// Adds p50, p90, p99, max and mean to 'details'
+  void describe(std::map<std::string, double> &details);
+};
+
+class Report {
+private:
+  std::vector<Result> results;
+  std::map<std::string, std::string> notes;
+
+public:
+  /// Records something about the run, eg. the build type
+  void note(const std::string &key, const std::string &value) {
+    notes[key] = value;
+  }
+  /// Records a result, and prints it as it comes in
+  void add(Result result);
+  /// The whole report as JSON, for tracking results between releases
+  void writeJSON(std::ostream &out) const;
+};
+
+inline double seconds(Clock::duration d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+} /* bench */
+} /* RESTClient */
@@ -0,0 +1,601 @@
+/// Benchmarks for RESTClient. Everything runs against an in process
+/// TestServer, so the numbers don't depend on the internet.
+///
+/// Usage: benchmarks [--quick] [--json results.json] [--filter regex]
+///                   [--server-threads N]
+///
+///  * small_get.* - requests/s of tiny GETs through JobRunner at several
+///    connection counts, with latency percentiles. With the CO_AWAIT build
+///    option, small_get.coawait.* does the same through AsyncJobRunner
+///  * download.* / upload.* - MB/s of big bodies: plain, chunked, gzip, TLS.
+///    upload.chunked is made by a BodySource as it's sent
+///  * connect.* - the cost of a new connection (DNS, TCP, TLS)
+///  * head.* - the cost of making a request's head, with our default headers
+///    added each time, or from a RequestTemplate
+///  * parse.headers - the cost of parsing a response's status line and headers
+///  * parse.chunks - the cost of each of many tiny chunks
+///  * scan.* - MB/s of the SIMD delimiter scans, and their scalar versions
+///  * overhead.* - sequential keep-alive GETs through the HTTP class vs. a
+///    bare asio loop like experiments/asio.cpp
+
+#include "Bench.hpp"
+
+#include <RESTClient/http/HTTP.hpp>
+#include <RESTClient/http/HTTPProtocol.hpp>
+#include <RESTClient/http/RequestTemplate.hpp>
+#include <RESTClient/http/ResponseCache.hpp>
+#include <RESTClient/http/Scan.hpp>
+#include <RESTClient/http/Services.hpp>
+#include <RESTClient/jobManagement/AsyncJobRunner.hpp>
+#include <RESTClient/jobManagement/JobRunner.hpp>
+#include <testServer/TestServer.hpp>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/spawn.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <regex>
+
+using namespace RESTClient;
+using namespace RESTClient::bench;
+
+namespace {
+
+struct Settings {
+  bool quick = false;
+  std::regex filter{""};
+  unsigned serverThreads = 2;
+  /// Shrinks iteration counts for --quick
+  size_t scale(size_t count) const {
+    return quick ? std::max<size_t>(count / 10, 1) : count;
+  }
+  bool wanted(const std::string &name) const {
+    return std::regex_search(name, filter);
+  }
+};
+
+/// Runs 'body' in a coroutine on the global io_service, and waits for it
+void runCoroutine(std::function<void(asio::yield_context)> body) {
+  auto &io = Services::instance().io_service;
+  io.reset();
+  asio::spawn(io, body);
+  io.run();
+}
+
+/// Text that compresses about as well as JSON does
+std::string makePayload(size_t size) {
+  static const char *words[] = {"\"id\": ",  "\"name\": ", "true, ",
+                                "false, ",   "null, ",    "{",
+                                "}, ",       "[",         "], ",
+                                "\"value\"", "12345",     "\"abc\"\n"};
+  std::string result;
+  result.reserve(size + 16);
+  uint32_t random = 12345;
+  while (result.size() < size) {
+    random = random * 1103515245 + 12345;
+    result += words[(random >> 16) % (sizeof(words) / sizeof(words[0]))];
+  }
+  result.resize(size);
+  return result;
+}
+
+std::string gzip(const std::string &in) {
+  namespace io = boost::iostreams;
+  std::string result;
+  io::filtering_ostream out;
+  out.push(io::gzip_compressor());
+  out.push(io::back_inserter(result));
+  out << in;
+  out.reset();
+  return result;
+}
+
+double megabytesPerSecond(size_t bytes, Clock::duration took) {
+  return bytes / 1e6 / seconds(took);
+}
+
+void smallRequests(Report &report, const Settings &settings,
+                   const HostInfo &host, const std::string &label) {
+  for (size_t concurrency : {1, 4, 16, 64}) {
+    std::string name =
+        "small_get.jobrunner." + label + ".c" + std::to_string(concurrency);
+    if (!settings.wanted(name))
+      continue;
+    size_t count = settings.scale(concurrency * 500);
+    JobRunner jobs;
+    Latencies latencies;
+    for (size_t i = 0; i != count; ++i)
+      jobs.queue(host).push(QueuedJob{
+          name, host, [&latencies](const std::string &, const HostInfo &,
+                                   HTTP &conn) {
+            HTTPResponse response = conn.get("/bytes/64");
+            latencies.add(Clock::now() - response.timings.start);
+            return true;
+          }});
+    auto start = Clock::now();
+    jobs.run(concurrency);
+    auto took = Clock::now() - start;
+    Result result{name, count / seconds(took), "requests/s"};
+    latencies.describe(result.details);
+    report.add(std::move(result));
+  }
+}
+
+/// Like smallRequests, but through a ResponseCache shared by all the
+/// connections. 'fresh' responses are served from memory; 'revalidated' ones
+/// cost a round trip for a 304 with no body
+void cachedRequests(Report &report, const Settings &settings,
+                    const HostInfo &host) {
+  const size_t concurrency = 16;
+  for (std::string mode : {"fresh", "revalidated"}) {
+    std::string name =
+        "small_get.cached." + mode + ".c" + std::to_string(concurrency);
+    if (!settings.wanted(name))
+      continue;
+    size_t count = settings.scale(concurrency * 500);
+    auto cache = std::make_shared<ResponseCache>();
+    JobRunner jobs;
+    Latencies latencies;
+    for (size_t i = 0; i != count; ++i)
+      jobs.queue(host).push(QueuedJob{
+          name, host, [&](const std::string &, const HostInfo &, HTTP &conn) {
+            conn.useCache(cache);
+            HTTPResponse response = conn.get("/bench/cached/" + mode);
+            latencies.add(Clock::now() - response.timings.start);
+            return true;
+          }});
+    auto start = Clock::now();
+    jobs.run(concurrency);
+    auto took = Clock::now() - start;
+    CacheStats stats = cache->stats();
+    Result result{name, count / seconds(took), "requests/s"};
+    latencies.describe(result.details);
+    result.details["hits"] = stats.hits;
+    result.details["revalidations"] = stats.revalidations;
+    report.add(std::move(result));
+  }
+}
+
+#if (BOOST_VERSION >= 107000) && defined(BOOST_ASIO_HAS_CO_AWAIT)
+/// Like smallRequests, but through AsyncJobRunner's stackless workers
+void smallRequestsCoAwait(Report &report, const Settings &settings,
+                          const HostInfo &host, const std::string &label) {
+  for (size_t concurrency : {1, 4, 16, 64}) {
+    std::string name =
+        "small_get.coawait." + label + ".c" + std::to_string(concurrency);
+    if (!settings.wanted(name))
+      continue;
+    size_t count = settings.scale(concurrency * 500);
+    AsyncJobRunner jobs;
+    Latencies latencies;
+    for (size_t i = 0; i != count; ++i)
+      jobs.queue({name, host,
+                  [&latencies](const std::string &, const HostInfo &,
+                               AsyncHTTP &conn) -> asio::awaitable<bool> {
+                    HTTPResponse response = co_await conn.get("/bytes/64");
+                    latencies.add(Clock::now() - response.timings.start);
+                    co_return true;
+                  }});
+    auto start = Clock::now();
+    jobs.run(concurrency);
+    auto took = Clock::now() - start;
+    Result result{name, count / seconds(took), "requests/s"};
+    latencies.describe(result.details);
+    report.add(std::move(result));
+  }
+}
+#endif
+
+void transfers(Report &report, const Settings &settings,
+               const TestServer &server) {
+  size_t size = settings.quick ? (4 << 20) : (32 << 20);
+  size_t repeats = 3;
+  struct Transfer {
+    std::string name;
+    HostInfo host;
+    std::string path;
+    /// Upload from a BodySource of unknown size, so it's sent in chunks
+    bool generated = false;
+  };
+  std::vector<Transfer> downloads{
+      {"download.plain", server.http(), "/bench/plain"},
+      {"download.chunked", server.http(), "/bench/chunked"},
+      {"download.gzip", server.http(), "/bench/gzip"},
+      {"download.tls", server.https(), "/bench/plain"},
+      {"download.tls_gzip", server.https(), "/bench/gzip"}};
+  for (const auto &transfer : downloads) {
+    if (!settings.wanted(transfer.name))
+      continue;
+    size_t bytes = 0;
+    Clock::duration took{};
+    runCoroutine([&](asio::yield_context yield) {
+      HTTP conn(transfer.host, yield);
+      // Warm up the connection
+      conn.get("/bytes/64");
+      auto start = Clock::now();
+      for (size_t i = 0; i != repeats; ++i) {
+        HTTPResponse response = conn.get(transfer.path);
+        bytes += response.timings.decodedBodyBytes;
+      }
+      took = Clock::now() - start;
+      conn.close();
+    });
+    report.add({transfer.name, megabytesPerSecond(bytes, took), "MB/s"});
+  }
+
+  std::string payload = makePayload(size);
+  std::vector<Transfer> uploads{
+      {"upload.plain", server.http(), "/bench/upload"},
+      {"upload.tls", server.https(), "/bench/upload"},
+      {"upload.chunked", server.http(), "/bench/upload", true}};
+  for (const auto &transfer : uploads) {
+    if (!settings.wanted(transfer.name))
+      continue;
+    Clock::duration took{};
+    runCoroutine([&](asio::yield_context yield) {
+      HTTP conn(transfer.host, yield);
+      conn.get("/bytes/64");
+      auto start = Clock::now();
+      for (size_t i = 0; i != repeats; ++i) {
+        if (!transfer.generated) {
+          conn.put(transfer.path, payload);
+          continue;
+        }
+        HTTPRequest request("PUT", transfer.path);
+        size_t sent = 0;
+        request.body.initWithGenerator([&](char *out, size_t size) {
+          size = std::min(size, payload.size() - sent);
+          std::memcpy(out, payload.data() + sent, size);
+          sent += size;
+          return size;
+        });
+        conn.action(request);
+      }
+      took = Clock::now() - start;
+      conn.close();
+    });
+    report.add({transfer.name,
+                megabytesPerSecond(payload.size() * repeats, took), "MB/s"});
+  }
+}
+
+void connectionSetup(Report &report, const Settings &settings,
+                     const HostInfo &host, const std::string &label) {
+  std::string name = "connect." + label;
+  if (!settings.wanted(name))
+    return;
+  size_t count = settings.scale(500);
+  Latencies setup, dns, connect, tls;
+  runCoroutine([&](asio::yield_context yield) {
+    for (size_t i = 0; i != count; ++i) {
+      HTTP conn(host, yield);
+      HTTPResponse response = conn.get("/bytes/1");
+      const HTTPTimings &timings = response.timings;
+      setup.add(timings.dns + timings.connect + timings.tlsHandshake);
+      dns.add(timings.dns);
+      connect.add(timings.connect);
+      tls.add(timings.tlsHandshake);
+      conn.close();
+    }
+  });
+  Result result{name, setup.mean(), "us"};
+  setup.describe(result.details);
+  result.details["dns_mean_us"] = dns.mean();
+  result.details["tcp_mean_us"] = connect.mean();
+  result.details["tls_mean_us"] = tls.mean();
+  report.add(std::move(result));
+}
+
+/// Like a client of an object store: a token, and paths under an account
+void requestHeads(Report &report, const Settings &settings,
+                  const HostInfo &host) {
+  const std::string token = "gAAAAABk7Xq2abcdefghijklmnopqrstuvwxyz0123456789";
+  const std::string account = "/v1/MossoCloudFS_0123456789abcdef";
+  size_t count = settings.scale(200000);
+  std::string head;
+  std::string name = "head.defaults";
+  if (settings.wanted(name)) {
+    HTTPRequest request("PUT", "");
+    request.body = "some data";
+    auto start = Clock::now();
+    for (size_t i = 0; i != count; ++i) {
+      request.path = account + "/container/object";
+      request.headers["X-Auth-Token"] = token;
+      addDefaultHeaders(request, host);
+      head.clear();
+      appendRequestHead(head, request);
+    }
+    auto took = Clock::now() - start;
+    report.add({name, std::chrono::duration<double, std::nano>(took).count() /
+                          count,
+                "ns/request", {{"head_bytes", double(head.size())}}});
+  }
+  name = "head.template";
+  if (settings.wanted(name)) {
+    RequestTemplate objects(host, account, {{"X-Auth-Token", token.c_str()}});
+    HTTPRequest request(objects, "PUT", "/container/object");
+    request.body = "some data";
+    auto start = Clock::now();
+    for (size_t i = 0; i != count; ++i) {
+      head.clear();
+      appendRequestHead(head, request);
+    }
+    auto took = Clock::now() - start;
+    report.add({name, std::chrono::duration<double, std::nano>(took).count() /
+                          count,
+                "ns/request", {{"head_bytes", double(head.size())}}});
+  }
+}
+
+void headerParsing(Report &report, const Settings &settings) {
+  const std::string name = "parse.headers";
+  if (!settings.wanted(name))
+    return;
+  const std::string reply = "HTTP/1.1 200 OK\r\n"
+                            "Date: Mon, 19 Oct 2026 01:02:03 GMT\r\n"
+                            "Content-Type: application/json\r\n"
+                            "Content-Length: 1234\r\n"
+                            "Connection: keep-alive\r\n"
+                            "Server: nginx\r\n"
+                            "Cache-Control: no-cache\r\n"
+                            "ETag: \"5d41402abc4b2a76b9719d911017c592\"\r\n"
+                            "Last-Modified: Sun, 18 Oct 2026 01:02:03 GMT\r\n"
+                            "X-Trans-Id: tx1234567890abcdef-0012345678\r\n"
+                            "Vary: Accept-Encoding\r\n"
+                            "\r\n";
+  size_t count = settings.scale(200000);
+  // Reused like a connection reuses them
+  HTTPConnectionBuffers buffers;
+  HTTPResponse response;
+  auto start = Clock::now();
+  for (size_t i = 0; i != count; ++i) {
+    buffers.spareHeaders.recycle(response.headers);
+    buffers.parser.start(response, buffers.spareHeaders);
+    std::string_view body;
+    buffers.parser.parse(reply.data(), reply.size(), body);
+  }
+  auto took = Clock::now() - start;
+  report.add({name, std::chrono::duration<double, std::nano>(took).count() /
+                        count,
+              "ns/reply", {{"headers_per_reply", 10}}});
+}
+
+void chunkParsing(Report &report, const Settings &settings) {
+  const std::string name = "parse.chunks";
+  if (!settings.wanted(name))
+    return;
+  // Lots of tiny chunks, like a server flushing small writes
+  std::string reply = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+  const size_t chunks = 1000;
+  for (size_t i = 0; i != chunks; ++i)
+    reply.append("8\r\nabcdefgh\r\n");
+  reply.append("0\r\n\r\n");
+  size_t count = settings.scale(2000);
+  HTTPConnectionBuffers buffers;
+  HTTPResponse response;
+  size_t bodyBytes = 0;
+  auto start = Clock::now();
+  for (size_t i = 0; i != count; ++i) {
+    buffers.spareHeaders.recycle(response.headers);
+    buffers.parser.start(response, buffers.spareHeaders);
+    size_t used = 0;
+    while (!buffers.parser.done()) {
+      std::string_view body;
+      used += buffers.parser.parse(reply.data() + used, reply.size() - used,
+                                   body);
+      bodyBytes += body.size();
+    }
+  }
+  auto took = Clock::now() - start;
+  if (bodyBytes != count * chunks * 8)
+    throw std::runtime_error(name + " lost some body");
+  report.add({name, std::chrono::duration<double, std::nano>(took).count() /
+                        (count * chunks),
+              "ns/chunk"});
+}
+
+/// The delimiter scans the parser uses, against their byte at a time
+/// versions, over a header heavy block
+void scanning(Report &report, const Settings &settings) {
+  std::string text;
+  while (text.size() < 64 * 1024)
+    text.append("X-Object-Meta-Something-Long: "
+                "a fairly ordinary header value, 0123456789\r\n");
+  text.append("\r\nbody");
+  const char *begin = text.data();
+  const char *end = begin + text.size();
+  struct Scan {
+    std::string name;
+    std::function<const char *(const char *)> find;
+  };
+  std::vector<Scan> scans{
+      {"scan.line.simd",
+       [end](const char *from) { return findByte(from, end, '\n'); }},
+      {"scan.line.scalar",
+       [end](const char *from) { return scalar::findByte(from, end, '\n'); }},
+      {"scan.colon_or_line.simd",
+       [end](const char *from) { return findEither(from, end, ':', '\n'); }},
+      {"scan.colon_or_line.scalar",
+       [end](const char *from) {
+         return scalar::findEither(from, end, ':', '\n');
+       }},
+      {"scan.head_end.simd",
+       [end](const char *from) { return findHeadEnd(from, end); }},
+      {"scan.head_end.scalar",
+       [end](const char *from) { return scalar::findHeadEnd(from, end); }}};
+  size_t count = settings.scale(2000);
+  for (const auto &scan : scans) {
+    if (!settings.wanted(scan.name))
+      continue;
+    size_t found = 0;
+    auto start = Clock::now();
+    for (size_t i = 0; i != count; ++i)
+      // Like the parser: find one, then carry on from just past it
+      for (const char *at = scan.find(begin); at != end;
+           at = scan.find(at + 1))
+        ++found;
+    auto took = Clock::now() - start;
+    report.add({scan.name, megabytesPerSecond(text.size() * count, took),
+                "MB/s",
+                {{"found_per_pass", double(found) / count}}});
+  }
+}
+
+/// Sequential keep-alive GETs with nothing but asio, like experiments/asio.cpp
+void rawAsioLoop(const HostInfo &host, size_t count, asio::yield_context yield) {
+  auto &services = Services::instance();
+  tcp::socket socket(services.io_service);
+  auto endpoints = services.resolver.async_resolve(
+      {host.hostname, std::to_string(host.getPort())}, yield);
+  asio::async_connect(socket, endpoints, yield);
+  const std::string request = "GET /bytes/64 HTTP/1.1\r\n"
+                              "Host: " + host.hostHeader() + "\r\n"
+                              "Accept: */*\r\n\r\n";
+  asio::streambuf buf;
+  for (size_t i = 0; i != count; ++i) {
+    asio::async_write(socket, asio::buffer(request), yield);
+    size_t headerSize = asio::async_read_until(socket, buf, "\r\n\r\n", yield);
+    std::string header(asio::buffers_begin(buf.data()),
+                       asio::buffers_begin(buf.data()) + headerSize);
+    const std::string field = "Content-Length: ";
+    size_t length = std::stoul(header.substr(header.find(field) + field.size()));
+    buf.consume(headerSize);
+    if (buf.size() < length)
+      asio::async_read(socket, buf,
+                       asio::transfer_exactly(length - buf.size()), yield);
+    buf.consume(length);
+  }
+  socket.close();
+}
+
+void overhead(Report &report, const Settings &settings,
+              const HostInfo &host) {
+  const std::string name = "overhead.http_vs_raw_asio";
+  if (!settings.wanted(name))
+    return;
+  size_t count = settings.scale(5000);
+  Clock::duration raw{}, http{};
+  runCoroutine([&](asio::yield_context yield) {
+    rawAsioLoop(host, count / 10, yield); // Warm up
+    auto start = Clock::now();
+    rawAsioLoop(host, count, yield);
+    raw = Clock::now() - start;
+  });
+  runCoroutine([&](asio::yield_context yield) {
+    HTTP conn(host, yield);
+    for (size_t i = 0; i != count / 10; ++i)
+      conn.get("/bytes/64");
+    auto start = Clock::now();
+    for (size_t i = 0; i != count; ++i)
+      conn.get("/bytes/64");
+    http = Clock::now() - start;
+    conn.close();
+  });
+  double rawUs = std::chrono::duration<double, std::micro>(raw).count() / count;
+  double httpUs =
+      std::chrono::duration<double, std::micro>(http).count() / count;
+  report.add({name, httpUs - rawUs, "us/request",
+              {{"raw_us", rawUs},
+               {"http_us", httpUs},
+               {"overhead_percent", (httpUs - rawUs) / rawUs * 100}}});
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+  Settings settings;
+  std::string jsonPath;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--quick")
+      settings.quick = true;
+    else if ((arg == "--json") && (i + 1 < argc))
+      jsonPath = argv[++i];
+    else if ((arg == "--filter") && (i + 1 < argc))
+      settings.filter = std::regex(argv[++i]);
+    else if ((arg == "--server-threads") && (i + 1 < argc))
+      settings.serverThreads = std::stoul(argv[++i]);
+    else {
+      std::cerr << "Usage: " << argv[0]
+                << " [--quick] [--json file] [--filter regex]"
+                   " [--server-threads N]"
+                << std::endl;
+      return 1;
+    }
+  }
+
+  TestServerOptions options;
+  options.threads = settings.serverThreads;
+  TestServer server(options);
+  Services::instance().trustCertificate(TestServer::certificateFile());
+
+  // Bodies for the transfer benchmarks, made once so the server only copies
+  const std::string payload =
+      makePayload(settings.quick ? (4 << 20) : (32 << 20));
+  const std::string gzipped = gzip(payload);
+  server.route("/bench/cached/", [](const TestRequest &request,
+                                    TestResponse &response) {
+    response.headers["ETag"] = "\"1\"";
+    if (request.path == "/bench/cached/fresh")
+      response.headers["Cache-Control"] = "max-age=3600";
+    auto condition = request.headers.find("If-None-Match");
+    if ((condition != request.headers.end()) &&
+        (condition->second == "\"1\"")) {
+      response.code = 304;
+      response.reason = "Not Modified";
+      return;
+    }
+    response.body = std::string(64, 'c');
+  });
+  server.route("/bench/", [&](const TestRequest &request,
+                              TestResponse &response) {
+    if (request.path == "/bench/plain") {
+      response.body = payload;
+    } else if (request.path == "/bench/chunked") {
+      response.body = payload;
+      response.chunkSize = 64 * 1024;
+    } else if (request.path == "/bench/gzip") {
+      response.body = gzipped;
+      response.headers["Content-Encoding"] = "gzip";
+    }
+    // /bench/upload just drops the body
+  });
+
+  Report report;
+  report.note("quick", settings.quick ? "true" : "false");
+  report.note("server_threads", std::to_string(settings.serverThreads));
+  report.note("scan", scanInstructions());
+
+  smallRequests(report, settings, server.http(), "http");
+  smallRequests(report, settings, server.https(), "https");
+  cachedRequests(report, settings, server.http());
+#if (BOOST_VERSION >= 107000) && defined(BOOST_ASIO_HAS_CO_AWAIT)
+  smallRequestsCoAwait(report, settings, server.http(), "http");
+  smallRequestsCoAwait(report, settings, server.https(), "https");
+#endif
+  transfers(report, settings, server);
+  connectionSetup(report, settings, server.http(), "http");
+  connectionSetup(report, settings, server.https(), "https");
+  requestHeads(report, settings, server.http());
+  headerParsing(report, settings);
+  chunkParsing(report, settings);
+  scanning(report, settings);
+  overhead(report, settings, server.http());
+
+  if (!jsonPath.empty()) {
+    std::ofstream out(jsonPath);
+    report.writeJSON(out);
+  }
+  return 0;
+}
@@ -5,6 +5,9 @@ find_package(Threads)
 # Boost
 FIND_PACKAGE(Boost 1.60 REQUIRED COMPONENTS system coroutine iostreams)
 include_directories(${OPENSSL_INCLUDE_DIR} ${OPENSSL_LIBRARIES})
+# Newer boost's default asio executor is type erased, and allocates on every
+# async operation. Keep the io_service era one
+add_definitions(-DBOOST_ASIO_USE_TS_EXECUTOR_AS_DEFAULT)
 
 if (${BUILD_TESTS})
   FIND_PACKAGE(Boost 1.60 REQUIRED COMPONENTS regex)
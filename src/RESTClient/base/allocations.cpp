@@ -0,0 +1,91 @@
+#include "allocations.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace RESTClient {
+
+namespace {
+
+// Plain old data, so it's usable before any constructors have run
+thread_local AllocationCounts counts = {0, 0, 0};
+thread_local AllocationObserver observer = nullptr;
+
+std::atomic<void *(*)(size_t)> allocateHook{&std::malloc};
+std::atomic<void (*)(void *)> deallocateHook{&std::free};
+
+void *allocate(size_t size) {
+  ++counts.allocations;
+  counts.bytes += size;
+  if (observer)
+    observer(size);
+  // malloc(0) may return nullptr, but new must give a unique pointer
+  void *result = allocateHook.load(std::memory_order_relaxed)(size ? size : 1);
+  if (!result)
+    throw std::bad_alloc();
+  return result;
+}
+
+void deallocate(void *p) {
+  if (!p)
+    return;
+  ++counts.deallocations;
+  deallocateHook.load(std::memory_order_relaxed)(p);
+}
+
+} // anonymous namespace
+
+AllocationCounts allocationCounts() { return counts; }
+
+AllocatorHooks setAllocatorHooks(AllocatorHooks hooks) {
+  return {allocateHook.exchange(hooks.allocate),
+          deallocateHook.exchange(hooks.deallocate)};
+}
+
+AllocationObserver setAllocationObserver(AllocationObserver newObserver) {
+  AllocationObserver result = observer;
+  observer = newObserver;
+  return result;
+}
+
+} /* RESTClient */
+
+// The replacements. The nothrow and array forms forward to these, but we
+// define them too so that no other library's versions get picked up
+
+void *operator new(size_t size) { return RESTClient::allocate(size); }
+
+void *operator new[](size_t size) { return RESTClient::allocate(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return RESTClient::allocate(size);
+  } catch (std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return RESTClient::allocate(size);
+  } catch (std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void operator delete(void *p) noexcept { RESTClient::deallocate(p); }
+
+void operator delete[](void *p) noexcept { RESTClient::deallocate(p); }
+
+void operator delete(void *p, size_t) noexcept { RESTClient::deallocate(p); }
+
+void operator delete[](void *p, size_t) noexcept { RESTClient::deallocate(p); }
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+  RESTClient::deallocate(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  RESTClient::deallocate(p);
+}
@@ -0,0 +1,57 @@
+/// Counts heap allocations per thread.
+///
+/// Linking the 'allocations' library replaces the global operator new and
+/// delete with ones that count calls and bytes, then forward to the current
+/// AllocatorHooks (malloc and free by default). With the cmake
+/// ALLOCATION_ACCOUNTING option, the http library links it and each
+/// response's timings say how many allocations its request cost.
+#pragma once
+
+#include <cstddef>
+
+namespace RESTClient {
+
+/// What this thread has allocated since it started
+struct AllocationCounts {
+  size_t allocations;
+  size_t deallocations;
+  /// Total bytes asked for (frees aren't subtracted)
+  size_t bytes;
+  AllocationCounts operator-(const AllocationCounts &other) const {
+    return {allocations - other.allocations,
+            deallocations - other.deallocations, bytes - other.bytes};
+  }
+};
+
+/// This thread's counts so far
+AllocationCounts allocationCounts();
+
+/// Where operator new and delete get their memory from
+struct AllocatorHooks {
+  void *(*allocate)(size_t size);
+  void (*deallocate)(void *p);
+};
+
+/// Swaps the allocator for the whole process; returns the old one. Memory must
+/// go back to the allocator it came from, so do this before any other threads
+/// start
+AllocatorHooks setAllocatorHooks(AllocatorHooks hooks);
+
+/// Called on every allocation this thread makes, eg. to stop in a debugger or
+/// to fail a test
+using AllocationObserver = void (*)(size_t size);
+
+/// Sets this thread's observer (nullptr for none); returns the old one
+AllocationObserver setAllocationObserver(AllocationObserver observer);
+
+/// Counts the allocations made by this thread in a scope
+class AllocationScope {
+private:
+  AllocationCounts start;
+
+public:
+  AllocationScope() : start(allocationCounts()) {}
+  AllocationCounts counts() const { return allocationCounts() - start; }
+};
+
+} /* RESTClient */
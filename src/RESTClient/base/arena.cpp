@@ -0,0 +1,69 @@
+#include "arena.hpp"
+
+#include <cstdint>
+
+namespace RESTClient {
+
+Arena::~Arena() {
+  while (blocks) {
+    Block *next = blocks->next;
+    ::operator delete(blocks);
+    blocks = next;
+  }
+}
+
+void Arena::addBlock(size_t minimum) {
+  size_t size = nextBlockSize;
+  while (size < minimum)
+    size *= 2;
+  nextBlockSize = size * 2;
+  Block *block = static_cast<Block *>(::operator new(sizeof(Block) + size));
+  block->next = blocks;
+  block->size = size;
+  blocks = block;
+  current = reinterpret_cast<char *>(block + 1);
+  end = current + size;
+}
+
+void *Arena::allocate(size_t size, size_t alignment) {
+  auto align = [alignment](char *p) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(p);
+    return reinterpret_cast<char *>((address + alignment - 1) &
+                                    ~(uintptr_t)(alignment - 1));
+  };
+  char *result = align(current);
+  if (!current || (result + size > end)) {
+    addBlock(size + alignment);
+    result = align(current);
+  }
+  current = result + size;
+  used += size;
+  return result;
+}
+
+void Arena::reset() {
+  if (!blocks)
+    return;
+  // Keep the newest block, which is the biggest
+  Block *keep = blocks;
+  Block *old = keep->next;
+  while (old) {
+    Block *next = old->next;
+    ::operator delete(old);
+    old = next;
+  }
+  keep->next = nullptr;
+  blocks = keep;
+  current = reinterpret_cast<char *>(keep + 1);
+  end = current + keep->size;
+  used = 0;
+}
+
+size_t Arena::capacity() const {
+  size_t result = 0;
+  for (Block *block = blocks; block; block = block->next)
+    result += block->size;
+  return result;
+}
+
+} /* RESTClient */
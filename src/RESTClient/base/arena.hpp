@@ -0,0 +1,78 @@
+/// A monotonic arena, and a pmr style allocator that uses it.
+///
+/// Allocating from an Arena is a pointer bump, and freeing does nothing.
+/// reset() frees everything at once and keeps the biggest block, so after
+/// warming up, a connection's per request storage comes from the same memory
+/// every time instead of a malloc shared with every other thread.
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace RESTClient {
+
+class Arena {
+private:
+  struct Block {
+    Block *next;
+    size_t size;
+  };
+  /// Newest (and biggest) first. Each block's storage follows its header
+  Block *blocks = nullptr;
+  char *current = nullptr;
+  char *end = nullptr;
+  size_t nextBlockSize;
+  size_t used = 0;
+  void addBlock(size_t minimum);
+
+public:
+  explicit Arena(size_t firstBlockSize = 4096)
+      : nextBlockSize(firstBlockSize) {}
+  Arena(const Arena &) = delete;
+  ~Arena();
+  void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+  /// Frees everything allocated since the last reset. Nothing allocated
+  /// from the arena may be used after this
+  void reset();
+  /// Bytes handed out since the last reset
+  size_t bytesUsed() const { return used; }
+  /// Bytes held from the heap
+  size_t capacity() const;
+};
+
+/// Allocates from an Arena, or from the heap when it has none; like
+/// std::pmr::polymorphic_allocator, but without needing C++17's
+/// <memory_resource>
+template <typename T> class ArenaAllocator {
+public:
+  using value_type = T;
+  Arena *arena;
+  ArenaAllocator(Arena *arena = nullptr) noexcept : arena(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) noexcept
+      : arena(other.arena) {}
+  T *allocate(size_t n) {
+    if (arena)
+      return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t) noexcept {
+    if (!arena)
+      ::operator delete(p);
+  }
+  /// Copies of containers go on the heap, so copying is how things get out of
+  /// an arena before it's reset
+  ArenaAllocator select_on_container_copy_construction() const { return {}; }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+  return a.arena == b.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+  return a.arena != b.arena;
+}
+
+} /* RESTClient */
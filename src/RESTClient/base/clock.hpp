@@ -0,0 +1,10 @@
+#pragma once
+
+#include <chrono>
+
+namespace RESTClient {
+
+/// The monotonic clock we use for all our timing, rate limiting and deadlines
+using Clock = std::chrono::steady_clock;
+
+} /* RESTClient */
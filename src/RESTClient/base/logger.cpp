@@ -1,9 +1,400 @@
 #include "logger.hpp"
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
 namespace RESTClient {
 
-#if MIN_LOG_LEVEL != NONE
-std::string log_channel;
+namespace {
+
+constexpr uint64_t ringSize = 1 << 18; // Bytes per thread; a power of two
+constexpr uint32_t maxMessage = ringSize / 4; // Longer messages are truncated
+
+/// The front of each message in a ring. The text follows it
+struct Record {
+  /// Size of the whole record, rounded up to 8 bytes. 0 means skip to the
+  /// start of the ring
+  uint32_t size;
+  int32_t level;
+  int32_t line;
+  uint32_t length;
+  const char *file;
+  const char *function;
+};
+
+/// One thread's messages. Only that thread writes, only the writer thread
+/// reads
+struct Ring {
+  std::atomic<uint64_t> head{0}; // Where the next record goes
+  std::atomic<uint64_t> tail{0}; // The next record to write out
+  std::atomic<bool> orphaned{false}; // The thread has finished
+  alignas(8) char data[ringSize];
+};
+
+/// A streambuf that appends to a string, so we can reuse its capacity
+class StringBuf : public std::streambuf {
+public:
+  std::string text;
+
+protected:
+  int_type overflow(int_type c) override {
+    if (c != traits_type::eof())
+      text.push_back(static_cast<char>(c));
+    return c;
+  }
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    text.append(s, n);
+    return n;
+  }
+};
+
+const char *levelName(int level) {
+  switch (level) {
+  case LOG_LEVEL_TRACE:
+    return "TRACE";
+  case LOG_LEVEL_DEBUG:
+    return "DEBUG";
+  case LOG_LEVEL_INFO:
+    return "INFO";
+  case LOG_LEVEL_WARN:
+    return "WARNING";
+  case LOG_LEVEL_ERROR:
+    return "ERROR";
+  default:
+    return "FATAL";
+  };
+}
+
+/// Turns a __FILE__ into the name of the directory it's in
+std::string moduleName(const char *file) {
+  std::string path(file);
+  std::replace(path.begin(), path.end(), '\\', '/');
+  size_t end = path.rfind('/');
+  if ((end == std::string::npos) || (end == 0))
+    return "";
+  size_t start = path.rfind('/', end - 1);
+  start = (start == std::string::npos) ? 0 : start + 1;
+  return path.substr(start, end - start);
+}
+
+/// Owns the rings, the module levels, and the background writer thread
+class Logger {
+private:
+  std::mutex lock;
+  std::condition_variable wake;
+  std::condition_variable flushed;
+  std::vector<std::unique_ptr<Ring>> rings;
+  std::map<std::string, std::unique_ptr<std::atomic<int>>> modules;
+  int defaultLevel = LOG_LEVEL_TRACE;
+  std::ostream *out = &std::clog;
+  uint64_t flushesWanted = 0;
+  uint64_t flushesDone = 0;
+  uint64_t dropsReported = 0;
+  bool stopping = false;
+  std::thread writer;
+
+  /// Writes out everything in a ring. Returns true if there was anything
+  bool drain(Ring &ring) {
+    uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    if (tail == head)
+      return false;
+    while (tail != head) {
+      uint64_t offset = tail & (ringSize - 1);
+      const Record &record =
+          *reinterpret_cast<const Record *>(ring.data + offset);
+      if (record.size == 0) {
+        tail += ringSize - offset;
+        continue;
+      }
+      write(record, ring.data + offset + sizeof(Record));
+      tail += record.size;
+    }
+    ring.tail.store(tail, std::memory_order_release);
+    return true;
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+      uint64_t flushing = flushesWanted;
+      bool stop = stopping;
+      bool wrote = false;
+      for (auto &ring : rings)
+        wrote |= drain(*ring);
+      uint64_t drops = dropped.load(std::memory_order_relaxed);
+      if (drops != dropsReported) {
+        *out << "WARNING - " << (drops - dropsReported)
+             << " log messages dropped; a thread's log buffer was full\n";
+        dropsReported = drops;
+        wrote = true;
+      }
+      // Forget finished threads once everything they said is out
+      rings.erase(std::remove_if(rings.begin(), rings.end(),
+                                 [](const std::unique_ptr<Ring> &ring) {
+                                   return ring->orphaned &&
+                                          (ring->head == ring->tail);
+                                 }),
+                  rings.end());
+      if (wrote || (flushing != flushesDone))
+        out->flush();
+      if (flushing != flushesDone) {
+        flushesDone = flushing;
+        flushed.notify_all();
+      }
+      if (stop)
+        return;
+      // Loggers never wake us (that would cost them a syscall), so poll
+      if (!wrote)
+        wake.wait_for(guard, std::chrono::milliseconds(10));
+    }
+  }
+
+public:
+  Logger() {
+    if (const char *spec = std::getenv("RESTCLIENT_LOG")) {
+      try {
+        configure(spec);
+      } catch (std::invalid_argument &e) {
+        std::clog << "Ignoring RESTCLIENT_LOG: " << e.what() << std::endl;
+      }
+    }
+    writer = std::thread([this]() { run(); });
+  }
+
+  /// Writes out what's left and stops the writer thread. Anything logged
+  /// after this is written straight out
+  void stop() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (stopping)
+        return;
+      stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    stopped.store(true, std::memory_order_release);
+    // Catch anything logged while the writer was finishing up
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &ring : rings)
+      drain(*ring);
+    out->flush();
+  }
+
+  /// Writes one message. Only called with 'lock' held
+  void write(const Record &record, const char *text) {
+#ifdef LOG_LOCATION
+    *out << levelName(record.level) << " - Line: " << record.line
+         << " - File: " << record.file << " - Function: " << record.function
+         << " - Msg: ";
+#else
+    *out << levelName(record.level) << " - ";
 #endif
-  
+    out->write(text, record.length);
+    *out << '\n';
+  }
+
+  /// Writes straight out, for when the writer thread has gone
+  void writeNow(const Record &record, const char *text) {
+    std::lock_guard<std::mutex> guard(lock);
+    write(record, text);
+    out->flush();
+  }
+
+  Ring *newRing() {
+    std::unique_ptr<Ring> ring(new Ring());
+    Ring *result = ring.get();
+    std::lock_guard<std::mutex> guard(lock);
+    rings.emplace_back(std::move(ring));
+    return result;
+  }
+
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<bool> stopped{false};
+
+  const std::atomic<int> &level(const char *file) {
+    std::string name = moduleName(file);
+    std::lock_guard<std::mutex> guard(lock);
+    auto &level = modules[name];
+    if (!level)
+      level.reset(new std::atomic<int>(defaultLevel));
+    return *level;
+  }
+
+  void setLevel(int level) {
+    std::lock_guard<std::mutex> guard(lock);
+    defaultLevel = level;
+    for (auto &module : modules)
+      module.second->store(level, std::memory_order_relaxed);
+  }
+
+  void setLevel(const std::string &module, int level) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto &found = modules[module];
+    if (!found)
+      found.reset(new std::atomic<int>(level));
+    found->store(level, std::memory_order_relaxed);
+  }
+
+  void configure(const std::string &spec) {
+    static const std::map<std::string, int> names{
+        {"trace", LOG_LEVEL_TRACE}, {"debug", LOG_LEVEL_DEBUG},
+        {"info", LOG_LEVEL_INFO},   {"warn", LOG_LEVEL_WARN},
+        {"error", LOG_LEVEL_ERROR}, {"fatal", LOG_LEVEL_FATAL},
+        {"none", LOG_LEVEL_NONE}};
+    auto levelFor = [&](const std::string &name) {
+      auto found = names.find(name);
+      if (found == names.end())
+        throw std::invalid_argument("Unknown log level: " + name);
+      return found->second;
+    };
+    size_t start = 0;
+    while (start < spec.size()) {
+      size_t end = spec.find(',', start);
+      if (end == std::string::npos)
+        end = spec.size();
+      std::string part = spec.substr(start, end - start);
+      size_t equals = part.find('=');
+      if (equals == std::string::npos)
+        setLevel(levelFor(part));
+      else
+        setLevel(part.substr(0, equals), levelFor(part.substr(equals + 1)));
+      start = end + 1;
+    }
+  }
+
+  void setOutput(std::ostream &output) {
+    std::lock_guard<std::mutex> guard(lock);
+    out->flush();
+    out = &output;
+  }
+
+  void flush() {
+    std::unique_lock<std::mutex> guard(lock);
+    if (stopping)
+      return;
+    uint64_t wanted = ++flushesWanted;
+    wake.notify_one();
+    flushed.wait(guard, [&]() { return flushesDone >= wanted; });
+  }
+};
+
+/// Never destroyed, as threads may log (and own rings) until the very end
+Logger &logger() {
+  static Logger *instance = new Logger();
+  return *instance;
+}
+
+/// Empties the rings on the way out
+struct StopAtExit {
+  ~StopAtExit() { logger().stop(); }
+} stopAtExit;
+
+/// This thread's formatting buffer and ring
+struct ThreadLog {
+  Ring *ring;
+  StringBuf buffer;
+  std::ostream stream;
+  bool busy = false;
+  ThreadLog() : ring(logger().newRing()), stream(&buffer) {
+    buffer.text.reserve(1024);
+  }
+  ~ThreadLog() { ring->orphaned = true; }
+
+  /// Copies a message into the ring; drops it if there's no room
+  void commit(const Record &header, const std::string &text) {
+    Record record(header);
+    record.length = std::min<uint64_t>(text.size(), maxMessage);
+    record.size = (sizeof(Record) + record.length + 7) & ~7u;
+    if (logger().stopped.load(std::memory_order_acquire)) {
+      logger().writeNow(record, text.data());
+      return;
+    }
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    uint64_t offset = head & (ringSize - 1);
+    uint64_t untilEnd = ringSize - offset;
+    // Records don't wrap; skip the end of the ring if it won't fit
+    uint64_t needed = record.size + (record.size > untilEnd ? untilEnd : 0);
+    if (ringSize - (head - tail) < needed) {
+      logger().dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    if (record.size > untilEnd) {
+      reinterpret_cast<Record *>(ring->data + offset)->size = 0;
+      head += untilEnd;
+      offset = 0;
+    }
+    std::memcpy(ring->data + offset, &record, sizeof(Record));
+    std::memcpy(ring->data + offset + sizeof(Record), text.data(),
+                record.length);
+    ring->head.store(head + record.size, std::memory_order_release);
+  }
+};
+
+ThreadLog &threadLog() {
+  thread_local ThreadLog mine;
+  return mine;
+}
+
+} // anonymous namespace
+
+const std::atomic<int> &moduleLogLevel(const char *file) {
+  return logger().level(file);
+}
+
+void setLogLevel(int level) { logger().setLevel(level); }
+
+void setLogLevel(const std::string &module, int level) {
+  logger().setLevel(module, level);
+}
+
+void configureLogging(const std::string &spec) { logger().configure(spec); }
+
+void setLogOutput(std::ostream &out) { logger().setOutput(out); }
+
+void flushLog() { logger().flush(); }
+
+uint64_t droppedLogMessages() {
+  return logger().dropped.load(std::memory_order_relaxed);
+}
+
+LogLine::LogLine(int level, const char *file, int line, const char *function)
+    : level(level), file(file), line(line), function(function) {
+  ThreadLog &mine = threadLog();
+  if (mine.busy) {
+    nested.reset(new std::ostringstream());
+    out = nested.get();
+    return;
+  }
+  mine.busy = true;
+  mine.buffer.text.clear();
+  // Undo anything the last message did to the stream
+  mine.stream.clear();
+  mine.stream.flags(std::ios_base::skipws | std::ios_base::dec);
+  mine.stream.precision(6);
+  mine.stream.width(0);
+  mine.stream.fill(' ');
+  out = &mine.stream;
+}
+
+LogLine::~LogLine() {
+  ThreadLog &mine = threadLog();
+  Record header{0, level, line, 0, file, function};
+  if (nested) {
+    mine.commit(header, nested->str());
+    return;
+  }
+  mine.commit(header, mine.buffer.text);
+  mine.busy = false;
+}
+
 } /* RESTClient */
@@ -1,7 +1,25 @@
+/// Logging.
+///
+/// A message is formatted on the calling thread into a reused per thread
+/// buffer, then copied into that thread's ring buffer. A background thread
+/// writes the rings out (to std::clog by default), so logging never flushes,
+/// takes a lock or does I/O on the event loop thread. If a thread's ring is
+/// full, its messages are dropped (and counted) rather than waiting.
+///
+/// Levels below MIN_LOG_LEVEL are compiled out. On top of that each module
+/// (the directory a source file is in, eg. "http" or "jobManagement") has a
+/// run time level; see setLogLevel and configureLogging.
+///
+/// Logging never throws. LOG_ERROR and LOG_FATAL only log; raise your own
+/// exceptions for errors.
 #pragma once
 
-#include <string>
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
 
 namespace RESTClient {
 
@@ -18,71 +36,101 @@ namespace RESTClient {
 #define MIN_LOG_LEVEL LOG_LEVEL_NONE
 #endif
 
-#ifdef LOG_LOCATION
+/// The run time level of the module that 'file' (a __FILE__) is in. Each log
+/// statement looks this up once and keeps the reference
+const std::atomic<int> &moduleLogLevel(const char *file);
+
+/// Sets the run time level of every module
+void setLogLevel(int level);
+
+/// Sets the run time level of one module, eg. setLogLevel("http",
+/// LOG_LEVEL_DEBUG)
+void setLogLevel(const std::string &module, int level);
+
+/// Sets levels from a spec like "info,http=debug,jobManagement=trace"; a
+/// level on its own applies to every module. Level names are trace, debug,
+/// info, warn, error, fatal and none. The RESTCLIENT_LOG environment variable
+/// is read this way on start up. Throws std::invalid_argument on a bad spec
+void configureLogging(const std::string &spec);
+
+/// Where the background thread writes messages (std::clog by default). 'out'
+/// must outlive all logging
+void setLogOutput(std::ostream &out);
+
+/// Blocks until everything logged so far has been written and flushed
+void flushLog();
+
+/// How many messages were dropped because a thread's ring buffer was full
+uint64_t droppedLogMessages();
+
+/// One message being formatted. Commits it to this thread's ring buffer when
+/// destroyed
+class LogLine {
+private:
+  int level;
+  const char *file;
+  int line;
+  const char *function;
+  // Only used when a log statement's arguments log something themselves
+  std::unique_ptr<std::ostringstream> nested;
+  std::ostream *out;
+
+public:
+  LogLine(int level, const char *file, int line, const char *function);
+  LogLine(const LogLine &) = delete;
+  ~LogLine();
+  std::ostream &stream() { return *out; }
+};
+
 #define LOG(LEVEL, ARG)                                                        \
-  std::clog << LEVEL << " - Line: " << __LINE__ << " - File: " << __FILE__     \
-            << " - Function: " << __FUNCTION__ << " - Msg: " << ARG            \
-            << std::endl;
-#else
-#define LOG(LEVEL, ARG) std::clog << LEVEL << " - " << ARG << std::endl;
-#endif
+  {                                                                            \
+    static const std::atomic<int> &logLevel =                                  \
+        ::RESTClient::moduleLogLevel(__FILE__);                                \
+    if (LEVEL >= logLevel.load(std::memory_order_relaxed))                     \
+      ::RESTClient::LogLine(LEVEL, __FILE__, __LINE__, __FUNCTION__).stream()  \
+          << ARG;                                                              \
+  }
 
 #if MIN_LOG_LEVEL <= LOG_LEVEL_TRACE
-#define LOG_TRACE(ARG) LOG("TRACE", ARG);
+#define LOG_TRACE(ARG) LOG(LOG_LEVEL_TRACE, ARG);
 #else
 #define LOG_TRACE(ARG)
 #endif
 
 #if MIN_LOG_LEVEL <= LOG_LEVEL_DEBUG
-#define LOG_DEBUG(ARG) LOG("DEBUG", ARG);
+#define LOG_DEBUG(ARG) LOG(LOG_LEVEL_DEBUG, ARG);
 #else
 #define LOG_DEBUG(ARG)
 #endif
 
 #if MIN_LOG_LEVEL <= LOG_LEVEL_INFO
-#define LOG_INFO(ARG) LOG("INFO", ARG);
+#define LOG_INFO(ARG) LOG(LOG_LEVEL_INFO, ARG);
 #else
 #define LOG_INFO(ARG)
 #endif
 
 #if MIN_LOG_LEVEL <= LOG_LEVEL_WARN
-#define LOG_WARN(ARG) LOG("WARNING", ARG);
+#define LOG_WARN(ARG) LOG(LOG_LEVEL_WARN, ARG);
 #else
 #define LOG_WARN(ARG)
 #endif
 
 #if MIN_LOG_LEVEL <= LOG_LEVEL_ERROR
-#define LOG_ERROR(ARG)                                                         \
-  {                                                                            \
-    LOG("ERROR", ARG)                                                          \
-    std::stringstream __msg;                                                   \
-    __msg << "ERROR: " << ARG;                                                 \
-    throw std::runtime_error(__msg.str());                                     \
-  }
+#define LOG_ERROR(ARG) LOG(LOG_LEVEL_ERROR, ARG);
 #else
-#define LOG_ERROR(ARG)                                                         \
-  {                                                                            \
-    std::stringstream __msg;                                                   \
-    __msg << "ERROR: " << ARG;                                                 \
-    throw std::runtime_error(__msg.str());                                     \
-  }
+#define LOG_ERROR(ARG)
 #endif
 
+// Fatal messages are written out before carrying on, as the program is
+// probably about to die
 #if MIN_LOG_LEVEL <= LOG_LEVEL_FATAL
 #define LOG_FATAL(ARG)                                                         \
   {                                                                            \
-    LOG("FATAL", ARG);                                                         \
-    std::stringstream __msg;                                                   \
-    __msg << "FATAL ERROR: " << ARG;                                           \
-    throw std::runtime_error(__msg.str());                                     \
+    LOG(LOG_LEVEL_FATAL, ARG);                                                 \
+    ::RESTClient::flushLog();                                                  \
   }
 #else
-#define LOG_FATAL(ARG)                                                         \
-  {                                                                            \
-    std::stringstream __msg;                                                   \
-    __msg << "FATAL ERROR: " << ARG;                                           \
-    throw std::runtime_error(__msg.str());                                     \
-  }
+#define LOG_FATAL(ARG)
 #endif
 
 } /* RESTClient */
@@ -0,0 +1,65 @@
+#include <RESTClient/base/arena.hpp>
+
+#include <cstdint>
+#include <map>
+#include <scoped_allocator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace RESTClient;
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+using String = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+using Map = std::map<String, String, std::less<>,
+                     std::scoped_allocator_adaptor<
+                         ArenaAllocator<std::pair<const String, String>>>>;
+
+int main(int argc, char *argv[]) {
+  Arena arena(64);
+
+  // Alignment is kept, and big allocations get their own block
+  arena.allocate(1, 1);
+  void *aligned = arena.allocate(8, 8);
+  EQ(reinterpret_cast<uintptr_t>(aligned) % 8, 0);
+  arena.allocate(1000);
+  EQ(arena.bytesUsed(), 1009);
+
+  // Reset keeps the newest (biggest) block, and reuses it
+  size_t biggest = arena.capacity();
+  arena.reset();
+  EQ(arena.bytesUsed(), 0);
+  EQ((arena.capacity() <= biggest), true);
+  EQ((arena.capacity() >= 1000), true);
+  void *first = arena.allocate(16);
+  arena.reset();
+  EQ(arena.allocate(16), first);
+
+  // Containers hand the arena on to their strings
+  {
+    Map map(&arena);
+    map.emplace("a key too long for the small string buffer",
+                "and a value that is also too long for it");
+    EQ(map.begin()->second.get_allocator().arena, &arena);
+    // Copies go on the heap
+    Map copy(map);
+    EQ((copy.get_allocator().outer_allocator().arena == nullptr), true);
+    EQ((copy.begin()->second.get_allocator().arena == nullptr), true);
+    EQ(copy.begin()->second, "and a value that is also too long for it");
+    // The heap is used without an arena
+    std::vector<int, ArenaAllocator<int>> onHeap(100, 1);
+    EQ((onHeap.get_allocator().arena == nullptr), true);
+  }
+  arena.reset();
+
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include <RESTClient/base/logger.hpp>
+
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace RESTClient;
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+/// What the LOG macro does, as if from 'file'
+void logFrom(const char *file, int level, const std::string &text) {
+  if (level >= moduleLogLevel(file).load(std::memory_order_relaxed))
+    LogLine(level, file, __LINE__, __FUNCTION__).stream() << text;
+}
+
+const char *http = "src/RESTClient/http/fake.cpp";
+const char *jobs = "src/RESTClient/jobManagement/fake.cpp";
+const char *metrics = "src/RESTClient/metrics/fake.cpp";
+
+int main(int argc, char *argv[]) {
+  // Read when the logger starts, which is the first time anything logs
+  setenv("RESTCLIENT_LOG", "error,base=info", 1);
+  EQ(moduleLogLevel(__FILE__).load(), LOG_LEVEL_INFO);
+  EQ(moduleLogLevel(http).load(), LOG_LEVEL_ERROR);
+
+  std::stringstream out;
+  setLogOutput(out);
+  configureLogging("warn,http=debug,jobManagement=none");
+  EQ(moduleLogLevel(http).load(), LOG_LEVEL_DEBUG);
+  EQ(moduleLogLevel(metrics).load(), LOG_LEVEL_WARN);
+  for (const char *bad : {"loud", "http=loud"}) {
+    bool threw = false;
+    try {
+      configureLogging(bad);
+    } catch (std::invalid_argument &) {
+      threw = true;
+    }
+    EQ(threw, true);
+  }
+
+  // Each thread's messages come out in the order it logged them; only the
+  // ones at or above their module's level
+  const int threads = 4;
+  const int messages = 1000;
+  std::vector<std::thread> loggers;
+  for (int t = 0; t != threads; ++t)
+    loggers.emplace_back([t] {
+      for (int i = 0; i != messages; ++i) {
+        std::string text =
+            "thread " + std::to_string(t) + " message " + std::to_string(i);
+        logFrom(http, LOG_LEVEL_INFO, text);
+        logFrom(http, LOG_LEVEL_TRACE, "hidden " + text);
+        logFrom(jobs, LOG_LEVEL_FATAL, "hidden " + text);
+        logFrom(metrics, LOG_LEVEL_INFO, "hidden " + text);
+        if (i % 100 == 0)
+          logFrom(metrics, LOG_LEVEL_WARN, "warned " + text);
+      }
+    });
+  for (auto &thread : loggers)
+    thread.join();
+  flushLog();
+
+  std::map<int, int> next;
+  int warnings = 0;
+  std::string line;
+  while (std::getline(out, line)) {
+    EQ(line.find("hidden"), std::string::npos);
+    if (line.find("warned") != std::string::npos) {
+      EQ(line.compare(0, 10, "WARNING - "), 0);
+      ++warnings;
+      continue;
+    }
+    EQ(line.compare(0, 7, "INFO - "), 0);
+    int thread;
+    int message;
+    std::istringstream words(line.substr(line.find("thread ")));
+    std::string word;
+    words >> word >> thread >> word >> message;
+    EQ(message, next[thread]);
+    ++next[thread];
+  }
+  EQ(next.size(), threads);
+  for (const auto &counted : next)
+    EQ(counted.second, messages);
+  EQ(warnings, threads * messages / 100);
+  EQ(droppedLogMessages(), 0);
+
+  setLogOutput(std::clog);
+  return 0;
+}
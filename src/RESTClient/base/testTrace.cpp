@@ -0,0 +1,103 @@
+#include <RESTClient/base/trace.hpp>
+
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+using namespace RESTClient;
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+/// What a connection's spans look like: an action, with the phases of
+/// connecting inside it
+void connection(const void *id) {
+  TraceSpan action("action", traceId(id));
+  {
+    TraceSpan connect("ensureConnection", traceId(id));
+    { TraceSpan dns("dns", traceId(id)); }
+    { TraceSpan tcp("connect", traceId(id)); }
+    { TraceSpan tls("tlsHandshake", traceId(id)); }
+  }
+  traceEvent("sent", traceId(id), 'n');
+}
+
+int main(int argc, char *argv[]) {
+  int first = 0;
+  int second = 0;
+  clearTrace();
+  connection(&first);
+  std::thread other([&] { connection(&second); });
+  other.join();
+
+  std::stringstream json;
+  writeTrace(json);
+  // The stream's formatting is as it was
+  EQ(json.precision(), std::stringstream().precision());
+  EQ((json.flags() == std::stringstream().flags()), true);
+  boost::property_tree::ptree trace;
+  boost::property_tree::read_json(json, trace);
+
+  // Each connection's spans nest, in time order, on one thread
+  std::map<std::string, std::vector<std::string>> open;
+  std::map<std::string, std::string> threads;
+  std::map<std::string, double> last;
+  std::map<std::string, std::vector<std::string>> seen;
+  size_t events = 0;
+  for (const auto &item : trace.get_child("traceEvents")) {
+    const auto &event = item.second;
+    std::string id = event.get<std::string>("id");
+    std::string name = event.get<std::string>("name");
+    std::string phase = event.get<std::string>("ph");
+    std::string thread = event.get<std::string>("tid");
+    double ts = event.get<double>("ts");
+    EQ(event.get<std::string>("cat"), "RESTClient");
+    if (threads.count(id))
+      EQ(threads[id], thread);
+    threads[id] = thread;
+    EQ((ts >= last[id]), true);
+    last[id] = ts;
+    if (phase == "b") {
+      open[id].push_back(name);
+      seen[id].push_back(name);
+    } else if (phase == "e") {
+      EQ(open[id].empty(), false);
+      EQ(open[id].back(), name);
+      open[id].pop_back();
+    } else {
+      EQ(phase, "n");
+      EQ(open[id].size(), 1);
+    }
+    ++events;
+  }
+  // Five spans and an instant each
+  EQ(events, 2 * 11);
+  EQ(threads.size(), 2);
+  EQ((threads.begin()->second != threads.rbegin()->second), true);
+  for (const auto &spans : seen) {
+    EQ(open[spans.first].empty(), true);
+    std::vector<std::string> expected{"action", "ensureConnection", "dns",
+                                      "connect", "tlsHandshake"};
+    EQ((spans.second == expected), true);
+  }
+
+  // Cleared, there's nothing
+  clearTrace();
+  std::stringstream empty;
+  writeTrace(empty);
+  boost::property_tree::read_json(empty, trace);
+  EQ(trace.get_child("traceEvents").size(), 0);
+  return 0;
+}
@@ -17,9 +17,11 @@ using namespace RESTClient;
 
 #define EQ(a, b)                                                               \
   if (a != b) {                                                                \
-    LOG_ERROR("Expected a == b, but it doesn't. a: "                           \
-              << a << " - b: " << b << " - Line: " << __LINE__ << " - File: "  \
-              << __FILE__ << " - Function: " << __FUNCTION__ << std::endl);    \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
   }
 
 namespace x3 = boost::spirit::x3;
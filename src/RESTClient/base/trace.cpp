@@ -0,0 +1,142 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace RESTClient {
+
+namespace {
+
+/// A cheap timestamp. On x86 it's the TSC (about half the cost of
+/// steady_clock); writeTrace converts ticks to nanoseconds.
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/// A tick count and the steady_clock time it was taken at, to calibrate ticks
+struct ClockPair {
+  uint64_t ticks;
+  std::chrono::steady_clock::time_point time;
+  static ClockPair now() {
+    return {RESTClient::ticks(), std::chrono::steady_clock::now()};
+  }
+};
+
+const ClockPair calibration = ClockPair::now();
+
+constexpr uint64_t ringSize = 1 << 16; // Must be a power of two
+
+/// One thread's events. Only the owning thread writes to it
+struct Ring {
+  uint32_t thread;
+  // Index of the next event to write
+  std::atomic<uint64_t> head{0};
+  // Events before this were cleared
+  std::atomic<uint64_t> tail{0};
+  TraceEvent events[ringSize];
+};
+
+std::mutex ringsLock; // Only taken when a thread first traces, or to dump
+std::vector<std::unique_ptr<Ring>> rings;
+
+Ring &myRing() {
+  thread_local Ring *ring = nullptr;
+  if (ring == nullptr) {
+    std::unique_ptr<Ring> fresh(new Ring());
+    ring = fresh.get();
+    std::lock_guard<std::mutex> lock(ringsLock);
+    ring->thread = static_cast<uint32_t>(rings.size());
+    rings.emplace_back(std::move(fresh));
+  }
+  return *ring;
+}
+
+} // anonymous namespace
+
+void traceEvent(const char *name, uint64_t id, char phase) {
+  Ring &ring = myRing();
+  uint64_t head = ring.head.load(std::memory_order_relaxed);
+  TraceEvent &event = ring.events[head & (ringSize - 1)];
+  event.ticks = ticks();
+  event.name = name;
+  event.id = id;
+  event.thread = ring.thread;
+  event.phase = phase;
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+void clearTrace() {
+  std::lock_guard<std::mutex> lock(ringsLock);
+  for (auto &ring : rings)
+    ring->tail.store(ring->head.load(std::memory_order_acquire),
+                     std::memory_order_relaxed);
+}
+
+void writeTrace(std::ostream &out) {
+  std::vector<TraceEvent> events;
+  {
+    std::lock_guard<std::mutex> lock(ringsLock);
+    for (auto &ring : rings) {
+      uint64_t head = ring->head.load(std::memory_order_acquire);
+      uint64_t first = ring->tail.load(std::memory_order_relaxed);
+      if (head - first > ringSize)
+        first = head - ringSize;
+      size_t start = events.size();
+      for (uint64_t i = first; i != head; ++i)
+        events.push_back(ring->events[i & (ringSize - 1)]);
+      // Skip anything the owning thread overwrote while we were copying
+      uint64_t after = ring->head.load(std::memory_order_acquire);
+      if (after - first > ringSize) {
+        size_t overwritten = std::min<uint64_t>(after - first - ringSize,
+                                                head - first);
+        events.erase(events.begin() + start,
+                     events.begin() + start + overwritten);
+      }
+    }
+  }
+  uint64_t origin = events.empty() ? 0 : events.front().ticks;
+  for (const auto &event : events)
+    origin = std::min(origin, event.ticks);
+  ClockPair end = ClockPair::now();
+  double nanosecondsPerTick = 1.0;
+  if (end.ticks != calibration.ticks)
+    nanosecondsPerTick =
+        std::chrono::duration<double, std::nano>(end.time - calibration.time)
+            .count() /
+        (end.ticks - calibration.ticks);
+
+  // The caller's stream is left as we found it
+  std::ios_base::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto &event : events) {
+    if (!first)
+      out << ',';
+    first = false;
+    out << "\n{\"name\":\"" << event.name << "\",\"cat\":\"RESTClient\""
+        << ",\"ph\":\"" << event.phase << "\",\"pid\":1,\"tid\":"
+        << event.thread << ",\"ts\":"
+        << (event.ticks - origin) * nanosecondsPerTick / 1000.0
+        << ",\"id\":\"0x" << std::hex << event.id << std::dec << "\"}";
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+  out.flags(flags);
+  out.precision(precision);
+}
+
+} /* RESTClient */
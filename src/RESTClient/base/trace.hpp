@@ -0,0 +1,71 @@
+/// Low overhead tracing of spans into per thread ring buffers.
+///
+/// Turn it on with -DTRACING (the cmake TRACING option). Without it, the
+/// TRACE_SPAN and TRACE_INSTANT macros are empty and cost nothing.
+///
+/// Each event is a fixed size binary record written to the calling thread's
+/// ring buffer; no locks, no allocation and no formatting. The buffers can be
+/// dumped as Chrome trace JSON, which chrome://tracing and Perfetto can load.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace RESTClient {
+
+/// One trace event. 'name' must be a string literal (we only keep the pointer)
+struct TraceEvent {
+  /// TSC ticks on x86, otherwise steady_clock nanoseconds
+  uint64_t ticks;
+  const char *name;
+  /// Spans with the same id are shown on the same track; we use the address of
+  /// the connection's stream
+  uint64_t id;
+  uint32_t thread;
+  char phase; // 'b' begin, 'e' end, 'n' instant
+};
+
+/// Records an event in this thread's ring buffer
+void traceEvent(const char *name, uint64_t id, char phase);
+
+/// Writes everything in all the ring buffers as Chrome trace JSON. Best done
+/// when things are quiet; events being overwritten during the dump are skipped
+void writeTrace(std::ostream &out);
+
+/// Forget all recorded events
+void clearTrace();
+
+inline uint64_t traceId(const void *p) { return reinterpret_cast<uintptr_t>(p); }
+inline uint64_t traceId(uint64_t id) { return id; }
+
+/// Records the begin and end of a scope
+class TraceSpan {
+private:
+  const char *name;
+  uint64_t id;
+
+public:
+  TraceSpan(const char *name, uint64_t id) : name(name), id(id) {
+    traceEvent(name, id, 'b');
+  }
+  TraceSpan(const TraceSpan &) = delete;
+  ~TraceSpan() { traceEvent(name, id, 'e'); }
+};
+
+#define TRACE_CONCAT2(A, B) A##B
+#define TRACE_CONCAT(A, B) TRACE_CONCAT2(A, B)
+
+#ifdef TRACING
+#define TRACE_SPAN(NAME, ID)                                                   \
+  ::RESTClient::TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(                   \
+      NAME, ::RESTClient::traceId(ID));
+#define TRACE_INSTANT(NAME, ID)                                                \
+  ::RESTClient::traceEvent(NAME, ::RESTClient::traceId(ID), 'n');
+#else
+#define TRACE_SPAN(NAME, ID)
+#define TRACE_INSTANT(NAME, ID)
+#endif
+
+} /* RESTClient */
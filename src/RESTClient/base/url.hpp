@@ -2,6 +2,7 @@
 
 #include <ostream>
 #include <map>
+#include <string>
 
 #include <boost/optional/optional_io.hpp>
 
@@ -25,6 +26,13 @@ struct HostInfo {
       return is_ssl() ? 443 : 80;
   }
   bool is_ssl() const { return (protocol == "https") ? true : false; }
+  /// What to send in the 'Host' header: the hostname, and the port if it's
+  /// not the default
+  string hostHeader() const {
+    if (port && (port.get() != (is_ssl() ? 443 : 80)))
+      return hostname + ":" + std::to_string(port.get());
+    return hostname;
+  }
   operator std::string() const {
     std::string result = protocol + "://";
     if ((!username.empty()) || (!password.empty()))
@@ -32,7 +32,10 @@ auto const path_def = char_('/') >> +(~char_("?%") | quoted_char) >> &(eoi | '?'
 
 // userpass
 auto const user_or_pass_def = +~char_(":@") >> !host_terminator_all;
-auto const userpass = (user_or_pass >> -(':' >> user_or_pass) >> '@');
+// Look for the '@' first, so a failed try doesn't leave the hostname in the
+// username
+auto const userpass = &(+~char_("@/") >> '@') >>
+                      (user_or_pass >> -(':' >> user_or_pass) >> '@');
 
 // query_string
 auto const query_word = +(~char_("&=%") | quoted_char);
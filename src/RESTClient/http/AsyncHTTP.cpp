@@ -0,0 +1,284 @@
+#include "AsyncHTTP.hpp"
+
+#if (BOOST_VERSION >= 107000) && defined(BOOST_ASIO_HAS_CO_AWAIT)
+
+#include "HTTP_ReadReply.hpp"
+
+#include <RESTClient/base/logger.hpp>
+
+#include <sstream>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/ssl/rfc2818_verification.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/write.hpp>
+
+namespace RESTClient {
+
+AsyncHTTP::AsyncHTTP(const HostInfo &hostInfo)
+    : hostInfo(hostInfo), services(Services::instance()),
+      metrics(Metrics::instance().local(Metrics::hostLabel(hostInfo))),
+      socket(services.io_service) {}
+
+AsyncHTTP::~AsyncHTTP() {
+  if (is_open()) {
+    LOG_FATAL("AsyncHTTP Connection to "
+              << hostInfo.hostname
+              << " should have been closed before destruction");
+  }
+}
+
+asio::awaitable<void> AsyncHTTP::ensureConnection(HTTPTimings &timings) {
+  timings.reusedConnection = is_open();
+  if (timings.reusedConnection) {
+    metrics.connectionsReused.add();
+    co_return;
+  }
+  metrics.connectionsOpened.add();
+  auto phaseStart = Clock::now();
+  auto endpoints = co_await services.resolver.async_resolve(
+      {hostInfo.hostname, std::to_string(hostInfo.getPort())},
+      asio::use_awaitable);
+  auto phaseEnd = Clock::now();
+  timings.dns = phaseEnd - phaseStart;
+  phaseStart = phaseEnd;
+  if (hostInfo.is_ssl()) {
+    sslStream.reset(new ssl::stream<tcp::socket>(services.io_service,
+                                                 services.ssl_context));
+    sslStream->set_verify_mode(ssl::verify_peer);
+    sslStream->set_verify_callback(
+        ssl::rfc2818_verification(hostInfo.hostname));
+    co_await asio::async_connect(sslStream->lowest_layer(), endpoints,
+                                 asio::use_awaitable);
+    phaseEnd = Clock::now();
+    timings.connect = phaseEnd - phaseStart;
+    phaseStart = phaseEnd;
+    co_await sslStream->async_handshake(ssl::stream<tcp::socket>::client,
+                                        asio::use_awaitable);
+    timings.tlsHandshake = Clock::now() - phaseStart;
+  } else {
+    co_await asio::async_connect(socket, endpoints, asio::use_awaitable);
+    timings.connect = Clock::now() - phaseStart;
+  }
+}
+
+template <typename Connection>
+asio::awaitable<void> AsyncHTTP::send(Connection &connection,
+                                      HTTPRequest &request) {
+  std::string &head = buffers.outgoing;
+  head.clear();
+  appendRequestHead(head, request);
+  RequestWriter &writer = buffers.writer;
+  writer.start(head, request.body);
+  while (writer.next())
+    outgoingByteCounter += co_await asio::async_write(
+        connection, writer.buffers(), asio::use_awaitable);
+}
+
+template <typename Connection>
+asio::awaitable<bool> AsyncHTTP::receive(Connection &connection,
+                                         HTTPResponse &response) {
+  HTTPParser &parser = buffers.parser;
+  parser.start(response, buffers.spareHeaders);
+  auto waitStart = Clock::now();
+  auto bodyStart = waitStart;
+  auto headersDone = [&]() {
+    bodyStart = Clock::now();
+    response.timings.timeToFirstByte = bodyStart - waitStart;
+  };
+  bool closed = false;
+  while (!parseIncoming(buffers, response, headersDone)) {
+    if (buffers.decoder.paused()) {
+      boost::system::error_code ec;
+      co_await buffers.decoder.streaming()->asyncWaitForResume(
+          asio::redirect_error(asio::use_awaitable, ec));
+      continue;
+    }
+    if (closed) {
+      parser.finish();
+      break;
+    }
+    boost::system::error_code ec;
+    incomingByteCounter += co_await asio::async_read(
+        connection, buffers.incoming, asio::transfer_at_least(parser.wanted()),
+        asio::redirect_error(asio::use_awaitable, ec));
+    if (connectionClosed(ec))
+      closed = true;
+    else if (ec)
+      throw boost::system::system_error(ec);
+  }
+  inFlight = false;
+  buffers.decoder.finish();
+  response.timings.bodyTransfer = Clock::now() - bodyStart;
+  if (closed || !parser.isKeepAlive())
+    co_await close();
+  co_return parser.isOK();
+}
+
+asio::awaitable<bool> AsyncHTTP::perform(HTTPRequest &request,
+                                         HTTPResponse &response) {
+  response.code = 0;
+  buffers.spareHeaders.recycle(response.headers);
+  response.body.clear();
+  response.timings = HTTPTimings();
+  HTTPTimings &timings = response.timings;
+  timings.start = Clock::now();
+  size_t bytesSentBefore = outgoingByteCounter;
+  size_t bytesReceivedBefore = incomingByteCounter;
+  co_await ensureConnection(timings);
+  addDefaultHeaders(request, hostInfo);
+  auto writeStart = Clock::now();
+  bool ok;
+  inFlight = true;
+  if (hostInfo.is_ssl()) {
+    co_await send(*sslStream, request);
+    timings.requestWrite = Clock::now() - writeStart;
+    ok = co_await receive(*sslStream, response);
+  } else {
+    co_await send(socket, request);
+    timings.requestWrite = Clock::now() - writeStart;
+    ok = co_await receive(socket, response);
+  }
+  timings.wireBytesSent = outgoingByteCounter - bytesSentBefore;
+  timings.wireBytesReceived = incomingByteCounter - bytesReceivedBefore;
+  metrics.status(response.code);
+  metrics.bytesSent.add(timings.wireBytesSent);
+  metrics.bytesReceived.add(timings.wireBytesReceived);
+  metrics.latency.record(
+      HostMetrics::nanoseconds(Clock::now() - timings.start));
+  for (auto &observer : responseObservers)
+    observer(response);
+  co_return ok;
+}
+
+void AsyncHTTP::abandonResponse() {
+  // Don't leave the rest of the request or its response on the connection
+  if (!inFlight)
+    return;
+  inFlight = false;
+  if (!is_open())
+    return;
+  metrics.connectionsClosed.add();
+  boost::system::error_code ec;
+  if (hostInfo.is_ssl())
+    sslStream->lowest_layer().close(ec);
+  else
+    socket.close(ec);
+  // And what we'd read of it
+  buffers.incoming.consume(buffers.incoming.size());
+}
+
+asio::awaitable<void> AsyncHTTP::action(HTTPRequest &request,
+                                        HTTPResponse &response) {
+  bool ok;
+  try {
+    ok = co_await perform(request, response);
+  } catch (...) {
+    abandonResponse();
+    throw;
+  }
+  if (!ok)
+    throw HTTPError(response.code, response.body);
+}
+
+asio::awaitable<void> AsyncHTTP::action(HTTPRequest &request,
+                                        HTTPResponse &response,
+                                        StreamedBody &body) {
+  buffers.decoder.streamTo(&body);
+  bool ok;
+  try {
+    ok = co_await perform(request, response);
+  } catch (...) {
+    buffers.decoder.streamTo(nullptr);
+    abandonResponse();
+    throw;
+  }
+  buffers.decoder.streamTo(nullptr);
+  if (!ok)
+    throw HTTPError(response.code);
+}
+
+asio::awaitable<HTTPOutcome> AsyncHTTP::tryAction(HTTPRequest &request,
+                                                  HTTPResponse &response) {
+  HTTPOutcome outcome;
+  outcome.response = &response;
+  try {
+    co_await perform(request, response);
+    outcome.code = response.code;
+  } catch (std::exception &e) {
+    abandonResponse();
+    outcome.error = e.what();
+    outcome.failure = std::current_exception();
+  }
+  co_return outcome;
+}
+
+asio::awaitable<HTTPResponse> AsyncHTTP::action(HTTPRequest &request) {
+  HTTPResponse response;
+  co_await action(request, response);
+  co_return response;
+}
+
+asio::awaitable<HTTPResponse> AsyncHTTP::get(std::string path,
+                                             Headers headers) {
+  HTTPRequest request("GET", std::move(path), std::move(headers));
+  co_return co_await action(request);
+}
+
+asio::awaitable<void> AsyncHTTP::get(std::string path,
+                                     HTTPResponse &response) {
+  HTTPRequest request("GET", std::move(path));
+  co_await action(request, response);
+}
+
+asio::awaitable<HTTPResponse> AsyncHTTP::del(std::string path) {
+  HTTPRequest request("DELETE", std::move(path));
+  co_return co_await action(request);
+}
+
+asio::awaitable<HTTPResponse> AsyncHTTP::put(std::string path,
+                                             std::string data) {
+  HTTPRequest request("PUT", std::move(path), {}, std::move(data));
+  co_return co_await action(request);
+}
+
+asio::awaitable<HTTPResponse> AsyncHTTP::post(std::string path,
+                                              std::string data) {
+  HTTPRequest request("POST", std::move(path), {}, std::move(data));
+  co_return co_await action(request);
+}
+
+bool AsyncHTTP::is_open() const {
+  if (hostInfo.is_ssl())
+    return sslStream && sslStream->lowest_layer().is_open();
+  return socket.is_open();
+}
+
+void AsyncHTTP::observeResponses(ResponseObserver observer) {
+  responseObservers.emplace_back(std::move(observer));
+}
+
+asio::awaitable<void> AsyncHTTP::close() {
+  if (is_open())
+    metrics.connectionsClosed.add();
+  if (sslStream && sslStream->lowest_layer().is_open()) {
+    boost::system::error_code ec;
+    co_await sslStream->async_shutdown(
+        asio::redirect_error(asio::use_awaitable, ec));
+    sslStream->lowest_layer().close();
+    if (!cleanSSLShutdown(ec)) {
+      std::stringstream msg;
+      msg << "Unabled to shutdown SSL connection: " << ec.category().name()
+          << " (" << ec.value() << ") " << ec.category().message(ec.value());
+      LOG_ERROR(msg.str());
+      throw std::runtime_error(msg.str());
+    }
+  } else if (socket.is_open()) {
+    socket.close();
+  }
+}
+
+} /* RESTClient */
+
+#endif
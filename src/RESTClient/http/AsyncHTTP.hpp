@@ -0,0 +1,87 @@
+/// HTTP for C++20 coroutines. Build with the CO_AWAIT option (C++20 and Boost
+/// 1.70 or newer); otherwise this header is empty.
+///
+/// A request waiting on the net holds a coroutine frame of a few hundred bytes,
+/// where HTTP on a yield_context holds a whole stack, so many more requests can
+/// be in flight per GB. Both share the HTTPParser and HTTPBodyDecoder, so they
+/// behave the same on the wire.
+#pragma once
+
+#include <boost/asio/detail/config.hpp>
+#include <boost/version.hpp>
+
+#if (BOOST_VERSION >= 107000) && defined(BOOST_ASIO_HAS_CO_AWAIT)
+
+// Boost 1.74's awaitable.hpp uses std::exchange without including it
+#include <utility>
+
+#include <boost/asio/awaitable.hpp>
+
+#include <RESTClient/http/HTTP.hpp>
+
+namespace RESTClient {
+
+/// One connection to one host, like HTTP, with requests you co_await
+class AsyncHTTP {
+private:
+  const HostInfo &hostInfo;
+  Services &services;
+  // This thread's metrics for our host
+  HostMetrics &metrics;
+  // Remade for each connection, as a dropped one leaves its SSL state behind
+  std::unique_ptr<ssl::stream<tcp::socket>> sslStream;
+  tcp::socket socket;
+  HTTPConnectionBuffers buffers;
+  /// See HTTP::inFlight
+  bool inFlight = false;
+  size_t incomingByteCounter = 0;
+  size_t outgoingByteCounter = 0;
+  std::vector<ResponseObserver> responseObservers;
+  asio::awaitable<void> ensureConnection(HTTPTimings &timings);
+  template <typename Connection>
+  asio::awaitable<void> send(Connection &connection, HTTPRequest &request);
+  template <typename Connection>
+  asio::awaitable<bool> receive(Connection &connection,
+                                HTTPResponse &response);
+  /// Returns true if the status was 2xx
+  asio::awaitable<bool> perform(HTTPRequest &request, HTTPResponse &response);
+  /// See HTTP::abandonResponse
+  void abandonResponse();
+
+public:
+  explicit AsyncHTTP(const HostInfo &hostInfo);
+  AsyncHTTP(const AsyncHTTP &) = delete;
+  ~AsyncHTTP();
+  /// Performs 'request', filling in 'response' and reusing its storage.
+  /// Adds our default headers to the request. Throws HTTPError if the status
+  /// wasn't 2xx
+  asio::awaitable<void> action(HTTPRequest &request, HTTPResponse &response);
+  /// Never throws; see HTTP::tryAction
+  asio::awaitable<HTTPOutcome> tryAction(HTTPRequest &request,
+                                         HTTPResponse &response);
+  /// Hands the body to 'body' as it arrives, instead of keeping it in
+  /// 'response'. See HTTP::action
+  asio::awaitable<void> action(HTTPRequest &request, HTTPResponse &response,
+                               StreamedBody &body);
+  asio::awaitable<HTTPResponse> action(HTTPRequest &request);
+  asio::awaitable<HTTPResponse> get(std::string path, Headers headers = {});
+  /// A GET that reuses 'response'
+  asio::awaitable<void> get(std::string path, HTTPResponse &response);
+  asio::awaitable<HTTPResponse> del(std::string path);
+  asio::awaitable<HTTPResponse> put(std::string path, std::string data);
+  asio::awaitable<HTTPResponse> post(std::string path, std::string data);
+  bool is_open() const;
+  /// Register a function to be called with every response we read, including
+  /// error responses
+  void observeResponses(ResponseObserver observer);
+  /// Total bytes read from the net over the life of this connection
+  size_t bytesReceived() const { return incomingByteCounter; }
+  /// Total bytes written to the net over the life of this connection
+  size_t bytesSent() const { return outgoingByteCounter; }
+  /// Must be awaited before destruction. Waits for the SSL shutdown
+  asio::awaitable<void> close();
+};
+
+} /* RESTClient */
+
+#endif
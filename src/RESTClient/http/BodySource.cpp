@@ -0,0 +1,137 @@
+#include "BodySource.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+namespace RESTClient {
+
+BodySource &BodySource::add(std::string_view bytes) {
+  Piece piece;
+  piece.bytes = bytes;
+  piece.size = bytes.size();
+  pieces.push_back(std::move(piece));
+  return *this;
+}
+
+BodySource &BodySource::addCopy(std::string bytes) {
+  // On the heap, so the view survives 'pieces' growing
+  auto kept = std::make_shared<const std::string>(std::move(bytes));
+  add(*kept);
+  pieces.back().keep = std::move(kept);
+  return *this;
+}
+
+BodySource &BodySource::addFile(const std::string &path) {
+  using boost::iostreams::mapped_file_source;
+  // An empty file can't be mapped, and adds nothing
+  std::ifstream existing(path, std::fstream::in | std::fstream::ate);
+  if (!existing)
+    throw std::runtime_error("Couldn't open " + path);
+  auto file = std::make_shared<mapped_file_source>();
+  if (existing.tellg() > 0)
+    file->open(path);
+  if (file->is_open())
+    add(std::string_view(file->data(), file->size()));
+  else
+    add(std::string_view());
+  pieces.back().keep = std::move(file);
+  return *this;
+}
+
+BodySource &BodySource::add(Pull pull, long size) {
+  Piece piece;
+  piece.pull = std::move(pull);
+  piece.size = size;
+  pieces.push_back(std::move(piece));
+  return *this;
+}
+
+long BodySource::size() const {
+  long result = 0;
+  for (const Piece &piece : pieces) {
+    if (piece.size < 0)
+      return -1;
+    result += piece.size;
+  }
+  return result;
+}
+
+void BodySource::pullEnded() {
+  const Piece &piece = pieces[current];
+  if ((piece.size >= 0) && (within != size_t(piece.size)))
+    throw std::runtime_error("A body piece ended " +
+                             std::to_string(piece.size - within) +
+                             " bytes short of its size");
+  nextPiece();
+}
+
+size_t BodySource::gather(std::vector<std::string_view> &out, char *scratch,
+                          size_t room) {
+  size_t bytes = 0;
+  size_t used = 0;
+  while ((current != pieces.size()) && (used != room)) {
+    Piece &piece = pieces[current];
+    if (!piece.pull) {
+      std::string_view rest = piece.bytes.substr(within);
+      if (!rest.empty())
+        out.push_back(rest);
+      bytes += rest.size();
+      nextPiece();
+      continue;
+    }
+    size_t wanted = room - used;
+    if (piece.size >= 0)
+      wanted = std::min(wanted, size_t(piece.size) - within);
+    size_t pulled = wanted ? piece.pull(scratch + used, wanted) : 0;
+    if (pulled == 0) {
+      pullEnded();
+      continue;
+    }
+    // Runs of pulled bytes are contiguous in 'scratch', so share a view
+    if (!out.empty() && (out.back().data() + out.back().size() ==
+                         scratch + used))
+      out.back() = std::string_view(out.back().data(),
+                                    out.back().size() + pulled);
+    else
+      out.push_back(std::string_view(scratch + used, pulled));
+    used += pulled;
+    bytes += pulled;
+    within += pulled;
+  }
+  total += bytes;
+  return bytes;
+}
+
+size_t BodySource::read(char *out, size_t size) {
+  size_t bytes = 0;
+  while ((current != pieces.size()) && (bytes != size)) {
+    Piece &piece = pieces[current];
+    size_t wanted = size - bytes;
+    if (piece.size >= 0)
+      wanted = std::min(wanted, size_t(piece.size) - within);
+    size_t got = 0;
+    if (!piece.pull) {
+      std::memcpy(out + bytes, piece.bytes.data() + within, wanted);
+      got = wanted;
+    } else if (wanted) {
+      got = piece.pull(out + bytes, wanted);
+    }
+    if (got == 0) {
+      if (piece.pull)
+        pullEnded();
+      else
+        nextPiece();
+      continue;
+    }
+    bytes += got;
+    within += got;
+  }
+  total += bytes;
+  return bytes;
+}
+
+} /* RESTClient */
@@ -0,0 +1,72 @@
+/// A request body made as it's sent, from pieces: bytes already in memory,
+/// mapped files, and functions that fill a buffer on demand. eg. a multipart
+/// upload is a header, a file, and a footer, none of which need copying
+/// into one string first.
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace RESTClient {
+
+class BodySource {
+public:
+  /// Fills 'out' with up to 'size' bytes, returning how many. It should fill
+  /// as much as it can; 0 means the piece is done
+  using Pull = std::function<size_t(char *out, size_t size)>;
+
+private:
+  struct Piece {
+    /// The bytes, if they're in memory
+    std::string_view bytes;
+    /// Keeps 'bytes' alive, if we own them
+    std::shared_ptr<const void> keep;
+    Pull pull;
+    /// -1 if we won't know till 'pull' returns 0
+    long size = -1;
+  };
+  std::vector<Piece> pieces;
+  /// The piece we're up to, and how far into it
+  size_t current = 0;
+  size_t within = 0;
+  size_t total = 0;
+  void nextPiece() {
+    ++current;
+    within = 0;
+  }
+  /// Moves on from a pull that returned 0. Throws if it promised more, as
+  /// the Content-Length sent counts on it
+  void pullEnded();
+
+public:
+  BodySource() = default;
+  /// A source of one function's bytes
+  BodySource(Pull pull, long size = -1) { add(std::move(pull), size); }
+  /// Adds bytes that are sent from where they are, so must live till it has
+  /// been sent
+  BodySource &add(std::string_view bytes);
+  /// Adds bytes that it keeps
+  BodySource &addCopy(std::string bytes);
+  /// Adds the file at 'path', mapped into memory
+  BodySource &addFile(const std::string &path);
+  /// Adds what 'pull' makes. Its 'size', if it's known, lets the whole body
+  /// have a Content-Length instead of being sent in chunks
+  BodySource &add(Pull pull, long size = -1);
+  /// The size of the whole body, or -1 if any piece doesn't know
+  long size() const;
+  /// How many bytes have been taken from it so far
+  size_t produced() const { return total; }
+  /// Puts views of the next bytes on the end of 'out', and returns how many
+  /// there are. Bytes in memory are pointed at where they lie; pulled ones
+  /// are put in 'scratch', which has room for 'room'. Memory pieces that
+  /// come after a full scratch wait for the next call. 0 means it's done
+  size_t gather(std::vector<std::string_view> &out, char *scratch,
+                size_t room);
+  /// Copies up to 'size' bytes into 'out', returning how many
+  size_t read(char *out, size_t size);
+};
+
+} /* RESTClient */
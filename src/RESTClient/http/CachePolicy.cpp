@@ -0,0 +1,249 @@
+#include "CachePolicy.hpp"
+#include "RequestTemplate.hpp"
+
+#include <RESTClient/metrics/Metrics.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+#include <boost/optional.hpp>
+
+#include <openssl/sha.h>
+
+namespace RESTClient {
+
+namespace {
+
+std::string_view trim(std::string_view text) {
+  while (!text.empty() && std::isspace(text.front()))
+    text.remove_prefix(1);
+  while (!text.empty() && std::isspace(text.back()))
+    text.remove_suffix(1);
+  return text;
+}
+
+/// There are only ever a few headers, so we look through them
+template <typename HeaderMap>
+std::string_view headerValue(const HeaderMap &headers, std::string_view name) {
+  for (const auto &header : headers)
+    if (sameHeaderName(header.first, name))
+      return header.second;
+  return {};
+}
+
+/// Calls 'handle' with each trimmed, non empty item of a comma separated list
+template <typename Handler>
+void eachItem(std::string_view list, Handler handle) {
+  while (!list.empty()) {
+    size_t comma = list.find(',');
+    std::string_view item = trim(list.substr(0, comma));
+    if (!item.empty())
+      handle(item);
+    if (comma == std::string_view::npos)
+      break;
+    list.remove_prefix(comma + 1);
+  }
+}
+
+/// eg. 'Wed, 21 Oct 2015 07:28:00 GMT'
+boost::optional<std::chrono::system_clock::time_point>
+parseHTTPDate(std::string_view value) {
+  std::tm when = {};
+  std::istringstream in{std::string(value)};
+  in >> std::get_time(&when, "%a, %d %b %Y %H:%M:%S");
+  if (in.fail())
+    return {};
+  return std::chrono::system_clock::from_time_t(timegm(&when));
+}
+
+/// Delta-seconds. Too many to hold are taken as 2^31, as the RFC says:
+/// https://tools.ietf.org/html/rfc7234#section-1.2.1
+boost::optional<long> parseSeconds(std::string_view value) {
+  if (value.empty() ||
+      !std::all_of(value.begin(), value.end(),
+                   [](unsigned char c) { return std::isdigit(c); }))
+    return {};
+  const long cap = 2147483648L;
+  long seconds = 0;
+  for (char c : value)
+    seconds = std::min(seconds * 10 + (c - '0'), cap);
+  return seconds;
+}
+
+/// How long a response is fresh for, by its max-age (less its Age) or its
+/// Expires. Without either it's never fresh
+Clock::duration lifetime(const CachedHeaders &headers,
+                         boost::optional<long> maxAge) {
+  if (maxAge) {
+    long age = parseSeconds(headerValue(headers, "Age")).value_or(0);
+    return std::chrono::seconds(std::max(*maxAge - age, 0L));
+  }
+  // One we can't read (eg. '0') means it's already expired
+  auto then = parseHTTPDate(headerValue(headers, "Expires"));
+  if (!then)
+    return Clock::duration::zero();
+  // Measured against the server's clock if we can, as ours may differ
+  auto now = parseHTTPDate(headerValue(headers, "Date"))
+                 .value_or(std::chrono::system_clock::now());
+  if (*then <= now)
+    return Clock::duration::zero();
+  return std::chrono::duration_cast<Clock::duration>(*then - now);
+}
+
+/// Codes that may be kept without the server saying so specially
+/// https://tools.ietf.org/html/rfc7231#section-6.1
+bool storableCode(int code) {
+  switch (code) {
+  case 200:
+  case 203:
+  case 204:
+  case 300:
+  case 301:
+  case 404:
+  case 410:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// Headers a 304 mustn't change in the stored response, as they're about its
+/// own body or its connection
+bool describesMessage(std::string_view name) {
+  return sameHeaderName(name, "Content-Length") ||
+         sameHeaderName(name, "Transfer-Encoding") ||
+         sameHeaderName(name, "Content-Encoding") ||
+         sameHeaderName(name, "Connection") ||
+         sameHeaderName(name, "Keep-Alive");
+}
+
+/// A digest of the credentials 'request' gives, or empty if it gives none.
+/// Keys are written to disk and logged, so they never hold the secrets
+/// themselves
+std::string credentialDigest(const HTTPRequest &request) {
+  std::string credentials;
+  bool any = false;
+  for (const std::string &name : credentialHeaders()) {
+    std::string_view value = request.header(name);
+    any = any || !value.empty();
+    // Newlines can't be in a header, so can't make two lists look the same
+    credentials.append(value);
+    credentials.push_back('\n');
+  }
+  if (!any)
+    return {};
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const unsigned char *>(credentials.data()),
+         credentials.size(), digest);
+  static const char hex[] = "0123456789abcdef";
+  std::string result;
+  result.reserve(2 * sizeof(digest));
+  for (unsigned char byte : digest) {
+    result.push_back(hex[byte >> 4]);
+    result.push_back(hex[byte & 0xf]);
+  }
+  return result;
+}
+
+} // namespace
+
+const std::vector<std::string> &credentialHeaders() {
+  static const std::vector<std::string> names{
+      "Authorization", "Proxy-Authorization", "X-Auth-Token", "Cookie"};
+  return names;
+}
+
+bool cacheableRequest(const HTTPRequest &request) {
+  return (request.verb == "GET") && (request.body.size() == 0) &&
+         request.header("If-None-Match").empty() &&
+         request.header("If-Modified-Since").empty() &&
+         request.header("Cache-Control").empty();
+}
+
+std::string cacheKey(const HostInfo &hostInfo, const HTTPRequest &request) {
+  std::string result = Metrics::hostLabel(hostInfo);
+  if (request.from)
+    result.append(request.from->getPathPrefix());
+  result.append(request.path);
+  std::string credentials = credentialDigest(request);
+  // Not a newline, as DiskCache keeps keys one to a line. A space can't be
+  // in a path on the wire
+  if (!credentials.empty()) {
+    result.push_back(' ');
+    result.append(credentials);
+  }
+  return result;
+}
+
+std::string_view findCachedHeader(const CachedHeaders &headers,
+                                  std::string_view name) {
+  return headerValue(headers, name);
+}
+
+CachedHeaders copyHeaders(const Headers &headers) {
+  CachedHeaders result;
+  result.reserve(headers.size());
+  for (const auto &header : headers)
+    result.emplace_back(std::string(header.first), std::string(header.second));
+  return result;
+}
+
+CacheRules cacheRules(int code, const CachedHeaders &headers,
+                      const HTTPRequest &request) {
+  CacheRules rules;
+  bool noStore = false;
+  bool noCache = false;
+  bool isPrivate = false;
+  boost::optional<long> maxAge;
+  eachItem(headerValue(headers, "Cache-Control"), [&](std::string_view item) {
+    if (sameHeaderName(item, "no-store"))
+      noStore = true;
+    else if (sameHeaderName(item, "no-cache"))
+      noCache = true;
+    else if (sameHeaderName(item, "private"))
+      isPrivate = true;
+    else if ((item.size() > 8) &&
+             sameHeaderName(item.substr(0, 8), "max-age="))
+      maxAge = parseSeconds(trim(item.substr(8)));
+  });
+  std::string_view vary = headerValue(headers, "Vary");
+  // Our caches are shared by many connections, so are never private ones
+  rules.storable = storableCode(code) && !noStore && !isPrivate &&
+                   (trim(vary) != "*");
+  if (!noCache)
+    rules.freshFor = lifetime(headers, maxAge);
+  rules.etag = headerValue(headers, "ETag");
+  rules.lastModified = headerValue(headers, "Last-Modified");
+  eachItem(vary, [&](std::string_view name) {
+    rules.vary.emplace_back(name, request.header(name));
+  });
+  return rules;
+}
+
+void freshenHeaders(CachedHeaders &stored, const Headers &notModified) {
+  for (const auto &header : notModified) {
+    if (describesMessage(header.first))
+      continue;
+    auto found = std::find_if(stored.begin(), stored.end(),
+                              [&](const auto &old) {
+                                return sameHeaderName(old.first, header.first);
+                              });
+    if (found == stored.end())
+      stored.emplace_back(std::string(header.first),
+                          std::string(header.second));
+    else
+      found->second = header.second;
+  }
+}
+
+bool varyMatches(const CachedHeaders &vary, const HTTPRequest &request) {
+  for (const auto &header : vary)
+    if (request.header(header.first) != header.second)
+      return false;
+  return true;
+}
+
+} /* RESTClient */
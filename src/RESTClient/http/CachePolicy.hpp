@@ -0,0 +1,63 @@
+/// The rules our response caches (ResponseCache and DiskCache) follow: which
+/// requests they answer, what they may keep, and for how long.
+/// https://tools.ietf.org/html/rfc7234
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <RESTClient/base/clock.hpp>
+#include <RESTClient/base/url.hpp>
+#include <RESTClient/http/HTTPRequest.hpp>
+
+namespace RESTClient {
+
+/// Headers as a cache keeps them: on the heap, in the order they came
+using CachedHeaders = std::vector<std::pair<std::string, std::string>>;
+
+/// What a response's headers say about caching it
+struct CacheRules {
+  /// False if it mustn't be kept at all
+  bool storable = false;
+  /// How long it may be served without asking the server
+  Clock::duration freshFor = Clock::duration::zero();
+  std::string etag;
+  std::string lastModified;
+  /// The request headers the response's Vary named, with their values
+  CachedHeaders vary;
+  /// True if the server can tell us it's Not Modified
+  bool revalidatable() const { return !etag.empty() || !lastModified.empty(); }
+  /// True if keeping it would be of use: we can serve it for a while, or ask
+  /// if it's changed
+  bool worthKeeping() const {
+    return storable &&
+           ((freshFor > Clock::duration::zero()) || revalidatable());
+  }
+};
+
+/// True for requests a cache may answer: GETs without a body, that don't make
+/// their own conditions or give a Cache-Control
+bool cacheableRequest(const HTTPRequest &request);
+/// Request headers that say who's asking: Authorization,
+/// Proxy-Authorization, X-Auth-Token and Cookie
+const std::vector<std::string> &credentialHeaders();
+/// What a cache files 'request' under. Requests with different credentials
+/// are filed apart, so no one is given a response meant for someone else
+std::string cacheKey(const HostInfo &hostInfo, const HTTPRequest &request);
+/// The value of a header, whatever the case of its name. Empty if it's not
+/// there
+std::string_view findCachedHeader(const CachedHeaders &headers,
+                                  std::string_view name);
+CachedHeaders copyHeaders(const Headers &headers);
+/// Reads the caching headers of a response to 'request'
+CacheRules cacheRules(int code, const CachedHeaders &headers,
+                      const HTTPRequest &request);
+/// Updates stored headers with those of a 304, less the ones about its own
+/// (empty) body
+void freshenHeaders(CachedHeaders &stored, const Headers &notModified);
+/// True if 'request' gives the header values in 'vary'
+bool varyMatches(const CachedHeaders &vary, const HTTPRequest &request);
+
+} /* RESTClient */
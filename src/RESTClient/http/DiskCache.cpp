@@ -0,0 +1,355 @@
+#include "DiskCache.hpp"
+
+#include <RESTClient/base/logger.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace RESTClient {
+
+namespace fs = std::filesystem;
+
+/// At the start of the index file
+struct DiskCache::IndexHead {
+  char magic[8];
+  uint32_t slots;
+  uint32_t spare;
+  /// Ticks on each use of a record, to tell which was used least recently
+  uint64_t clock;
+  /// What to call the next response's files
+  uint64_t nextName;
+  /// In all the bodies
+  uint64_t bytes;
+};
+
+/// One slot of the index, after the head
+struct DiskCache::Record {
+  /// Of the key; 0 if the slot's free
+  uint64_t hash;
+  /// Its files are 'name'.body and 'name'.head
+  uint64_t name;
+  uint64_t bytes;
+  /// Milliseconds since the epoch, by the system clock, as the steady clock
+  /// doesn't last between processes
+  int64_t expires;
+  /// The head's clock when it was last used
+  uint64_t used;
+};
+
+namespace {
+
+const char magic[8] = {'R', 'C', 'D', 'I', 'S', 'K', '1', '\0'};
+
+/// FNV-1a. 0 marks a free slot, so it's never one
+uint64_t hashKey(const std::string &key) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : key) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash ? hash : 1;
+}
+
+int64_t nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+int64_t expiry(const CacheRules &rules) {
+  return nowMs() +
+         std::chrono::duration_cast<std::chrono::milliseconds>(rules.freshFor)
+             .count();
+}
+
+/// Reads a head file written by DiskCache::writeHead. False if it can't, or
+/// if it's for some other key whose hash is the same as ours
+bool readHead(const std::string &path, const std::string &key, int &code,
+              CachedHeaders &headers, CachedHeaders &vary) {
+  std::ifstream in(path, std::fstream::in | std::fstream::binary);
+  std::string line;
+  if (!std::getline(in, line) || (line != key) || !std::getline(in, line))
+    return false;
+  code = std::atoi(line.c_str());
+  CachedHeaders *into = &headers;
+  while (std::getline(in, line)) {
+    // Headers, then a blank line, then the request headers it varies by
+    if (line.empty()) {
+      into = &vary;
+      continue;
+    }
+    size_t colon = line.find(": ");
+    if (colon == std::string::npos)
+      return false;
+    into->emplace_back(line.substr(0, colon), line.substr(colon + 2));
+  }
+  return code != 0;
+}
+
+} // namespace
+
+DiskCache::Entry::Entry(Entry &&other)
+    : code(other.code), headers(std::move(other.headers)),
+      etag(std::move(other.etag)), lastModified(std::move(other.lastModified)),
+      fresh(other.fresh), body(other.body), name(other.name) {
+  other.body = -1;
+}
+
+DiskCache::Entry &DiskCache::Entry::operator=(Entry &&other) {
+  if (body >= 0)
+    ::close(body);
+  code = other.code;
+  headers = std::move(other.headers);
+  etag = std::move(other.etag);
+  lastModified = std::move(other.lastModified);
+  fresh = other.fresh;
+  body = other.body;
+  name = other.name;
+  other.body = -1;
+  return *this;
+}
+
+DiskCache::Entry::~Entry() {
+  if (body >= 0)
+    ::close(body);
+}
+
+DiskCache::DiskCache(std::string directory, size_t budget, size_t slots)
+    : directory(std::move(directory)), budget(budget) {
+  openIndex(slots);
+}
+
+void DiskCache::openIndex(size_t slots) {
+  fs::create_directories(directory);
+  std::string path = directory + "/index";
+  std::error_code ec;
+  auto size = fs::file_size(path, ec);
+  if (!ec && (size >= sizeof(IndexHead))) {
+    index.open(path, boost::iostreams::mapped_file::readwrite);
+    head = reinterpret_cast<IndexHead *>(index.data());
+    if ((std::memcmp(head->magic, magic, sizeof(magic)) == 0) &&
+        (size == sizeof(IndexHead) + head->slots * sizeof(Record))) {
+      records = reinterpret_cast<Record *>(index.data() + sizeof(IndexHead));
+      return;
+    }
+    index.close();
+  }
+  // Nothing here we can use, so start again
+  LOG_INFO("Starting a new disk cache in " << directory);
+  for (const auto &file : fs::directory_iterator(directory))
+    if ((file.path().extension() == ".body") ||
+        (file.path().extension() == ".head"))
+      fs::remove(file.path(), ec);
+  {
+    std::ofstream create(path, std::fstream::out | std::fstream::binary |
+                                   std::fstream::trunc);
+  }
+  // Grown with zeros: every slot free
+  fs::resize_file(path, sizeof(IndexHead) + slots * sizeof(Record));
+  index.open(path, boost::iostreams::mapped_file::readwrite);
+  head = reinterpret_cast<IndexHead *>(index.data());
+  std::memcpy(head->magic, magic, sizeof(magic));
+  head->slots = slots;
+  head->nextName = 1;
+  records = reinterpret_cast<Record *>(index.data() + sizeof(IndexHead));
+}
+
+std::string DiskCache::pathOf(uint64_t name, const char *extension) const {
+  return directory + "/" + std::to_string(name) + extension;
+}
+
+DiskCache::Record *DiskCache::findRecord(uint64_t hash) {
+  // A few thousand records take microseconds to look through; nothing next to
+  // the size of what they hold
+  for (Record *record = records; record != records + head->slots; ++record)
+    if (record->hash == hash)
+      return record;
+  return nullptr;
+}
+
+void DiskCache::drop(Record &record) {
+  std::error_code ec;
+  fs::remove(pathOf(record.name, ".body"), ec);
+  fs::remove(pathOf(record.name, ".head"), ec);
+  head->bytes -= record.bytes;
+  record = Record();
+}
+
+void DiskCache::writeHead(uint64_t name, const std::string &key, int code,
+                          const CachedHeaders &headers,
+                          const CachedHeaders &vary) {
+  // Written whole before it's in place, so no one reads half of one
+  std::string path = pathOf(name, ".head");
+  {
+    std::ofstream out(path + ".new", std::fstream::out |
+                                         std::fstream::binary |
+                                         std::fstream::trunc);
+    out << key << '\n' << code << '\n';
+    for (const auto &header : headers)
+      out << header.first << ": " << header.second << '\n';
+    out << '\n';
+    for (const auto &header : vary)
+      out << header.first << ": " << header.second << '\n';
+    if (!out.flush())
+      throw std::runtime_error("Couldn't write " + path);
+  }
+  fs::rename(path + ".new", path);
+}
+
+boost::optional<DiskCache::Entry>
+DiskCache::find(const std::string &key, const HTTPRequest &request) {
+  Entry entry;
+  CachedHeaders vary;
+  int64_t expires;
+  uint64_t hash = hashKey(key);
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    Record *record = findRecord(hash);
+    if (!record)
+      return {};
+    record->used = ++head->clock;
+    entry.name = record->name;
+    expires = record->expires;
+  }
+  // The files are read outside the lock, so lookups don't queue behind the
+  // disk. A head is never changed in place, and an open body lives on if
+  // it's dropped, so at worst we miss
+  if (!readHead(pathOf(entry.name, ".head"), key, entry.code, entry.headers,
+                vary))
+    return {};
+  entry.body =
+      ::open(pathOf(entry.name, ".body").c_str(), O_RDONLY | O_CLOEXEC);
+  if (entry.body < 0) {
+    // Evicted meanwhile, or someone's been tidying up
+    std::lock_guard<std::mutex> guard(lock);
+    Record *record = findRecord(hash);
+    if (record && (record->name == entry.name))
+      drop(*record);
+    return {};
+  }
+  if (!varyMatches(vary, request))
+    return {};
+  entry.etag = findCachedHeader(entry.headers, "ETag");
+  entry.lastModified = findCachedHeader(entry.headers, "Last-Modified");
+  entry.fresh = nowMs() < expires;
+  if (entry.fresh)
+    hits.fetch_add(1, std::memory_order_relaxed);
+  return entry;
+}
+
+void DiskCache::store(const std::string &key, const HTTPRequest &request,
+                      HTTPResponse &response) {
+  misses.fetch_add(1, std::memory_order_relaxed);
+  if (response.body.kind() != HTTPBody::Kind::file)
+    return;
+  CachedHeaders headers = copyHeaders(response.headers);
+  CacheRules rules = cacheRules(response.code, headers, request);
+  response.body.flush();
+  size_t bytes = response.body.size();
+  if (!rules.worthKeeping() || (bytes > budget))
+    return;
+  uint64_t name;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    name = head->nextName++;
+  }
+  // The copying happens outside the lock; no one knows the name yet
+  int from = ::open(response.body.path().c_str(), O_RDONLY | O_CLOEXEC);
+  if (from < 0)
+    return;
+  try {
+    copyFile(from, pathOf(name, ".body"));
+    ::close(from);
+    writeHead(name, key, response.code, headers, rules.vary);
+  } catch (std::exception &e) {
+    ::close(from);
+    LOG_WARN("Couldn't keep " << key << " in the disk cache: " << e.what());
+    std::error_code ec;
+    fs::remove(pathOf(name, ".body"), ec);
+    fs::remove(pathOf(name, ".head"), ec);
+    return;
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  uint64_t hash = hashKey(key);
+  if (Record *old = findRecord(hash))
+    drop(*old);
+  // Evict the least recently used till the body fits and there's a free slot
+  Record *slot = findRecord(0);
+  while (!slot || (head->bytes + bytes > budget)) {
+    Record *oldest = nullptr;
+    for (Record *record = records; record != records + head->slots; ++record)
+      if (record->hash && (!oldest || (record->used < oldest->used)))
+        oldest = record;
+    if (!oldest)
+      break;
+    drop(*oldest);
+    evictions.fetch_add(1, std::memory_order_relaxed);
+    slot = findRecord(0);
+  }
+  if (!slot)
+    return;
+  slot->hash = hash;
+  slot->name = name;
+  slot->bytes = bytes;
+  slot->expires = expiry(rules);
+  slot->used = ++head->clock;
+  head->bytes += bytes;
+  stores.fetch_add(1, std::memory_order_relaxed);
+}
+
+void DiskCache::revalidated(const std::string &key, const HTTPRequest &request,
+                            Entry &stale, const HTTPResponse &notModified) {
+  revalidations.fetch_add(1, std::memory_order_relaxed);
+  freshenHeaders(stale.headers, notModified.headers);
+  CacheRules rules = cacheRules(stale.code, stale.headers, request);
+  stale.etag = rules.etag;
+  stale.lastModified = rules.lastModified;
+  std::lock_guard<std::mutex> guard(lock);
+  Record *record = findRecord(hashKey(key));
+  // Unless it's been replaced meanwhile
+  if (!record || (record->name != stale.name))
+    return;
+  if (!rules.storable) {
+    drop(*record);
+    return;
+  }
+  try {
+    writeHead(stale.name, key, stale.code, stale.headers, rules.vary);
+  } catch (std::exception &e) {
+    LOG_WARN("Couldn't freshen " << key << " in the disk cache: " << e.what());
+    drop(*record);
+    return;
+  }
+  record->expires = expiry(rules);
+  stores.fetch_add(1, std::memory_order_relaxed);
+}
+
+void DiskCache::clear() {
+  std::lock_guard<std::mutex> guard(lock);
+  for (Record *record = records; record != records + head->slots; ++record)
+    if (record->hash)
+      drop(*record);
+}
+
+CacheStats DiskCache::stats() {
+  CacheStats result;
+  result.hits = hits.load(std::memory_order_relaxed);
+  result.misses = misses.load(std::memory_order_relaxed);
+  result.revalidations = revalidations.load(std::memory_order_relaxed);
+  result.stores = stores.load(std::memory_order_relaxed);
+  result.evictions = evictions.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> guard(lock);
+  for (Record *record = records; record != records + head->slots; ++record)
+    if (record->hash)
+      ++result.entries;
+  result.bytes = head->bytes;
+  return result;
+}
+
+} /* RESTClient */
@@ -0,0 +1,112 @@
+/// A cache on disk of GET responses read into files, eg. by HTTP::getToFile,
+/// for objects too big to keep in memory. Give one to any number of HTTP
+/// connections (on any threads) with HTTP::useDiskCache.
+///
+/// Each response is kept as two files in the cache's directory: its body, and
+/// its status and headers. An index of them, memory mapped, holds what's
+/// needed to find one, to know if it's fresh, and to pick which to evict: the
+/// least recently used, once the bodies are over the byte budget. It all
+/// stays on disk, so the next process to use the directory starts with what
+/// this one kept.
+///
+/// Freshness, revalidation, private responses and credentials follow the
+/// same rules as ResponseCache, so what one token fetched is never served to
+/// another, even by a later process. Keys hold a digest of the credentials,
+/// never the credentials themselves.
+///
+/// A hit is copied into the response's file with copyFile: a reflink where
+/// the filesystem can, otherwise a copy in the kernel.
+///
+/// One process at a time may use a directory.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/optional.hpp>
+
+#include <RESTClient/http/CachePolicy.hpp>
+#include <RESTClient/http/HTTPRequest.hpp>
+#include <RESTClient/http/HTTPResponse.hpp>
+#include <RESTClient/http/ResponseCache.hpp>
+
+namespace RESTClient {
+
+class DiskCache {
+public:
+  /// A stored response, with its body open, so it can be copied even if it's
+  /// evicted meanwhile
+  struct Entry {
+    int code = 0;
+    CachedHeaders headers;
+    std::string etag;
+    std::string lastModified;
+    bool fresh = false;
+    /// The body file's descriptor
+    int body = -1;
+    /// Which files it's in
+    uint64_t name = 0;
+    Entry() = default;
+    Entry(Entry &&other);
+    Entry &operator=(Entry &&other);
+    ~Entry();
+    bool revalidatable() const {
+      return !etag.empty() || !lastModified.empty();
+    }
+  };
+
+private:
+  struct IndexHead;
+  struct Record;
+  std::string directory;
+  size_t budget;
+  /// Guards the index, and which files are in it
+  std::mutex lock;
+  boost::iostreams::mapped_file index;
+  IndexHead *head = nullptr;
+  Record *records = nullptr;
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+  std::atomic<uint64_t> revalidations{0};
+  std::atomic<uint64_t> stores{0};
+  std::atomic<uint64_t> evictions{0};
+  /// Opens the index, or makes a new one (and an empty directory) if there
+  /// isn't one we can use
+  void openIndex(size_t slots);
+  std::string pathOf(uint64_t name, const char *extension) const;
+  /// The record for 'hash', or nullptr
+  Record *findRecord(uint64_t hash);
+  /// Empties a record and deletes its files
+  void drop(Record &record);
+  /// Writes the head file for 'name'
+  void writeHead(uint64_t name, const std::string &key, int code,
+                 const CachedHeaders &headers, const CachedHeaders &vary);
+
+public:
+  /// Keeps its files in 'directory', making it if need be. 'budget' is in
+  /// bytes of body; 'slots' is the most responses it'll hold
+  explicit DiskCache(std::string directory,
+                     size_t budget = 1024l * 1024 * 1024, size_t slots = 4096);
+  DiskCache(const DiskCache &) = delete;
+  /// The response stored for 'request', fresh or not, if its Vary headers
+  /// match. Counts a hit if it's fresh
+  boost::optional<Entry> find(const std::string &key,
+                              const HTTPRequest &request);
+  /// Counts a miss, and keeps a copy of 'response', whose body must be a
+  /// file, if its CacheRules say it's worth keeping
+  void store(const std::string &key, const HTTPRequest &request,
+             HTTPResponse &response);
+  /// Counts a revalidation, and freshens 'stale' with the headers of
+  /// 'notModified'
+  void revalidated(const std::string &key, const HTTPRequest &request,
+                   Entry &stale, const HTTPResponse &notModified);
+  /// Drops everything
+  void clear();
+  CacheStats stats();
+};
+
+} /* RESTClient */
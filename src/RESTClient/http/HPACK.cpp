@@ -0,0 +1,469 @@
+#include "HPACK.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace RESTClient {
+
+namespace {
+
+struct StaticEntry {
+  const char *name;
+  const char *value;
+};
+
+/// RFC 7541 Appendix A. Index 1 is at [0]
+const StaticEntry staticTable[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""}};
+
+const size_t staticSize = sizeof(staticTable) / sizeof(staticTable[0]);
+
+struct HuffmanCode {
+  uint32_t code;
+  uint8_t bits;
+};
+
+/// RFC 7541 Appendix B. [256] is EOS
+const HuffmanCode huffmanCodes[257] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+    {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+    {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+    {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+    {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+    {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12}, {0x1ff9, 13}, {0x15, 6},
+    {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+    {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6}, {0x0, 5}, {0x1, 5}, {0x2, 5},
+    {0x19, 6}, {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6}, {0x1e, 6},
+    {0x1f, 6}, {0x5c, 7}, {0xfb, 8}, {0x7ffc, 15}, {0x20, 6}, {0xffb, 12},
+    {0x3fc, 10}, {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7}, {0x5f, 7},
+    {0x60, 7}, {0x61, 7}, {0x62, 7}, {0x63, 7}, {0x64, 7}, {0x65, 7},
+    {0x66, 7}, {0x67, 7}, {0x68, 7}, {0x69, 7}, {0x6a, 7}, {0x6b, 7},
+    {0x6c, 7}, {0x6d, 7}, {0x6e, 7}, {0x6f, 7}, {0x70, 7}, {0x71, 7},
+    {0x72, 7}, {0xfc, 8}, {0x73, 7}, {0xfd, 8}, {0x1ffb, 13}, {0x7fff0, 19},
+    {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6}, {0x7ffd, 15}, {0x3, 5}, {0x23, 6},
+    {0x4, 5}, {0x24, 6}, {0x5, 5}, {0x25, 6}, {0x26, 6}, {0x27, 6}, {0x6, 5},
+    {0x74, 7}, {0x75, 7}, {0x28, 6}, {0x29, 6}, {0x2a, 6}, {0x7, 5}, {0x2b, 6},
+    {0x76, 7}, {0x2c, 6}, {0x8, 5}, {0x9, 5}, {0x2d, 6}, {0x77, 7}, {0x78, 7},
+    {0x79, 7}, {0x7a, 7}, {0x7b, 7}, {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14},
+    {0x1ffd, 13}, {0xffffffc, 28}, {0xfffe6, 20}, {0x3fffd2, 22},
+    {0xfffe7, 20}, {0xfffe8, 20}, {0x3fffd3, 22}, {0x3fffd4, 22},
+    {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22}, {0x7fffda, 23},
+    {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23}, {0x7fffde, 23},
+    {0xffffeb, 24}, {0x7fffdf, 23}, {0xffffec, 24}, {0xffffed, 24},
+    {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24}, {0x7fffe1, 23},
+    {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23}, {0x1fffdc, 21},
+    {0x3fffd8, 22}, {0x7fffe5, 23}, {0x3fffd9, 22}, {0x7fffe6, 23},
+    {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22}, {0x1fffdd, 21},
+    {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22}, {0x7fffe8, 23},
+    {0x7fffe9, 23}, {0x1fffde, 21}, {0x7fffea, 23}, {0x3fffdd, 22},
+    {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21}, {0x3fffdf, 22},
+    {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21}, {0x1fffe1, 21},
+    {0x3fffe0, 22}, {0x1fffe2, 21}, {0x7fffed, 23}, {0x3fffe1, 22},
+    {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20}, {0x3fffe2, 22},
+    {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23}, {0x3fffe5, 22},
+    {0x3fffe6, 22}, {0x7ffff1, 23}, {0x3ffffe0, 26}, {0x3ffffe1, 26},
+    {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22}, {0x7ffff2, 23},
+    {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26}, {0x3ffffe3, 26},
+    {0x3ffffe4, 26}, {0x7ffffde, 27}, {0x7ffffdf, 27}, {0x3ffffe5, 26},
+    {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19}, {0x1fffe3, 21},
+    {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27}, {0x3ffffe7, 26},
+    {0x7ffffe2, 27}, {0xfffff2, 24}, {0x1fffe4, 21}, {0x1fffe5, 21},
+    {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28}, {0x7ffffe3, 27},
+    {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20}, {0xfffff3, 24},
+    {0xfffed, 20}, {0x1fffe6, 21}, {0x3fffe9, 22}, {0x1fffe7, 21},
+    {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22}, {0x3fffeb, 22},
+    {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24}, {0xfffff5, 24},
+    {0x3ffffea, 26}, {0x7ffff4, 23}, {0x3ffffeb, 26}, {0x7ffffe6, 27},
+    {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27}, {0x7ffffe8, 27},
+    {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27}, {0xffffffe, 28},
+    {0x7ffffec, 27}, {0x7ffffed, 27}, {0x7ffffee, 27}, {0x7ffffef, 27},
+    {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30}};
+
+/// Walks a bit at a time from the root to a symbol
+struct HuffmanTree {
+  struct Node {
+    int16_t child[2] = {-1, -1};
+    int16_t symbol = -1;
+  };
+  Node nodes[513];
+  int16_t used = 1;
+  HuffmanTree() {
+    for (int16_t symbol = 0; symbol != 257; ++symbol) {
+      const HuffmanCode &code = huffmanCodes[symbol];
+      int16_t node = 0;
+      for (int bit = code.bits - 1; bit >= 0; --bit) {
+        int16_t &next = nodes[node].child[(code.code >> bit) & 1];
+        if (next == -1)
+          next = used++;
+        node = next;
+      }
+      nodes[node].symbol = symbol;
+    }
+  }
+};
+
+const HuffmanTree &huffmanTree() {
+  static const HuffmanTree tree;
+  return tree;
+}
+
+void appendString(std::string &out, std::string_view text) {
+  size_t huffman = HPACK::huffmanSize(text);
+  if (huffman < text.size()) {
+    HPACK::appendInteger(out, huffman, 7, 0x80);
+    HPACK::appendHuffman(out, text);
+  } else {
+    HPACK::appendInteger(out, text.size(), 7, 0);
+    out.append(text.data(), text.size());
+  }
+}
+
+void bad(const char *what) {
+  throw std::runtime_error(std::string("Bad HPACK header block: ") + what);
+}
+
+} /* anonymous namespace */
+
+namespace HPACK {
+
+void appendInteger(std::string &out, size_t value, int prefixBits,
+                   uint8_t flags) {
+  size_t limit = (1u << prefixBits) - 1;
+  if (value < limit) {
+    out.push_back(static_cast<char>(flags | value));
+    return;
+  }
+  out.push_back(static_cast<char>(flags | limit));
+  value -= limit;
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+size_t readInteger(const uint8_t *&data, const uint8_t *end, int prefixBits) {
+  if (data == end)
+    bad("truncated integer");
+  size_t limit = (1u << prefixBits) - 1;
+  size_t result = *data++ & limit;
+  if (result < limit)
+    return result;
+  for (int shift = 0; shift < 56; shift += 7) {
+    if (data == end)
+      bad("truncated integer");
+    uint8_t byte = *data++;
+    result += size_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return result;
+  }
+  bad("integer too big");
+  return 0;
+}
+
+size_t huffmanSize(std::string_view text) {
+  size_t bits = 0;
+  for (unsigned char c : text)
+    bits += huffmanCodes[c].bits;
+  return (bits + 7) / 8;
+}
+
+void appendHuffman(std::string &out, std::string_view text) {
+  uint64_t pending = 0;
+  int bits = 0;
+  for (unsigned char c : text) {
+    const HuffmanCode &code = huffmanCodes[c];
+    pending = (pending << code.bits) | code.code;
+    bits += code.bits;
+    while (bits >= 8) {
+      bits -= 8;
+      out.push_back(static_cast<char>(pending >> bits));
+    }
+  }
+  // Pad with the start of EOS (all ones)
+  if (bits > 0)
+    out.push_back(static_cast<char>((pending << (8 - bits)) |
+                                    (0xff >> bits)));
+}
+
+void decodeHuffman(const uint8_t *data, size_t size, std::string &out) {
+  const HuffmanTree &tree = huffmanTree();
+  int16_t node = 0;
+  // Since the last symbol, for checking the padding
+  int bits = 0;
+  bool allOnes = true;
+  for (const uint8_t *end = data + size; data != end; ++data) {
+    for (int bit = 7; bit >= 0; --bit) {
+      int which = (*data >> bit) & 1;
+      node = tree.nodes[node].child[which];
+      ++bits;
+      allOnes = allOnes && which;
+      if (node == -1)
+        bad("bad huffman code");
+      int16_t symbol = tree.nodes[node].symbol;
+      if (symbol == -1)
+        continue;
+      if (symbol == 256)
+        bad("EOS in a huffman string");
+      out.push_back(static_cast<char>(symbol));
+      node = 0;
+      bits = 0;
+      allOnes = true;
+    }
+  }
+  if ((bits > 7) || !allOnes)
+    bad("bad huffman padding");
+}
+
+} /* HPACK */
+
+void HPACKTable::evict(size_t room) {
+  while (!entries.empty() && (size + room > maxSize)) {
+    size -= entrySize(entries.back().first, entries.back().second);
+    entries.pop_back();
+  }
+}
+
+void HPACKTable::add(std::string_view name, std::string_view value) {
+  size_t newSize = entrySize(name, value);
+  if (newSize > maxSize) {
+    // Too big for any table; it just empties it
+    clear();
+    return;
+  }
+  // 'name' may be in an entry we're about to evict
+  std::pair<std::string, std::string> entry(name, value);
+  evict(newSize);
+  entries.emplace_front(std::move(entry));
+  size += newSize;
+}
+
+void HPACKTable::setMaxSize(size_t maxSize) {
+  this->maxSize = maxSize;
+  evict(0);
+}
+
+bool HPACKTable::get(size_t index, std::string_view &name,
+                     std::string_view &value) const {
+  if (index == 0)
+    return false;
+  if (index <= staticSize) {
+    name = staticTable[index - 1].name;
+    value = staticTable[index - 1].value;
+    return true;
+  }
+  index -= staticSize + 1;
+  if (index >= entries.size())
+    return false;
+  name = entries[index].first;
+  value = entries[index].second;
+  return true;
+}
+
+size_t HPACKTable::find(std::string_view name, std::string_view value,
+                        bool &valueToo) const {
+  size_t result = 0;
+  valueToo = false;
+  for (size_t i = 0; i != staticSize; ++i) {
+    if (name != staticTable[i].name)
+      continue;
+    if (value == staticTable[i].value) {
+      valueToo = true;
+      return i + 1;
+    }
+    if (result == 0)
+      result = i + 1;
+  }
+  for (size_t i = 0; i != entries.size(); ++i) {
+    if (name != entries[i].first)
+      continue;
+    if (value == entries[i].second) {
+      valueToo = true;
+      return staticSize + i + 1;
+    }
+    if (result == 0)
+      result = staticSize + i + 1;
+  }
+  return result;
+}
+
+void HPACKTable::clear() {
+  entries.clear();
+  size = 0;
+}
+
+void HPACKEncoder::setMaxTableSize(size_t size) {
+  // We never need more than the default
+  size = std::min<size_t>(size, 4096);
+  if (size == table.getMaxSize() && !tableSizeChanged)
+    return;
+  lowestTableSize = tableSizeChanged ? std::min(lowestTableSize, size) : size;
+  tableSizeChanged = true;
+  table.setMaxSize(size);
+}
+
+void HPACKEncoder::encode(std::string &out, std::string_view name,
+                          std::string_view value, bool sensitive) {
+  if (tableSizeChanged) {
+    if (lowestTableSize < table.getMaxSize())
+      HPACK::appendInteger(out, lowestTableSize, 5, 0x20);
+    HPACK::appendInteger(out, table.getMaxSize(), 5, 0x20);
+    tableSizeChanged = false;
+  }
+  bool valueToo;
+  size_t index = table.find(name, value, valueToo);
+  if (valueToo && !sensitive) {
+    HPACK::appendInteger(out, index, 7, 0x80);
+    return;
+  }
+  // Big values would push everything else out of the table
+  bool keep = !sensitive &&
+              (HPACKTable::entrySize(name, value) <= table.getMaxSize() / 2);
+  if (keep)
+    HPACK::appendInteger(out, index, 6, 0x40);
+  else
+    HPACK::appendInteger(out, index, 4, sensitive ? 0x10 : 0);
+  if (index == 0)
+    appendString(out, name);
+  appendString(out, value);
+  if (keep)
+    table.add(name, value);
+}
+
+void HPACKEncoder::reset() {
+  table.clear();
+  table.setMaxSize(4096);
+  tableSizeChanged = false;
+}
+
+void HPACKDecoder::readString(const uint8_t *&data, const uint8_t *end,
+                              std::string &scratch,
+                              std::string_view &result) {
+  if (data == end)
+    bad("truncated string");
+  bool huffman = *data & 0x80;
+  size_t size = HPACK::readInteger(data, end, 7);
+  if (size > size_t(end - data))
+    bad("truncated string");
+  if (huffman) {
+    scratch.clear();
+    HPACK::decodeHuffman(data, size, scratch);
+    result = scratch;
+  } else {
+    result = std::string_view(reinterpret_cast<const char *>(data), size);
+  }
+  data += size;
+}
+
+bool HPACKDecoder::next(const char *&data, const char *end,
+                        std::string_view &name, std::string_view &value) {
+  auto in = reinterpret_cast<const uint8_t *>(data);
+  auto last = reinterpret_cast<const uint8_t *>(end);
+  while (in != last) {
+    uint8_t first = *in;
+    if (first & 0x80) {
+      // Indexed
+      if (!table.get(HPACK::readInteger(in, last, 7), name, value))
+        bad("bad index");
+      data = reinterpret_cast<const char *>(in);
+      return true;
+    }
+    if ((first & 0xe0) == 0x20) {
+      // Dynamic table size update
+      size_t size = HPACK::readInteger(in, last, 5);
+      if (size > maxTableSize)
+        bad("table size update too big");
+      table.setMaxSize(size);
+      continue;
+    }
+    // A literal; with incremental indexing, without, or never indexed
+    bool indexing = (first & 0xc0) == 0x40;
+    size_t index = HPACK::readInteger(in, last, indexing ? 6 : 4);
+    if (index == 0)
+      readString(in, last, nameScratch, name);
+    else if (!table.get(index, name, value))
+      bad("bad index");
+    else if (indexing && (index > staticSize)) {
+      // Adding to the table might evict the entry 'name' is in
+      nameScratch.assign(name.data(), name.size());
+      name = nameScratch;
+    }
+    readString(in, last, valueScratch, value);
+    data = reinterpret_cast<const char *>(in);
+    if (indexing)
+      table.add(name, value);
+    return true;
+  }
+  data = end;
+  return false;
+}
+
+void HPACKDecoder::reset() {
+  table.clear();
+  table.setMaxSize(maxTableSize);
+}
+
+} /* RESTClient */
@@ -0,0 +1,98 @@
+/// HPACK, the header compression of HTTP/2 (RFC 7541). Like HTTPParser, it
+/// does no IO; HTTP2Session and the test server feed it header blocks
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace RESTClient {
+
+/// The headers both ends have seen lately, most recent first. Entries are
+/// numbered after the 61 in the static table
+class HPACKTable {
+private:
+  std::deque<std::pair<std::string, std::string>> entries;
+  size_t size = 0;
+  size_t maxSize = 4096;
+  void evict(size_t room);
+
+public:
+  /// The size of an entry, as RFC 7541 counts it
+  static size_t entrySize(std::string_view name, std::string_view value) {
+    return name.size() + value.size() + 32;
+  }
+  void add(std::string_view name, std::string_view value);
+  void setMaxSize(size_t maxSize);
+  size_t getMaxSize() const { return maxSize; }
+  /// Looks up 'index' in the static table, then this one. Returns false if
+  /// it's in neither
+  bool get(size_t index, std::string_view &name,
+           std::string_view &value) const;
+  /// The index of an entry with 'name' (0 if none). 'valueToo' is set if
+  /// that entry has 'value' as well
+  size_t find(std::string_view name, std::string_view value,
+              bool &valueToo) const;
+  void clear();
+};
+
+/// Turns headers into a header block
+class HPACKEncoder {
+private:
+  HPACKTable table;
+  /// The smallest table size the peer allowed since our last header block,
+  /// and what it allows now; both must be announced
+  size_t lowestTableSize = 0;
+  bool tableSizeChanged = false;
+
+public:
+  /// The peer's SETTINGS_HEADER_TABLE_SIZE
+  void setMaxTableSize(size_t size);
+  /// Appends one header to the block in 'out'. Names must be lower case.
+  /// 'sensitive' headers (eg. Authorization) are never put in a table
+  void encode(std::string &out, std::string_view name, std::string_view value,
+              bool sensitive = false);
+  /// Forget everything, for a new connection
+  void reset();
+};
+
+/// Reads headers out of a header block
+class HPACKDecoder {
+private:
+  HPACKTable table;
+  size_t maxTableSize = 4096;
+  std::string nameScratch;
+  std::string valueScratch;
+  void readString(const uint8_t *&data, const uint8_t *end,
+                  std::string &scratch, std::string_view &result);
+
+public:
+  /// Reads the next header from 'data', moving it on. Returns false at the
+  /// end of the block. 'name' and 'value' are only good until the next call.
+  /// Throws std::runtime_error on a bad block, which ruins the connection
+  bool next(const char *&data, const char *end, std::string_view &name,
+            std::string_view &value);
+  /// Forget everything, for a new connection
+  void reset();
+};
+
+namespace HPACK {
+
+/// Appends 'value' with a 'prefixBits' bit prefix. 'flags' fills the rest of
+/// the first byte
+void appendInteger(std::string &out, size_t value, int prefixBits,
+                   uint8_t flags);
+/// Reads an integer with a 'prefixBits' bit prefix, moving 'data' on
+size_t readInteger(const uint8_t *&data, const uint8_t *end, int prefixBits);
+/// How long 'text' would be Huffman coded
+size_t huffmanSize(std::string_view text);
+void appendHuffman(std::string &out, std::string_view text);
+/// Appends the Huffman coded 'data' to 'out'. Throws on bad codes or padding
+void decodeHuffman(const uint8_t *data, size_t size, std::string &out);
+
+} /* HPACK */
+
+} /* RESTClient */
@@ -2,8 +2,11 @@
 
 #include <sstream>
 
-#include "HTTP_OutputToNet.hpp"
+#include "HTTP2.hpp"
 #include "HTTP_ReadReply.hpp"
+#include "DiskCache.hpp"
+#include "RequestCoalescer.hpp"
+#include "ResponseCache.hpp"
 
 #include "HTTP_CopyToCout.hpp"
 
@@ -13,8 +16,9 @@
 #include <boost/algorithm/string/split.hpp>
 #include <boost/asio/connect.hpp>
 #include <boost/asio/error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
-#include <boost/iostreams/restrict.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/range/algorithm/search.hpp>
 #include <boost/range/istream_range.hpp>
@@ -27,90 +31,44 @@ namespace RESTClient {
 
 namespace io = boost::iostreams;
 
-/// Convenience function to create an OutputToNet sink
-template <typename Connection>
-OutputToNet<Connection> make_output_to_net(Connection &connection,
-                                           asio::yield_context &yield) {
-  LOG_TRACE("make_output_to_net");
-  return OutputToNet<Connection>(connection, yield);
-}
-
 /// Adds the default HTTP headers to a request
 void HTTP::addDefaultHeaders(HTTPRequest &request) {
   LOG_TRACE("addDefaultHeaders");
-  // Host
-  std::string *value = &request.headers["Host"];
-  if (value->empty())
-    *value = hostInfo.hostname;
-  // Accept */*
-  value = &request.headers["Accept"];
-  if (value->empty())
-    *value = "*/*";
-  // Accept-Encoding: gzip, deflate
-  value = &request.headers["Accept-Encoding"];
-  if (value->empty())
-    *value = "gzip, deflate";
-  // TE: trailers
-  value = &request.headers["TE"];
-  if (value->empty())
-    *value = "trailers";
-  // Content-Length
-  long size = request.body.size();
-  if (size >= 0) {
-    value = &request.headers["Content-Length"];
-    if (value->empty())
-      *value = std::to_string(size);
-  }
+  RESTClient::addDefaultHeaders(request, hostInfo);
 }
 
-/// Transmits a body with 'chunked' transfer-encoding (untested because
-/// httpbin.org doesn't support it, but cloud files API does, we'll have to
-/// write some tests that connect to cloud files api later)
-void chunkedTransmit(filtering_ostream &transmitter, std::istream &data) {
-  // https://www.w3.org/Protocols/rfc2616/rfc2616-sec3.html#sec3.6.1
-  const size_t bufferSize = 4096;
-  char buffer[bufferSize];
-  while (data.good()) {
-    data.read(buffer, bufferSize);
-    size_t bytes = data.gcount();
-    if (bytes == 0)
-      break;
-    // Write the chunksize
-    transmitter << std::ios_base::hex << bytes << "\r\n";
-    // Write the data
-    io::copy(io::restrict(data, 0, bytes), transmitter);
-    // Write a new line
-    transmitter << "\r\n";
+/// Writes the head in 'buffers.outgoing' then the body, a round of buffers
+/// at a time
+template <typename Connection>
+void HTTP::writeRequest(Connection &connection, HTTPRequest &request) {
+  RequestWriter &writer = buffers.writer;
+  writer.start(buffers.outgoing, request.body);
+  while (writer.next()) {
+#ifdef HTTP_ON_STD_OUT
+    for (const auto &buffer : writer.buffers())
+      copyOutgoingToCout(asio::buffer_cast<const char *>(buffer),
+                         asio::buffer_size(buffer));
+#endif
+    // A lone buffer, eg. a request with no body, needs no gathering
+    if (writer.buffers().size() == 1)
+      outgoingByteCounter += asio::async_write(
+          connection, writer.buffers().front(), asio::transfer_all(), yield);
+    else
+      outgoingByteCounter += asio::async_write(connection, writer.buffers(),
+                                               asio::transfer_all(), yield);
   }
 }
 
-/// Transmits a body. If the request.size (body size) is positive (not -1),
-/// it'll send it in one go. A negative number indicates that we don't know the
-/// size, so it should be sent in chunked transfer-encoding
-void transmitBody(filtering_ostream &transmitter, HTTPRequest &request,
-                  asio::yield_context &yield) {
-  // If we know the body size
-  std::istream &body = request.body;
-  if (request.body.size() >= 0)
-    io::copy(body, transmitter);
-  else
-    chunkedTransmit(transmitter, body);
-}
-
 HTTP::HTTP(const HostInfo &hostInfo, asio::yield_context yield)
-    : hostInfo(hostInfo), services(Services::instance()), yield(yield),
-      ssl_context(services.io_service, ssl::context::sslv23),
-      sslStream(services.io_service, ssl_context), socket(services.io_service) {
+    : hostInfo(hostInfo), services(Services::instance()),
+      metrics(Metrics::instance().local(Metrics::hostLabel(hostInfo))),
+      yield(yield), socket(services.io_service) {
   LOG_TRACE("HTTP constructor: " << hostInfo);
-  // Set up
-  ssl_context.set_default_verify_paths();
-  sslStream.set_verify_mode(ssl::verify_peer);
-  sslStream.set_verify_callback(ssl::rfc2818_verification(hostInfo.hostname));
 }
 
 HTTP::~HTTP() {
   const char *ending(" should have been closed before destruction");
-  if (sslStream.lowest_layer().is_open()) {
+  if (sslStream && sslStream->lowest_layer().is_open()) {
     LOG_FATAL("HTTP SSL Connection to " << hostInfo.hostname << ending);
   }
   if (socket.is_open()) {
@@ -120,34 +78,357 @@ HTTP::~HTTP() {
 
 /// Handles an HTTP action (verb) GET/POST/ etc..
 HTTPResponse HTTP::action(HTTPRequest &request, std::string filePath) {
-  ensureConnection();
-  addDefaultHeaders(request);
-  output << request.verb << " " << request.path << " HTTP/1.1"
-         << "\r\n";
-
-  for (const auto &header : request.headers)
-    output << header.first << ": " << header.second << "\r\n";
-  output << "\r\n";
-
   HTTPResponse result;
   if (!filePath.empty())
     result.body.initWithFile(filePath);
-  transmitBody(output, request, yield);
+  action(request, result);
+  return result;
+}
 
-  readHTTPReply(result);
+void HTTP::action(HTTPRequest &request, HTTPResponse &response) {
+  bool ok;
+  try {
+    ok = perform(request, response, nullptr);
+  } catch (...) {
+    abandonResponse();
+    throw;
+  }
+  if (!ok)
+    throw HTTPError(response.code, response.body);
+}
 
-  return result;
+void HTTP::action(HTTPRequest &request, HTTPResponse &response,
+                  StreamedBody &body) {
+  bool ok;
+  try {
+    ok = perform(request, response, &body);
+  } catch (...) {
+    abandonResponse();
+    buffers.decoder.streamTo(nullptr);
+    throw;
+  }
+  buffers.decoder.streamTo(nullptr);
+  if (!ok)
+    throw HTTPError(response.code);
 }
 
-void HTTP::readHTTPReply(HTTPResponse &result) {
+HTTPOutcome HTTP::tryAction(HTTPRequest &request, HTTPResponse &response) {
+  HTTPOutcome outcome;
+  outcome.response = &response;
+  try {
+    perform(request, response, nullptr);
+    outcome.code = response.code;
+  } catch (std::exception &e) {
+    abandonResponse();
+    outcome.error = e.what();
+    outcome.failure = std::current_exception();
+  }
+  return outcome;
+}
+
+HTTPOutcome HTTP::tryGet(const std::string &path, HTTPResponse &response) {
+  getRequest.path = path;
+  return tryAction(getRequest, response);
+}
+
+void HTTPOutcome::throwIfFailed() const {
+  if (failure)
+    std::rethrow_exception(failure);
+  if (!ok())
+    throw HTTPError(code, response ? std::string(response->body) : "");
+}
+
+void HTTP::abandonResponse() {
+  if (!inFlight)
+    return;
+  inFlight = false;
+  if (!is_open())
+    return;
+  metrics.connectionsClosed.add();
+  boost::system::error_code ec;
   if (hostInfo.is_ssl())
-    RESTClient::readHTTPReply(result, yield, sslStream,
-                              std::bind(&HTTP::close, this));
+    sslStream->lowest_layer().close(ec);
   else
-    RESTClient::readHTTPReply(result, yield, socket,
-                              std::bind(&HTTP::close, this));
+    socket.close(ec);
+  // And what we'd read of it
+  buffers.incoming.consume(buffers.incoming.size());
+}
+
+/// True if 'body' is read into memory; a view may be one the coalescer shared
+static bool inMemory(const HTTPBody &body) {
+  return (body.kind() == HTTPBody::Kind::buffer) ||
+         (body.kind() == HTTPBody::Kind::view);
+}
+
+bool HTTP::perform(HTTPRequest &request, HTTPResponse &response,
+                   StreamedBody *streamed) {
+  if (streamed || !cacheableRequest(request))
+    return exchange(request, response, streamed);
+  if (coalescer && inMemory(response.body))
+    return performCoalesced(request, response);
+  return performCacheable(request, response);
 }
 
+bool HTTP::performCacheable(HTTPRequest &request, HTTPResponse &response) {
+  if (cache && inMemory(response.body))
+    return performCached(request, response);
+  if (diskCache && (response.body.kind() == HTTPBody::Kind::file))
+    return performDiskCached(request, response);
+  return exchange(request, response, nullptr);
+}
+
+bool HTTP::performCoalesced(HTTPRequest &request, HTTPResponse &response) {
+  // Held, as useCoalescer() may be called while we wait
+  std::shared_ptr<RequestCoalescer> coalescer = this->coalescer;
+  std::string key = coalescer->key(hostInfo, request);
+  auto joined = coalescer->join(key);
+  RequestCoalescer::Flight &flight = *joined.first;
+  if (joined.second) {
+    bool ok;
+    try {
+      ok = performCacheable(request, response);
+    } catch (...) {
+      coalescer->land(key, flight, std::current_exception());
+      throw;
+    }
+    coalescer->land(key, flight, response);
+    return ok;
+  }
+  TRACE_SPAN("coalesced", traceId());
+  startCachedTimings(response.timings);
+  coalescer->wait(flight, yield);
+  if (flight.failure)
+    std::rethrow_exception(flight.failure);
+  response.code = flight.code;
+  buffers.spareHeaders.recycle(response.headers);
+  for (const auto &header : flight.headers)
+    buffers.spareHeaders.add(response.headers, header.first, header.second);
+  response.body.initWithShared(flight.body);
+  response.timings.decodedBodyBytes = flight.body->size();
+  response.timings.coalesced = true;
+  return (flight.code >= 200) && (flight.code < 300);
+}
+
+/// Fills in 'response' from what the cache had. The body is shared with the
+/// cache, not copied
+static void serveCached(const ResponseCache::Entry &entry,
+                        HTTPResponse &response, SpareHeaders &spareHeaders) {
+  response.code = entry.code;
+  spareHeaders.recycle(response.headers);
+  for (const auto &header : entry.headers)
+    spareHeaders.add(response.headers, header.first, header.second);
+  response.body.initWithShared(entry.body);
+  response.timings.decodedBodyBytes = entry.body->size();
+  response.timings.fromCache = true;
+}
+
+/// Fills in 'response', whose body is a file, from what the disk cache had
+static void serveCached(const DiskCache::Entry &entry, HTTPResponse &response,
+                        SpareHeaders &spareHeaders) {
+  response.code = entry.code;
+  spareHeaders.recycle(response.headers);
+  for (const auto &header : entry.headers)
+    spareHeaders.add(response.headers, header.first, header.second);
+  response.body.copyFileFrom(entry.body);
+  response.timings.decodedBodyBytes = response.body.size();
+  response.timings.fromCache = true;
+}
+
+void HTTP::startCachedTimings(HTTPTimings &timings) {
+  timings = HTTPTimings();
+  timings.start = Clock::now();
+  timings.queueWait = pendingQueueWait;
+  pendingQueueWait = Clock::duration::zero();
+}
+
+bool HTTP::exchangeIfChanged(HTTPRequest &request, HTTPResponse &response,
+                             std::string_view etag,
+                             std::string_view lastModified) {
+  // What we add comes off again, so the request can be reused
+  if (!etag.empty())
+    request.headers.emplace("If-None-Match", etag);
+  if (!lastModified.empty())
+    request.headers.emplace("If-Modified-Since", lastModified);
+  auto unconditional = [&] {
+    if (!etag.empty())
+      request.headers.erase("If-None-Match");
+    if (!lastModified.empty())
+      request.headers.erase("If-Modified-Since");
+  };
+  bool ok;
+  try {
+    ok = exchange(request, response, nullptr);
+  } catch (...) {
+    unconditional();
+    throw;
+  }
+  unconditional();
+  return ok;
+}
+
+bool HTTP::performCached(HTTPRequest &request, HTTPResponse &response) {
+  std::string key = cacheKey(hostInfo, request);
+  ResponseCache::EntryPtr stored = cache->find(key, request);
+  if (stored && stored->fresh(Clock::now())) {
+    TRACE_SPAN("cached", traceId());
+    startCachedTimings(response.timings);
+    serveCached(*stored, response, buffers.spareHeaders);
+    return (stored->code >= 200) && (stored->code < 300);
+  }
+  if (!stored) {
+    bool ok = exchange(request, response, nullptr);
+    cache->store(key, request, response);
+    return ok;
+  }
+  bool ok =
+      exchangeIfChanged(request, response, stored->etag, stored->lastModified);
+  if (stored->revalidatable() && (response.code == 304)) {
+    stored = cache->revalidated(key, request, stored, response);
+    serveCached(*stored, response, buffers.spareHeaders);
+    return (stored->code >= 200) && (stored->code < 300);
+  }
+  cache->store(key, request, response);
+  return ok;
+}
+
+bool HTTP::performDiskCached(HTTPRequest &request, HTTPResponse &response) {
+  std::string key = cacheKey(hostInfo, request);
+  boost::optional<DiskCache::Entry> stored = diskCache->find(key, request);
+  if (stored && stored->fresh) {
+    TRACE_SPAN("cached", traceId());
+    startCachedTimings(response.timings);
+    serveCached(*stored, response, buffers.spareHeaders);
+    return (stored->code >= 200) && (stored->code < 300);
+  }
+  if (!stored) {
+    bool ok = exchange(request, response, nullptr);
+    diskCache->store(key, request, response);
+    return ok;
+  }
+  bool ok =
+      exchangeIfChanged(request, response, stored->etag, stored->lastModified);
+  if (stored->revalidatable() && (response.code == 304)) {
+    diskCache->revalidated(key, request, *stored, response);
+    serveCached(*stored, response, buffers.spareHeaders);
+    return (stored->code >= 200) && (stored->code < 300);
+  }
+  diskCache->store(key, request, response);
+  return ok;
+}
+
+void HTTP::pace() {
+  Clock::duration wait = pacer();
+  if (wait <= Clock::duration::zero())
+    return;
+  TRACE_SPAN("paced", traceId());
+  asio::steady_timer timer(services.io_service);
+  timer.expires_from_now(wait);
+  timer.async_wait(yield);
+}
+
+bool HTTP::exchange(HTTPRequest &request, HTTPResponse &response,
+                    StreamedBody *streamed) {
+  // Before the timings start, so the wait isn't counted as latency
+  if (pacer)
+    pace();
+  TRACE_SPAN("action", traceId());
+  response.code = 0;
+  buffers.spareHeaders.recycle(response.headers);
+  response.body.clear();
+  response.timings = HTTPTimings();
+  startTimings(response.timings);
+  if (http2 && http2->usable(response.timings, yield)) {
+    addDefaultHeaders(request);
+    bool ok = http2->action(request, response, yield, streamed);
+    outgoingByteCounter += response.timings.wireBytesSent;
+    incomingByteCounter += response.timings.wireBytesReceived;
+    finishResponse(response);
+    return ok;
+  }
+  ensureConnection(response.timings);
+  auto writeStart = Clock::now();
+  addDefaultHeaders(request);
+  std::string &head = buffers.outgoing;
+  head.clear();
+  appendRequestHead(head, request);
+  inFlight = true;
+  if (hostInfo.is_ssl())
+    writeRequest(*sslStream, request);
+  else
+    writeRequest(socket, request);
+  response.timings.requestWrite = Clock::now() - writeStart;
+
+  buffers.decoder.streamTo(streamed);
+  return readHTTPReply(response);
+}
+
+void HTTP::startTimings(HTTPTimings &timings) {
+  timings.start = Clock::now();
+  timings.queueWait = pendingQueueWait;
+  pendingQueueWait = Clock::duration::zero();
+  timingBytesSent = outgoingByteCounter;
+  timingBytesReceived = incomingByteCounter;
+#ifdef ALLOCATION_ACCOUNTING
+  timingAllocations = allocationCounts();
+#endif
+}
+
+void HTTP::setQueueWait(Clock::duration wait) { pendingQueueWait = wait; }
+
+bool HTTP::readHTTPReply(HTTPResponse &result) {
+  bool ok;
+  // A lambda fits in std::function without the heap; a std::bind doesn't
+  auto close = [this] { this->close(); };
+  if (hostInfo.is_ssl())
+    ok = RESTClient::readHTTPReply(result, yield, *sslStream, close,
+                                   incomingByteCounter, buffers);
+  else
+    ok = RESTClient::readHTTPReply(result, yield, socket, close,
+                                   incomingByteCounter, buffers);
+  inFlight = false;
+  finishResponse(result);
+  return ok;
+}
+
+void HTTP::finishResponse(HTTPResponse &result) {
+  result.timings.wireBytesSent = outgoingByteCounter - timingBytesSent;
+  result.timings.wireBytesReceived = incomingByteCounter - timingBytesReceived;
+#ifdef ALLOCATION_ACCOUNTING
+  AllocationCounts allocations = allocationCounts() - timingAllocations;
+  result.timings.allocations = allocations.allocations;
+  result.timings.allocatedBytes = allocations.bytes;
+#endif
+  metrics.status(result.code);
+  metrics.bytesSent.add(result.timings.wireBytesSent);
+  metrics.bytesReceived.add(result.timings.wireBytesReceived);
+  metrics.latency.record(
+      HostMetrics::nanoseconds(Clock::now() - result.timings.start));
+  for (auto &observer : responseObservers)
+    observer(result);
+}
+
+void HTTP::useHTTP2(std::shared_ptr<HTTP2Session> session) {
+  http2 = std::move(session);
+}
+
+void HTTP::useCache(std::shared_ptr<ResponseCache> cache) {
+  this->cache = std::move(cache);
+}
+
+void HTTP::useDiskCache(std::shared_ptr<DiskCache> cache) {
+  diskCache = std::move(cache);
+}
+
+void HTTP::useCoalescer(std::shared_ptr<RequestCoalescer> coalescer) {
+  this->coalescer = std::move(coalescer);
+}
+
+void HTTP::observeResponses(ResponseObserver observer) {
+  responseObservers.emplace_back(std::move(observer));
+}
+
+void HTTP::paceRequests(RequestPacer pacer) { this->pacer = std::move(pacer); }
+
 std::string HTTPError::lookupCode(int code) {
   // TODO: Maybe translate the http error code into a useful message
   // Maybe copy how it's done in curlpp11 where you pass an error code callback
@@ -159,41 +440,89 @@ std::string HTTPError::lookupCode(int code) {
   return std::move(result.str());
 }
 
-void HTTP::ensureConnection() {
-  // Resolve if needed
-  tcp::resolver::iterator endpoints;
-  if (endpoints == decltype(endpoints)()) {
-    endpoints = services.resolver.async_resolve(
-        {hostInfo.hostname, hostInfo.protocol}, yield);
-  }
-  // Connect if needed
-  if (hostInfo.is_ssl()) {
-    if (!sslStream.lowest_layer().is_open()) {
-      asio::async_connect(sslStream.lowest_layer(), endpoints, yield);
+void HTTP::ensureConnection(HTTPTimings &timings) {
+  TRACE_SPAN("ensureConnection", traceId());
+  timings.reusedConnection = is_open();
+  if (timings.reusedConnection) {
+    metrics.connectionsReused.add();
+  } else {
+    metrics.connectionsOpened.add();
+    // Resolve
+    auto phaseStart = Clock::now();
+    tcp::resolver::iterator endpoints;
+    {
+      TRACE_SPAN("dns", traceId());
+      endpoints = services.resolver.async_resolve(
+          {hostInfo.hostname, std::to_string(hostInfo.getPort())}, yield);
+    }
+    auto phaseEnd = Clock::now();
+    timings.dns = phaseEnd - phaseStart;
+    // Connect
+    phaseStart = phaseEnd;
+    if (hostInfo.is_ssl()) {
+      sslStream.reset(new ssl::stream<tcp::socket>(services.io_service,
+                                                   services.ssl_context));
+      sslStream->set_verify_mode(ssl::verify_peer);
+      sslStream->set_verify_callback(
+          ssl::rfc2818_verification(hostInfo.hostname));
+      {
+        TRACE_SPAN("connect", traceId());
+        asio::async_connect(sslStream->lowest_layer(), endpoints, yield);
+      }
+      phaseEnd = Clock::now();
+      timings.connect = phaseEnd - phaseStart;
       // Perform SSL handshake and verify the remote host's
       // certificate.
-      sslStream.async_handshake(ssl::stream<tcp::socket>::client, yield);
+      phaseStart = phaseEnd;
+      {
+        TRACE_SPAN("tlsHandshake", traceId());
+        sslStream->async_handshake(ssl::stream<tcp::socket>::client, yield);
+      }
+      timings.tlsHandshake = Clock::now() - phaseStart;
+    } else {
+      {
+        TRACE_SPAN("connect", traceId());
+        asio::async_connect(socket, endpoints, yield);
+      }
+      timings.connect = Clock::now() - phaseStart;
     }
-  } else {
-    if (!socket.is_open())
-      asio::async_connect(socket, endpoints, yield);
   }
-  makeOutput();
 }
 
 HTTPResponse HTTP::get(std::string path, Headers headers) {
-  HTTPRequest request("GET", path, headers);
+  resetArena();
+  HTTPRequest request("GET", path,
+                      Headers(headers.begin(), headers.end(), &arena));
   return action(request);
 }
 
+const HTTPResponse &HTTP::fetch(HTTPRequest &request) {
+  resetArena();
+  action(request, arenaResponse);
+  return arenaResponse;
+}
+
+void HTTP::resetArena() {
+  // Nothing may be left in the arena when it's reset
+  arenaResponse.headers.clear();
+  arena.reset();
+}
+
+void HTTP::get(const std::string &path, HTTPResponse &response) {
+  getRequest.path = path;
+  action(getRequest, response);
+}
+
 HTTPResponse HTTP::getToFile(std::string serverPath,
                              const std::string &filePath) {
-  HTTPRequest request("GET", serverPath);
+  resetArena();
+  HTTPRequest request("GET", serverPath, Headers(&arena));
   return action(request, filePath);
 }
 
 HTTPResponse HTTP::del(std::string path) {
-  HTTPRequest request("DELETE", path);
+  resetArena();
+  HTTPRequest request("DELETE", path, Headers(&arena));
   return action(request);
 }
 
@@ -201,13 +530,15 @@ HTTPResponse HTTP::PUT_OR_POST(std::string verb, std::string path,
                                std::string data) {
   // TODO: urlencode ? parameters ? other headers ? chunked data support
   // TODO: use 'action' instead
-  HTTPRequest request(verb, path, {}, data);
+  resetArena();
+  HTTPRequest request(verb, path, Headers(&arena), data);
   return action(request);
 }
 
 HTTPResponse HTTP::put(const std::string path, std::string data) {
   LOG_TRACE("PUT " << path << " - " << data);
-  HTTPRequest request("PUT", path, {}, data);
+  resetArena();
+  HTTPRequest request("PUT", path, Headers(&arena), data);
   return action(request);
 }
 
@@ -218,49 +549,19 @@ HTTPResponse HTTP::post(const std::string path, std::string data) {
 
 HTTPResponse HTTP::PUT_OR_POST_STREAM(std::string verb, std::string path,
                                       std::istream &data) {
-  // TODO: use 'action' instead
-  boost::asio::streambuf buf;
-  std::ostream request(&buf);
-  // TODO: urlencode ? parameters ? other headers ? chunked data support
-  request << verb << " " << path << " HTTP/1.1"
-          << "\r\n";
-  request << "Host: " << hostInfo.hostname << "\r\n";
-  request << "Accept: */*"
-          << "\r\n";
-  request << "Accept-Encoding: gzip, deflate"
-          << "\r\n";
-  request << "TE: trailers"
-          << "\r\n";
-  // Find the stream size
+  // Find the stream size. Without one it's sent in chunks
   data.seekg(0, std::istream::end);
   long size = data.tellg();
+  data.clear();
   data.seekg(0);
-  if (size != -1)
-    request << "Content-Length: " << size << "\r\n";
-  request << "\r\n";
-#ifdef HTTP_ON_STD_OUT
-  std::cout << std::endl << "> ";
-  for (auto &part : buf.data())
-    std::cout.write(boost::asio::buffer_cast<const char *>(part),
-                    boost::asio::buffer_size(part));
-#endif
-  HTTPResponse result;
-  ensureConnection();
-  io::copy(buf, output);
-  io::copy(data, output);
-  readHTTPReply(result);
-  return result;
-}
-
-void HTTP::makeOutput() {
-  output.reset();
-#ifdef HTTP_ON_STD_OUT
-  output.push(CopyOutgoingToCout());
-#endif
-  if (hostInfo.is_ssl())
-    output.push(make_output_to_net(sslStream, yield));
-  else
-    output.push(make_output_to_net(socket, yield));
+  HTTPRequest request(verb, path);
+  request.body.initWithGenerator(
+      [&data](char *out, size_t size) -> size_t {
+        data.read(out, size);
+        return data.gcount();
+      },
+      size);
+  return action(request);
 }
 
 HTTPResponse HTTP::putStream(std::string path, std::istream &data) {
@@ -275,52 +576,57 @@ HTTPResponse HTTP::postStream(std::string path, std::istream &data) {
 
 bool HTTP::is_open() const {
   if (hostInfo.is_ssl())
-    return sslStream.lowest_layer().is_open();
+    return sslStream && sslStream->lowest_layer().is_open();
   else
     return socket.is_open();
 }
 
+bool cleanSSLShutdown(const boost::system::error_code &ec) {
+  using asio::error::misc_errors;
+  using asio::error::basic_errors;
+  const auto &misc_cat = asio::error::get_misc_category();
+  const auto &ssl_cat = asio::error::get_ssl_category();
+  // This error means the remote party has initiated has already closed the
+  // underlying transport (TCP FIN) without shutting down the SSL.
+  // It may be a truncate attack attempt, but nothing we can do about it
+  // except close the connection.
+  if (ec.category() == ssl_cat &&
+      ec.value() == ERR_PACK(ERR_LIB_SSL, 0, SSL_R_SHORT_READ)) {
+    LOG_DEBUG("SSL Shutdown - remote party just dropped TCP FIN instead of "
+              "closing SSL protocol. Possible truncate attack - closing "
+              "connection.")
+    return true;
+  }
+  // We are the first one to run ssl_shutdown, and remote party responded in
+  // kind, just continue
+  if (ec.category() == misc_cat && ec.value() == misc_errors::eof)
+    return true;
+  // The remote party sent ssl_shutdown, then just dropped the connection
+  if (ec.category() == misc_cat &&
+      ec.value() == basic_errors::operation_aborted)
+    return true;
+  // Everything went as planned
+  return ec.category() == boost::system::system_category() &&
+         ec.value() == boost::system::errc::success;
+}
+
 void HTTP::close() {
-  if (sslStream.lowest_layer().is_open()) {
+  if (is_open())
+    metrics.connectionsClosed.add();
+  if (sslStream && sslStream->lowest_layer().is_open()) {
     boost::system::error_code ec;
-    sslStream.async_shutdown(yield[ec]);
-    sslStream.lowest_layer().close();
+    sslStream->async_shutdown(yield[ec]);
+    sslStream->lowest_layer().close();
     LOG_DEBUG("SSH Shutdown 1: " << ec.category().name() << " - " << ec.value()
                                  << " - " << ec.category().message(ec.value()));
-    using asio::error::misc_errors;
-    using asio::error::basic_errors;
-    const auto &misc_cat = asio::error::get_misc_category();
-    const auto &ssl_cat = asio::error::get_ssl_category();
-    // This error means the remote party has initiated has already closed the
-    // underlying transport (TCP FIN) without shutting down the SSL.
-    // It may be a truncate attack attempt, but nothing we can do about it
-    // except close the connection.
-    if (ec.category() == ssl_cat &&
-        ec.value() == ERR_PACK(ERR_LIB_SSL, 0, SSL_R_SHORT_READ)) {
-      LOG_DEBUG("SSL Shutdown - remote party just dropped TCP FIN instead of "
-                "closing SSL protocol. Possible truncate attack - closing "
-                "connection.")
+    if (cleanSSLShutdown(ec))
       return;
-    }
-    // We are the first one to run ssl_shutdown, and remote party responded in
-    // kind, just continue
-    if (ec.category() == misc_cat && ec.value() == misc_errors::eof) {
-      return;
-    }
-    // The remote party sent ssl_shutdown, then just dropped the connection
-    if (ec.category() == misc_cat &&
-        ec.value() == basic_errors::operation_aborted) {
-      return;
-    }
-    // Everything went as planned
-    if (ec.category() == boost::system::system_category() &&
-        ec.value() == boost::system::errc::success) {
-      return;
-    }
-    // Something scary happened, log an error (throw an exception too)
-    LOG_ERROR("Unabled to shutdown SSL connection: "
-              << ec.category().name() << " (" << ec.value() << ") "
-              << ec.category().message(ec.value()));
+    // Something scary happened
+    std::stringstream msg;
+    msg << "Unabled to shutdown SSL connection: " << ec.category().name()
+        << " (" << ec.value() << ") " << ec.category().message(ec.value());
+    LOG_ERROR(msg.str());
+    throw std::runtime_error(msg.str());
   } else if (socket.is_open()) {
     socket.close();
   }
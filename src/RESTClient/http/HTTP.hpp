@@ -5,12 +5,22 @@
 #include <boost/asio/ssl/stream.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
 
+#include <RESTClient/base/allocations.hpp>
+#include <RESTClient/base/trace.hpp>
 #include <RESTClient/base/url.hpp>
 #include <RESTClient/http/Services.hpp>
+#include <RESTClient/http/HTTPConnectionBuffers.hpp>
 #include <RESTClient/http/HTTPResponse.hpp>
 #include <RESTClient/http/HTTPRequest.hpp>
+#include <RESTClient/http/StreamedBody.hpp>
+#include <RESTClient/metrics/Metrics.hpp>
 
 namespace RESTClient {
 
@@ -25,34 +35,134 @@ public:
   int code;
 };
 
+/// What a request came to, told without throwing. A response is an outcome
+/// whatever its status; only a request that got no response (DNS, connect or
+/// TLS failures, a dropped connection, a malformed reply) has an 'error'
+struct HTTPOutcome {
+  /// Filled in as far as the request got
+  HTTPResponse *response = nullptr;
+  /// The response's status, or 0 if there wasn't one
+  int code = 0;
+  /// Why there was no response, if there wasn't
+  std::string error;
+  /// The exception behind 'error', for throwIfFailed
+  std::exception_ptr failure;
+  bool responded() const { return error.empty() && (code != 0); }
+  /// True for a 2xx status, whatever the reason phrase said
+  bool ok() const { return responded() && (code >= 200) && (code < 300); }
+  explicit operator bool() const { return ok(); }
+  /// For those who'd rather have exceptions: rethrows why there was no
+  /// response, or throws HTTPError if the status wasn't 2xx
+  void throwIfFailed() const;
+};
+
 using namespace boost;
 using namespace boost::asio::ip; // to get 'tcp::'
 namespace ssl = boost::asio::ssl;
 
 class HTTP;
+class HTTP2Session;
+class ResponseCache;
+class DiskCache;
+class RequestCoalescer;
 using boost::iostreams::filtering_istream;
 using boost::iostreams::filtering_ostream;
 
+/// True if 'ec', from shutting down an SSL stream, is nothing to worry about
+bool cleanSSLShutdown(const boost::system::error_code &ec);
+
+/// Gets to look at every response before 'HTTP::action' returns (or throws)
+using ResponseObserver = std::function<void(const HTTPResponse &)>;
+/// Asked before each request goes on the wire. Returns how long to wait
+/// before sending it
+using RequestPacer = std::function<Clock::duration()>;
+
 // Handle an HTTP connection
 class HTTP {
 private:
   const HostInfo& hostInfo;
   Services& services;
+  // This thread's metrics for our host
+  HostMetrics& metrics;
   asio::yield_context yield;
-  ssl::context ssl_context;
   // Needs to be a unique_ptr, because ssl::stream has no copy and no move
-  // powerz, but we want to be able to move HTTP instances
-  ssl::stream<tcp::socket> sslStream;
+  // powerz, but we want to be able to move HTTP instances. It's remade for each
+  // connection, as a dropped one leaves its SSL state behind
+  std::unique_ptr<ssl::stream<tcp::socket>> sslStream;
   tcp::socket socket;
-  filtering_ostream output;
+  HTTPConnectionBuffers buffers;
+  /// True from when a request's head is written until its response is read
+  /// whole. A failure meanwhile leaves the connection part way through one
+  bool inFlight = false;
+  /// Reused by get(path, response)
+  HTTPRequest getRequest{"GET", ""};
+  /// Holds the storage of one request and its response; reset for each
+  /// request made by fetch() or the convenience functions
+  Arena arena;
+  /// Lives in 'arena'; returned by fetch()
+  HTTPResponse arenaResponse{&arena};
+  void resetArena();
   size_t incomingByteCounter = 0;
-  void ensureConnection();
-  void readHTTPReply(HTTPResponse &result);
+  size_t outgoingByteCounter = 0;
+  // Byte counters at the start of the current request
+  size_t timingBytesSent = 0;
+  size_t timingBytesReceived = 0;
+  // Queue wait to report in the next response's timings
+  Clock::duration pendingQueueWait = Clock::duration::zero();
+#ifdef ALLOCATION_ACCOUNTING
+  // This thread's allocation counts at the start of the current request
+  AllocationCounts timingAllocations;
+#endif
+  std::vector<ResponseObserver> responseObservers;
+  /// Set by paceRequests()
+  RequestPacer pacer;
+  /// Waits as long as 'pacer' says before the next request
+  void pace();
+  /// Set by useHTTP2()
+  std::shared_ptr<HTTP2Session> http2;
+  /// Set by useCache()
+  std::shared_ptr<ResponseCache> cache;
+  /// Set by useDiskCache()
+  std::shared_ptr<DiskCache> diskCache;
+  /// Set by useCoalescer()
+  std::shared_ptr<RequestCoalescer> coalescer;
+  /// Returns true if the status was 2xx. Goes through the coalescer and the
+  /// caches if it can
+  bool perform(HTTPRequest &request, HTTPResponse &response,
+               StreamedBody *streamed);
+  /// perform() for a request the coalescer may share
+  bool performCoalesced(HTTPRequest &request, HTTPResponse &response);
+  /// perform() for a request the caches may answer
+  bool performCacheable(HTTPRequest &request, HTTPResponse &response);
+  /// perform() for a request the cache may answer
+  bool performCached(HTTPRequest &request, HTTPResponse &response);
+  /// perform() for a request the disk cache may answer, into a file
+  bool performDiskCached(HTTPRequest &request, HTTPResponse &response);
+  /// Timings for a response we didn't fetch ourselves: from a cache, or
+  /// shared by the coalescer
+  void startCachedTimings(HTTPTimings &timings);
+  /// exchange(), asking for the response only if it's changed since it had
+  /// these validators, if it had any
+  bool exchangeIfChanged(HTTPRequest &request, HTTPResponse &response,
+                         std::string_view etag, std::string_view lastModified);
+  /// Sends 'request' and reads the response, over HTTP/2 or our connection
+  bool exchange(HTTPRequest &request, HTTPResponse &response,
+                StreamedBody *streamed);
+  /// Closes the connection if a request was left part sent, or its response
+  /// part read, so the rest isn't taken for the next. Called when a request
+  /// fails
+  void abandonResponse();
+  void startTimings(HTTPTimings &timings);
+  void ensureConnection(HTTPTimings &timings);
+  bool readHTTPReply(HTTPResponse &result);
+  /// Records a finished response, and shows it to the observers
+  void finishResponse(HTTPResponse &result);
   HTTPResponse PUT_OR_POST(std::string verb, std::string path,
                            std::string data);
   HTTPResponse PUT_OR_POST_STREAM(std::string verb,
                                   std::string path, std::istream &data);
-  void makeOutput();
+  template <typename Connection>
+  void writeRequest(Connection &connection, HTTPRequest &request);
 
 public:
   HTTP(const HostInfo &hostInfo, asio::yield_context yield);
@@ -63,14 +173,38 @@ public:
   /// Modifies 'request' to have our default headers (won't change headers that
   /// are already in place)
   void addDefaultHeaders(HTTPRequest &request);
-  /// Perform an HTTP action (this is a catch all)
+  /// Like action(request, response), but never throws. How it went is in the
+  /// outcome: a status, or why there wasn't one. A status that isn't 2xx is
+  /// only an outcome, so eg. checking for a 404 costs no exceptions
+  HTTPOutcome tryAction(HTTPRequest &request, HTTPResponse &response);
+  /// A GET that never throws, reusing 'response' and a request kept by this
+  /// connection
+  HTTPOutcome tryGet(const std::string &path, HTTPResponse &response);
+  /// Perform an HTTP action (this is a catch all). Throws HTTPError if the
+  /// status wasn't 2xx.
   /// request headers may be modified to add the defaults
   /// By default will read the response to a string, but if you specify
   /// 'filePath' it'll save it to a file
   HTTPResponse action(HTTPRequest& request, std::string filePath="");
+  /// Like action(request), but fills in 'response', reusing its storage.
+  /// Keep passing the same request and response to a connection, and a
+  /// keep-alive request with a small body needn't touch the heap
+  void action(HTTPRequest &request, HTTPResponse &response);
+  /// Like action(request, response), but hands the body to 'body' as it
+  /// arrives, rather than keeping it in 'response'. Throws HTTPError (with no
+  /// body) after the fact if the status wasn't 2xx. If a handler throws,
+  /// the rest of the response is abandoned with the connection
+  void action(HTTPRequest &request, HTTPResponse &response,
+              StreamedBody &body);
+  /// Performs 'request' and returns a response kept in this connection's
+  /// arena. It's only valid until the next request on this connection; use
+  /// its copy() to keep it longer
+  const HTTPResponse &fetch(HTTPRequest &request);
   // Get a resource from the server. Path is the part after the URL.
   // eg. get("/person/1"); would get http://httpbin.org/person/1
   HTTPResponse get(std::string path, Headers headers = {});
+  /// A GET that reuses 'response', and a request kept by this connection
+  void get(const std::string &path, HTTPResponse &response);
   HTTPResponse getToFile(std::string serverPath, const std::string& filePath);
   HTTPResponse del(std::string path);
   HTTPResponse put(std::string path, std::string data);
@@ -79,6 +213,41 @@ public:
   HTTPResponse postStream(std::string path, std::istream& data);
   HTTPResponse patch(std::string path, std::string data);
   bool is_open() const; // Return true if the connection is open
+  /// Register a function to be called with every response we read, including
+  /// error responses
+  void observeResponses(ResponseObserver observer);
+  /// Ask 'pacer' before each request we send how long to wait first. Those
+  /// the caches or the coalescer answer aren't asked about. nullptr stops it
+  void paceRequests(RequestPacer pacer);
+  /// Send our requests over 'session', alongside other HTTP objects' requests
+  /// to the same host, while the server speaks HTTP/2. If it only speaks
+  /// HTTP/1.1 we use our own connection as usual. Whoever made the session
+  /// closes it
+  void useHTTP2(std::shared_ptr<HTTP2Session> session);
+  /// Look for GET responses in 'cache' before asking the server, and keep
+  /// the ones we can. Responses read into a file or streamed aren't cached.
+  /// nullptr stops it
+  void useCache(std::shared_ptr<ResponseCache> cache);
+  /// Look for GET responses read into files (eg. by getToFile) in 'cache'
+  /// before asking the server, and keep the ones we can. nullptr stops it
+  void useDiskCache(std::shared_ptr<DiskCache> cache);
+  /// Share the responses to GETs with others using 'coalescer', while
+  /// they're asking for the same thing at the same time. Responses read into
+  /// a file or streamed aren't shared. nullptr stops it
+  void useCoalescer(std::shared_ptr<RequestCoalescer> coalescer);
+  /// Tell us how long the current job waited in a queue. It's reported in the
+  /// timings of the next response
+  void setQueueWait(Clock::duration wait);
+  /// Identifies this connection in traces
+  const void *traceId() const {
+    if (hostInfo.is_ssl())
+      return &sslStream;
+    return &socket;
+  }
+  /// Total bytes read from the net over the life of this connection
+  size_t bytesReceived() const { return incomingByteCounter; }
+  /// Total bytes written to the net over the life of this connection
+  size_t bytesSent() const { return outgoingByteCounter; }
   /// WARNING: This is the only blocking function, and must be called before
   /// shutting down. It'll wait for the SSL shutdown procedure
   void close();
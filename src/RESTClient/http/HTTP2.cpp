@@ -0,0 +1,675 @@
+#include "HTTP2.hpp"
+
+#include <RESTClient/base/logger.hpp>
+#include <RESTClient/http/HTTP.hpp>
+#include <RESTClient/http/RequestTemplate.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <vector>
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/ssl/rfc2818_verification.hpp>
+#include <boost/asio/write.hpp>
+
+namespace RESTClient {
+
+using namespace HTTP2;
+
+namespace {
+
+/// What we offer in ALPN, best first
+const unsigned char alpnProtocols[] = "\x02h2\x08http/1.1";
+
+/// Headers that only mean something to a single HTTP/1.1 connection
+bool connectionSpecific(std::string_view name) {
+  return (name == "host") || (name == "connection") ||
+         (name == "keep-alive") || (name == "proxy-connection") ||
+         (name == "transfer-encoding") || (name == "upgrade");
+}
+
+} /* anonymous namespace */
+
+HTTP2Session::HTTP2Session(const HostInfo &hostInfo)
+    : hostInfo(hostInfo), services(Services::instance()),
+      metrics(Metrics::instance().local(Metrics::hostLabel(hostInfo))) {
+  // We don't do HTTP/2 in the clear
+  if (!hostInfo.is_ssl())
+    protocol = Protocol::http1;
+}
+
+HTTP2Session::~HTTP2Session() {
+  if (is_open()) {
+    LOG_FATAL("HTTP/2 connection to "
+              << hostInfo.hostname
+              << " should have been closed before destruction");
+  }
+}
+
+bool HTTP2Session::is_open() const {
+  return sslStream && sslStream->lowest_layer().is_open();
+}
+
+void HTTP2Session::wait(asio::yield_context yield) {
+  asio::steady_timer timer(services.io_service);
+  timer.expires_at(asio::steady_timer::time_point::max());
+  waiting.push_back(&timer);
+  boost::system::error_code ec;
+  timer.async_wait(yield[ec]);
+  waiting.remove(&timer);
+}
+
+void HTTP2Session::wakeAll() {
+  std::list<asio::steady_timer *> waking;
+  waking.swap(waiting);
+  for (auto timer : waking)
+    timer->cancel();
+}
+
+bool HTTP2Session::usable(HTTPTimings &timings, asio::yield_context yield) {
+  while (true) {
+    switch (protocol) {
+    case Protocol::http1:
+      return false;
+    case Protocol::http2:
+      if (!draining)
+        return true;
+      // Wait for the old connection's streams to finish, then make a new one
+      wait(yield);
+      break;
+    case Protocol::connecting:
+      wait(yield);
+      break;
+    case Protocol::unknown:
+      if (readerRunning || writerRunning)
+        wait(yield);
+      else
+        connect(timings, yield);
+    }
+  }
+}
+
+void HTTP2Session::connect(HTTPTimings &timings, asio::yield_context yield) {
+  protocol = Protocol::connecting;
+  metrics.connectionsOpened.add();
+  try {
+    sslStream.reset(
+        new ssl::stream<tcp::socket>(services.io_service, services.ssl_context));
+    sslStream->set_verify_mode(ssl::verify_peer);
+    sslStream->set_verify_callback(ssl::rfc2818_verification(hostInfo.hostname));
+    SSL_set_alpn_protos(sslStream->native_handle(), alpnProtocols,
+                        sizeof(alpnProtocols) - 1);
+    auto phaseStart = Clock::now();
+    tcp::resolver::iterator endpoints = services.resolver.async_resolve(
+        {hostInfo.hostname, std::to_string(hostInfo.getPort())}, yield);
+    auto phaseEnd = Clock::now();
+    timings.dns = phaseEnd - phaseStart;
+    phaseStart = phaseEnd;
+    asio::async_connect(sslStream->lowest_layer(), endpoints, yield);
+    sslStream->lowest_layer().set_option(tcp::no_delay(true));
+    phaseEnd = Clock::now();
+    timings.connect = phaseEnd - phaseStart;
+    phaseStart = phaseEnd;
+    sslStream->async_handshake(ssl::stream<tcp::socket>::client, yield);
+    timings.tlsHandshake = Clock::now() - phaseStart;
+  } catch (...) {
+    boost::system::error_code ec;
+    sslStream->lowest_layer().close(ec);
+    protocol = Protocol::unknown;
+    wakeAll();
+    throw;
+  }
+  const unsigned char *chosen = nullptr;
+  unsigned int chosenSize = 0;
+  SSL_get0_alpn_selected(sslStream->native_handle(), &chosen, &chosenSize);
+  if (std::string_view(reinterpret_cast<const char *>(chosen), chosenSize) !=
+      "h2") {
+    LOG_INFO(hostInfo.hostname << " doesn't speak HTTP/2. Using HTTP/1.1");
+    boost::system::error_code ec;
+    sslStream->async_shutdown(yield[ec]);
+    sslStream->lowest_layer().close(ec);
+    metrics.connectionsClosed.add();
+    protocol = Protocol::http1;
+    wakeAll();
+    return;
+  }
+  // A fresh connection
+  protocol = Protocol::http2;
+  draining = false;
+  closing = false;
+  encoder.reset();
+  decoder.reset();
+  nextStreamId = 1;
+  peerMaxFrameSize = defaultMaxFrameSize;
+  peerInitialWindow = defaultWindowSize;
+  peerMaxStreams = 100;
+  sendWindow = defaultWindowSize;
+  unacknowledged = 0;
+  headerStream = 0;
+  incoming.consume(incoming.size());
+  outgoing.assign(preface.data(), preface.size());
+  appendFrameHeader(outgoing, 12, FrameType::settings, 0, 0);
+  appendSetting(outgoing, Setting::enablePush, 0);
+  appendSetting(outgoing, Setting::initialWindowSize, windowSize);
+  if (windowSize > defaultWindowSize)
+    appendWindowUpdate(outgoing, 0, windowSize - defaultWindowSize);
+  readerRunning = true;
+  asio::spawn(services.io_service,
+              [this](asio::yield_context yield) { read(yield); });
+  wakeAll();
+  flush(yield);
+}
+
+void HTTP2Session::flush(asio::yield_context yield) {
+  // Whoever's writing now will send ours too
+  if (writerRunning)
+    return;
+  writerRunning = true;
+  try {
+    while (!outgoing.empty()) {
+      writing.swap(outgoing);
+      outgoing.clear();
+      outgoingByteCounter +=
+          asio::async_write(*sslStream, asio::buffer(writing), yield);
+    }
+  } catch (std::exception &e) {
+    writerRunning = false;
+    outgoing.clear();
+    fail(e.what());
+    throw;
+  }
+  writerRunning = false;
+}
+
+void HTTP2Session::read(asio::yield_context yield) {
+  std::string why;
+  try {
+    // After GOAWAY, we hang up once the last stream is done
+    while (!(draining && streams.empty())) {
+      auto fill = [&](size_t size) {
+        if (incoming.size() < size)
+          incomingByteCounter += asio::async_read(
+              *sslStream, incoming,
+              asio::transfer_at_least(size - incoming.size()), yield);
+      };
+      fill(FrameHeader::size);
+      const char *data = asio::buffer_cast<const char *>(incoming.data());
+      FrameHeader header = readFrameHeader(data);
+      if (header.length > defaultMaxFrameSize)
+        throw std::runtime_error("HTTP/2 frame bigger than we allow");
+      fill(FrameHeader::size + header.length);
+      data = asio::buffer_cast<const char *>(incoming.data());
+      frame(header, std::string_view(data + FrameHeader::size, header.length));
+      incoming.consume(FrameHeader::size + header.length);
+      if (!outgoing.empty())
+        flush(yield);
+    }
+  } catch (std::exception &e) {
+    why = e.what();
+  }
+  readerRunning = false;
+  if (!closing) {
+    if (is_open())
+      metrics.connectionsClosed.add();
+    boost::system::error_code ec;
+    if (draining && streams.empty())
+      sslStream->lowest_layer().close(ec);
+    else
+      fail(why.empty() ? "connection closed" : why);
+    protocol = Protocol::unknown;
+  }
+  wakeAll();
+}
+
+void HTTP2Session::frame(const FrameHeader &header, std::string_view payload) {
+  if ((headerStream != 0) && (header.type != FrameType::continuation))
+    throw std::runtime_error("HTTP/2 header block interrupted");
+  auto found = streams.find(header.stream);
+  Stream *target = (found == streams.end()) ? nullptr : found->second;
+  if (target)
+    target->bytesReceived += FrameHeader::size + header.length;
+  switch (header.type) {
+  case FrameType::data: {
+    if (header.stream == 0)
+      throw std::runtime_error("HTTP/2 DATA frame on stream 0");
+    // The connection's window counts frames for streams we've dropped too
+    unacknowledged += header.length;
+    if (unacknowledged >= windowSize / 2) {
+      appendWindowUpdate(outgoing, 0, unacknowledged);
+      unacknowledged = 0;
+    }
+    if (!target)
+      break;
+    if (!target->gotHeaders)
+      throw std::runtime_error("HTTP/2 DATA before HEADERS");
+    std::string_view body = unpadded(header, payload);
+    if (target->streamed) {
+      // Its window is given back as the sender uses it
+      target->held.append(body.data(), body.size());
+      target->unacknowledged += header.length - body.size();
+      if (header.has(Flags::endStream))
+        finish(*target);
+      else
+        target->done.cancel();
+      break;
+    }
+    try {
+      if (!body.empty())
+        target->decoder.write(body);
+    } catch (std::exception &e) {
+      appendRstStream(outgoing, target->id, ErrorCode::cancel);
+      finish(*target, e.what());
+      break;
+    }
+    if (header.has(Flags::endStream)) {
+      finish(*target);
+      break;
+    }
+    target->unacknowledged += header.length;
+    if (target->unacknowledged >= windowSize / 2) {
+      appendWindowUpdate(outgoing, target->id, target->unacknowledged);
+      target->unacknowledged = 0;
+    }
+    break;
+  }
+  case FrameType::headers: {
+    if (header.stream == 0)
+      throw std::runtime_error("HTTP/2 HEADERS frame on stream 0");
+    std::string_view block = unpadded(header, payload);
+    if (header.has(Flags::endHeaders)) {
+      headers(header.stream, block, header.has(Flags::endStream));
+    } else {
+      headerBlock.assign(block.data(), block.size());
+      headerStream = header.stream;
+      headerFlags = header.flags;
+    }
+    break;
+  }
+  case FrameType::continuation: {
+    if ((headerStream == 0) || (header.stream != headerStream))
+      throw std::runtime_error("Unexpected HTTP/2 CONTINUATION frame");
+    headerBlock.append(payload.data(), payload.size());
+    if (header.has(Flags::endHeaders)) {
+      uint32_t id = headerStream;
+      headerStream = 0;
+      headers(id, headerBlock, (headerFlags & Flags::endStream) != 0);
+    }
+    break;
+  }
+  case FrameType::rstStream: {
+    if (payload.size() != 4)
+      throw std::runtime_error("Bad HTTP/2 RST_STREAM frame");
+    if (target) {
+      std::stringstream msg;
+      msg << "HTTP/2 stream reset by " << hostInfo.hostname
+          << ". Error code: " << readUint32(payload.data());
+      finish(*target, msg.str());
+    }
+    break;
+  }
+  case FrameType::settings:
+    settings(header, payload);
+    break;
+  case FrameType::ping:
+    if (payload.size() != 8)
+      throw std::runtime_error("Bad HTTP/2 PING frame");
+    if (!header.has(Flags::ack)) {
+      appendFrameHeader(outgoing, 8, FrameType::ping, Flags::ack, 0);
+      outgoing.append(payload.data(), payload.size());
+    }
+    break;
+  case FrameType::goAway: {
+    if (payload.size() < 8)
+      throw std::runtime_error("Bad HTTP/2 GOAWAY frame");
+    uint32_t lastStream = readUint32(payload.data()) & 0x7fffffff;
+    LOG_DEBUG("HTTP/2 GOAWAY from " << hostInfo.hostname << ". Error code: "
+                                    << readUint32(payload.data() + 4));
+    draining = true;
+    // Streams after 'lastStream' were never started, so are safe to retry
+    std::vector<Stream *> refused;
+    for (auto &both : streams)
+      if (both.first > lastStream)
+        refused.push_back(both.second);
+    for (Stream *each : refused)
+      finish(*each, "HTTP/2 stream refused by server going away");
+    break;
+  }
+  case FrameType::windowUpdate: {
+    if (payload.size() != 4)
+      throw std::runtime_error("Bad HTTP/2 WINDOW_UPDATE frame");
+    uint32_t increment = readUint32(payload.data()) & 0x7fffffff;
+    if (header.stream == 0)
+      sendWindow += increment;
+    else if (target)
+      target->sendWindow += increment;
+    if ((sendWindow > maxWindowSize) ||
+        (target && (target->sendWindow > maxWindowSize)))
+      throw std::runtime_error("HTTP/2 flow control window overflow");
+    wakeAll();
+    break;
+  }
+  case FrameType::pushPromise:
+    throw std::runtime_error("HTTP/2 server push, though we turned it off");
+  default:
+    // PRIORITY, and frame types we don't know, are ignored
+    break;
+  }
+}
+
+void HTTP2Session::headers(uint32_t id, std::string_view block,
+                           bool endStream) {
+  auto found = streams.find(id);
+  Stream *target = (found == streams.end()) ? nullptr : found->second;
+  // We decode it even if nobody wants it, to keep HPACK in step
+  const char *data = block.data();
+  const char *end = data + block.size();
+  std::string_view name, value;
+  bool interim = false;
+  bool trailers = target && target->gotHeaders;
+  bool gzipped = false;
+  long contentLength = -1;
+  while (decoder.next(data, end, name, value)) {
+    if (!target)
+      continue;
+    HTTPResponse &response = *target->response;
+    if (name == ":status") {
+      response.code = std::stoi(std::string(value));
+      interim = (response.code >= 100) && (response.code < 200);
+      continue;
+    }
+    if (interim || name.empty() || (name[0] == ':'))
+      continue;
+    if ((name == "content-encoding") &&
+        (value.find("gzip") != std::string_view::npos))
+      gzipped = true;
+    if ((name == "content-length") && !value.empty() && (value.size() < 19) &&
+        (value.find_first_not_of("0123456789") == std::string_view::npos))
+      contentLength = std::stol(std::string(value));
+    nameScratch.assign(name.data(), name.size());
+    titleCase(nameScratch);
+    response.headers.emplace(nameScratch, value);
+  }
+  if (!target || interim)
+    return;
+  if (!trailers) {
+    if (target->response->code == 0)
+      throw std::runtime_error("HTTP/2 response without a :status");
+    target->gotHeaders = true;
+    target->headersAt = Clock::now();
+    try {
+      // A StreamedBody's handler sees the headers here
+      target->decoder.start(*target->response, gzipped,
+                            endStream ? 0 : contentLength);
+    } catch (std::exception &e) {
+      appendRstStream(outgoing, target->id, ErrorCode::cancel);
+      finish(*target, e.what());
+      return;
+    }
+  }
+  if (endStream)
+    finish(*target);
+}
+
+void HTTP2Session::settings(const FrameHeader &header,
+                            std::string_view payload) {
+  if (header.stream != 0)
+    throw std::runtime_error("HTTP/2 SETTINGS on a stream");
+  if (header.has(Flags::ack))
+    return;
+  if (payload.size() % 6 != 0)
+    throw std::runtime_error("Bad HTTP/2 SETTINGS frame");
+  for (size_t i = 0; i != payload.size(); i += 6) {
+    auto bytes = reinterpret_cast<const uint8_t *>(payload.data() + i);
+    auto id = static_cast<Setting>((bytes[0] << 8) | bytes[1]);
+    uint32_t value = readUint32(payload.data() + i + 2);
+    switch (id) {
+    case Setting::headerTableSize:
+      encoder.setMaxTableSize(value);
+      break;
+    case Setting::initialWindowSize: {
+      if (value > maxWindowSize)
+        throw std::runtime_error("HTTP/2 initial window too big");
+      // Applies to the streams we already have, too
+      int64_t change = int64_t(value) - peerInitialWindow;
+      for (auto &both : streams)
+        both.second->sendWindow += change;
+      peerInitialWindow = value;
+      break;
+    }
+    case Setting::maxFrameSize:
+      if ((value < defaultMaxFrameSize) || (value > maxMaxFrameSize))
+        throw std::runtime_error("Bad HTTP/2 max frame size");
+      peerMaxFrameSize = value;
+      break;
+    case Setting::maxConcurrentStreams:
+      peerMaxStreams = value;
+      break;
+    default:
+      break;
+    }
+  }
+  appendFrameHeader(outgoing, 0, FrameType::settings, Flags::ack, 0);
+  wakeAll();
+}
+
+void HTTP2Session::finish(Stream &stream, std::string error) {
+  stream.finished = true;
+  stream.error = std::move(error);
+  streams.erase(stream.id);
+  stream.done.cancel();
+  // Someone may be waiting for a free stream
+  wakeAll();
+}
+
+void HTTP2Session::fail(const std::string &why) {
+  LOG_WARN("HTTP/2 connection to " << hostInfo.hostname << " failed: " << why);
+  std::vector<Stream *> failed;
+  for (auto &both : streams)
+    failed.push_back(both.second);
+  for (Stream *each : failed)
+    finish(*each, "HTTP/2 connection to " + hostInfo.hostname +
+                        " failed: " + why);
+  boost::system::error_code ec;
+  if (sslStream)
+    sslStream->lowest_layer().close(ec);
+}
+
+void HTTP2Session::sendBody(Stream &stream, HTTPRequest &request,
+                            asio::yield_context yield) {
+  // Negative for a body of unknown size
+  long remaining = request.body.size();
+  size_t offset = 0;
+  while (true) {
+    while (!stream.finished && ((sendWindow <= 0) || (stream.sendWindow <= 0)))
+      wait(yield);
+    // The server may answer (or reset the stream) before it has the body
+    if (stream.finished)
+      return;
+    size_t room = std::min<int64_t>(std::min(sendWindow, stream.sendWindow),
+                                    peerMaxFrameSize);
+    if (remaining >= 0)
+      room = std::min<size_t>(room, remaining);
+    // Read the body straight into the outgoing frames
+    size_t at = outgoing.size();
+    outgoing.resize(at + FrameHeader::size + room);
+    size_t bytes =
+        request.body.read(offset, &outgoing[at + FrameHeader::size], room);
+    outgoing.resize(at + FrameHeader::size + bytes);
+    offset += bytes;
+    if (remaining >= 0)
+      remaining -= bytes;
+    bool last = (bytes == 0) || (remaining == 0);
+    std::string header;
+    appendFrameHeader(header, bytes, FrameType::data,
+                      last ? Flags::endStream : 0, stream.id);
+    outgoing.replace(at, FrameHeader::size, header);
+    sendWindow -= bytes;
+    stream.sendWindow -= bytes;
+    stream.bytesSent += FrameHeader::size + bytes;
+    flush(yield);
+    if (last)
+      return;
+  }
+}
+
+void HTTP2Session::receive(Stream &stream, asio::yield_context yield) {
+  std::string taken;
+  while (true) {
+    boost::system::error_code ec;
+    if (stream.streamed && stream.streamed->paused()) {
+      stream.streamed->asyncWaitForResume(yield[ec]);
+      continue;
+    }
+    if (!stream.decoder.ready())
+      continue;
+    if (!stream.held.empty() && stream.error.empty()) {
+      taken.swap(stream.held);
+      stream.decoder.write(taken);
+      if (!stream.finished) {
+        stream.unacknowledged += taken.size();
+        if (stream.unacknowledged >= windowSize / 2) {
+          appendWindowUpdate(outgoing, stream.id, stream.unacknowledged);
+          stream.unacknowledged = 0;
+          flush(yield);
+        }
+      }
+      taken.clear();
+      continue;
+    }
+    if (stream.finished)
+      return;
+    stream.done.expires_at(asio::steady_timer::time_point::max());
+    stream.done.async_wait(yield[ec]);
+  }
+}
+
+bool HTTP2Session::action(HTTPRequest &request, HTTPResponse &response,
+                          asio::yield_context yield, StreamedBody *streamed) {
+  HTTPTimings &timings = response.timings;
+  // Wait for the connection, and a free stream on it
+  while (true) {
+    if (!usable(timings, yield))
+      throw std::runtime_error(hostInfo.hostname + " stopped speaking HTTP/2");
+    if (streams.size() < peerMaxStreams)
+      break;
+    wait(yield);
+  }
+  // Only the request that connected has connection timings
+  timings.reusedConnection = timings.connect == Clock::duration::zero();
+  if (timings.reusedConnection)
+    metrics.connectionsReused.add();
+  Stream stream(services.io_service);
+  stream.id = nextStreamId;
+  nextStreamId += 2;
+  stream.response = &response;
+  stream.streamed = streamed;
+  stream.decoder.streamTo(streamed);
+  stream.sendWindow = peerInitialWindow;
+  streams[stream.id] = &stream;
+  // If we're thrown out of here, tell the server we've lost interest
+  struct Forget {
+    HTTP2Session &session;
+    Stream &stream;
+    ~Forget() {
+      if (stream.finished)
+        return;
+      session.streams.erase(stream.id);
+      appendRstStream(session.outgoing, stream.id, ErrorCode::cancel);
+    }
+  } forget{*this, stream};
+  // Encode the headers and queue them in one go, so streams start in order
+  std::string block;
+  // A template's headers go first, then the request's own
+  const Headers *fixed = request.from ? &request.from->getHeaders() : nullptr;
+  auto hostIn = [](const Headers *headers) -> const HeaderString * {
+    if (!headers)
+      return nullptr;
+    auto found = headers->find("Host");
+    return (found == headers->end()) ? nullptr : &found->second;
+  };
+  const HeaderString *host = hostIn(&request.headers);
+  if (!host)
+    host = hostIn(fixed);
+  encoder.encode(block, ":method", request.verb);
+  encoder.encode(block, ":scheme", "https");
+  encoder.encode(block, ":authority",
+                 host ? std::string_view(*host)
+                      : std::string_view(hostInfo.hostHeader()));
+  if (request.from)
+    nameScratch.assign(request.from->getPathPrefix()).append(request.path);
+  else
+    nameScratch.assign(request.path);
+  encoder.encode(block, ":path", nameScratch);
+  auto encodeHeaders = [&](const Headers &headers) {
+    for (const auto &header : headers) {
+      nameScratch.assign(header.first.data(), header.first.size());
+      std::transform(nameScratch.begin(), nameScratch.end(),
+                     nameScratch.begin(), ::tolower);
+      if (connectionSpecific(nameScratch) ||
+          ((nameScratch == "te") && (header.second != "trailers")))
+        continue;
+      encoder.encode(block, nameScratch, header.second,
+                     (nameScratch == "authorization") ||
+                         (nameScratch == "x-auth-token"));
+    }
+  };
+  if (fixed)
+    encodeHeaders(*fixed);
+  encodeHeaders(request.headers);
+  bool hasBody = request.body.size() != 0;
+  size_t before = outgoing.size();
+  appendHeaderBlock(outgoing, stream.id, block, !hasBody, peerMaxFrameSize);
+  stream.bytesSent += outgoing.size() - before;
+  auto writeStart = Clock::now();
+  flush(yield);
+  if (hasBody)
+    sendBody(stream, request, yield);
+  auto waitStart = Clock::now();
+  timings.requestWrite = waitStart - writeStart;
+  receive(stream, yield);
+  if (stream.gotHeaders) {
+    timings.timeToFirstByte = stream.headersAt - waitStart;
+    timings.bodyTransfer = Clock::now() - stream.headersAt;
+  }
+  timings.wireBytesSent = stream.bytesSent;
+  timings.wireBytesReceived = stream.bytesReceived;
+  if (!stream.error.empty())
+    throw std::runtime_error(stream.error);
+  stream.decoder.finish();
+  return (response.code >= 200) && (response.code < 300);
+}
+
+void HTTP2Session::close(asio::yield_context yield) {
+  while ((protocol == Protocol::connecting) || !streams.empty())
+    wait(yield);
+  if (protocol == Protocol::http1)
+    return;
+  protocol = Protocol::unknown;
+  if (!is_open())
+    return;
+  closing = true;
+  // We never accept pushed streams, so the last one we took was 0
+  appendGoAway(outgoing, 0, ErrorCode::noError);
+  try {
+    flush(yield);
+  } catch (std::exception &) {
+    // We were hanging up anyway
+  }
+  boost::system::error_code ec;
+  sslStream->lowest_layer().cancel(ec);
+  while (readerRunning || writerRunning)
+    wait(yield);
+  if (sslStream->lowest_layer().is_open()) {
+    sslStream->async_shutdown(yield[ec]);
+    sslStream->lowest_layer().close();
+    metrics.connectionsClosed.add();
+    if (!cleanSSLShutdown(ec))
+      LOG_WARN("Unclean HTTP/2 SSL shutdown with " << hostInfo.hostname << ": "
+                                                   << ec.message());
+  }
+  closing = false;
+}
+
+} /* RESTClient */
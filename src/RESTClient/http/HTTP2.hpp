@@ -0,0 +1,144 @@
+/// One HTTP/2 connection to a host, shared by many HTTP objects at once. Each
+/// request gets its own stream, so a host's workers need one socket between
+/// them, instead of one each.
+///
+/// It's negotiated with ALPN when connecting. If the server would rather
+/// speak HTTP/1.1, usable() says so, and the HTTP objects use their own
+/// connections as before.
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <boost/asio/spawn.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/streambuf.hpp>
+
+#include <RESTClient/base/url.hpp>
+#include <RESTClient/http/HPACK.hpp>
+#include <RESTClient/http/HTTP2Frames.hpp>
+#include <RESTClient/http/HTTPProtocol.hpp>
+#include <RESTClient/http/Services.hpp>
+#include <RESTClient/http/StreamedBody.hpp>
+#include <RESTClient/metrics/Metrics.hpp>
+
+namespace RESTClient {
+
+namespace ssl = boost::asio::ssl;
+
+class HTTP2Session {
+private:
+  enum class Protocol { unknown, connecting, http2, http1 };
+  /// A request in flight. Lives in the frame of the coroutine that sent it
+  struct Stream {
+    uint32_t id = 0;
+    HTTPResponse *response = nullptr;
+    HTTPBodyDecoder decoder;
+    /// Cancelled to wake the sender when the response is in
+    asio::steady_timer done;
+    int64_t sendWindow = 0;
+    /// Bytes received that we haven't given back with a WINDOW_UPDATE
+    uint32_t unacknowledged = 0;
+    bool gotHeaders = false;
+    bool finished = false;
+    /// Why the stream failed, if it did
+    std::string error;
+    size_t bytesSent = 0;
+    size_t bytesReceived = 0;
+    Clock::time_point headersAt;
+    /// For a streamed body, DATA is kept here by the reader, and decoded by
+    /// the sender as it's wanted. The server gets window back as it's used
+    StreamedBody *streamed = nullptr;
+    std::string held;
+    Stream(asio::io_service &io) : done(io) {}
+  };
+  const HostInfo hostInfo;
+  Services &services;
+  HostMetrics &metrics;
+  /// Remade for each connection, as an ssl::stream can't be reused
+  std::unique_ptr<ssl::stream<tcp::socket>> sslStream;
+  Protocol protocol = Protocol::unknown;
+  /// True once the server has sent GOAWAY; no new streams are started
+  bool draining = false;
+  /// True while close() hangs up
+  bool closing = false;
+  bool readerRunning = false;
+  HPACKEncoder encoder;
+  HPACKDecoder decoder;
+  std::map<uint32_t, Stream *> streams;
+  uint32_t nextStreamId = 1;
+  /// The server's settings
+  uint32_t peerMaxFrameSize = HTTP2::defaultMaxFrameSize;
+  uint32_t peerInitialWindow = HTTP2::defaultWindowSize;
+  uint32_t peerMaxStreams = 100;
+  /// How much we may send before the server gives us more window
+  int64_t sendWindow = HTTP2::defaultWindowSize;
+  /// Connection level bytes received but not given back yet
+  uint32_t unacknowledged = 0;
+  /// The header block being read, when it runs over CONTINUATION frames
+  std::string headerBlock;
+  uint32_t headerStream = 0;
+  uint8_t headerFlags = 0;
+  /// For lower (and title) casing header names
+  std::string nameScratch;
+  asio::streambuf incoming;
+  /// Frames waiting to go out, and those on their way
+  std::string outgoing;
+  std::string writing;
+  bool writerRunning = false;
+  /// Coroutines waiting for the connection, a free stream, or send window
+  std::list<asio::steady_timer *> waiting;
+  size_t incomingByteCounter = 0;
+  size_t outgoingByteCounter = 0;
+  void connect(HTTPTimings &timings, asio::yield_context yield);
+  /// Waits until something changes: settings, windows, or streams finishing
+  void wait(asio::yield_context yield);
+  void wakeAll();
+  /// Writes out everything in 'outgoing', unless another coroutine already is
+  void flush(asio::yield_context yield);
+  void read(asio::yield_context yield);
+  void frame(const HTTP2::FrameHeader &header, std::string_view payload);
+  void headers(uint32_t id, std::string_view block, bool endStream);
+  void settings(const HTTP2::FrameHeader &header, std::string_view payload);
+  void finish(Stream &stream, std::string error = "");
+  /// Fails every stream and hangs up
+  void fail(const std::string &why);
+  void sendBody(Stream &stream, HTTPRequest &request,
+                asio::yield_context yield);
+  /// Waits for the response, passing a streamed body on as it comes
+  void receive(Stream &stream, asio::yield_context yield);
+
+public:
+  /// Flow control window we give the server, for the connection and each
+  /// stream. Set before connecting
+  uint32_t windowSize = 16 * 1024 * 1024;
+  explicit HTTP2Session(const HostInfo &hostInfo);
+  HTTP2Session(const HTTP2Session &) = delete;
+  ~HTTP2Session();
+  /// Connects if need be, and says if the server speaks HTTP/2. Once it has
+  /// said no, it won't ask again. Fills in the connection timings of the
+  /// request that made the connection
+  bool usable(HTTPTimings &timings, asio::yield_context yield);
+  /// Sends 'request' on a new stream and waits for its response, while
+  /// other coroutines do the same. The response's wire byte counts are its
+  /// frames. Returns true if the status was 2xx.
+  /// If 'streamed' is given, the body goes there instead of the response
+  bool action(HTTPRequest &request, HTTPResponse &response,
+              asio::yield_context yield, StreamedBody *streamed = nullptr);
+  bool is_open() const;
+  /// Requests in flight
+  size_t activeStreams() const { return streams.size(); }
+  /// Total bytes read from the net over the life of this session
+  size_t bytesReceived() const { return incomingByteCounter; }
+  /// Total bytes written to the net over the life of this session
+  size_t bytesSent() const { return outgoingByteCounter; }
+  /// Says goodbye to the server and hangs up, once all the streams are done.
+  /// Must be called before destruction
+  void close(asio::yield_context yield);
+};
+
+} /* RESTClient */
@@ -0,0 +1,185 @@
+/// HTTP/2 framing (RFC 7540 section 4 and 6): writing and reading frame
+/// headers, and the handful of small frames both ends send
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace RESTClient {
+namespace HTTP2 {
+
+/// What a client sends before its first frame
+const std::string_view preface("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", 24);
+
+enum class FrameType : uint8_t {
+  data = 0,
+  headers = 1,
+  priority = 2,
+  rstStream = 3,
+  settings = 4,
+  pushPromise = 5,
+  ping = 6,
+  goAway = 7,
+  windowUpdate = 8,
+  continuation = 9
+};
+
+namespace Flags {
+const uint8_t endStream = 0x1;
+const uint8_t ack = 0x1;
+const uint8_t endHeaders = 0x4;
+const uint8_t padded = 0x8;
+const uint8_t priority = 0x20;
+} /* Flags */
+
+enum class Setting : uint16_t {
+  headerTableSize = 1,
+  enablePush = 2,
+  maxConcurrentStreams = 3,
+  initialWindowSize = 4,
+  maxFrameSize = 5,
+  maxHeaderListSize = 6
+};
+
+enum class ErrorCode : uint32_t {
+  noError = 0,
+  protocolError = 1,
+  internalError = 2,
+  flowControlError = 3,
+  settingsTimeout = 4,
+  streamClosed = 5,
+  frameSizeError = 6,
+  refusedStream = 7,
+  cancel = 8,
+  compressionError = 9
+};
+
+/// Every frame starts with one of these
+struct FrameHeader {
+  static const size_t size = 9;
+  uint32_t length = 0;
+  FrameType type = FrameType::data;
+  uint8_t flags = 0;
+  uint32_t stream = 0;
+  bool has(uint8_t flag) const { return (flags & flag) == flag; }
+};
+
+/// The frames we'll take before we've said otherwise, and the most a frame
+/// can ever hold
+const uint32_t defaultMaxFrameSize = 16384;
+const uint32_t maxMaxFrameSize = (1u << 24) - 1;
+const uint32_t defaultWindowSize = 65535;
+const int64_t maxWindowSize = (1u << 31) - 1;
+
+inline void appendUint32(std::string &out, uint32_t value) {
+  out.push_back(static_cast<char>(value >> 24));
+  out.push_back(static_cast<char>(value >> 16));
+  out.push_back(static_cast<char>(value >> 8));
+  out.push_back(static_cast<char>(value));
+}
+
+inline uint32_t readUint32(const char *data) {
+  auto bytes = reinterpret_cast<const uint8_t *>(data);
+  return (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) |
+         (uint32_t(bytes[2]) << 8) | bytes[3];
+}
+
+inline void appendFrameHeader(std::string &out, uint32_t length,
+                              FrameType type, uint8_t flags,
+                              uint32_t stream) {
+  out.push_back(static_cast<char>(length >> 16));
+  out.push_back(static_cast<char>(length >> 8));
+  out.push_back(static_cast<char>(length));
+  out.push_back(static_cast<char>(type));
+  out.push_back(static_cast<char>(flags));
+  appendUint32(out, stream & 0x7fffffff);
+}
+
+inline FrameHeader readFrameHeader(const char *data) {
+  auto bytes = reinterpret_cast<const uint8_t *>(data);
+  FrameHeader result;
+  result.length =
+      (uint32_t(bytes[0]) << 16) | (uint32_t(bytes[1]) << 8) | bytes[2];
+  result.type = static_cast<FrameType>(bytes[3]);
+  result.flags = bytes[4];
+  result.stream = readUint32(data + 5) & 0x7fffffff;
+  return result;
+}
+
+inline void appendSetting(std::string &out, Setting id, uint32_t value) {
+  out.push_back(static_cast<char>(static_cast<uint16_t>(id) >> 8));
+  out.push_back(static_cast<char>(id));
+  appendUint32(out, value);
+}
+
+inline void appendWindowUpdate(std::string &out, uint32_t stream,
+                               uint32_t increment) {
+  appendFrameHeader(out, 4, FrameType::windowUpdate, 0, stream);
+  appendUint32(out, increment);
+}
+
+inline void appendRstStream(std::string &out, uint32_t stream,
+                            ErrorCode error) {
+  appendFrameHeader(out, 4, FrameType::rstStream, 0, stream);
+  appendUint32(out, static_cast<uint32_t>(error));
+}
+
+inline void appendGoAway(std::string &out, uint32_t lastStream,
+                         ErrorCode error) {
+  appendFrameHeader(out, 8, FrameType::goAway, 0, 0);
+  appendUint32(out, lastStream);
+  appendUint32(out, static_cast<uint32_t>(error));
+}
+
+/// Appends a HEADERS frame holding 'block', with as many CONTINUATION frames
+/// as it takes to fit 'maxFrameSize'
+inline void appendHeaderBlock(std::string &out, uint32_t stream,
+                              std::string_view block, bool endStream,
+                              uint32_t maxFrameSize) {
+  FrameType type = FrameType::headers;
+  uint8_t flags = endStream ? Flags::endStream : 0;
+  do {
+    std::string_view part = block.substr(0, maxFrameSize);
+    block.remove_prefix(part.size());
+    if (block.empty())
+      flags |= Flags::endHeaders;
+    appendFrameHeader(out, part.size(), type, flags, stream);
+    out.append(part.data(), part.size());
+    type = FrameType::continuation;
+    flags = 0;
+  } while (!block.empty());
+}
+
+/// HTTP/2 header names are lower case. This gives them the case HTTP/1.1
+/// tends to use (Content-Type), which is how our code looks them up
+inline void titleCase(std::string &name) {
+  bool start = true;
+  for (char &c : name) {
+    if (start && (c >= 'a') && (c <= 'z'))
+      c -= 'a' - 'A';
+    start = c == '-';
+  }
+}
+
+/// The payload of a DATA or HEADERS frame without its padding (and for
+/// HEADERS, its priority fields)
+inline std::string_view unpadded(const FrameHeader &header,
+                                 std::string_view payload) {
+  if (header.has(Flags::padded)) {
+    if (payload.empty() || (uint8_t(payload[0]) >= payload.size()))
+      throw std::runtime_error("HTTP/2 frame with too much padding");
+    size_t padding = uint8_t(payload[0]);
+    payload = payload.substr(1, payload.size() - 1 - padding);
+  }
+  if ((header.type == FrameType::headers) && header.has(Flags::priority)) {
+    if (payload.size() < 5)
+      throw std::runtime_error("HTTP/2 HEADERS frame too short");
+    payload.remove_prefix(5);
+  }
+  return payload;
+}
+
+} /* HTTP2 */
+} /* RESTClient */
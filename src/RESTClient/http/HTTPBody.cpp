@@ -1,87 +1,413 @@
 #include "HTTPBody.hpp"
+#include "HTTPResponse.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+#include <boost/iostreams/device/mapped_file.hpp>
 
 namespace RESTClient {
 
+struct HTTPBody::Mapped {
+  boost::iostreams::mapped_file_source file;
+  std::string path;
+  std::string_view view() const {
+    if (!file.is_open())
+      return {};
+    return std::string_view(file.data(), file.size());
+  }
+};
+
+/// Lets the body be used as an iostream, as it was before it kept its own
+/// bytes
+struct HTTPBody::Streams {
+  /// Reads through HTTPBody::read, or straight from memory if it can
+  struct Reading : std::streambuf {
+    HTTPBody *body;
+    size_t offset = 0;
+    char buffer[4096];
+    Reading(HTTPBody *body) : body(body) {}
+    void rewind() {
+      offset = 0;
+      setg(nullptr, nullptr, nullptr);
+    }
+    int_type underflow() override {
+      if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+      if (body->isContiguous()) {
+        std::string_view all = body->view();
+        if (offset >= all.size())
+          return traits_type::eof();
+        char *begin = const_cast<char *>(all.data());
+        setg(begin, begin + offset, begin + all.size());
+        offset = all.size();
+      } else {
+        size_t bytes = body->read(offset, buffer, sizeof(buffer));
+        if (bytes == 0)
+          return traits_type::eof();
+        offset += bytes;
+        setg(buffer, buffer, buffer + bytes);
+      }
+      return traits_type::to_int_type(*gptr());
+    }
+  };
+  /// Appends to the body, with no buffer of its own
+  struct Writing : std::streambuf {
+    HTTPBody *body;
+    Writing(HTTPBody *body) : body(body) {}
+    int_type overflow(int_type c) override {
+      if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        char ch = traits_type::to_char_type(c);
+        body->append(&ch, 1);
+      }
+      return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+      body->append(s, n);
+      return n;
+    }
+  };
+  Reading in;
+  Writing out;
+  std::istream reading;
+  std::ostream writing;
+  Streams(HTTPBody *body)
+      : in(body), out(body), reading(&in), writing(&out) {}
+};
+
+namespace {
+
+/// 'source', checking it's at 'offset'
+BodySource &inOrder(BodySource &source, size_t offset) {
+  if (offset != source.produced())
+    throw std::runtime_error("A BodySource can only be read once, in order");
+  return source;
+}
+
+} /* anonymous namespace */
+
+HTTPBody::HTTPBody() = default;
+HTTPBody::HTTPBody(std::string value) : data(std::move(value)) {}
+HTTPBody::HTTPBody(std::stringstream &&value) : data(value.str()) {}
+HTTPBody::~HTTPBody() = default;
+
+HTTPBody::HTTPBody(HTTPBody &&other)
+    : data(std::move(other.data)), shared(std::move(other.shared)) {}
+
+HTTPBody &HTTPBody::operator=(HTTPBody &&other) {
+  data = std::move(other.data);
+  shared = std::move(other.shared);
+  // Our streams point at us, so needn't change
+  return *this;
+}
+
 void HTTPBody::consumeData(std::string &buffer) {
-  auto asStream = dynamic_cast<HTTPStreamBody *>(body.get());
-  if (!asStream)
-    throw std::runtime_error("Unkown HTTPBody type. Cannot find stream");
-  std::ostream &saving = asStream->writing();
-  saving.write(buffer.c_str(), buffer.size());
+  append(buffer.data(), buffer.size());
   buffer.clear();
 }
 
-/// Initialize the body with a file stream
 void HTTPBody::initWithFile(const std::string &path) {
-  body.reset(new HTTPFileBody(path));
+  File file;
+  file.path = path;
+  file.writing.exceptions(std::fstream::failbit | std::fstream::badbit);
+  file.reading.exceptions(std::fstream::badbit);
+  // To send it, we need its size
+  std::ifstream existing(path, std::fstream::in | std::fstream::binary |
+                                   std::fstream::ate);
+  if (existing)
+    file.size = existing.tellg();
+  data = std::move(file);
 }
 
-/// Turn the body into a string (copies the input value)
+size_t copyFile(int from, const std::string &to) {
+  struct stat info;
+  if (::fstat(from, &info) != 0)
+    throw std::runtime_error("Couldn't stat a file to copy to " + to);
+  int out = ::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (out < 0)
+    throw std::runtime_error("Couldn't open " + to);
+  size_t size = info.st_size;
+  size_t done = 0;
+#ifdef FICLONE
+  if (::ioctl(out, FICLONE, from) == 0)
+    done = size;
+#endif
+#ifdef __linux__
+  // copy_file_range works from the file positions we give it, so 'from' can
+  // be shared
+  loff_t in = 0;
+  while (done < size) {
+    ssize_t copied = ::copy_file_range(from, &in, out, nullptr, size - done, 0);
+    if (copied <= 0)
+      break;
+    done += copied;
+  }
+#endif
+  // Not on this filesystem (or kernel); copy it ourselves
+  char buffer[64 * 1024];
+  while (done < size) {
+    ssize_t got = ::pread(from, buffer, sizeof(buffer), done);
+    if ((got < 0) && (errno == EINTR))
+      continue;
+    if ((got <= 0) || (::pwrite(out, buffer, got, done) != got)) {
+      ::close(out);
+      throw std::runtime_error("Couldn't copy a file to " + to);
+    }
+    done += got;
+  }
+  ::close(out);
+  return size;
+}
+
+void HTTPBody::copyFileFrom(int from) {
+  File &file = std::get<File>(data);
+  if (file.reading.is_open())
+    file.reading.close();
+  if (file.writing.is_open())
+    file.writing.close();
+  file.size = copyFile(from, file.path);
+}
+
+void HTTPBody::initWithMappedFile(const std::string &path) {
+  std::unique_ptr<Mapped> mapped(new Mapped);
+  mapped->path = path;
+  // An empty file can't be mapped, but then there's nothing to map
+  std::ifstream existing(path, std::fstream::in | std::fstream::ate);
+  if (!existing)
+    throw std::runtime_error("Couldn't open " + path);
+  if (existing.tellg() > 0)
+    mapped->file.open(path);
+  data = std::move(mapped);
+}
+
+void HTTPBody::initWithView(std::string_view view) { data = view; }
+
+void HTTPBody::initWithShared(std::shared_ptr<const std::string> bytes) {
+  data = std::string_view(*bytes);
+  shared = std::move(bytes);
+}
+
+void HTTPBody::initWithGenerator(Generator generator, long size) {
+  data = BodySource(std::move(generator), size);
+}
+
+void HTTPBody::initWithSource(BodySource source) { data = std::move(source); }
+
 HTTPBody &HTTPBody::operator=(std::string value) {
-  body.reset(new HTTPStringStreamBody(std::move(value)));
+  data = std::move(value);
   return *this;
 }
 
-/// Turn the body into a stringstream
 HTTPBody &HTTPBody::operator=(std::stringstream &&value) {
-  body.reset(new HTTPStringStreamBody{std::move(value)});
+  data = value.str();
   return *this;
 }
 
-/// Copy the body into a new string
+std::string &HTTPBody::toBuffer() {
+  if (kind() != Kind::buffer) {
+    data = std::string(*this);
+    shared.reset();
+  }
+  return std::get<std::string>(data);
+}
+
 HTTPBody::operator std::string() const {
-  auto streamBody = dynamic_cast<HTTPStreamBody *>(body.get());
-  if (!streamBody)
-    return "";
-  auto* stringStream = dynamic_cast<std::stringstream*>(&streamBody->reading());
-  if (stringStream)
-    return stringStream->str();
-  else {
-    std::istream& in = streamBody->reading();
-    in.seekg(0, std::ios_base::end);
-    auto size = in.tellg();
-    in.seekg(0);
-    std::string result;
-    result.reserve(size);
-    std::copy(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>(), std::back_inserter(result));
+  if (isContiguous())
+    return std::string(view());
+  if (kind() == Kind::file) {
+    // Reading doesn't change the body, but it moves the file's position
+    auto &self = const_cast<HTTPBody &>(*this);
+    std::string result(std::get<File>(data).size, '\0');
+    result.resize(self.read(0, &result[0], result.size()));
     return result;
   }
+  // A source is gone once it's been read
+  return "";
+}
+
+std::string HTTPBody::take() {
+  std::string result;
+  if (kind() == Kind::buffer)
+    result.swap(std::get<std::string>(data));
+  else
+    result = std::string(*this);
+  data = std::string();
+  shared.reset();
+  return result;
+}
+
+bool HTTPBody::isContiguous() const {
+  Kind k = kind();
+  return (k == Kind::buffer) || (k == Kind::view) || (k == Kind::mapped);
+}
+
+std::string_view HTTPBody::view() const {
+  switch (kind()) {
+  case Kind::buffer:
+    return std::get<std::string>(data);
+  case Kind::view:
+    return std::get<std::string_view>(data);
+  case Kind::mapped:
+    return std::get<std::unique_ptr<Mapped>>(data)->view();
+  default:
+    throw std::logic_error("HTTPBody isn't in memory");
+  }
+}
+
+const std::string &HTTPBody::path() const {
+  if (kind() == Kind::file)
+    return std::get<File>(data).path;
+  if (kind() == Kind::mapped)
+    return std::get<std::unique_ptr<Mapped>>(data)->path;
+  throw std::logic_error("HTTPBody isn't a file");
+}
+
+size_t HTTPBody::read(size_t offset, char *out, size_t size) {
+  if (isContiguous()) {
+    std::string_view all = view();
+    if (offset >= all.size())
+      return 0;
+    size = std::min(size, all.size() - offset);
+    std::memcpy(out, all.data() + offset, size);
+    return size;
+  }
+  if (kind() == Kind::source)
+    return inOrder(std::get<BodySource>(data), offset).read(out, size);
+  File &file = std::get<File>(data);
+  if (file.writing.is_open())
+    file.writing.flush();
+  if (!file.reading.is_open())
+    file.reading.open(file.path, std::fstream::in | std::fstream::binary);
+  file.reading.clear();
+  if (size_t(file.reading.tellg()) != offset)
+    file.reading.seekg(offset);
+  file.reading.read(out, size);
+  return file.reading.gcount();
+}
+
+size_t HTTPBody::gather(size_t offset, std::vector<std::string_view> &out,
+                        char *scratch, size_t room) {
+  if (isContiguous()) {
+    std::string_view all = view();
+    if (offset >= all.size())
+      return 0;
+    out.push_back(all.substr(offset));
+    return all.size() - offset;
+  }
+  if (kind() == Kind::source)
+    return inOrder(std::get<BodySource>(data), offset)
+        .gather(out, scratch, room);
+  size_t bytes = read(offset, scratch, room);
+  if (bytes != 0)
+    out.push_back(std::string_view(scratch, bytes));
+  return bytes;
+}
+
+void HTTPBody::append(const char *bytes, size_t size) {
+  switch (kind()) {
+  case Kind::buffer:
+    std::get<std::string>(data).append(bytes, size);
+    break;
+  case Kind::file: {
+    File &file = std::get<File>(data);
+    if (!file.writing.is_open())
+      file.writing.open(file.path, std::fstream::out | std::fstream::binary |
+                                       std::fstream::app);
+    file.writing.write(bytes, size);
+    file.size += size;
+    break;
+  }
+  case Kind::source:
+    throw std::logic_error("Can't append to a BodySource");
+  default:
+    toBuffer().append(bytes, size);
+  }
+}
+
+void HTTPBody::reserve(size_t size) {
+  if (kind() == Kind::buffer)
+    std::get<std::string>(data).reserve(size);
 }
 
-/// Get a reference to a stream for reading from. If the body is stored in a string, move it
-/// into a stream and return that.
 HTTPBody::operator std::istream &() {
-  auto asStream = dynamic_cast<HTTPStreamBody *>(body.get());
-  if (!asStream)
-    throw std::runtime_error("Unkown HTTPBody type. Cannot find stream");
-  return asStream->reading();
+  if (!streams)
+    streams.reset(new Streams(this));
+  streams->in.rewind();
+  streams->reading.clear();
+  return streams->reading;
 }
 
-/// Get a reference to a stream for reading from. If the body is stored in a string, move it
-/// into a stream and return that.
 HTTPBody::operator std::ostream &() {
-  auto asStream = dynamic_cast<HTTPStreamBody *>(body.get());
-  if (!asStream)
-    throw std::runtime_error("Unkown HTTPBody type. Cannot find stream");
-  return asStream->writing();
+  if (!streams)
+    streams.reset(new Streams(this));
+  return streams->writing;
 }
 
-/// If it's a stream flush it
 void HTTPBody::flush() {
-  auto asStream = dynamic_cast<HTTPStreamBody *>(body.get());
-  if (asStream)
-    asStream->writing().flush();
-}
-
-long HTTPBody::size() {
-  auto asStream = dynamic_cast<HTTPStreamBody *>(body.get());
-  if (!asStream)
-    return 0;
-  std::istream& data = asStream->reading();
-  data.seekg(0, std::istream::end);
-  long size = data.tellg();
-  data.seekg(0);
-  return size;
+  if (kind() == Kind::file) {
+    File &file = std::get<File>(data);
+    if (file.writing.is_open())
+      file.writing.flush();
+  }
+}
+
+void HTTPBody::clear() {
+  switch (kind()) {
+  case Kind::buffer:
+    // Keeps the string's capacity, so small bodies can be reused without
+    // touching the heap
+    std::get<std::string>(data).clear();
+    break;
+  case Kind::file: {
+    File &file = std::get<File>(data);
+    if (file.reading.is_open())
+      file.reading.close();
+    if (file.writing.is_open())
+      file.writing.close();
+    file.writing.open(file.path, std::fstream::out | std::fstream::binary |
+                                     std::fstream::trunc);
+    file.size = 0;
+    break;
+  }
+  default:
+    data = std::string();
+    shared.reset();
+  }
+}
+
+long HTTPBody::size() const {
+  switch (kind()) {
+  case Kind::file:
+    return std::get<File>(data).size;
+  case Kind::source:
+    return std::get<BodySource>(data).size();
+  default:
+    return view().size();
+  }
+}
+
+HTTPResponse HTTPResponse::copy() const {
+  HTTPResponse result;
+  result.code = code;
+  // Copying the map puts it on the heap
+  result.headers = Headers(headers);
+  if (body.kind() == HTTPBody::Kind::file)
+    result.body.initWithFile(body.path());
+  else
+    result.body = std::string(body);
+  result.timings = timings;
+  return result;
 }
 
 } /* RESTClient */
@@ -1,85 +1,129 @@
 #pragma once
 
-#include <iostream>
 #include <fstream>
-#include <string>
+#include <functional>
+#include <iostream>
+#include <memory>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
 
-#include <cassert>
+#include <RESTClient/http/BodySource.hpp>
 
 namespace RESTClient {
 
-struct HTTPBaseBody {
-  virtual ~HTTPBaseBody(){};
-};
+/// Copies all of the open file 'from' to the file at 'to', replacing it, and
+/// returns its size. Where the filesystem can, the two share their blocks (a
+/// reflink) and nothing is copied; otherwise the kernel does the copying
+size_t copyFile(int from, const std::string &to);
 
-struct HTTPStreamBody : public HTTPBaseBody {
-  virtual std::ostream& writing() = 0;
-  virtual std::istream& reading() = 0;
-};
-
-struct HTTPFileBody : public HTTPStreamBody {
-  std::string path;
-  std::ofstream _writing;
-  std::ifstream _reading;
-  HTTPFileBody(std::string path)
-      : path(path)  {
-    _writing.exceptions(std::fstream::failbit | std::fstream::badbit);
-    _reading.exceptions(std::fstream::failbit | std::fstream::badbit);
-  }
-  virtual std::istream &reading() override {
-    if (_writing.is_open())
-      _writing.flush();
-    if (!_reading.is_open())
-      _reading.open(path, std::fstream::in | std::fstream::binary);
-    return _reading;
-  }
-  virtual std::ostream &writing() override {
-    if (!_writing.is_open())
-      _writing.open(path, std::fstream::out | std::fstream::binary);
-    return _writing;
-  }
-};
+/// The body of a request or response. It's one of:
+///  - buffer: bytes we own, in one piece. What responses are read into
+///  - view: someone else's bytes, which must outlive the request, or bytes
+///    shared with others
+///  - file: a file on disk, read or written as it goes
+///  - mapped: a file mapped into memory, read only
+///  - source: made as it's sent, once, by a BodySource
+/// Its size is always known without looking, if it can be known at all
+class HTTPBody {
+public:
+  enum class Kind { buffer, view, file, mapped, source };
+  /// Fills 'out' with up to 'size' bytes of body, returning how many. 0
+  /// means there's no more
+  using Generator = BodySource::Pull;
 
-struct HTTPStringStreamBody : public HTTPStreamBody {
-  std::stringstream data;
-  HTTPStringStreamBody() : data() {}
-  HTTPStringStreamBody(std::stringstream&& input) : data(std::move(input)) {}
-  HTTPStringStreamBody(const std::string &input) { data << input; }
-  virtual std::istream& reading() override { return data; }
-  virtual std::ostream& writing() override { return data; }
-};
+private:
+  struct File {
+    std::string path;
+    std::ofstream writing;
+    std::ifstream reading;
+    size_t size = 0;
+  };
+  struct Mapped;
+  struct Streams;
+  std::variant<std::string, std::string_view, File, std::unique_ptr<Mapped>,
+               BodySource>
+      data;
+  /// Made the first time it's used as an iostream
+  std::unique_ptr<Streams> streams;
+  /// Keeps the bytes of a view alive, if they were given us to share
+  std::shared_ptr<const std::string> shared;
+  /// Makes it a buffer holding a copy of what it had
+  std::string &toBuffer();
 
-struct HTTPBody {
-  HTTPBody() { body.reset(new HTTPStringStreamBody()); }
-  HTTPBody(std::string data) { *this = std::move(data); }
-  HTTPBody(std::stringstream&& data) { *this = std::move(data); }
-  std::unique_ptr<HTTPBaseBody> body;
+public:
+  HTTPBody();
+  HTTPBody(std::string value);
+  HTTPBody(std::stringstream &&value);
+  HTTPBody(HTTPBody &&other);
+  HTTPBody &operator=(HTTPBody &&other);
+  ~HTTPBody();
+  Kind kind() const { return static_cast<Kind>(data.index()); }
+  /// Return true if the body has been initialized. It always is now
+  operator bool() const { return true; }
   /// Called when downloading. It'll consume from the buffer and append into our
   /// body
   void consumeData(std::string &buffer);
-  /// Return true if the body has been initialized
-  operator bool() const { return body != nullptr; }
-  /// Initialize the body with a file stream
+  /// Initialize the body with a file stream. Downloads are written there
   void initWithFile(const std::string &path);
+  /// Makes a file body a copy of the open file 'from', with copyFile
+  void copyFileFrom(int from);
+  /// Send the file at 'path' straight from memory. Read only
+  void initWithMappedFile(const std::string &path);
+  /// Send 'data' without copying it. It must live till the request is done
+  void initWithView(std::string_view data);
+  /// A view of 'bytes', which we keep alive. Read only, as whoever else has
+  /// them sees the same bytes
+  void initWithShared(std::shared_ptr<const std::string> bytes);
+  /// Send what 'generator' makes. If 'size' is -1 it's sent in chunks
+  void initWithGenerator(Generator generator, long size = -1);
+  /// Send what 'source' makes. If its size isn't known it's sent in chunks
+  void initWithSource(BodySource source);
   /// Turn the body into a string
   HTTPBody &operator=(std::string value);
-  /// Turn the body into a stringstream
+  /// Turn the body into a string, from a stream
   HTTPBody &operator=(std::stringstream &&value);
-  /// Turn the body into a file stream
-  HTTPBody &operator=(std::fstream &&value);
   /// Copy the body into a new string
   operator std::string() const;
-  /// Get a reference to a stream for reading. 
+  /// Move the body out, leaving it empty. Only a buffer moves without a copy
+  std::string take();
+  /// The buffer the body is kept in, made from what it had if it's not one
+  /// already
+  std::string &buffer() { return toBuffer(); }
+  /// True if the whole body is in memory: a buffer, view or mapped file
+  bool isContiguous() const;
+  /// The whole body, if it's contiguous
+  std::string_view view() const;
+  /// The path of a file body
+  const std::string &path() const;
+  /// Copies up to 'size' bytes from 'offset' into 'out', returning how many.
+  /// A source can only be read in order
+  size_t read(size_t offset, char *out, size_t size);
+  /// Puts views of the body from 'offset' on the end of 'out', returning how
+  /// many bytes they hold. What's in memory is pointed at; the rest is read
+  /// into 'scratch', up to 'room' bytes
+  size_t gather(size_t offset, std::vector<std::string_view> &out,
+                char *scratch, size_t room);
+  /// Adds to the end of a buffer or file. Other kinds become a buffer first
+  void append(const char *data, size_t size);
+  void append(std::string_view data) { append(data.data(), data.size()); }
+  /// Makes room for 'size' bytes in a buffer, eg. from a Content-Length
+  void reserve(size_t size);
+  /// Get a reference to a stream for reading, from the start
   operator std::istream &();
-  /// Get a reference to a stream for writing. 
+  /// Get a reference to a stream that appends to the body
   operator std::ostream &();
-  /// If it's a stream flush it
+  /// If it's a file, flush it
   void flush();
+  /// Empty the body, keeping the storage to write it again. A file is
+  /// truncated; a view, mapping or generator is dropped for an empty buffer
+  void clear();
   /// Return the size of the body. -1 means we don't know. 0 means there is no
   /// body. positive values are the body size. You should never ever get any
   /// other negative values.
-  long size();
+  long size() const;
 };
 
 } /* RESTClient */
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <boost/asio/streambuf.hpp>
+
+#include <string>
+
+#include "HTTPHeaders.hpp"
+#include "HTTPProtocol.hpp"
+
+namespace RESTClient {
+
+/// Scratch space that lives as long as a connection. Once it has grown to fit
+/// a request and its reply, sending and reading them needn't touch the heap
+struct HTTPConnectionBuffers {
+  /// What we've read from the net but not used yet
+  boost::asio::streambuf incoming;
+  /// The request line and headers on their way out
+  std::string outgoing;
+  RequestWriter writer;
+  SpareHeaders spareHeaders;
+  HTTPParser parser;
+  HTTPBodyDecoder decoder;
+};
+
+} /* RESTClient */
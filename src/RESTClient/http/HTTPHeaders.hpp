@@ -1,7 +1,78 @@
 #pragma once
 
+#include <cctype>
+#include <map>
+#include <scoped_allocator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <RESTClient/base/arena.hpp>
+
 namespace RESTClient {
-  
-using Headers = std::map<std::string, std::string>;
+
+/// A header name or value; from the heap, or from a connection's Arena
+using HeaderString =
+    std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+/// Compares anything that looks like a string, so we can find() with a
+/// literal or a std::string without making a HeaderString
+struct HeaderLess {
+  using is_transparent = void;
+  bool operator()(std::string_view a, std::string_view b) const {
+    return a < b;
+  }
+};
+
+/// Header names are case insensitive; and HTTP/2 has them in lower case
+inline bool sameHeaderName(std::string_view a, std::string_view b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i != a.size(); ++i)
+    if (std::tolower(a[i]) != std::tolower(b[i]))
+      return false;
+  return true;
+}
+
+/// The scoped allocator hands the map's arena (if any) on to its strings
+using Headers = std::map<
+    HeaderString, HeaderString, HeaderLess,
+    std::scoped_allocator_adaptor<
+        ArenaAllocator<std::pair<const HeaderString, HeaderString>>>>;
+
+/// Keeps the map nodes of old headers, so that filling in the next set of
+/// headers needn't touch the heap
+class SpareHeaders {
+private:
+  std::vector<Headers::node_type> nodes;
+
+public:
+  /// Empties 'headers', keeping its nodes for later (unless they're in an
+  /// arena, which will have them back when it's reset)
+  void recycle(Headers &headers) {
+    if (headers.get_allocator().outer_allocator().arena) {
+      headers.clear();
+      return;
+    }
+    while (!headers.empty())
+      nodes.emplace_back(headers.extract(headers.begin()));
+  }
+  /// Adds a header, reusing a spare node if we have one. Like
+  /// Headers::insert, it won't replace an existing header
+  void add(Headers &headers, std::string_view key, std::string_view value) {
+    if (nodes.empty() ||
+        (nodes.back().get_allocator() != headers.get_allocator())) {
+      headers.emplace(key, value);
+      return;
+    }
+    Headers::node_type node = std::move(nodes.back());
+    nodes.pop_back();
+    node.key().assign(key.data(), key.size());
+    node.mapped().assign(value.data(), value.size());
+    auto inserted = headers.insert(std::move(node));
+    if (!inserted.inserted)
+      nodes.emplace_back(std::move(inserted.node));
+  }
+};
 
 } /* RESTClient */
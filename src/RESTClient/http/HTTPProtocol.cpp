@@ -0,0 +1,498 @@
+#include "HTTPProtocol.hpp"
+#include "RequestTemplate.hpp"
+#include "Scan.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+#include <boost/iostreams/concepts.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+
+namespace RESTClient {
+
+namespace io = boost::iostreams;
+
+void addDefaultHeaders(HTTPRequest &request, const HostInfo &hostInfo) {
+  // Its template has them already, and the body's size goes in as it's sent
+  if (request.from)
+    return;
+  Headers &headers = request.headers;
+  // Returns where to put a header's value if it's not set yet. Finding first
+  // means a reused request doesn't touch the heap
+  auto missing = [&headers](const char *key) -> HeaderString * {
+    auto found = headers.find(key);
+    if (found == headers.end())
+      return &headers[key];
+    return found->second.empty() ? &found->second : nullptr;
+  };
+  HeaderString *value;
+  // Host
+  if ((value = missing("Host")))
+    *value = hostInfo.hostHeader();
+  // Accept */*
+  if ((value = missing("Accept")))
+    *value = "*/*";
+  // Accept-Encoding: gzip, deflate
+  if ((value = missing("Accept-Encoding")))
+    *value = "gzip, deflate";
+  // TE: trailers
+  if ((value = missing("TE")))
+    *value = "trailers";
+  // Content-Length always follows the body, as requests may be reused. A
+  // body of unknown size goes in chunks
+  long size = request.body.size();
+  auto stale = headers.find(size >= 0 ? "Transfer-Encoding" : "Content-Length");
+  if (stale != headers.end())
+    headers.erase(stale);
+  if (size >= 0)
+    headers["Content-Length"] = std::to_string(size);
+  else
+    headers["Transfer-Encoding"] = "chunked";
+}
+
+void appendRequestHead(std::string &head, const HTTPRequest &request) {
+  if (request.from) {
+    request.from->appendHead(head, request);
+    return;
+  }
+  head.append(request.verb).append(" ").append(request.path);
+  head.append(" HTTP/1.1\r\n");
+  for (const auto &header : request.headers)
+    head.append(header.first).append(": ").append(header.second).append("\r\n");
+  head.append("\r\n");
+}
+
+void RequestWriter::start(const std::string &head, HTTPBody &body) {
+  this->head = &head;
+  this->body = &body;
+  offset = 0;
+  chunked = body.size() < 0;
+  finished = false;
+}
+
+bool RequestWriter::next() {
+  round.clear();
+  if (finished)
+    return false;
+  if (head) {
+    round.push_back(boost::asio::buffer(*head));
+    head = nullptr;
+  }
+  pieces.clear();
+  size_t bytes = 0;
+  if (body->size() != 0) {
+    if (!body->isContiguous() && (scratch.size() != roundSize))
+      scratch.resize(roundSize);
+    bytes = body->gather(offset, pieces, &scratch[0], scratch.size());
+  }
+  offset += bytes;
+  // https://tools.ietf.org/html/rfc7230#section-4.1
+  if (chunked && (bytes != 0)) {
+    int length = std::snprintf(chunkSize, sizeof(chunkSize), "%zx\r\n", bytes);
+    round.push_back(boost::asio::buffer(chunkSize, length));
+  }
+  for (std::string_view piece : pieces)
+    round.push_back(boost::asio::buffer(piece.data(), piece.size()));
+  if (chunked && (bytes != 0))
+    round.push_back(boost::asio::buffer("\r\n", 2));
+  if ((bytes == 0) || (!chunked && (long)offset >= body->size())) {
+    // The last chunk is empty
+    if (chunked)
+      round.push_back(boost::asio::buffer("0\r\n\r\n", 5));
+    finished = true;
+  }
+  return !round.empty();
+}
+
+namespace {
+
+/// Header names and some values are case insensitive
+bool sameText(std::string_view a, std::string_view b) {
+  return (a.size() == b.size()) &&
+         std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return (x | 0x20) == (y | 0x20);
+         });
+}
+
+bool endsWith(std::string_view s, std::string_view ending) {
+  return (s.size() >= ending.size()) &&
+         sameText(s.substr(s.size() - ending.size()), ending);
+}
+
+} /* anonymous namespace */
+
+void HTTPParser::start(HTTPResponse &response, SpareHeaders &spares) {
+  this->response = &response;
+  this->spares = &spares;
+  state = State::statusLine;
+  partial.clear();
+  remaining = 0;
+  chunkLine = 0;
+  chunkCR = false;
+  haveLength = false;
+  ok = false;
+  keepAlive = true;
+  chunked = false;
+  gzipped = false;
+}
+
+bool HTTPParser::takeLine(const char *data, size_t size, size_t &used,
+                          std::string_view &line, size_t *colon) {
+  const char *begin = data + used;
+  const char *end = data + size;
+  const char *newLine;
+  const char *found = nullptr;
+  if (colon) {
+    newLine = findEither(begin, end, ':', '\n');
+    if ((newLine != end) && (*newLine == ':')) {
+      found = newLine;
+      newLine = findByte(found + 1, end, '\n');
+    }
+  } else {
+    newLine = findByte(begin, end, '\n');
+  }
+  if (newLine == end) {
+    partial.append(begin, end);
+    used = size;
+    if (partial.size() > maxLine)
+      throw std::runtime_error("HTTP response line too long");
+    return false;
+  }
+  used = newLine + 1 - data;
+  if (partial.empty()) {
+    line = std::string_view(begin, newLine - begin);
+    if (colon)
+      *colon = found ? found - begin : std::string_view::npos;
+  } else {
+    // The colon may have been in the part we kept
+    partial.append(begin, newLine);
+    line = partial;
+    if (colon)
+      *colon = line.find(':');
+  }
+  if (!line.empty() && (line.back() == '\r'))
+    line.remove_suffix(1);
+  return true;
+}
+
+void HTTPParser::statusLine(std::string_view line) {
+  // eg. HTTP/1.1 200 OK
+  if (line.substr(0, 5) != "HTTP/")
+    throw std::runtime_error("Bad HTTP status line");
+  size_t space = line.find(' ');
+  int code = 0;
+  size_t i = space + 1;
+  for (; (i < line.size()) && (line[i] >= '0') && (line[i] <= '9'); ++i)
+    code = code * 10 + (line[i] - '0');
+  if ((space == std::string_view::npos) || (i != space + 4))
+    throw std::runtime_error("Bad HTTP status code");
+  response->code = code;
+  // Success is the status class. Reason phrases vary, and mean nothing
+  ok = (code >= 200) && (code < 300);
+  // HTTP/1.0 servers close unless they say otherwise
+  keepAlive = line.substr(0, space) != "HTTP/1.0";
+}
+
+void HTTPParser::header(std::string_view line, size_t colon) {
+  if (colon == std::string_view::npos)
+    throw std::runtime_error("Bad HTTP header line");
+  std::string_view key = trimmed(line.substr(0, colon));
+  std::string_view value = trimmed(line.substr(colon + 1));
+  spares->add(response->headers, key, value);
+  if (state == State::trailers)
+    return;
+  // Note the ones that say how the body comes
+  if (sameText(key, "Content-Length")) {
+    if (value.empty())
+      throw std::runtime_error("Bad HTTP Content-Length");
+    remaining = 0;
+    for (char c : value) {
+      if ((c < '0') || (c > '9'))
+        throw std::runtime_error("Bad HTTP Content-Length");
+      size_t digit = c - '0';
+      if (remaining > (SIZE_MAX - digit) / 10)
+        throw std::runtime_error("HTTP Content-Length too big");
+      remaining = remaining * 10 + digit;
+    }
+    length = remaining;
+    haveLength = true;
+  } else if (sameText(key, "Connection")) {
+    if (sameText(value, "close"))
+      keepAlive = false;
+    else if (sameText(value, "keep-alive"))
+      keepAlive = true;
+  } else if (sameText(key, "Transfer-Encoding")) {
+    chunked = endsWith(value, "chunked");
+  } else if (sameText(key, "Content-Encoding")) {
+    gzipped = sameText(value, "gzip");
+  }
+}
+
+void HTTPParser::headersDone() {
+  int code = response->code;
+  if ((code >= 100) && (code < 200)) {
+    // An interim response (eg. 100 Continue); the real one follows
+    spares->recycle(response->headers);
+    start(*response, *spares);
+    return;
+  }
+  if ((code == 204) || (code == 304))
+    state = State::done;
+  else if (chunked) {
+    state = State::chunkSize;
+    remaining = 0;
+    chunkLine = 0;
+  }
+  else if (haveLength)
+    state = (remaining > 0) ? State::body : State::done;
+  else if (!keepAlive)
+    state = State::untilClose;
+  else
+    // No length, and the connection stays open: no body
+    state = State::done;
+}
+
+size_t HTTPParser::chunkSize(const char *data, size_t size, size_t used) {
+  // The size is in hex, eg. 'F' means 15
+  for (; used != size; ++used) {
+    char c = data[used];
+    int digit;
+    if ((c >= '0') && (c <= '9'))
+      digit = c - '0';
+    else if (((c | 0x20) >= 'a') && ((c | 0x20) <= 'f'))
+      digit = (c | 0x20) - 'a' + 10;
+    else
+      break;
+    if (remaining > (SIZE_MAX >> 4))
+      throw std::runtime_error("HTTP chunk size too big");
+    remaining = remaining * 16 + digit;
+    ++chunkLine;
+  }
+  if (used == size)
+    return used;
+  if (chunkLine == 0)
+    throw std::runtime_error("Bad HTTP chunk size");
+  // Whatever follows the digits is skipped. eg. "1A;name=value" or "1A "
+  char c = data[used];
+  if ((c != ';') && (c != ' ') && (c != '\t') && (c != '\r') && (c != '\n'))
+    throw std::runtime_error("Bad HTTP chunk size");
+  state = State::chunkExtension;
+  return used;
+}
+
+size_t HTTPParser::chunkExtension(const char *data, size_t size,
+                                  size_t used) {
+  // We understand no extensions, so they're ignored:
+  // https://tools.ietf.org/html/rfc7230#section-4.1.1
+  const char *end = data + size;
+  const char *newLine = findByte(data + used, end, '\n');
+  chunkLine += newLine - (data + used);
+  if (chunkLine > maxLine)
+    throw std::runtime_error("HTTP chunk size line too long");
+  if (newLine == end)
+    return size;
+  chunkSizeDone();
+  return newLine + 1 - data;
+}
+
+void HTTPParser::chunkSizeDone() {
+  chunkLine = 0;
+  if (remaining == 0) {
+    state = State::trailers;
+  } else {
+    state = State::chunkData;
+    chunkCR = false;
+  }
+}
+
+size_t HTTPParser::chunkEnd(const char *data, size_t size, size_t used) {
+  // Each chunk's data is followed by "\r\n", or a bare "\n"
+  for (; used != size; ++used) {
+    char c = data[used];
+    if ((c == '\r') && !chunkCR) {
+      chunkCR = true;
+    } else if (c == '\n') {
+      state = State::chunkSize;
+      remaining = 0;
+      return used + 1;
+    } else {
+      throw std::runtime_error("Bad HTTP chunk ending");
+    }
+  }
+  return used;
+}
+
+size_t HTTPParser::parse(const char *data, size_t size,
+                         std::string_view &body) {
+  body = std::string_view();
+  size_t used = 0;
+  std::string_view line;
+  size_t colon;
+  while (used != size) {
+    switch (state) {
+    case State::statusLine:
+      if (!takeLine(data, size, used, line))
+        return used;
+      statusLine(line);
+      state = State::headers;
+      break;
+    case State::headers:
+    case State::trailers:
+      if (!takeLine(data, size, used, line, &colon))
+        return used;
+      if (line.empty()) {
+        partial.clear();
+        if (state == State::trailers) {
+          state = State::done;
+          return used;
+        }
+        headersDone();
+        // Let the caller see the headers before any body
+        return used;
+      }
+      header(line, colon);
+      break;
+    case State::body:
+    case State::chunkData: {
+      size_t slice = std::min(remaining, size - used);
+      body = std::string_view(data + used, slice);
+      used += slice;
+      remaining -= slice;
+      if (remaining == 0)
+        state = (state == State::body) ? State::done : State::chunkEnd;
+      return used;
+    }
+    case State::chunkSize:
+      used = chunkSize(data, size, used);
+      break;
+    case State::chunkExtension:
+      used = chunkExtension(data, size, used);
+      break;
+    case State::chunkEnd:
+      used = chunkEnd(data, size, used);
+      break;
+    case State::untilClose:
+      body = std::string_view(data, size);
+      return size;
+    case State::done:
+      return used;
+    }
+    partial.clear();
+  }
+  return used;
+}
+
+void HTTPParser::finish() {
+  if (state != State::untilClose)
+    throw std::runtime_error(
+        "The connection closed before the end of the HTTP response");
+  state = State::done;
+}
+
+size_t HTTPParser::wanted() const {
+  const size_t sliceSize = 64 * 1024;
+  if ((state == State::body) || (state == State::chunkData))
+    return std::min(remaining, sliceSize);
+  return 1;
+}
+
+namespace {
+
+/// Where gunzipped body goes. It takes nothing while the body is paused,
+/// which stops the decompressor part way through its input
+class DecodedSink : public io::sink {
+private:
+  HTTPBodyDecoder *decoder;
+
+public:
+  DecodedSink(HTTPBodyDecoder &decoder) : decoder(&decoder) {}
+  std::streamsize write(const char *s, std::streamsize n) {
+    return decoder->deliver(s, n);
+  }
+};
+
+} /* anonymous namespace */
+
+/// Used directly rather than in a filtering_ostream, so it can stop when the
+/// sink does
+struct HTTPBodyDecoder::Gunzip {
+  io::gzip_decompressor filter;
+  DecodedSink sink;
+  /// Set while flushing the end of the body, which can't be paused
+  bool finishing = false;
+  Gunzip(HTTPBodyDecoder &decoder) : sink(decoder) {}
+};
+
+HTTPBodyDecoder::HTTPBodyDecoder() = default;
+HTTPBodyDecoder::~HTTPBodyDecoder() = default;
+
+void HTTPBodyDecoder::start(HTTPResponse &response, bool gzipped,
+                            long contentLength) {
+  out = streamed ? nullptr : &response.body;
+  if (out && !gzipped && (contentLength > 0))
+    out->reserve(contentLength);
+  timings = &response.timings;
+  pending.clear();
+  // The last body was abandoned half way; start afresh
+  if (gunzipping)
+    gunzip.reset();
+  gunzipping = gzipped;
+  if (gzipped && !gunzip)
+    gunzip.reset(new Gunzip(*this));
+  if (streamed)
+    streamed->headers(response);
+}
+
+bool HTTPBodyDecoder::ready() {
+  if (paused())
+    return false;
+  if (!pending.empty()) {
+    auto decodeStart = Clock::now();
+    pending.erase(0, gunzip->filter.write(gunzip->sink, pending.data(),
+                                          pending.size()));
+    timings->decompression += Clock::now() - decodeStart;
+  }
+  return pending.empty() && !paused();
+}
+
+void HTTPBodyDecoder::write(std::string_view data) {
+  auto decodeStart = Clock::now();
+  if (!gunzipping)
+    deliver(data.data(), data.size());
+  else if (!pending.empty())
+    // Behind what was held back by a pause
+    pending.append(data.data(), data.size());
+  else
+    // Keeps what it didn't get to, if it was paused part way
+    pending.assign(data.substr(
+        gunzip->filter.write(gunzip->sink, data.data(), data.size())));
+  timings->decompression += Clock::now() - decodeStart;
+}
+
+size_t HTTPBodyDecoder::deliver(const char *data, size_t size) {
+  if (paused() && gunzipping && !gunzip->finishing)
+    return 0;
+  timings->decodedBodyBytes += size;
+  if (streamed)
+    streamed->data(std::string_view(data, size));
+  else
+    out->append(data, size);
+  return size;
+}
+
+void HTTPBodyDecoder::finish() {
+  if (!gunzipping)
+    return;
+  auto decodeStart = Clock::now();
+  gunzip->finishing = true;
+  gunzip->filter.write(gunzip->sink, pending.data(), pending.size());
+  pending.clear();
+  gunzip->filter.close(gunzip->sink, std::ios_base::out);
+  gunzip->finishing = false;
+  gunzipping = false;
+  timings->decompression += Clock::now() - decodeStart;
+}
+
+} /* RESTClient */
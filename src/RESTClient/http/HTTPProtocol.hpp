@@ -0,0 +1,191 @@
+/// The part of HTTP/1.1 that doesn't care how bytes get to and from the net:
+/// writing request heads, and parsing and decoding responses. The
+/// yield_context HTTP and the co_await AsyncHTTP both drive it.
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+
+#include <RESTClient/base/url.hpp>
+#include <RESTClient/http/HTTPRequest.hpp>
+#include <RESTClient/http/HTTPResponse.hpp>
+#include <RESTClient/http/StreamedBody.hpp>
+
+namespace RESTClient {
+
+/// Adds the headers we always send, unless the request already has them, and
+/// a Content-Length for its body. Does nothing to a request made from a
+/// RequestTemplate
+void addDefaultHeaders(HTTPRequest &request, const HostInfo &hostInfo);
+
+/// Appends the request line and headers of 'request' to 'head', along with
+/// its template's if it has one
+void appendRequestHead(std::string &head, const HTTPRequest &request);
+
+/// Turns a request's head and body into rounds of buffers for gathered
+/// writes, in chunks if the body's size isn't known. Body that's in memory is
+/// pointed at where it lies; the rest is read into a scratch buffer, a round
+/// at a time. Lives as long as a connection, so it can reuse its storage
+class RequestWriter {
+private:
+  std::vector<boost::asio::const_buffer> round;
+  std::vector<std::string_view> pieces;
+  std::string scratch;
+  char chunkSize[20];
+  const std::string *head = nullptr;
+  HTTPBody *body = nullptr;
+  size_t offset = 0;
+  bool chunked = false;
+  bool finished = true;
+
+public:
+  /// How much body is read into memory per round
+  static const size_t roundSize = 64 * 1024;
+  /// Starts writing 'head' then 'body', which must live till it's done
+  void start(const std::string &head, HTTPBody &body);
+  /// Makes the next round. Returns false once it's all been written
+  bool next();
+  /// What to write this round
+  const std::vector<boost::asio::const_buffer> &buffers() const {
+    return round;
+  }
+};
+
+/// 's' without leading and trailing whitespace
+inline std::string_view trimmed(std::string_view s) {
+  const char *space = " \t\r\n";
+  size_t first = s.find_first_not_of(space);
+  if (first == std::string_view::npos)
+    return {};
+  return s.substr(first, s.find_last_not_of(space) - first + 1);
+}
+
+/// Reads a response from whatever bytes it's given, as they arrive. It does
+/// no IO itself; the caller reads from the net, and passes on what it got.
+/// Lines are parsed where they lie, and are only copied when a read splits one.
+/// Chunk framing is decoded a byte at a time, so it's never copied
+class HTTPParser {
+public:
+  enum class State {
+    statusLine,
+    headers,
+    body,
+    chunkSize,
+    chunkExtension,
+    chunkData,
+    chunkEnd,
+    trailers,
+    untilClose,
+    done
+  };
+
+private:
+  State state = State::done;
+  HTTPResponse *response = nullptr;
+  SpareHeaders *spares = nullptr;
+  /// The start of a line that a read split
+  std::string partial;
+  /// Bytes left in the body or the current chunk. While reading a chunk size,
+  /// the size so far
+  size_t remaining = 0;
+  /// How long the chunk size line is so far
+  size_t chunkLine = 0;
+  /// True once the '\r' after a chunk's data is in
+  bool chunkCR = false;
+  /// The Content-Length, if haveLength
+  size_t length = 0;
+  bool haveLength = false;
+  bool ok = false;
+  bool keepAlive = true;
+  bool chunked = false;
+  bool gzipped = false;
+  /// Finds the line starting at data[used]. Returns false (and keeps what
+  /// there is) if it isn't all there yet. If 'colon' is given, it's set to
+  /// where the line's first ':' is, found in the same pass
+  bool takeLine(const char *data, size_t size, size_t &used,
+                std::string_view &line, size_t *colon = nullptr);
+  void statusLine(std::string_view line);
+  void header(std::string_view line, size_t colon);
+  void headersDone();
+  /// Each reads what it can of the chunk framing from data[used], and returns
+  /// where it got to
+  size_t chunkSize(const char *data, size_t size, size_t used);
+  size_t chunkExtension(const char *data, size_t size, size_t used);
+  size_t chunkEnd(const char *data, size_t size, size_t used);
+  /// Called at the end of a chunk size line
+  void chunkSizeDone();
+
+public:
+  /// The longest status, header or chunk size line we'll accept
+  static const size_t maxLine = 64 * 1024;
+  /// Starts reading a new response into 'response'. Headers come from
+  /// 'spares' if it has any
+  void start(HTTPResponse &response, SpareHeaders &spares);
+  /// Parses as much of 'data' as it can, stopping after the headers, after a
+  /// slice of body, or at the end of the response. Returns how many bytes it
+  /// used. A slice of body among them (still content encoded) is left in
+  /// 'body'. Throws std::runtime_error on a malformed response
+  size_t parse(const char *data, size_t size, std::string_view &body);
+  /// Tells us the server closed the connection. That ends a response that
+  /// runs until close, and is an error in any other
+  void finish();
+  State getState() const { return state; }
+  bool headersComplete() const { return state > State::headers; }
+  bool done() const { return state == State::done; }
+  /// True if the status was 2xx
+  bool isOK() const { return ok; }
+  bool isKeepAlive() const { return keepAlive; }
+  bool isGzipped() const { return gzipped; }
+  /// What the Content-Length header said, or -1 if there wasn't one
+  long contentLength() const { return haveLength ? long(length) : -1; }
+  /// How much it'd be worth reading from the net before parsing again
+  size_t wanted() const;
+};
+
+/// Decodes (gunzips if need be) body slices from an HTTPParser into a
+/// response's body, or a StreamedBody, keeping its timings
+class HTTPBodyDecoder {
+private:
+  struct Gunzip;
+  HTTPBody *out = nullptr;
+  StreamedBody *streamed = nullptr;
+  HTTPTimings *timings = nullptr;
+  /// Only made for gzipped bodies
+  std::unique_ptr<Gunzip> gunzip;
+  /// True while 'gunzip' is part way through a body
+  bool gunzipping = false;
+  /// Compressed body that arrived while the StreamedBody was paused
+  std::string pending;
+
+public:
+  HTTPBodyDecoder();
+  ~HTTPBodyDecoder();
+  /// Sends the bodies of the responses that follow to 'body' instead of
+  /// their HTTPResponse::body. nullptr goes back to keeping them
+  void streamTo(StreamedBody *body) { streamed = body; }
+  StreamedBody *streaming() const { return streamed; }
+  /// True while the StreamedBody wants no more
+  bool paused() const { return streamed && streamed->paused(); }
+  /// Passes on anything held back by a pause, if it's over. Returns true if
+  /// it's ready for more body
+  bool ready();
+  /// True if a pause left some body undecoded
+  bool holding() const { return !pending.empty(); }
+  /// Called once the response's headers are in. Shows them to the
+  /// StreamedBody if there is one, or makes room for 'contentLength' bytes
+  /// in the response's body
+  void start(HTTPResponse &response, bool gzipped, long contentLength = -1);
+  void write(std::string_view data);
+  /// Hands on decoded body. Returns how much was taken, which is none while
+  /// paused
+  size_t deliver(const char *data, size_t size);
+  /// Flushes anything the decompressor is holding on to, paused or not
+  void finish();
+};
+
+} /* RESTClient */
@@ -4,15 +4,27 @@
 
 namespace RESTClient {
 
+class RequestTemplate;
+
 struct HTTPRequest {
   std::string verb;
+  /// With a template, the part of the path after its prefix
   std::string path;
+  /// With a template, only the headers it doesn't have
   Headers headers;
   HTTPBody body;
+  /// The template it was made from, if any. It must outlive the request
+  const RequestTemplate *from = nullptr;
   HTTPRequest(std::string verb, std::string path, Headers headers = {},
               HTTPBody body = {})
       : verb(std::move(verb)), path(std::move(path)),
         headers(std::move(headers)), body(std::move(body)) {}
+  /// A request whose fixed headers and path prefix come from 'from'
+  HTTPRequest(const RequestTemplate &from, std::string verb, std::string path,
+              Headers headers = {}, HTTPBody body = {});
+  /// The value of a header, from us or our template, whatever the case of its
+  /// name. Empty if there's no such header
+  std::string_view header(std::string_view name) const;
 };
 
 } /* RESTClient */
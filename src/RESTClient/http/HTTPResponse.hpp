@@ -1,15 +1,26 @@
 #pragma once
 #include "HTTPBody.hpp"
 #include "HTTPHeaders.hpp"
+#include "HTTPTimings.hpp"
 
 namespace RESTClient {
 
 /// Response from an HTTP request
 class HTTPResponse {
 public:
-  int code;
+  HTTPResponse() = default;
+  HTTPResponse(HTTPResponse &&) = default;
+  HTTPResponse &operator=(HTTPResponse &&) = default;
+  /// Keeps its headers in 'arena'
+  explicit HTTPResponse(Arena *arena) : headers(arena) {}
+  int code = 0;
   Headers headers;
   HTTPBody body;
+  /// Where the time went
+  HTTPTimings timings;
+  /// A copy on the heap, eg. to keep a response from HTTP::fetch after the
+  /// connection has moved on
+  HTTPResponse copy() const;
 };
 
 } /* RESTClient */
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+#include <RESTClient/base/clock.hpp>
+
+namespace RESTClient {
+
+/// Where the time (and bytes) went for a single request. All times come from
+/// the monotonic Clock. Phases that didn't happen (eg. DNS on a reused
+/// connection) are zero.
+struct HTTPTimings {
+  /// When action() was called
+  Clock::time_point start;
+  /// How long the job waited in the JobRunner's queue before it started
+  Clock::duration queueWait = Clock::duration::zero();
+  Clock::duration dns = Clock::duration::zero();
+  Clock::duration connect = Clock::duration::zero();
+  Clock::duration tlsHandshake = Clock::duration::zero();
+  /// Sending the request line, headers and body
+  Clock::duration requestWrite = Clock::duration::zero();
+  /// From the end of the request until the response headers arrived
+  Clock::duration timeToFirstByte = Clock::duration::zero();
+  /// From the response headers until the last byte of the body
+  Clock::duration bodyTransfer = Clock::duration::zero();
+  /// The part of bodyTransfer spent decoding (gunzipping) and storing the body
+  Clock::duration decompression = Clock::duration::zero();
+  /// True if we didn't have to connect for this request
+  bool reusedConnection = false;
+  /// True if the response came from a ResponseCache, fresh or revalidated
+  bool fromCache = false;
+  /// True if the response was shared by a RequestCoalescer, from another
+  /// request for the same thing that was already on its way
+  bool coalesced = false;
+  /// Bytes written to the net, including the request line and headers
+  size_t wireBytesSent = 0;
+  /// Bytes read from the net, including headers and chunk framing
+  size_t wireBytesReceived = 0;
+  /// Size of the body after decoding
+  size_t decodedBodyBytes = 0;
+  /// Heap allocations by this thread during the request, including anything
+  /// else it ran while we waited on the net. Only counted with the
+  /// ALLOCATION_ACCOUNTING build option
+  size_t allocations = 0;
+  size_t allocatedBytes = 0;
+  /// Everything except the queue wait
+  Clock::duration total() const {
+    return dns + connect + tlsHandshake + requestWrite + timeToFirstByte +
+           bodyTransfer;
+  }
+};
+
+} /* RESTClient */
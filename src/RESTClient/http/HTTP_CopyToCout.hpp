@@ -8,44 +8,27 @@ namespace RESTClient {
 
 namespace io = boost::iostreams;
 
-/// Copies all incoming text to cout
-class CopyIncomingToCout {
-public:
-  typedef char char_type;
-  typedef io::input_filter_tag category;
-
-  bool first = true; // Is this the first char in a line
-  bool disabled = false;
-
-  template <typename Source> int get(Source &src) {
-    char_type c = io::get(src);
-    if (!disabled) {
-      if (first)
-        std::cout << "> ";
-      std::cout.put(c);
-      first = (c == '\n');
-    }
-    return c;
+/// Copies text read from the net to cout
+inline void copyIncomingToCout(const char *data, size_t size) {
+  static bool first = true; // Is this the first char in a line
+  for (size_t i = 0; i != size; ++i) {
+    if (first)
+      std::cout << "> ";
+    std::cout.put(data[i]);
+    first = (data[i] == '\n');
   }
-};
+}
 
-/// Copies all outgoing text to cout
-class CopyOutgoingToCout {
-public:
-  typedef char char_type;
-  typedef io::output_filter_tag category;
-
-  bool first = true; // Is this the first char in a line ?
-
-  template <typename Sink> bool put(Sink &dest, int c) {
+/// Copies text written to the net to cout
+inline void copyOutgoingToCout(const char *data, size_t size) {
+  static bool first = true; // Is this the first char in a line
+  for (size_t i = 0; i != size; ++i) {
     if (first)
       std::cout << "< ";
-    std::cout.put(c);
-    first = (c == '\n');
-    io::put(dest, c);
-    return true;
+    std::cout.put(data[i]);
+    first = (data[i] == '\n');
   }
-};
-  
+}
+
 } /* RESTClient */
 #endif
@@ -1,173 +1,113 @@
 #pragma once
 
-#include <boost/algorithm/string/trim.hpp>
-#include <boost/range/algorithm/copy.hpp>
-#include <boost/algorithm/string/find.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/spawn.hpp>
+#include <boost/asio/ssl/error.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/version.hpp>
+
+#include <string_view>
 
 #include <RESTClient/base/logger.hpp>
-#include "HTTP_readChunk.hpp"
+#include <RESTClient/base/trace.hpp>
+#include "HTTPConnectionBuffers.hpp"
 #include "HTTP_CopyToCout.hpp"
 
 namespace RESTClient {
 
-/// Reads the first line of the HTTP reply and all the headers
-template <typename T>
-std::tuple<bool, int> readFirstLine(T &connection, std::istream &data) {
-  // Read in all the header data from the net
-  // For later
-  std::string temp, ok;
-  // Read in the first line
-  int code;
-  data >> temp >> code;
-  getline(data, ok);
-  boost::trim(ok);
-  return {ok == "OK", code};
+/// True if 'ec' means the server hung up
+inline bool connectionClosed(const boost::system::error_code &ec) {
+  if (ec == asio::error::eof)
+    return true;
+#if BOOST_VERSION >= 106200
+  return ec == asio::ssl::error::stream_truncated;
+#else
+  return (ec.category() == asio::error::get_ssl_category()) &&
+         (ec.value() == ERR_PACK(ERR_LIB_SSL, 0, SSL_R_SHORT_READ));
+#endif
 }
 
-/// Returns the HTTP response/error code, and 'true' if it has 'OK' at the end
-/// of the reply.
-/// throws std::runtime_error if there aren't three words in the reply.
-/// Expects streambuf to have at least all the header info
-void readHeaders(std::istream &data, Headers &headers,
-                 std::function<void(std::istream &, std::string &)> getLine =
-                     [](std::istream &i,
-                        std::string &s) { std::getline(i, s); }) {
-  std::string line, key, value;
-  while (true) {
-    // Parse it a line at a time
-    getLine(data, line);
-    if (line == "\r")
-      return;
-    auto pos = boost::find_first(line, ":");
-    assert(pos);
-    using namespace boost::range;
-    key.clear();
-    copy(make_iterator_range(line.begin(), pos.begin()),
-         std::back_inserter(key));
-    value.clear();
-    copy(make_iterator_range(pos.end(), line.end()), std::back_inserter(value));
-    boost::trim(key);
-    boost::trim(value);
-    headers.insert({key, value});
+/// Hands what's in 'buffers.incoming' to the connection's HTTPParser, and the
+/// body it finds to its HTTPBodyDecoder. Returns false if the parser needs
+/// more from the net, or a paused body is holding it up. 'headersDone()' is
+/// called once, when the headers are in
+template <typename HeadersDone>
+bool parseIncoming(HTTPConnectionBuffers &buffers, HTTPResponse &result,
+                   HeadersDone &&headersDone) {
+  asio::streambuf &buf = buffers.incoming;
+  HTTPParser &parser = buffers.parser;
+  HTTPBodyDecoder &decoder = buffers.decoder;
+  while ((buf.size() != 0) && !parser.done()) {
+    // Leave the rest where it is while the body's paused
+    if (parser.headersComplete() && !decoder.ready())
+      return false;
+    const char *data = asio::buffer_cast<const char *>(buf.data());
+    bool hadHeaders = parser.headersComplete();
+    std::string_view body;
+    size_t used = parser.parse(data, buf.size(), body);
+#ifdef HTTP_ON_STD_OUT
+    copyIncomingToCout(data, used);
+#endif
+    if (!body.empty())
+      decoder.write(body);
+    buf.consume(used);
+    if (!hadHeaders && parser.headersComplete()) {
+      decoder.start(result, parser.isGzipped(),
+                    parser.done() ? 0 : parser.contentLength());
+      headersDone();
+    }
   }
+  if (parser.done() && decoder.holding())
+    return decoder.ready();
+  return parser.done();
 }
 
+/// Reads a whole HTTP reply into 'result'. 'byteCounter' is increased by the
+/// number of bytes read from the net. 'buffers' must be the connection's own,
+/// as they may hold the start of the next reply.
+/// Returns true if the status was 2xx
 template <typename Connection>
-void readHTTPReply(HTTPResponse &result, asio::yield_context &yield,
-                   Connection &connection, std::function<void()> close) {
-  size_t contentLength = 0;
-  // Copy the data into a line
-  bool keepAlive = true; // All http 1.1 connections are keepalive unless
-                         // they contain a 'Connection: close' header
-  bool chunked = false;  // Chunked encoding (instead of contentLength)
-  bool gzipped = false;  // incoming content is gzip encoded
-  bool ok;
-
-  // Reads the headers into the result
-  asio::streambuf buf;
-  LOG_TRACE("readHTTPReply read headers (yield)")
-  asio::async_read_until(connection, buf, "\r\n\r\n", yield);
-  std::istream data(&buf);
-  data.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-
-  std::tie(ok, result.code) = readFirstLine(connection, data);
-  readHeaders(data, result.headers);
-
-  // Read important header values
-  // Content-Length
-  auto found = result.headers.find("Content-Length");
-  if (found != result.headers.end())
-    contentLength = std::stol(found->second);
-  // Connection: close
-  found = result.headers.find("Connection");
-  if ((found != result.headers.end()) && (found->second == "close"))
-    keepAlive = false;
-  // Chunked encoding
-  found = result.headers.find("Transfer-Encoding");
-  if ((found != result.headers.end()) && (found->second == "chunked"))
-    chunked = true;
-  // gzip encoding
-  found = result.headers.find("Content-Encoding");
-  if ((found != result.headers.end()) && (found->second == "gzip"))
-    gzipped = true;
-
-  /// Tries to read a line, and if there's not a whole line in the buffer, gets
-  /// more from the net
-  auto getLine = [&](std::string &line) {
-    // If there's not enough to hold a line, just get more
-    if (buf.in_avail() < 2) {
-      LOG_TRACE("readHTTPReply - getLine (yield)");
-      asio::async_read_until(connection, buf, "\r\n", yield);
-      std::getline(data, line);
-      return;
-    }
-
-    // Otherwise read carefully until we find '\n' or hit eof
-    // Loop at most twice. If the first read fails, then we fill the buffer from
-    // the net and continue reading
-    for (int i = 0; i < 2; ++i) {
-      char c = data.get();
-      while (!data.eof()) {
-        if (c == '\n')
-          // Found \n; return
-          return; 
-        else
-          // Not \n yet, store the character
-          line.push_back(c);
-        c = data.get();
-      }
-      // We've hit eof, read some more buffer then start again
-      LOG_TRACE("readHTTPReply - read one line (yield)");
-      asio::async_read_until(connection, buf, "\r\n", yield);
-      data.clear();
-    }
-    assert (false); // Code should never reath here
+bool readHTTPReply(HTTPResponse &result, asio::yield_context &yield,
+                   Connection &connection, std::function<void()> close,
+                   size_t &byteCounter, HTTPConnectionBuffers &buffers) {
+  TRACE_SPAN("readHTTPReply", &connection);
+  HTTPParser &parser = buffers.parser;
+  parser.start(result, buffers.spareHeaders);
+  auto waitStart = Clock::now();
+  auto bodyStart = waitStart;
+  auto headersDone = [&]() {
+    bodyStart = Clock::now();
+    result.timings.timeToFirstByte = bodyStart - waitStart;
   };
-
-  if ((!chunked) && (contentLength > 0)) {
-    // Read a straight content length body
-    size_t bytesToRead = contentLength - buf.in_avail();
-    LOG_TRACE("readHTTPReply - read whole body (yield): " << contentLength);
-    readChunk(connection, contentLength, gzipped, buf, data, result.body, yield);
-  } else {
-    // The body is chunked
-    while (true) {
-      // read the chunk size (in hex (16 base) ascii numbers)
-      // eg. F means 16
-      std::string line;
-      getLine(line); // Use our slightly smarter getline
-      size_t chunkSize = std::stoul(line, 0, 16);
-      if (chunkSize == 0)
-        break;
-
-      std::ostream& body = result.body;;
-      auto start = body.tellp();
-    LOG_TRACE("readHTTPReply - read chunk (yield): " << chunkSize);
-      readChunk(connection, chunkSize, gzipped, buf, data, body, yield);
-      // Read an empty line
-      char c;
-      data.get(c);
-      assert(c = '\r');
-      data.get(c);
-      assert(c = '\n');
+  bool closed = false;
+  LOG_TRACE("readHTTPReply (yield)");
+  while (!parseIncoming(buffers, result, headersDone)) {
+    // Leave the rest on the socket till they want it
+    if (buffers.decoder.paused()) {
+      boost::system::error_code ec;
+      buffers.decoder.streaming()->asyncWaitForResume(yield[ec]);
+      continue;
+    }
+    if (closed) {
+      parser.finish();
+      break;
     }
-    // See if we have any trailing headers after the chunks
-    readHeaders(data, result.headers,
-                [&getLine](std::istream &, std::string &s) {
-      s.clear();
-      getLine(s);
-    });
+    boost::system::error_code ec;
+    byteCounter += asio::async_read(connection, buffers.incoming,
+                                    asio::transfer_at_least(parser.wanted()),
+                                    yield[ec]);
+    if (connectionClosed(ec))
+      closed = true;
+    else if (ec)
+      throw boost::system::system_error(ec);
   }
+  buffers.decoder.finish();
+  result.timings.bodyTransfer = Clock::now() - bodyStart;
 
-  // We don't want to read from the next request's buffer
-  assert(buf.in_avail() == 0); 
   // Close connection if that's what the server wants
-  if (!keepAlive)
+  if (closed || !parser.isKeepAlive())
     close();
-  // If the result was bad
-  if (!ok)
-    throw HTTPError(result.code, result.body);
+  return parser.isOK();
 }
 
 } /* RESTClient */
-
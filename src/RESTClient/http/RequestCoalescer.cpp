@@ -0,0 +1,75 @@
+#include "RequestCoalescer.hpp"
+
+namespace RESTClient {
+
+RequestCoalescer::RequestCoalescer(std::vector<std::string> keyHeaders)
+    : keyHeaders(std::move(keyHeaders)) {}
+
+std::string RequestCoalescer::key(const HostInfo &hostInfo,
+                                  const HTTPRequest &request) const {
+  std::string result = request.verb;
+  result.push_back(' ');
+  // Tells credentials apart
+  result.append(cacheKey(hostInfo, request));
+  // Newlines can't be in a header, so can't make two keys look the same
+  for (const std::string &name : keyHeaders) {
+    result.push_back('\n');
+    result.append(request.header(name));
+  }
+  return result;
+}
+
+std::pair<RequestCoalescer::FlightPtr, bool>
+RequestCoalescer::join(const std::string &key) {
+  std::lock_guard<std::mutex> guard(lock);
+  FlightPtr &flight = flights[key];
+  if (flight) {
+    joined.fetch_add(1, std::memory_order_relaxed);
+    return {flight, false};
+  }
+  flight = std::make_shared<Flight>();
+  flown.fetch_add(1, std::memory_order_relaxed);
+  return {flight, true};
+}
+
+void RequestCoalescer::finish(const std::string &key, Flight &flight) {
+  {
+    // Anyone who comes now has missed it, and makes a new flight
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = flights.find(key);
+    if ((found != flights.end()) && (found->second.get() == &flight))
+      flights.erase(found);
+  }
+  std::vector<std::function<void()>> waiting;
+  {
+    std::lock_guard<std::mutex> guard(flight.lock);
+    flight.landed = true;
+    waiting.swap(flight.waiting);
+  }
+  for (auto &wake : waiting)
+    wake();
+}
+
+void RequestCoalescer::land(const std::string &key, Flight &flight,
+                            HTTPResponse &response) {
+  flight.code = response.code;
+  flight.headers = copyHeaders(response.headers);
+  flight.body = std::make_shared<const std::string>(response.body.take());
+  response.body.initWithShared(flight.body);
+  finish(key, flight);
+}
+
+void RequestCoalescer::land(const std::string &key, Flight &flight,
+                            std::exception_ptr failure) {
+  flight.failure = std::move(failure);
+  finish(key, flight);
+}
+
+CoalescerStats RequestCoalescer::stats() const {
+  CoalescerStats result;
+  result.flights = flown.load(std::memory_order_relaxed);
+  result.joined = joined.load(std::memory_order_relaxed);
+  return result;
+}
+
+} /* RESTClient */
@@ -0,0 +1,116 @@
+/// Lets identical GETs that are in flight at the same time share one trip to
+/// the server. Give one to any number of HTTP connections (on any threads)
+/// with HTTP::useCoalescer.
+///
+/// The first request for a key goes to the server (through the connection's
+/// caches, if it has any). Any that come for the same key before it's
+/// answered wait for it, then get its status, headers and body. The body is
+/// shared, not copied, so it's read only for all of them.
+///
+/// Requests are the same if they have the same verb, host, path and
+/// credentials (Authorization, Proxy-Authorization, X-Auth-Token and Cookie
+/// headers, from the request or its template), and the same values for any
+/// other headers the coalescer was told matter (eg. Accept). So no one is
+/// ever given a response meant for someone else.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+
+#include <RESTClient/base/url.hpp>
+#include <RESTClient/http/CachePolicy.hpp>
+#include <RESTClient/http/HTTPRequest.hpp>
+#include <RESTClient/http/HTTPResponse.hpp>
+
+namespace RESTClient {
+
+/// What a RequestCoalescer has done since it was made
+struct CoalescerStats {
+  /// Requests that went to the server for others
+  uint64_t flights = 0;
+  /// Requests that waited for another's response instead
+  uint64_t joined = 0;
+};
+
+class RequestCoalescer {
+public:
+  /// A request on its way to the server, and later what came of it
+  struct Flight {
+    std::mutex lock;
+    bool landed = false;
+    int code = 0;
+    CachedHeaders headers;
+    std::shared_ptr<const std::string> body;
+    /// Why there's no response, if there isn't
+    std::exception_ptr failure;
+    /// Wake the waiters
+    std::vector<std::function<void()>> waiting;
+  };
+  using FlightPtr = std::shared_ptr<Flight>;
+
+private:
+  std::vector<std::string> keyHeaders;
+  std::mutex lock;
+  std::unordered_map<std::string, FlightPtr> flights;
+  std::atomic<uint64_t> flown{0};
+  std::atomic<uint64_t> joined{0};
+  /// Takes 'flight' out from under 'key', marks it landed and wakes its
+  /// waiters. 'flight' must be filled in first
+  void finish(const std::string &key, Flight &flight);
+
+public:
+  /// Requests that differ in their credentials, or in any of 'keyHeaders',
+  /// aren't the same
+  explicit RequestCoalescer(std::vector<std::string> keyHeaders = {});
+  RequestCoalescer(const RequestCoalescer &) = delete;
+  /// What a request is known by
+  std::string key(const HostInfo &hostInfo, const HTTPRequest &request) const;
+  /// The flight for 'key', and true if we made it, in which case the caller
+  /// must send the request and land() it
+  std::pair<FlightPtr, bool> join(const std::string &key);
+  /// Shares 'response' with the waiters. Its body becomes a view of the
+  /// shared bytes
+  void land(const std::string &key, Flight &flight, HTTPResponse &response);
+  /// Tells the waiters the request failed with 'failure'
+  void land(const std::string &key, Flight &flight,
+            std::exception_ptr failure);
+  /// Waits for 'flight' to land. The completion is posted to the waiter's
+  /// own executor (eg. a coroutine's strand), whatever thread it lands on
+  template <typename CompletionToken>
+  auto wait(Flight &flight, CompletionToken &&token) {
+    return boost::asio::async_initiate<CompletionToken, void()>(
+        [&flight](auto handler) {
+          using Handler = decltype(handler);
+          // std::function needs something it can copy
+          auto held = std::make_shared<Handler>(std::move(handler));
+          auto work = boost::asio::make_work_guard(
+              boost::asio::get_associated_executor(*held));
+          auto wake = [held, work]() mutable {
+            boost::asio::post(std::move(*held));
+            work.reset();
+          };
+          std::unique_lock<std::mutex> guard(flight.lock);
+          if (flight.landed) {
+            guard.unlock();
+            wake();
+          } else
+            flight.waiting.push_back(std::move(wake));
+        },
+        token);
+  }
+  CoalescerStats stats() const;
+};
+
+} /* RESTClient */
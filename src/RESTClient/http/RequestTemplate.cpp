@@ -0,0 +1,61 @@
+#include "RequestTemplate.hpp"
+#include "HTTPProtocol.hpp"
+
+#include <cstdio>
+
+namespace RESTClient {
+
+HTTPRequest::HTTPRequest(const RequestTemplate &from, std::string verb,
+                         std::string path, Headers headers, HTTPBody body)
+    : verb(std::move(verb)), path(std::move(path)),
+      headers(std::move(headers)), body(std::move(body)), from(&from) {}
+
+std::string_view HTTPRequest::header(std::string_view name) const {
+  // There are only ever a few, so this beats making a key to find()
+  for (const auto &header : headers)
+    if (sameHeaderName(header.first, name))
+      return header.second;
+  if (from)
+    for (const auto &header : from->getHeaders())
+      if (sameHeaderName(header.first, name))
+        return header.second;
+  return {};
+}
+
+RequestTemplate::RequestTemplate(const HostInfo &hostInfo,
+                                 std::string pathPrefix,
+                                 const Headers &headers)
+    : pathPrefix(std::move(pathPrefix)), headers(headers) {
+  // The same defaults as addDefaultHeaders, less the ones that follow the
+  // body
+  this->headers.emplace("Host", hostInfo.hostHeader());
+  this->headers.emplace("Accept", "*/*");
+  this->headers.emplace("Accept-Encoding", "gzip, deflate");
+  this->headers.emplace("TE", "trailers");
+  for (const auto &header : this->headers)
+    fixed.append(header.first)
+        .append(": ")
+        .append(header.second)
+        .append("\r\n");
+}
+
+void RequestTemplate::appendHead(std::string &head,
+                                 const HTTPRequest &request) const {
+  head.append(request.verb).append(" ").append(pathPrefix);
+  head.append(request.path).append(" HTTP/1.1\r\n");
+  head.append(fixed);
+  for (const auto &header : request.headers)
+    head.append(header.first).append(": ").append(header.second).append("\r\n");
+  // https://tools.ietf.org/html/rfc7230#section-3.3.2
+  long size = request.body.size();
+  if (size >= 0) {
+    char digits[24];
+    int length = std::snprintf(digits, sizeof(digits), "%ld", size);
+    head.append("Content-Length: ").append(digits, length).append("\r\n");
+  } else {
+    head.append("Transfer-Encoding: chunked\r\n");
+  }
+  head.append("\r\n");
+}
+
+} /* RESTClient */
@@ -0,0 +1,38 @@
+/// The parts of a request that don't change from one to the next, eg. for a
+/// host and an auth token, serialized once. Requests made from one only have
+/// their path, their own headers and their Content-Length spliced in as
+/// they're sent.
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <RESTClient/base/url.hpp>
+#include <RESTClient/http/HTTPHeaders.hpp>
+
+namespace RESTClient {
+
+struct HTTPRequest;
+
+class RequestTemplate {
+private:
+  std::string pathPrefix;
+  /// Our default headers and the caller's, as they go on the wire
+  std::string fixed;
+  /// The same headers, for HTTP/2, which encodes its own
+  Headers headers;
+
+public:
+  /// 'headers' go with every request, and replace our defaults (Host, Accept,
+  /// Accept-Encoding and TE) if they have the same names. 'pathPrefix' goes
+  /// before every request's path, eg. "/v1/MossoCloudFS_abc"
+  RequestTemplate(const HostInfo &hostInfo, std::string pathPrefix = "",
+                  const Headers &headers = {});
+  const std::string &getPathPrefix() const { return pathPrefix; }
+  const Headers &getHeaders() const { return headers; }
+  /// Appends the head of 'request', which was made from us, to 'head'. The
+  /// request's own headers mustn't repeat ours, or give a Content-Length
+  void appendHead(std::string &head, const HTTPRequest &request) const;
+};
+
+} /* RESTClient */
@@ -0,0 +1,147 @@
+#include "ResponseCache.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace RESTClient {
+
+namespace {
+
+/// Fills in what 'entry' knows from the rules for its headers
+void understand(ResponseCache::Entry &entry, const std::string &key,
+                CacheRules &&rules) {
+  entry.etag = std::move(rules.etag);
+  entry.lastModified = std::move(rules.lastModified);
+  entry.vary = std::move(rules.vary);
+  entry.expires = Clock::now() + rules.freshFor;
+  entry.bytes = sizeof(entry) + key.size() + entry.body->size();
+  for (const auto &header : entry.headers)
+    entry.bytes += header.first.size() + header.second.size();
+  for (const auto &header : entry.vary)
+    entry.bytes += header.first.size() + header.second.size();
+}
+
+} // namespace
+
+ResponseCache::ResponseCache(size_t budget, size_t shardCount)
+    : shardBudget(budget / std::max<size_t>(shardCount, 1)) {
+  shards.resize(std::max<size_t>(shardCount, 1));
+  for (auto &shard : shards)
+    shard.reset(new Shard);
+}
+
+ResponseCache::Shard &ResponseCache::shardFor(const std::string &key) {
+  return *shards[std::hash<std::string>{}(key) % shards.size()];
+}
+
+ResponseCache::EntryPtr ResponseCache::find(const std::string &key,
+                                            const HTTPRequest &request) {
+  EntryPtr entry;
+  {
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    auto found = shard.entries.find(key);
+    if (found == shard.entries.end())
+      return nullptr;
+    shard.recent.splice(shard.recent.begin(), shard.recent,
+                        found->second.second);
+    entry = found->second.first;
+  }
+  if (!varyMatches(entry->vary, request))
+    return nullptr;
+  if (entry->fresh(Clock::now()))
+    hits.fetch_add(1, std::memory_order_relaxed);
+  return entry;
+}
+
+void ResponseCache::store(const std::string &key, const HTTPRequest &request,
+                          const HTTPResponse &response) {
+  misses.fetch_add(1, std::memory_order_relaxed);
+  if (!response.body.isContiguous())
+    return;
+  auto entry = std::make_shared<Entry>();
+  entry->code = response.code;
+  entry->headers = copyHeaders(response.headers);
+  CacheRules rules = cacheRules(entry->code, entry->headers, request);
+  if (!rules.worthKeeping())
+    return;
+  entry->body = std::make_shared<const std::string>(response.body.view());
+  understand(*entry, key, std::move(rules));
+  insert(key, std::move(entry));
+}
+
+ResponseCache::EntryPtr
+ResponseCache::revalidated(const std::string &key,
+                           const HTTPRequest &request, const EntryPtr &stale,
+                           const HTTPResponse &notModified) {
+  revalidations.fetch_add(1, std::memory_order_relaxed);
+  auto entry = std::make_shared<Entry>(*stale);
+  freshenHeaders(entry->headers, notModified.headers);
+  CacheRules rules = cacheRules(entry->code, entry->headers, request);
+  bool storable = rules.storable;
+  understand(*entry, key, std::move(rules));
+  if (!storable) {
+    Shard &shard = shardFor(key);
+    std::lock_guard<std::mutex> lock(shard.lock);
+    drop(shard, key);
+  } else {
+    insert(key, entry);
+  }
+  return entry;
+}
+
+void ResponseCache::drop(Shard &shard, const std::string &key) {
+  auto found = shard.entries.find(key);
+  if (found == shard.entries.end())
+    return;
+  shard.bytes -= found->second.first->bytes;
+  shard.recent.erase(found->second.second);
+  shard.entries.erase(found);
+}
+
+void ResponseCache::insert(const std::string &key, EntryPtr entry) {
+  Shard &shard = shardFor(key);
+  std::lock_guard<std::mutex> lock(shard.lock);
+  drop(shard, key);
+  // Too big to keep at all
+  if (entry->bytes > shardBudget)
+    return;
+  stores.fetch_add(1, std::memory_order_relaxed);
+  shard.bytes += entry->bytes;
+  shard.recent.push_front(key);
+  shard.entries.emplace(key, std::make_pair(std::move(entry),
+                                            shard.recent.begin()));
+  while (shard.bytes > shardBudget) {
+    auto oldest = shard.entries.find(shard.recent.back());
+    shard.bytes -= oldest->second.first->bytes;
+    shard.entries.erase(oldest);
+    shard.recent.pop_back();
+    evictions.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void ResponseCache::clear() {
+  for (auto &shard : shards) {
+    std::lock_guard<std::mutex> lock(shard->lock);
+    shard->entries.clear();
+    shard->recent.clear();
+    shard->bytes = 0;
+  }
+}
+
+CacheStats ResponseCache::stats() const {
+  CacheStats result;
+  result.hits = hits.load(std::memory_order_relaxed);
+  result.misses = misses.load(std::memory_order_relaxed);
+  result.revalidations = revalidations.load(std::memory_order_relaxed);
+  result.stores = stores.load(std::memory_order_relaxed);
+  result.evictions = evictions.load(std::memory_order_relaxed);
+  for (auto &shard : shards) {
+    std::lock_guard<std::mutex> lock(shard->lock);
+    result.entries += shard->entries.size();
+    result.bytes += shard->bytes;
+  }
+  return result;
+}
+
+} /* RESTClient */
@@ -0,0 +1,120 @@
+/// An in memory cache of GET responses, in front of HTTP::action. Give one to
+/// any number of HTTP connections (on any threads) with HTTP::useCache.
+///
+/// Responses are kept while they're fresh by Cache-Control max-age or
+/// Expires, and served without touching the net. After that, one with an ETag
+/// or Last-Modified is revalidated with If-None-Match or If-Modified-Since;
+/// a 304 is answered from the cache, with no body on the wire.
+///
+/// As it's shared, responses marked Cache-Control: private are never kept,
+/// and requests with different credentials (Authorization, X-Auth-Token,
+/// etc.) never get each other's responses.
+///
+/// It's split into shards, each with its own lock and its own share of the
+/// byte budget, and each dropping its least recently used responses to stay
+/// in it.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <RESTClient/base/clock.hpp>
+#include <RESTClient/http/CachePolicy.hpp>
+#include <RESTClient/http/HTTPRequest.hpp>
+#include <RESTClient/http/HTTPResponse.hpp>
+
+namespace RESTClient {
+
+/// What a ResponseCache has done since it was made
+struct CacheStats {
+  /// Served fresh, without asking the server
+  uint64_t hits = 0;
+  /// Had to fetch the whole response
+  uint64_t misses = 0;
+  /// Served after the server said it was Not Modified
+  uint64_t revalidations = 0;
+  /// Responses stored, including freshened ones
+  uint64_t stores = 0;
+  /// Responses dropped to stay in budget
+  uint64_t evictions = 0;
+  size_t entries = 0;
+  size_t bytes = 0;
+};
+
+class ResponseCache {
+public:
+  /// A stored response. It never changes once it's in the cache; revalidating
+  /// it replaces it with one that shares its body
+  struct Entry {
+    int code = 0;
+    CachedHeaders headers;
+    std::shared_ptr<const std::string> body;
+    /// The request headers the response's Vary named, with their values
+    CachedHeaders vary;
+    std::string etag;
+    std::string lastModified;
+    /// Served without asking until then
+    Clock::time_point expires;
+    /// What it counts against the budget
+    size_t bytes = 0;
+    bool fresh(Clock::time_point now) const { return now < expires; }
+    /// True if the server can tell us it's Not Modified
+    bool revalidatable() const {
+      return !etag.empty() || !lastModified.empty();
+    }
+  };
+  using EntryPtr = std::shared_ptr<const Entry>;
+
+private:
+  struct Shard {
+    std::mutex lock;
+    /// Keys, most recently used first
+    std::list<std::string> recent;
+    std::unordered_map<std::string,
+                       std::pair<EntryPtr, std::list<std::string>::iterator>>
+        entries;
+    size_t bytes = 0;
+  };
+  size_t shardBudget;
+  std::vector<std::unique_ptr<Shard>> shards;
+  std::atomic<uint64_t> hits{0};
+  std::atomic<uint64_t> misses{0};
+  std::atomic<uint64_t> revalidations{0};
+  std::atomic<uint64_t> stores{0};
+  std::atomic<uint64_t> evictions{0};
+  Shard &shardFor(const std::string &key);
+  /// Puts 'entry' under 'key', replacing what was there, and evicts to fit
+  void insert(const std::string &key, EntryPtr entry);
+  /// Takes 'key' out of 'shard', whose lock must be held
+  void drop(Shard &shard, const std::string &key);
+
+public:
+  /// 'budget' is in bytes of bodies, headers and keys
+  explicit ResponseCache(size_t budget = 64 * 1024 * 1024,
+                         size_t shardCount = 16);
+  ResponseCache(const ResponseCache &) = delete;
+  /// The response stored for 'request', fresh or not, if its Vary headers
+  /// match. Counts a hit if it's fresh
+  EntryPtr find(const std::string &key, const HTTPRequest &request);
+  /// Counts a miss, and keeps a copy of 'response' if its CacheRules say it's
+  /// worth keeping
+  void store(const std::string &key, const HTTPRequest &request,
+             const HTTPResponse &response);
+  /// Counts a revalidation, and replaces 'stale' with a copy freshened by the
+  /// headers of 'notModified'. Returns the copy
+  EntryPtr revalidated(const std::string &key, const HTTPRequest &request,
+                       const EntryPtr &stale, const HTTPResponse &notModified);
+  /// Drops everything
+  void clear();
+  CacheStats stats() const;
+};
+
+} /* RESTClient */
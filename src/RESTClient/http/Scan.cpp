@@ -0,0 +1,137 @@
+#include "Scan.hpp"
+
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_SIMD "avx2"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_SIMD "sse2"
+#endif
+
+namespace RESTClient {
+
+namespace {
+
+#if defined(__AVX2__)
+/// What one look at the bytes can do
+struct Lanes {
+  static const size_t width = 32;
+  using Vector = __m256i;
+  static Vector splat(char c) { return _mm256_set1_epi8(c); }
+  static Vector load(const char *at) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(at));
+  }
+  /// A bit for each byte of 'bytes' that's in 'needle'
+  static uint32_t equal(Vector bytes, Vector needle) {
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, needle));
+  }
+};
+#elif defined(__SSE2__)
+struct Lanes {
+  static const size_t width = 16;
+  using Vector = __m128i;
+  static Vector splat(char c) { return _mm_set1_epi8(c); }
+  static Vector load(const char *at) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(at));
+  }
+  static uint32_t equal(Vector bytes, Vector needle) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, needle));
+  }
+};
+#endif
+
+/// If the '\n' at 'at' is followed by an empty line, returns its '\n'
+const char *blankLineAfter(const char *at, const char *end) {
+  if ((end - at > 1) && (at[1] == '\n'))
+    return at + 1;
+  if ((end - at > 2) && (at[1] == '\r') && (at[2] == '\n'))
+    return at + 2;
+  return nullptr;
+}
+
+} /* anonymous namespace */
+
+namespace scalar {
+
+const char *findByte(const char *begin, const char *end, char c) {
+  for (; begin != end; ++begin)
+    if (*begin == c)
+      return begin;
+  return end;
+}
+
+const char *findEither(const char *begin, const char *end, char a, char b) {
+  for (; begin != end; ++begin)
+    if ((*begin == a) || (*begin == b))
+      return begin;
+  return end;
+}
+
+const char *findHeadEnd(const char *begin, const char *end) {
+  for (const char *at = findByte(begin, end, '\n'); at != end;
+       at = findByte(at + 1, end, '\n'))
+    if (const char *after = blankLineAfter(at, end))
+      return after;
+  return end;
+}
+
+} /* scalar */
+
+#ifdef SCAN_SIMD
+
+const char *findByte(const char *begin, const char *end, char c) {
+  auto needle = Lanes::splat(c);
+  for (; size_t(end - begin) >= Lanes::width; begin += Lanes::width)
+    if (uint32_t found = Lanes::equal(Lanes::load(begin), needle))
+      return begin + __builtin_ctz(found);
+  return scalar::findByte(begin, end, c);
+}
+
+const char *findEither(const char *begin, const char *end, char a, char b) {
+  auto first = Lanes::splat(a);
+  auto second = Lanes::splat(b);
+  for (; size_t(end - begin) >= Lanes::width; begin += Lanes::width) {
+    auto bytes = Lanes::load(begin);
+    if (uint32_t found =
+            Lanes::equal(bytes, first) | Lanes::equal(bytes, second))
+      return begin + __builtin_ctz(found);
+  }
+  return scalar::findEither(begin, end, a, b);
+}
+
+const char *findHeadEnd(const char *begin, const char *end) {
+  auto newLine = Lanes::splat('\n');
+  for (; size_t(end - begin) >= Lanes::width; begin += Lanes::width) {
+    // Every line end in the block is a candidate
+    uint32_t found = Lanes::equal(Lanes::load(begin), newLine);
+    for (; found != 0; found &= found - 1)
+      if (const char *after =
+              blankLineAfter(begin + __builtin_ctz(found), end))
+        return after;
+  }
+  return scalar::findHeadEnd(begin, end);
+}
+
+const char *scanInstructions() { return SCAN_SIMD; }
+
+#else
+
+const char *findByte(const char *begin, const char *end, char c) {
+  return scalar::findByte(begin, end, c);
+}
+
+const char *findEither(const char *begin, const char *end, char a, char b) {
+  return scalar::findEither(begin, end, a, b);
+}
+
+const char *findHeadEnd(const char *begin, const char *end) {
+  return scalar::findHeadEnd(begin, end);
+}
+
+const char *scanInstructions() { return "scalar"; }
+
+#endif
+
+} /* RESTClient */
@@ -0,0 +1,33 @@
+/// Finds the bytes HTTP/1.1 is framed by: line ends, header colons, and the
+/// blank line ending a head. Looks at 16 bytes at a time with SSE2, or 32
+/// with AVX2 if it's compiled with -mavx2 (the AVX2 build option). Other CPUs
+/// get the scalar versions.
+#pragma once
+
+#include <cstddef>
+
+namespace RESTClient {
+
+/// The first 'c' in [begin, end), or 'end'
+const char *findByte(const char *begin, const char *end, char c);
+
+/// The first 'a' or 'b' in [begin, end), or 'end'
+const char *findEither(const char *begin, const char *end, char a, char b);
+
+/// The last byte of the blank line that ends a head ("\r\n\r\n", or a bare
+/// "\n\n"), so the head is [begin, found]. Or 'end' if [begin, end) doesn't
+/// have one
+const char *findHeadEnd(const char *begin, const char *end);
+
+/// The instructions the functions above were built with, eg. "avx2"
+const char *scanInstructions();
+
+/// A byte at a time, for CPUs without SIMD, and to test and benchmark the
+/// others against
+namespace scalar {
+const char *findByte(const char *begin, const char *end, char c);
+const char *findEither(const char *begin, const char *end, char a, char b);
+const char *findHeadEnd(const char *begin, const char *end);
+} /* scalar */
+
+} /* RESTClient */
@@ -4,7 +4,11 @@ namespace RESTClient {
 
 std::unique_ptr<Services> globalServices;
 
-Services::Services() : io_service(), resolver(io_service) {}
+Services::Services()
+    : io_service(), resolver(io_service),
+      ssl_context(asio::ssl::context::sslv23) {
+  ssl_context.set_default_verify_paths();
+}
 
 Services& Services::instance() {
   if (!globalServices)
@@ -13,4 +17,8 @@ Services& Services::instance() {
   return *globalServices;
 }
 
+void Services::trustCertificate(const std::string &pemFile) {
+  ssl_context.load_verify_file(pemFile);
+}
+
 } /* RESTClientt */
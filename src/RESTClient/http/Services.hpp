@@ -2,6 +2,7 @@
 
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
 
 namespace RESTClient {
 
@@ -11,8 +12,13 @@ using namespace boost::asio::ip; // to get 'tcp::'
 struct Services {
   asio::io_service io_service;
   tcp::resolver resolver;
+  /// Shared by all HTTPS connections. Trusts the system's CA certificates
+  asio::ssl::context ssl_context;
   Services();
   static Services& instance();
+  /// Also trust the certificate(s) in a PEM file, eg. a test server's self
+  /// signed one. Do this before making connections
+  void trustCertificate(const std::string &pemFile);
 };
 
   
@@ -0,0 +1,21 @@
+#include "StreamedBody.hpp"
+
+#include "Services.hpp"
+
+namespace RESTClient {
+
+StreamedBody::StreamedBody(HeadersHandler onHeaders, DataHandler onData)
+    : onHeaders(std::move(onHeaders)), onData(std::move(onData)),
+      resumed(Services::instance().io_service) {}
+
+void StreamedBody::pause() {
+  isPaused = true;
+  resumed.expires_at(boost::asio::steady_timer::time_point::max());
+}
+
+void StreamedBody::resume() {
+  isPaused = false;
+  resumed.cancel();
+}
+
+} /* RESTClient */
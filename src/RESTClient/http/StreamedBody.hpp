@@ -0,0 +1,55 @@
+/// A response body handed to callbacks as it arrives, instead of being kept in
+/// HTTPResponse::body. Memory use stays flat however big the body is, and work
+/// can start on the first byte.
+#pragma once
+
+#include <functional>
+#include <string_view>
+
+#include <boost/asio/steady_timer.hpp>
+
+namespace RESTClient {
+
+class HTTPResponse;
+
+class StreamedBody {
+public:
+  /// Called once the status and headers are in, before any body
+  using HeadersHandler = std::function<void(const HTTPResponse &)>;
+  /// Called with each piece of body, after gunzipping. The view is only good
+  /// until it returns
+  using DataHandler = std::function<void(std::string_view)>;
+
+private:
+  HeadersHandler onHeaders;
+  DataHandler onData;
+  bool isPaused = false;
+  /// Cancelled by resume()
+  boost::asio::steady_timer resumed;
+
+public:
+  StreamedBody(HeadersHandler onHeaders, DataHandler onData);
+  StreamedBody(const StreamedBody &) = delete;
+  void headers(const HTTPResponse &response) {
+    if (onHeaders)
+      onHeaders(response);
+  }
+  void data(std::string_view data) { onData(data); }
+  /// Stops the connection reading until resume(). What it already has is
+  /// held back; the server is slowed down by TCP (or HTTP/2 flow control).
+  /// Callable from the handlers, which then aren't called again till resumed
+  void pause();
+  /// Carries on reading. Callable from any coroutine on the io_service
+  void resume();
+  bool paused() const { return isPaused; }
+  /// Completes when resume() is called, or straight away if we're not paused.
+  /// Takes a yield_context or use_awaitable
+  template <typename CompletionToken>
+  auto asyncWaitForResume(CompletionToken &&token) {
+    if (!isPaused)
+      resumed.expires_at(boost::asio::steady_timer::time_point::min());
+    return resumed.async_wait(std::forward<CompletionToken>(token));
+  }
+};
+
+} /* RESTClient */
@@ -0,0 +1,164 @@
+#include <RESTClient/http/HPACK.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace RESTClient;
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+using HeaderList = std::vector<std::pair<std::string, std::string>>;
+
+std::string hex(const std::string &bytes) {
+  std::stringstream out;
+  for (unsigned char c : bytes)
+    out << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 0xf];
+  return out.str();
+}
+
+std::string unhex(const std::string &text) {
+  std::string result;
+  for (size_t i = 0; i < text.size(); i += 2)
+    result.push_back(static_cast<char>(std::stoi(text.substr(i, 2), 0, 16)));
+  return result;
+}
+
+std::string decodeAll(HPACKDecoder &decoder, const std::string &block) {
+  std::string result;
+  const char *data = block.data();
+  std::string_view name, value;
+  while (decoder.next(data, block.data() + block.size(), name, value))
+    result.append(name).append(": ").append(value).append("\n");
+  return result;
+}
+
+std::string lines(const HeaderList &headers) {
+  std::string result;
+  for (const auto &header : headers)
+    result.append(header.first).append(": ").append(header.second).append(
+        "\n");
+  return result;
+}
+
+/// RFC 7541 C.4: requests with Huffman coding
+const std::vector<std::pair<HeaderList, std::string>> requests{
+    {{{":method", "GET"},
+      {":scheme", "http"},
+      {":path", "/"},
+      {":authority", "www.example.com"}},
+     "828684418cf1e3c2e5f23a6ba0ab90f4ff"},
+    {{{":method", "GET"},
+      {":scheme", "http"},
+      {":path", "/"},
+      {":authority", "www.example.com"},
+      {"cache-control", "no-cache"}},
+     "828684be5886a8eb10649cbf"},
+    {{{":method", "GET"},
+      {":scheme", "https"},
+      {":path", "/index.html"},
+      {":authority", "www.example.com"},
+      {"custom-key", "custom-value"}},
+     "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"}};
+
+void testEncoder() {
+  HPACKEncoder encoder;
+  for (const auto &request : requests) {
+    std::string block;
+    for (const auto &header : request.first)
+      encoder.encode(block, header.first, header.second);
+    EQ(hex(block), request.second);
+  }
+}
+
+void testDecoder() {
+  HPACKDecoder decoder;
+  for (const auto &request : requests)
+    EQ(decodeAll(decoder, unhex(request.second)), lines(request.first));
+  // RFC 7541 C.6: responses, with a 256 byte table (so entries get evicted)
+  decoder.reset();
+  const std::vector<std::pair<HeaderList, std::string>> responses{
+      {{{":status", "302"},
+        {"cache-control", "private"},
+        {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+        {"location", "https://www.example.com"}},
+       "3fe101488264025885aec3771a4b6196d07abe941054d444a8200595040b8166e082a6"
+       "2d1bff6e919d29ad171863c78f0b97c8e9ae82ae43d3"},
+      {{{":status", "307"},
+        {"cache-control", "private"},
+        {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+        {"location", "https://www.example.com"}},
+       "4883640effc1c0bf"},
+      {{{":status", "200"},
+        {"cache-control", "private"},
+        {"date", "Mon, 21 Oct 2013 20:13:22 GMT"},
+        {"location", "https://www.example.com"},
+        {"content-encoding", "gzip"},
+        {"set-cookie",
+         "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1"}},
+       "88c16196d07abe941054d444a8200595040b8166e084a62d1bffc05a839bd9ab77ad94"
+       "e7821dd7f2e6c7b335dfdfcd5b3960d5af27087f3672c1ab270fb5291f9587316065c0"
+       "03ed4ee5b1063d5007"}};
+  for (const auto &response : responses)
+    EQ(decodeAll(decoder, unhex(response.second)), lines(response.first));
+}
+
+void testRoundTrip() {
+  // Integers (C.1.2) and the table size setting
+  std::string out;
+  HPACK::appendInteger(out, 1337, 5, 0);
+  EQ(hex(out), "1f9a0a");
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(out.data());
+  EQ(HPACK::readInteger(data, data + out.size(), 5), 1337);
+  HPACKEncoder encoder;
+  HPACKDecoder decoder;
+  encoder.setMaxTableSize(100);
+  HeaderList headers{{"x-big", std::string(200, 'x')},
+                     {"authorization", "secret"},
+                     {"x-every-byte", std::string("\0\x01\xff~", 4)}};
+  for (int i = 0; i != 3; ++i) {
+    std::string block;
+    for (const auto &header : headers)
+      encoder.encode(block, header.first, header.second,
+                     header.first == "authorization");
+    EQ(decodeAll(decoder, block), lines(headers));
+  }
+  // Huffman padding must be short and all ones
+  for (std::string bad : {"8200", "82ffff"}) {
+    bool threw = false;
+    try {
+      std::string result;
+      std::string bytes = unhex(bad);
+      HPACK::decodeHuffman(reinterpret_cast<const uint8_t *>(bytes.data()) + 1,
+                           bytes.size() - 1, result);
+    } catch (std::runtime_error &) {
+      threw = true;
+    }
+    EQ(threw, true);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int failures = 0;
+  auto check = [&failures](const char *name, void (*test)()) {
+    try {
+      test();
+    } catch (std::exception &e) {
+      std::cerr << name << " FAILED: " << e.what() << std::endl;
+      ++failures;
+    }
+  };
+  check("encoder", testEncoder);
+  check("decoder", testDecoder);
+  check("round trip", testRoundTrip);
+  return failures;
+}
@@ -0,0 +1,235 @@
+#include <RESTClient/http/HTTPProtocol.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace RESTClient;
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+/// Feeds 'reply' to a parser 'step' bytes at a time, like reads off the net
+/// would, and returns the body it found. 'rest' gets what's left after the
+/// end of the response
+std::string parse(HTTPParser &parser, HTTPResponse &response,
+                  const std::string &reply, size_t step,
+                  std::string *rest = nullptr) {
+  SpareHeaders spares;
+  spares.recycle(response.headers);
+  parser.start(response, spares);
+  std::string body;
+  std::string pending;
+  size_t fed = 0;
+  while (!parser.done()) {
+    if (pending.empty()) {
+      if (fed == reply.size())
+        break;
+      pending = reply.substr(fed, step);
+      fed += pending.size();
+    }
+    std::string_view slice;
+    size_t used = parser.parse(pending.data(), pending.size(), slice);
+    body.append(slice.data(), slice.size());
+    pending.erase(0, used);
+  }
+  if (rest)
+    *rest = pending + reply.substr(fed);
+  return body;
+}
+
+void testContentLength() {
+  const std::string reply = "HTTP/1.1 200 OK\r\n"
+                            "content-length: 11\r\n"
+                            "X-Spaced:   padded value  \r\n"
+                            "\r\n"
+                            "hello world"
+                            "HTTP/1.1 200 OK";
+  for (size_t step = 1; step <= reply.size(); ++step) {
+    HTTPParser parser;
+    HTTPResponse response;
+    std::string rest;
+    EQ(parse(parser, response, reply, step, &rest), "hello world");
+    EQ(response.code, 200);
+    EQ(parser.isOK(), true);
+    EQ(parser.isKeepAlive(), true);
+    EQ(response.headers.at("X-Spaced"), "padded value");
+    // The next reply is left alone
+    EQ(rest, "HTTP/1.1 200 OK");
+  }
+}
+
+void testChunked() {
+  const std::string reply = "HTTP/1.1 404 Not Found\r\n"
+                            "Transfer-Encoding: chunked\r\n"
+                            "\r\n"
+                            "5\r\nhello\r\n"
+                            "1\r\n \r\n"
+                            "A\r\n0123456789\r\n"
+                            "0\r\n"
+                            "Trailing: header\r\n"
+                            "\r\n";
+  for (size_t step = 1; step <= reply.size(); ++step) {
+    HTTPParser parser;
+    HTTPResponse response;
+    EQ(parse(parser, response, reply, step), "hello 0123456789");
+    EQ(response.code, 404);
+    EQ(parser.isOK(), false);
+    EQ(response.headers.at("Trailing"), "header");
+  }
+}
+
+void testChunkExtensions() {
+  // Extensions are skipped, and bare line feeds are taken as line ends
+  const std::string reply = "HTTP/1.1 200 OK\r\n"
+                            "Transfer-Encoding: chunked\r\n"
+                            "\r\n"
+                            "5;name=value\r\nhello\r\n"
+                            "1 ; quoted=\"a;b\"\r\n \r\n"
+                            "0006\nworld!\n"
+                            "0;last\r\n"
+                            "\r\n"
+                            "HTTP/1.1 200 OK";
+  for (size_t step = 1; step <= reply.size(); ++step) {
+    HTTPParser parser;
+    HTTPResponse response;
+    std::string rest;
+    EQ(parse(parser, response, reply, step, &rest), "hello world!");
+    EQ(rest, "HTTP/1.1 200 OK");
+  }
+}
+
+void testManyChunks() {
+  // Lots of tiny chunks, all in one read, each handed out where it lies
+  std::string reply = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+  std::string expected;
+  for (int i = 0; i != 500; ++i) {
+    reply.append("1\r\n").append(1, char('a' + i % 26)).append("\r\n");
+    expected.append(1, char('a' + i % 26));
+  }
+  reply.append("0\r\n\r\n");
+  SpareHeaders spares;
+  HTTPParser parser;
+  HTTPResponse response;
+  parser.start(response, spares);
+  std::string body;
+  size_t used = 0;
+  while (!parser.done()) {
+    std::string_view slice;
+    used += parser.parse(reply.data() + used, reply.size() - used, slice);
+    if (!slice.empty()) {
+      // Not copied out of the reply
+      EQ((slice.data() >= reply.data()), true);
+      EQ((slice.data() < reply.data() + reply.size()), true);
+    }
+    body.append(slice.data(), slice.size());
+  }
+  EQ(used, reply.size());
+  EQ(body, expected);
+}
+
+void testUntilClose() {
+  const std::string reply = "HTTP/1.0 200 OK\r\n\r\nall of it";
+  HTTPParser parser;
+  HTTPResponse response;
+  EQ(parse(parser, response, reply, 4), "all of it");
+  EQ(parser.isKeepAlive(), false);
+  EQ(parser.done(), false);
+  parser.finish();
+  EQ(parser.done(), true);
+  // Closing early is an error for anything else
+  parse(parser, response, "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nab", 4);
+  bool threw = false;
+  try {
+    parser.finish();
+  } catch (std::runtime_error &) {
+    threw = true;
+  }
+  EQ(threw, true);
+}
+
+void testNoBody() {
+  // Interim responses are skipped, and 204s have no body
+  const std::string reply = "HTTP/1.1 100 Continue\r\n\r\n"
+                            "HTTP/1.1 204 No Content\r\n"
+                            "Content-Length: 10\r\n"
+                            "\r\n";
+  HTTPParser parser;
+  HTTPResponse response;
+  EQ(parse(parser, response, reply, 3), "");
+  EQ(parser.done(), true);
+  EQ(response.code, 204);
+}
+
+void testStatusClass() {
+  // Success is any 2xx, whatever the reason phrase says
+  for (auto status : {std::make_pair("200 OK", true),
+                      std::make_pair("201 Created", true),
+                      std::make_pair("200 Fine", true),
+                      std::make_pair("299", true),
+                      std::make_pair("302 OK", false),
+                      std::make_pair("404 Not Found", false)}) {
+    HTTPParser parser;
+    HTTPResponse response;
+    parse(parser, response,
+          std::string("HTTP/1.1 ") + status.first +
+              "\r\nContent-Length: 0\r\n\r\n",
+          100);
+    EQ(parser.isOK(), status.second);
+  }
+}
+
+void testBadInput() {
+  for (std::string reply : {"HTTP/1.1 2000 OK\r\n\r\n", "FTP 200 OK\r\n\r\n",
+                            "HTTP/1.1 200 OK\r\nNo colon\r\n\r\n",
+                            "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked"
+                            "\r\n\r\nzz\r\n",
+                            "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked"
+                            "\r\n\r\n5x\r\nhello\r\n",
+                            "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked"
+                            "\r\n\r\n5\r\nhelloXX0\r\n\r\n",
+                            "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked"
+                            "\r\n\r\n11111111111111111\r\n",
+                            // Would wrap round to 3
+                            "HTTP/1.1 200 OK\r\nContent-Length: "
+                            "18446744073709551619\r\n\r\nabc",
+                            "HTTP/1.1 200 OK\r\nContent-Length: \r\n\r\n"}) {
+    bool threw = false;
+    try {
+      HTTPParser parser;
+      HTTPResponse response;
+      parse(parser, response, reply, reply.size());
+    } catch (std::runtime_error &) {
+      threw = true;
+    }
+    EQ(threw, true);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int failures = 0;
+  auto check = [&failures](const char *name, void (*test)()) {
+    try {
+      test();
+    } catch (std::exception &e) {
+      std::cerr << name << " FAILED: " << e.what() << std::endl;
+      ++failures;
+    }
+  };
+  check("content length", testContentLength);
+  check("chunked", testChunked);
+  check("chunk extensions", testChunkExtensions);
+  check("many chunks", testManyChunks);
+  check("until close", testUntilClose);
+  check("no body", testNoBody);
+  check("status class", testStatusClass);
+  check("bad input", testBadInput);
+  return failures;
+}
@@ -0,0 +1,111 @@
+/// Checks the SIMD scans find the same as the scalar ones, wherever the bytes
+/// are: in the first or last lane, across lanes, or in the scalar tail
+#include <RESTClient/http/Scan.hpp>
+
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace RESTClient;
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+/// Where 'found' is in 'text', for messages that make sense
+long at(const std::string &text, const char *found) {
+  return found - text.data();
+}
+
+void testFindByte() {
+  // Every position and length, so every lane and the tail are covered
+  for (size_t size = 0; size != 100; ++size) {
+    std::string text(size, 'x');
+    const char *end = text.data() + size;
+    EQ(at(text, findByte(text.data(), end, '\n')), long(size));
+    for (size_t i = 0; i != size; ++i) {
+      text[i] = '\n';
+      EQ(at(text, findByte(text.data(), end, '\n')), long(i));
+      // Starting past it
+      EQ(at(text, findByte(text.data() + i + 1, end, '\n')), long(size));
+      text[i] = 'x';
+    }
+  }
+  // Bytes with the top bit set aren't mistaken for anything
+  std::string high(64, '\x8a');
+  EQ(at(high, findByte(high.data(), high.data() + 64, '\n')), 64);
+}
+
+void testFindEither() {
+  std::string line = "Content-Type: text/plain; charset=utf-8\r\n";
+  const char *end = line.data() + line.size();
+  EQ(at(line, findEither(line.data(), end, ':', '\n')), 12);
+  EQ(at(line, findEither(line.data() + 13, end, ':', '\n')),
+     long(line.size() - 1));
+  for (size_t size = 1; size != 80; ++size) {
+    std::string text(size, 'a');
+    text[size - 1] = '\n';
+    if (size > 2)
+      text[size / 2] = ':';
+    size_t expected = (size > 2) ? size / 2 : size - 1;
+    EQ(at(text, findEither(text.data(), text.data() + size, ':', '\n')),
+       long(expected));
+  }
+}
+
+void testFindHeadEnd() {
+  std::string head = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+  const char *end = head.data() + head.size();
+  EQ(at(head, findHeadEnd(head.data(), end)), long(head.size() - 6));
+  // Ending right at the end of what's there
+  EQ(at(head, findHeadEnd(head.data(), end - 5)), long(head.size() - 6));
+  // Bare line feeds
+  std::string bare = "HTTP/1.0 200 OK\nA: b\n\nbody";
+  EQ(at(bare, findHeadEnd(bare.data(), bare.data() + bare.size())),
+     long(bare.size() - 5));
+  // Not there yet
+  std::string partial = "HTTP/1.1 200 OK\r\nA: b\r\n\r";
+  EQ(at(partial, findHeadEnd(partial.data(), partial.data() + partial.size())),
+     long(partial.size()));
+  // Random heads, checked against the scalar version, with the blank line
+  // landing at every offset
+  std::mt19937 random(42);
+  const char alphabet[] = "ab:\r\n";
+  for (int round = 0; round != 2000; ++round) {
+    std::string text(random() % 200, 'x');
+    for (char &c : text)
+      c = alphabet[random() % 5];
+    const char *begin = text.data();
+    const char *stop = begin + text.size();
+    EQ(at(text, findHeadEnd(begin, stop)),
+       at(text, scalar::findHeadEnd(begin, stop)));
+    EQ(at(text, findEither(begin, stop, ':', '\n')),
+       at(text, scalar::findEither(begin, stop, ':', '\n')));
+    EQ(at(text, findByte(begin, stop, '\r')),
+       at(text, scalar::findByte(begin, stop, '\r')));
+  }
+}
+
+int main(int argc, char *argv[]) {
+  std::cout << "Scanning with " << scanInstructions() << std::endl;
+  int failures = 0;
+  auto check = [&failures](const char *name, void (*test)()) {
+    try {
+      test();
+    } catch (std::exception &e) {
+      std::cerr << name << " FAILED: " << e.what() << std::endl;
+      ++failures;
+    }
+  };
+  check("findByte", testFindByte);
+  check("findEither", testFindEither);
+  check("findHeadEnd", testFindHeadEnd);
+  return failures;
+}
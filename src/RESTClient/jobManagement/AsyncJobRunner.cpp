@@ -0,0 +1,65 @@
+#include "AsyncJobRunner.hpp"
+
+#if (BOOST_VERSION >= 107000) && defined(BOOST_ASIO_HAS_CO_AWAIT)
+
+#include <algorithm>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+
+#include <RESTClient/base/logger.hpp>
+
+namespace RESTClient {
+
+void AsyncJobRunner::queue(AsyncJob job) {
+  HostInfo hostInfo = job.hostInfo;
+  auto found = hosts.try_emplace(std::move(hostInfo)).first;
+  found->second.jobs.emplace_back(std::move(job));
+  // Queued from inside a job; the host's workers may be gone, or never were
+  if (connectionsPerHost)
+    spawnWorkers(found->first, found->second);
+}
+
+void AsyncJobRunner::spawnWorkers(const HostInfo &hostInfo, HostState &host) {
+  while ((host.workers < connectionsPerHost) &&
+         (host.workers < host.jobs.size())) {
+    ++host.workers;
+    asio::co_spawn(services.io_service, worker(hostInfo, host),
+                   asio::detached);
+  }
+}
+
+asio::awaitable<void> AsyncJobRunner::worker(const HostInfo &hostInfo,
+                                             HostState &host) {
+  AsyncHTTP conn(hostInfo);
+  std::deque<AsyncJob> &jobs = host.jobs;
+  while (!jobs.empty()) {
+    AsyncJob job = std::move(jobs.front());
+    jobs.pop_front();
+    try {
+      LOG_DEBUG("AsyncJobRunner - Starting Job: " << hostInfo << " - "
+                                                  << job.name);
+      co_await job.work(job.name, hostInfo, conn);
+    } catch (std::exception &e) {
+      LOG_WARN("AsyncJobRunner - Job (" << job.name << ") - host (" << hostInfo
+                                        << ") threw exception: " << e.what());
+    }
+  }
+  // Before we hang up, so a job queued meanwhile gets a new worker
+  --host.workers;
+  co_await conn.close();
+}
+
+void AsyncJobRunner::run(size_t connectionsPerHost) {
+  this->connectionsPerHost = std::max<size_t>(connectionsPerHost, 1);
+  for (auto &both : hosts)
+    spawnWorkers(both.first, both.second);
+  auto &io = services.io_service;
+  io.reset();
+  io.run();
+  this->connectionsPerHost = 0;
+}
+
+} /* RESTClient */
+
+#endif
@@ -0,0 +1,55 @@
+/// Runs co_await jobs, a few connections per host, in a single thread. Build
+/// with the CO_AWAIT option; otherwise this header is empty.
+#pragma once
+
+#include <RESTClient/http/AsyncHTTP.hpp>
+
+#if (BOOST_VERSION >= 107000) && defined(BOOST_ASIO_HAS_CO_AWAIT)
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+
+namespace RESTClient {
+
+using AsyncJobFunction = std::function<asio::awaitable<bool>(
+    const std::string &name, const HostInfo &hostInfo, AsyncHTTP &server)>;
+
+struct AsyncJob {
+  std::string name;
+  HostInfo hostInfo;
+  AsyncJobFunction work;
+};
+
+/// Like JobRunner::run(), but each worker is a stackless coroutine with an
+/// AsyncHTTP connection. Jobs run in the order they were queued; priorities,
+/// deadlines and rate limits are still JobRunner's
+class AsyncJobRunner {
+private:
+  Services &services = Services::instance();
+  struct HostState {
+    std::deque<AsyncJob> jobs;
+    /// Workers running for the host
+    size_t workers = 0;
+  };
+  using Hosts = std::map<HostInfo, HostState>;
+  Hosts hosts;
+  /// Set by run(); 0 until then
+  size_t connectionsPerHost = 0;
+  asio::awaitable<void> worker(const HostInfo &hostInfo, HostState &host);
+  /// Starts workers for 'host' until it has one per job, or as many as it
+  /// may have
+  void spawnWorkers(const HostInfo &hostInfo, HostState &host);
+
+public:
+  /// Not thread safe; queue jobs before run(), or from inside a running job.
+  /// A job queued while running gets a worker if its host has none left
+  void queue(AsyncJob job);
+  /// Runs all the queued jobs, returning when there are none left
+  void run(size_t connectionsPerHost = 4);
+};
+
+} /* RESTClient */
+
+#endif
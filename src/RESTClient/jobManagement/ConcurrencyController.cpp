@@ -0,0 +1,78 @@
+#include "ConcurrencyController.hpp"
+
+#include <RESTClient/base/logger.hpp>
+
+#include <algorithm>
+
+namespace RESTClient {
+
+ConcurrencyController::ConcurrencyController(ConcurrencyLimits limits,
+                                             Clock::time_point now)
+    : limits(limits), current(std::max(limits.min, std::min(limits.max,
+                                                            limits.initial))),
+      windowStart(now) {}
+
+void ConcurrencyController::started() {
+  ++inFlight;
+  peakInFlight = std::max(peakInFlight, inFlight);
+}
+
+void ConcurrencyController::completed(Clock::duration latency,
+                                      bool wasThrottled, bool failed,
+                                      Clock::time_point now) {
+  if (inFlight > 0)
+    --inFlight;
+  ++completions;
+  if (wasThrottled)
+    ++throttled;
+  if (failed)
+    ++failures;
+  totalLatency += std::chrono::duration<double>(latency).count();
+  if (now - windowStart >= limits.window)
+    endWindow(now);
+}
+
+void ConcurrencyController::endWindow(Clock::time_point now) {
+  double elapsed = std::chrono::duration<double>(now - windowStart).count();
+  double throughput = completions / elapsed;
+  double latency = totalLatency / completions;
+  double before = current;
+
+  if ((throttled > 0) || (failures > 0)) {
+    // Multiplicative decrease; the server is telling us to slow down
+    current *= limits.backoff;
+  } else if ((bestLatency > 0) &&
+             (latency > bestLatency * limits.latencyTolerance)) {
+    // Queueing somewhere; shrink in proportion to how much latency grew
+    current *= bestLatency / latency;
+  } else if ((peakInFlight >= limit()) &&
+             (throughput >= lastThroughput * 0.95)) {
+    // Additive increase; we were using everything and it's still paying off
+    current += 1;
+  }
+  current = std::max<double>(limits.min, std::min<double>(limits.max, current));
+
+  // Remember the best latency, but forget it slowly
+  if ((bestLatency == 0) || (latency < bestLatency))
+    bestLatency = latency;
+  else
+    bestLatency += (latency - bestLatency) * 0.05;
+  lastThroughput = throughput;
+
+  if (static_cast<size_t>(before) != limit())
+    LOG_DEBUG("ConcurrencyController: " << static_cast<size_t>(before)
+                                        << " -> " << limit()
+                                        << " throughput: " << throughput
+                                        << "/s latency: " << latency
+                                        << "s throttled: " << throttled
+                                        << " failures: " << failures);
+
+  windowStart = now;
+  completions = 0;
+  throttled = 0;
+  failures = 0;
+  totalLatency = 0;
+  peakInFlight = inFlight;
+}
+
+} /* RESTClient */
@@ -0,0 +1,65 @@
+/// Works out how many connections we should have open to a host
+#pragma once
+
+#include <cstddef>
+
+#include <RESTClient/base/clock.hpp>
+
+namespace RESTClient {
+
+/// Bounds and tuning for the adaptive per host concurrency
+struct ConcurrencyLimits {
+  size_t min = 1;
+  size_t max = 32;
+  /// Where we start
+  size_t initial = 4;
+  /// How often we re-think the limit
+  Clock::duration window = std::chrono::milliseconds(500);
+  /// Latency may grow this much over the best we've seen before we back off
+  double latencyTolerance = 1.5;
+  /// What we multiply the limit by when the server pushes back (429/503 or
+  /// errors)
+  double backoff = 0.5;
+};
+
+/// AIMD concurrency control with a latency gradient.
+///
+/// Every window we look at the completed jobs:
+///  * If any were throttled (429/503) or failed, we multiply the limit by
+///    'backoff'
+///  * If latency grew past 'latencyTolerance' times the best we've seen, we
+///    shrink the limit in proportion (best latency / current latency)
+///  * Otherwise, if we were using all our connections and throughput didn't
+///    drop, we add one more
+class ConcurrencyController {
+private:
+  ConcurrencyLimits limits;
+  double current;
+  // The best average latency we've seen (seconds); slowly forgotten so we can
+  // adapt to a server that's got slower for good
+  double bestLatency = 0;
+  double lastThroughput = 0;
+  // This window's samples
+  Clock::time_point windowStart;
+  size_t completions = 0;
+  size_t throttled = 0;
+  size_t failures = 0;
+  double totalLatency = 0;
+  size_t inFlight = 0;
+  size_t peakInFlight = 0;
+  void endWindow(Clock::time_point now);
+
+public:
+  ConcurrencyController(ConcurrencyLimits limits = {},
+                        Clock::time_point now = Clock::now());
+  const ConcurrencyLimits &getLimits() const { return limits; }
+  /// The number of connections we should have open right now
+  size_t limit() const { return static_cast<size_t>(current); }
+  /// Call when a job starts
+  void started();
+  /// Call when a job ends. 'wasThrottled' means the server said 429 or 503
+  void completed(Clock::duration latency, bool wasThrottled, bool failed,
+                 Clock::time_point now = Clock::now());
+};
+
+} /* RESTClient */
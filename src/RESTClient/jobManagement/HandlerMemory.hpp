@@ -0,0 +1,104 @@
+/// Recycled memory for asio completion handlers.
+///
+/// asio allocates each operation's handler, and only recycles that memory for
+/// handlers started from the io_service's own thread. A handler posted from
+/// another thread, like JobRunner::submit's, goes to the heap every time.
+/// Wrapping it with withMemory() makes it use a block kept for it instead.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <boost/version.hpp>
+
+namespace RESTClient {
+
+/// One block for one handler at a time. If it's busy, or too small, handlers
+/// fall back to the heap. Safe to use from any thread
+class HandlerMemory {
+private:
+  typename std::aligned_storage<256, alignof(std::max_align_t)>::type storage;
+  std::atomic<bool> inUse{false};
+
+public:
+  HandlerMemory() = default;
+  HandlerMemory(const HandlerMemory &) = delete;
+  void *allocate(size_t size) {
+    if ((size <= sizeof(storage)) &&
+        !inUse.exchange(true, std::memory_order_acquire))
+      return &storage;
+    return ::operator new(size);
+  }
+  void deallocate(void *p) {
+    if (p == &storage)
+      inUse.store(false, std::memory_order_release);
+    else
+      ::operator delete(p);
+  }
+};
+
+/// The standard allocator interface to a HandlerMemory, which is how newer
+/// asio finds a handler's memory
+template <typename T> class HandlerAllocator {
+public:
+  using value_type = T;
+  HandlerMemory *memory;
+  explicit HandlerAllocator(HandlerMemory &memory) noexcept
+      : memory(&memory) {}
+  template <typename U>
+  HandlerAllocator(const HandlerAllocator<U> &other) noexcept
+      : memory(other.memory) {}
+  T *allocate(size_t n) {
+    return static_cast<T *>(memory->allocate(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t) noexcept { memory->deallocate(p); }
+};
+
+template <typename T, typename U>
+bool operator==(const HandlerAllocator<T> &a, const HandlerAllocator<U> &b) {
+  return a.memory == b.memory;
+}
+
+template <typename T, typename U>
+bool operator!=(const HandlerAllocator<T> &a, const HandlerAllocator<U> &b) {
+  return a.memory != b.memory;
+}
+
+/// A handler that asio allocates from a HandlerMemory
+template <typename Handler> class HandlerWithMemory {
+private:
+  HandlerMemory &memory;
+  Handler handler;
+
+public:
+  using allocator_type = HandlerAllocator<void>;
+  HandlerWithMemory(HandlerMemory &memory, Handler handler)
+      : memory(memory), handler(std::move(handler)) {}
+  allocator_type get_allocator() const noexcept {
+    return allocator_type(memory);
+  }
+  template <typename... Args> void operator()(Args &&... args) {
+    handler(std::forward<Args>(args)...);
+  }
+#if BOOST_VERSION < 106600
+  // Older asio only has the allocation hooks
+  friend void *asio_handler_allocate(size_t size, HandlerWithMemory *self) {
+    return self->memory.allocate(size);
+  }
+  friend void asio_handler_deallocate(void *p, size_t,
+                                      HandlerWithMemory *self) {
+    self->memory.deallocate(p);
+  }
+#endif
+};
+
+template <typename Handler>
+HandlerWithMemory<typename std::decay<Handler>::type>
+withMemory(HandlerMemory &memory, Handler &&handler) {
+  return {memory, std::forward<Handler>(handler)};
+}
+
+} /* RESTClient */
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <RESTClient/base/clock.hpp>
 #include <RESTClient/base/url.hpp>
 #include <RESTClient/http/HTTP.hpp>
 
+#include <boost/optional.hpp>
+
 #include <cassert>
 
 namespace RESTClient {
@@ -10,13 +13,32 @@ namespace RESTClient {
 using JobFunction = std::function<
     bool(const std::string &name, const HostInfo &hostname, HTTP &server)>;
 
+/// Jobs with a higher priority are always started before lower ones
+enum class Priority { low, normal, high };
+
+struct QueuedJob;
+
+/// Called instead of the job, when the job missed its deadline
+using ExpiredFunction = std::function<void(const QueuedJob &job)>;
+
 struct QueuedJob {
   std::string name;
   HostInfo hostInfo;
   JobFunction work;
+  Priority priority = Priority::normal;
+  /// If the job hasn't started by this time, it is dropped
+  boost::optional<Clock::time_point> deadline;
+  /// Optional; told about the job if it's dropped for missing its deadline
+  ExpiredFunction expired;
+  /// Set by JobRunner::submit, or by the JobQueue when the job is pushed if
+  /// it wasn't submitted
+  Clock::time_point queuedAt;
   bool operator()(HTTP &server) const {
     return work(name, hostInfo, server);
   }
+  bool pastDeadline(Clock::time_point now = Clock::now()) const {
+    return deadline && (*deadline < now);
+  }
 };
 
 } /* RESTClient */
@@ -0,0 +1,66 @@
+/// A priority queue of jobs for a single host
+#pragma once
+
+#include <RESTClient/jobManagement/Job.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace RESTClient {
+
+/// Orders jobs by priority class, then earliest deadline first (jobs without a
+/// deadline go last), then first in first out.
+/// It's a binary heap, so pushing and popping are O(log n)
+class JobQueue {
+private:
+  struct Entry {
+    size_t sequence;
+    QueuedJob job;
+  };
+  /// Returns true if 'a' should run after 'b'
+  struct RunsLater {
+    bool operator()(const Entry &a, const Entry &b) const {
+      if (a.job.priority != b.job.priority)
+        return a.job.priority < b.job.priority;
+      if (a.job.deadline != b.job.deadline) {
+        if (!a.job.deadline)
+          return true;
+        if (!b.job.deadline)
+          return false;
+        return *b.job.deadline < *a.job.deadline;
+      }
+      return a.sequence > b.sequence;
+    }
+  };
+  std::vector<Entry> heap;
+  size_t nextSequence = 0;
+
+public:
+  void push(QueuedJob job) {
+    // Jobs that were submit()ted have been waiting since then
+    if (job.queuedAt == Clock::time_point())
+      job.queuedAt = Clock::now();
+    heap.push_back(Entry{nextSequence++, std::move(job)});
+    std::push_heap(heap.begin(), heap.end(), RunsLater());
+  }
+  template <typename... Args> void emplace(Args &&... args) {
+    push(QueuedJob{std::forward<Args>(args)...});
+  }
+  /// The job that'll run next
+  const QueuedJob &top() const {
+    assert(!heap.empty());
+    return heap.front().job;
+  }
+  /// Removes and returns the job that should run next
+  QueuedJob pop() {
+    assert(!heap.empty());
+    std::pop_heap(heap.begin(), heap.end(), RunsLater());
+    QueuedJob result = std::move(heap.back().job);
+    heap.pop_back();
+    return result;
+  }
+  size_t size() const { return heap.size(); }
+  bool empty() const { return heap.empty(); }
+};
+
+} /* RESTClient */
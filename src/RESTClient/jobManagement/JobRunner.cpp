@@ -1,39 +1,135 @@
 #include "JobRunner.hpp"
 
+#include <RESTClient/http/HTTP2.hpp>
 #include <RESTClient/http/Services.hpp>
 
 namespace RESTClient {
 
 int queueWorkerId = 0;
 
+JobRunner::Hosts::value_type &JobRunner::host(const HostInfo &hostInfo) {
+  auto found = hosts.find(hostInfo);
+  if (found == hosts.end()) {
+    found = hosts.emplace(hostInfo, HostState()).first;
+    if (adaptive)
+      found->second.concurrency.emplace(*adaptive);
+  }
+  return *found;
+}
+
+size_t JobRunner::workerLimit(const HostState &host) const {
+  size_t result = host.limiter.getLimits().maxConnections;
+  if (host.concurrency) {
+    size_t adapted = host.concurrency->limit();
+    if ((result == 0) || (adapted < result))
+      result = adapted;
+  }
+  if (result == 0)
+    result = connectionsPerHost;
+  return result;
+}
+
 /// Spawns a single worker for a queue (not a thread, but a co-routine)
 /// Returns immediately but when
 /// RESTClient::Services::instance().io_service.run() is run, the spawned jobs
 /// will run
-void queueWorker(const HostInfo &host_info, std::queue<QueuedJob> &jobs) {
+void JobRunner::spawnWorker(const HostInfo &host_info, HostState &host) {
   int myId = queueWorkerId++;
   std::string conn_info = host_info;
   LOG_TRACE("queueWorker spawning: (" << myId << ") " << conn_info << " - "
-                                      << jobs.size());
-  asio::spawn(Services::instance().io_service,
-              [ conn_info = std::move(conn_info), myId, &jobs, &host_info ](
-                  asio::yield_context yield) {
+                                      << host.jobs.size());
+  ++host.workers;
+  if (http2 && host_info.is_ssl() && !host.session)
+    host.session = std::make_shared<HTTP2Session>(host_info);
+  spawnPooled(services.io_service, stacks,
+              [ this, conn_info = std::move(conn_info), myId, &host,
+                &host_info ](asio::yield_context yield) {
+    JobQueue &jobs = host.jobs;
+    RateLimiter &limiter = host.limiter;
     LOG_TRACE("queueWorker running: (" << myId << ") " << conn_info << " - "
                                        << jobs.size());
     if (jobs.size() == 0) {
       LOG_TRACE("queueWorker NO JOBS - exiting: (" << myId << ") " << conn_info
                                                    << " - " << jobs.size());
+      --host.workers;
       return;
     }
     // Extract the login info
     HTTP conn(host_info, yield);
-    while (jobs.size() > 0) {
-      QueuedJob job = std::move(jobs.front());
-      jobs.pop();
+    if (host.session)
+      conn.useHTTP2(host.session);
+    TRACE_SPAN("queueWorker", conn.traceId());
+    HostMetrics &metrics =
+        Metrics::instance().local(Metrics::hostLabel(host_info));
+    bool throttled = false;
+    conn.observeResponses([&limiter, &throttled](const HTTPResponse &response) {
+      limiter.observe(response);
+      if ((response.code == 429) || (response.code == 503))
+        throttled = true;
+    });
+    // Each request, not each job, waits its turn, without holding up the
+    // other hosts' workers
+    conn.paceRequests([&limiter, myId, &conn_info]() {
+      auto wait = limiter.acquire();
+      if (wait > Clock::duration::zero())
+        LOG_DEBUG("queueWorker: (" << myId << ") - Rate limited for "
+                                   << std::chrono::duration_cast<
+                                          std::chrono::milliseconds>(wait)
+                                          .count()
+                                   << " ms: " << conn_info);
+      return wait;
+    });
+    asio::steady_timer timer(services.io_service);
+    /// Drops the job if it missed its deadline. Returns true if it did
+    auto dropIfExpired = [&](const QueuedJob &job) {
+      if (!job.pastDeadline())
+        return false;
+      LOG_WARN("queueWorker: (" << myId << ") - Job (" << job.name
+                                << ") - host (" << conn_info
+                                << ") missed its deadline. Dropping it");
+      if (job.expired)
+        job.expired(job);
+      return true;
+    };
+    /// Waits for dispatch() to hand us a job. Returns false if we timed out
+    auto waitForWork = [&]() {
+      LOG_TRACE("queueWorker: (" << myId << ") - Idle: " << conn_info);
+      host.idle.push_back(&timer);
+      timer.expires_from_now(idleTimeout);
+      boost::system::error_code ec;
+      timer.async_wait(yield[ec]);
+      if (ec == asio::error::operation_aborted)
+        // dispatch() or stop() woke us and took us off the idle list
+        return true;
+      host.idle.remove(&timer);
+      return false;
+    };
+    while (true) {
+      if (jobs.size() == 0) {
+        if (!persistent || stopping)
+          break;
+        // If we timed out, but a job snuck in just as we did, run it anyway
+        if (!waitForWork() && (jobs.size() == 0))
+          break;
+        continue;
+      }
+      QueuedJob job = jobs.pop();
+      if (dropIfExpired(job))
+        continue;
+      size_t bytesBefore = conn.bytesSent() + conn.bytesReceived();
+      bool failed = false;
+      throttled = false;
+      auto jobStart = Clock::now();
+      if (host.concurrency)
+        host.concurrency->started();
+      conn.setQueueWait(jobStart - job.queuedAt);
+      metrics.poolWait.record(HostMetrics::nanoseconds(jobStart - job.queuedAt));
       try {
+        TRACE_SPAN("job", conn.traceId());
         LOG_DEBUG("queueWorker: (" << myId << ") - Starting Job: " << conn_info
                                    << " - " << job.name);
-        job(conn);
+        // A job may say it failed without throwing
+        failed = !job(conn);
         LOG_DEBUG("queueWorker: (" << myId << ") - Job Completed: " << conn_info
                                    << " connections still open? "
                                    << conn.is_open() << " - " << job.name);
@@ -42,54 +138,185 @@ void queueWorker(const HostInfo &host_info, std::queue<QueuedJob> &jobs) {
                                   << ") - host (" << conn_info
                                   << ") threw exception: "
                                   << "': " << e.what());
+        failed = true;
       } catch (...) {
         LOG_WARN("queueWorker: ("
                  << myId << ") - Unknown exception caught while running job '"
                  << job.name);
+        failed = true;
+      }
+      limiter.consumed(conn.bytesSent() + conn.bytesReceived() - bytesBefore);
+      if (host.concurrency) {
+        host.concurrency->completed(Clock::now() - jobStart, throttled,
+                                    failed);
+        // Too many of us; hang up
+        if (host.workers > workerLimit(host)) {
+          LOG_DEBUG("queueWorker: (" << myId << ") - Concurrency limit dropped "
+                                     << "to " << workerLimit(host)
+                                     << ". Retiring: " << conn_info);
+          break;
+        }
+        // Room for more of us
+        while ((host.workers < workerLimit(host)) &&
+               (host.workers < jobs.size()))
+          spawnWorker(host_info, host);
       }
     }
     // Hang up
+    --host.workers;
     LOG_TRACE("queueWorker: (" << myId
                                << ") - Closing connection: " << conn_info);
     conn.close();
+    // The last one out hangs up the shared connection
+    if (host.session && (host.workers == 0))
+      host.session->close(yield);
   });
 }
 
+JobRunner::~JobRunner() {
+  if (thread.joinable())
+    stop();
+}
+
 JobRunner::JobQueue &JobRunner::queue(const HostInfo &hostInfo) {
-  return queues[hostInfo];
+  return host(hostInfo).second.jobs;
+}
+
+void JobRunner::limit(const HostInfo &hostInfo, RateLimit limits) {
+  host(hostInfo).second.limiter = RateLimiter(limits);
+}
+
+void JobRunner::adapt(const HostInfo &hostInfo, ConcurrencyLimits limits) {
+  host(hostInfo).second.concurrency.emplace(limits);
+}
+
+void JobRunner::dispatch(QueuedJob job) {
+  auto &found = host(job.hostInfo);
+  HostState &host = found.second;
+  host.jobs.push(std::move(job));
+  if (!host.idle.empty()) {
+    // Wake an idle worker; its connection is probably still open
+    asio::steady_timer *timer = host.idle.front();
+    host.idle.pop_front();
+    timer->cancel();
+  } else if (host.workers < workerLimit(host)) {
+    spawnWorker(found.first, host);
+  }
+}
+
+void JobRunner::drainSubmissions() {
+  // Let the next submit() post another drain. Anything pushed before this
+  // line will be seen by the loop below
+  drainPosted.store(false, std::memory_order_release);
+  while (auto job = submissions.pop())
+    dispatch(std::move(*job));
+}
+
+std::future<bool> JobRunner::submit(QueuedJob job) {
+  auto promise = std::make_shared<std::promise<bool>>();
+  std::future<bool> result = promise->get_future();
+  // Report the job's outcome through the promise
+  JobFunction work = std::move(job.work);
+  job.work = [promise, work](const std::string &name, const HostInfo &hostInfo,
+                             HTTP &server) {
+    try {
+      bool ok = work(name, hostInfo, server);
+      promise->set_value(ok);
+      return ok;
+    } catch (...) {
+      promise->set_exception(std::current_exception());
+      throw;
+    }
+  };
+  ExpiredFunction expired = std::move(job.expired);
+  job.expired = [promise, expired](const QueuedJob &dropped) {
+    if (expired)
+      expired(dropped);
+    promise->set_exception(std::make_exception_ptr(JobExpired(dropped.name)));
+  };
+  // Its wait starts now, not when the io_service thread gets to it
+  job.queuedAt = Clock::now();
+  submissions.push(std::move(job));
+  // Have the io_service thread sort it into its host's queue
+  if (!drainPosted.exchange(true, std::memory_order_acq_rel))
+    services.io_service.post(
+        withMemory(drainMemory, [this]() { drainSubmissions(); }));
+  return result;
+}
+
+void JobRunner::start(size_t connectionsPerHost) {
+  assert(!thread.joinable());
+  this->connectionsPerHost = connectionsPerHost;
+  persistent = true;
+  stopping = false;
+  auto &io = services.io_service;
+  io.reset();
+  keepRunning.reset(new asio::io_service::work(io));
+  thread = std::thread([this, &io]() {
+    LOG_TRACE("JobRunner::start - io_service thread running");
+    io.run();
+    LOG_TRACE("JobRunner::start - io_service thread done");
+  });
+  // Start on anything that was queued before we started
+  io.post([this]() {
+    for (auto &both : hosts) {
+      HostState &host = both.second;
+      while ((host.workers < workerLimit(host)) &&
+             (host.workers < host.jobs.size()))
+        spawnWorker(both.first, host);
+    }
+  });
+}
+
+void JobRunner::stop() {
+  if (!thread.joinable())
+    return;
+  services.io_service.post([this]() {
+    drainSubmissions();
+    stopping = true;
+    // Wake all the idle workers so they can hang up
+    for (auto &both : hosts) {
+      for (auto timer : both.second.idle)
+        timer->cancel();
+      both.second.idle.clear();
+    }
+  });
+  // Once the workers have finished their jobs and closed their connections,
+  // io_service::run will return
+  keepRunning.reset();
+  thread.join();
+  persistent = false;
 }
 
 void JobRunner::run(size_t connectionsPerHost) {
-  while (queues.size() > 0) {
-    LOG_TRACE("jobRunner::run - spawning workers: " << queues.size());
+  assert(!thread.joinable());
+  this->connectionsPerHost = connectionsPerHost;
+  auto hasJobs = [this]() {
+    for (auto &both : hosts)
+      if (both.second.jobs.size() > 0)
+        return true;
+    return false;
+  };
+  // Always go round at least once, in case everything came in through submit()
+  do {
+    LOG_TRACE("jobRunner::run - spawning workers: " << hosts.size());
     // For each hostname and job queue
-    for (auto &both : queues) {
+    for (auto &both : hosts) {
+      HostState &host = both.second;
       // Spawn workers
-      for (size_t i = 0; i < std::min(connectionsPerHost, both.second.size());
-           ++i) {
+      while ((host.workers < workerLimit(host)) &&
+             (host.workers < host.jobs.size())) {
         // Spawn a worker
-        queueWorker(both.first, both.second);
+        spawnWorker(both.first, host);
       }
     }
-    // Run everything that needs running
+    // Run everything that needs running. Jobs submit()ed while we run start
+    // straight away
     LOG_TRACE("jobRunner::run - Running queued jobs");
-    auto& io = RESTClient::Services::instance().io_service;
+    auto& io = services.io_service;
     io.reset();
     io.run();
-    LOG_TRACE("jobRunner::run - removing empty queues: " << queues.size());
-    // Delete empty queues
-    auto it = queues.begin();
-    while (it != queues.end()) {
-      if (it->second.size() == 0) {
-        LOG_TRACE("JobRunner::run - Removing queue " << it->first);
-        it = queues.erase(it);
-      } else { 
-        LOG_TRACE("JobRunner::run - NOT Removing queue " << it->first);
-        ++it;
-      }
-    }
-    LOG_TRACE("jobRunner::run - empty queues removed: " << queues.size());
-  }
+  } while (hasJobs());
 }
 
 } /* RESTClient */
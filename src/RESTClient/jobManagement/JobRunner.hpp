@@ -1,30 +1,120 @@
 /// Keeps X amount of jobs running in a single thread using the boost asio job runner
 #pragma once
 
+#include <atomic>
+#include <future>
+#include <list>
 #include <map>
-#include <queue>
+#include <memory>
 #include <string>
+#include <thread>
+
+#include <boost/asio/steady_timer.hpp>
 
 #include <RESTClient/base/logger.hpp>
 #include <RESTClient/base/url.hpp>
+#include <RESTClient/jobManagement/ConcurrencyController.hpp>
+#include <RESTClient/jobManagement/HandlerMemory.hpp>
 #include <RESTClient/jobManagement/Job.hpp>
+#include <RESTClient/jobManagement/JobQueue.hpp>
+#include <RESTClient/jobManagement/MPSCQueue.hpp>
+#include <RESTClient/jobManagement/RateLimiter.hpp>
+#include <RESTClient/jobManagement/StackPool.hpp>
 #include <RESTClient/http/Services.hpp>
 
 namespace RESTClient {
 
 using namespace boost;
 
+/// Thrown through the future of a submitted job that missed its deadline
+class JobExpired : public std::runtime_error {
+public:
+  JobExpired(const std::string &name)
+      : std::runtime_error("Job missed its deadline: " + name) {}
+};
+
 /// Runs all the jobs for a certain hostname
+///
+/// There are two ways to use it:
+///  * Fill up the queues, then call run(); it returns when they're empty
+///  * Call start(), then submit() jobs from any thread; stop() when done
 class JobRunner {
 public:
-  using JobQueue = std::queue<QueuedJob>;
+  using JobQueue = RESTClient::JobQueue;
 private:
+  /// Everything we know about one host
+  struct HostState {
+    JobQueue jobs;
+    // The traffic shaper shared by all the host's workers
+    RateLimiter limiter;
+    // If set, decides how many workers the host should have
+    boost::optional<ConcurrencyController> concurrency;
+    size_t workers = 0;
+    // Timers of workers waiting for a job. Cancelling one wakes its worker
+    std::list<asio::steady_timer *> idle;
+    // The connection all the workers share, when 'http2' is on
+    std::shared_ptr<HTTP2Session> session;
+  };
   Services& services = Services::instance();
-  // Map of hostname to job queue
-  std::map<HostInfo, JobQueue> queues;
+  // Map of hostname to job queue and workers
+  using Hosts = std::map<HostInfo, HostState>;
+  Hosts hosts;
+  size_t connectionsPerHost = 4;
+  // Jobs submitted from any thread, waiting to be sorted into 'hosts'
+  MPSCQueue<QueuedJob> submissions;
+  // True when a drainSubmissions is already posted to the io_service
+  std::atomic<bool> drainPosted{false};
+  // Holds the posted drainSubmissions handler, as submit() is usually called
+  // from outside the io_service thread, where asio wouldn't recycle it
+  HandlerMemory drainMemory;
+  // When true, idle workers wait for more jobs instead of exiting
+  bool persistent = false;
+  bool stopping = false;
+  std::unique_ptr<asio::io_service::work> keepRunning;
+  std::thread thread;
+  /// Finds or creates a host's state
+  Hosts::value_type &host(const HostInfo &hostInfo);
+  size_t workerLimit(const HostState &host) const;
+  void spawnWorker(const HostInfo &hostInfo, HostState &host);
+  /// Hands a job to the host's workers, waking or spawning one if needed
+  void dispatch(QueuedJob job);
+  /// Moves everything from 'submissions' to the host queues. Only runs on the
+  /// io_service thread
+  void drainSubmissions();
 public:
+  /// How long a persistent worker keeps its connection open with nothing to do
+  Clock::duration idleTimeout = std::chrono::seconds(30);
+  /// If set, hosts without their own adapt() settings adapt their connection
+  /// count within these bounds, instead of using 'connectionsPerHost'
+  boost::optional<ConcurrencyLimits> adaptive;
+  /// Have each HTTPS host's workers send their requests as streams over one
+  /// shared HTTP/2 connection, when the server speaks it, instead of a
+  /// connection each. 'connectionsPerHost' then limits the streams in flight
+  bool http2 = false;
+  /// Where the workers' coroutine stacks come from. Set its stackSize and
+  /// guardPages before running any jobs
+  StackPool stacks;
+  ~JobRunner();
+  /// The job queue for a host. Not thread safe; only use it before run() or
+  /// from inside a running job. Use submit() from other threads
   JobQueue &queue(const HostInfo &hostInfo);
+  /// Limit the request rate, byte rate and connection count for a host.
+  /// Hosts without limits are only limited by 'connectionsPerHost'
+  void limit(const HostInfo &hostInfo, RateLimit limits);
+  /// Let the number of connections to a host grow while throughput rises and
+  /// latency stays flat, and back off when it doesn't. A RateLimit
+  /// maxConnections still caps it
+  void adapt(const HostInfo &hostInfo, ConcurrencyLimits limits);
+  /// Runs all the queued jobs, returning when there are none left
   void run(size_t connectionsPerHost = 4);
+  /// Starts a long lived runner on a background thread
+  void start(size_t connectionsPerHost = 4);
+  /// Waits for all submitted jobs to finish, then stops the background thread
+  void stop();
+  /// Queue a job from any thread. It starts straight away if the host has an
+  /// idle worker, or a spare connection slot. The future gets the job's return
+  /// value, or its exception
+  std::future<bool> submit(QueuedJob job);
 };
 
 } /* RESTClient */
@@ -0,0 +1,59 @@
+/// A lock-free, multi producer, single consumer queue
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+#include <boost/optional.hpp>
+
+namespace RESTClient {
+
+/// Dmitry Vyukov's node based MPSC queue. Any thread may push (wait-free, one
+/// atomic exchange); only one thread at a time may pop.
+///
+/// There's a tiny window where a producer has swapped the head but not yet
+/// linked its node in; pop() will return nothing during that window even
+/// though the queue isn't empty. Producers should always tell the consumer to
+/// have another look after pushing.
+template <typename T> class MPSCQueue {
+private:
+  struct Node {
+    std::atomic<Node *> next{nullptr};
+    T value;
+    Node() = default;
+    Node(T value) : value(std::move(value)) {}
+  };
+  // Producers push on to the head
+  std::atomic<Node *> head;
+  // The consumer pops from the tail. The tail is always a spent node (its
+  // value has already been taken)
+  Node *tail;
+
+public:
+  MPSCQueue() : head(new Node()), tail(head.load()) {}
+  MPSCQueue(const MPSCQueue &) = delete;
+  MPSCQueue &operator=(const MPSCQueue &) = delete;
+  ~MPSCQueue() {
+    while (pop())
+      ;
+    delete tail;
+  }
+  /// Safe to call from any thread
+  void push(T value) {
+    Node *node = new Node(std::move(value));
+    Node *previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+  }
+  /// Only call from the consumer thread
+  boost::optional<T> pop() {
+    Node *next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr)
+      return {};
+    boost::optional<T> result(std::move(next->value));
+    delete tail;
+    tail = next;
+    return result;
+  }
+};
+
+} /* RESTClient */
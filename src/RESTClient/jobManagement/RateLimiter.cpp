@@ -0,0 +1,121 @@
+#include "RateLimiter.hpp"
+
+#include <RESTClient/base/logger.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+
+namespace RESTClient {
+
+TokenBucket::TokenBucket(double rate, double burst)
+    : rate(rate), burst(std::max(burst, 1.0)), tokens(this->burst),
+      lastFill(Clock::now()) {}
+
+void TokenBucket::refill(Clock::time_point now) {
+  if (now <= lastFill)
+    return;
+  std::chrono::duration<double> elapsed = now - lastFill;
+  tokens = std::min(burst, tokens + elapsed.count() * rate);
+  lastFill = now;
+}
+
+Clock::duration TokenBucket::timeToRepay() const {
+  if (tokens >= 0)
+    return Clock::duration::zero();
+  return std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(-tokens / rate));
+}
+
+Clock::duration TokenBucket::take(double amount, Clock::time_point now) {
+  if (unlimited())
+    return Clock::duration::zero();
+  refill(now);
+  tokens -= amount;
+  return timeToRepay();
+}
+
+Clock::duration TokenBucket::debt(Clock::time_point now) {
+  if (unlimited())
+    return Clock::duration::zero();
+  refill(now);
+  return timeToRepay();
+}
+
+RateLimiter::RateLimiter(RateLimit limits)
+    : limits(limits), requests(limits.requestsPerSecond, limits.requestBurst),
+      bytes(limits.bytesPerSecond, limits.byteBurst) {}
+
+Clock::duration RateLimiter::acquire() {
+  auto now = Clock::now();
+  Clock::duration wait = Clock::duration::zero();
+  if (pausedUntil > now)
+    wait = pausedUntil - now;
+  // Don't start anything while we're still paying off the bytes we've moved
+  wait = std::max(wait, bytes.debt(now));
+  // Reserve our request slot
+  wait = std::max(wait, requests.take(1, now));
+  return wait;
+}
+
+void RateLimiter::consumed(size_t byteCount) {
+  bytes.take(byteCount);
+}
+
+void RateLimiter::pause(Clock::duration howLong) {
+  pausedUntil = std::max(pausedUntil, Clock::now() + howLong);
+}
+
+void RateLimiter::observe(const HTTPResponse &response) {
+  // 429 Too Many Requests, 503 Service Unavailable
+  if ((response.code != 429) && (response.code != 503))
+    return;
+  auto found = response.headers.find("Retry-After");
+  if (found == response.headers.end())
+    return;
+  auto howLong = parseRetryAfter(std::string(found->second));
+  if (!howLong) {
+    LOG_WARN("Couldn't understand Retry-After header: " << found->second);
+    return;
+  }
+  LOG_INFO("Server asked us to back off for "
+           << std::chrono::duration_cast<std::chrono::milliseconds>(*howLong)
+                  .count()
+           << " ms");
+  pause(*howLong);
+}
+
+boost::optional<Clock::duration> parseRetryAfter(const std::string &value) {
+  if (value.empty())
+    return {};
+  // delta-seconds; counted only as far as the cap, so any number of digits
+  // is fine
+  if (std::all_of(value.begin(), value.end(), [](unsigned char c) {
+        return std::isdigit(c);
+      })) {
+    const long cap =
+        std::chrono::duration_cast<std::chrono::seconds>(maxRetryAfter)
+            .count();
+    long seconds = 0;
+    for (char c : value)
+      seconds = std::min(seconds * 10 + (c - '0'), cap);
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::seconds(seconds));
+  }
+  // HTTP-date, eg. 'Wed, 21 Oct 2015 07:28:00 GMT'
+  std::tm when = {};
+  std::istringstream in(value);
+  in >> std::get_time(&when, "%a, %d %b %Y %H:%M:%S");
+  if (in.fail())
+    return {};
+  auto then = std::chrono::system_clock::from_time_t(timegm(&when));
+  auto now = std::chrono::system_clock::now();
+  if (then <= now)
+    return Clock::duration::zero();
+  return std::min(maxRetryAfter,
+                  std::chrono::duration_cast<Clock::duration>(then - now));
+}
+
+} /* RESTClient */
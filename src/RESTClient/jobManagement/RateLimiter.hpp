@@ -0,0 +1,81 @@
+/// Per host request and byte rate limiting for the JobRunner
+#pragma once
+
+#include <string>
+
+#include <boost/optional.hpp>
+
+#include <RESTClient/base/clock.hpp>
+#include <RESTClient/http/HTTPResponse.hpp>
+
+namespace RESTClient {
+
+/// A token bucket. Tokens drip in at 'rate' per second, and we can save up
+/// at most 'burst' of them. Taking tokens may put the bucket into debt; the
+/// debt is how long the taker has to wait before it may use what it took. That
+/// way many workers can reserve slots and they'll be spaced out evenly.
+class TokenBucket {
+private:
+  double rate;  // Tokens per second. 0 or less means unlimited
+  double burst; // The most tokens we can save up
+  double tokens;
+  Clock::time_point lastFill;
+  void refill(Clock::time_point now);
+  Clock::duration timeToRepay() const;
+
+public:
+  TokenBucket(double rate = 0, double burst = 1);
+  bool unlimited() const { return rate <= 0; }
+  /// Reserve 'amount' tokens. Returns how long to wait before using them
+  Clock::duration take(double amount, Clock::time_point now = Clock::now());
+  /// Returns how long until the bucket is out of debt
+  Clock::duration debt(Clock::time_point now = Clock::now());
+};
+
+/// The limits for a single host
+struct RateLimit {
+  /// Requests per second; every request a job sends counts, but not those a
+  /// cache answers. 0 means unlimited
+  double requestsPerSecond = 0;
+  /// Bytes (sent + received) per second. 0 means unlimited
+  double bytesPerSecond = 0;
+  /// How many requests we can fire back to back before the rate kicks in
+  double requestBurst = 1;
+  /// How many bytes we can move back to back before the byte rate kicks in
+  double byteBurst = 64 * 1024;
+  /// The most connections we'll open to this host. 0 means use the
+  /// 'connectionsPerHost' passed to JobRunner::run
+  size_t maxConnections = 0;
+};
+
+/// Shapes the traffic to a single host. All the workers for the host share
+/// one of these.
+class RateLimiter {
+private:
+  RateLimit limits;
+  TokenBucket requests;
+  TokenBucket bytes;
+  Clock::time_point pausedUntil;
+
+public:
+  RateLimiter(RateLimit limits = {});
+  const RateLimit &getLimits() const { return limits; }
+  /// Reserve the right to send one request. Returns how long to wait before
+  /// sending it
+  Clock::duration acquire();
+  /// Account for the bytes a finished job moved over the wire
+  void consumed(size_t byteCount);
+  /// Stop sending anything to the host for 'howLong'
+  void pause(Clock::duration howLong);
+  /// Looks at a response and backs off if the server asked us to
+  void observe(const HTTPResponse &response);
+};
+
+/// The longest we'll pause a host for, whatever its Retry-After says
+const Clock::duration maxRetryAfter = std::chrono::hours(1);
+
+/// Parses a 'Retry-After' header value; either delta-seconds or an HTTP-date.
+/// Returns nothing if we can't understand it. Never more than maxRetryAfter
+boost::optional<Clock::duration> parseRetryAfter(const std::string &value);
+
+} /* RESTClient */
@@ -0,0 +1,60 @@
+#include "StackPool.hpp"
+
+#include <new>
+
+#include <sys/mman.h>
+
+#include <boost/coroutine/stack_traits.hpp>
+
+namespace RESTClient {
+
+StackPool::~StackPool() {
+  for (Stack &stack : spare)
+    ::munmap(stack.limit, stack.size);
+}
+
+size_t StackPool::mappedSize(size_t usable) const {
+  const size_t page = coroutines::stack_traits::page_size();
+  size_t pages = (usable + page - 1) / page;
+  if (guardPages)
+    ++pages;
+  return pages * page;
+}
+
+void StackPool::allocate(coroutines::stack_context &ctx, size_t size) {
+  const size_t mapped = mappedSize(size);
+  Stack stack{nullptr, mapped};
+  // The newest spare stack is the one most likely to still be in the cache
+  for (auto found = spare.rbegin(); found != spare.rend(); ++found) {
+    if (found->size == mapped) {
+      stack = *found;
+      spare.erase(std::next(found).base());
+      break;
+    }
+  }
+  if (!stack.limit) {
+    stack.limit = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stack.limit == MAP_FAILED)
+      throw std::bad_alloc();
+    if (guardPages &&
+        (::mprotect(stack.limit, coroutines::stack_traits::page_size(),
+                    PROT_NONE) != 0)) {
+      ::munmap(stack.limit, mapped);
+      throw std::bad_alloc();
+    }
+  }
+  // Stacks grow down, so the coroutine starts at the top
+  ctx.size = stack.size;
+  ctx.sp = static_cast<char *>(stack.limit) + stack.size;
+}
+
+void StackPool::deallocate(coroutines::stack_context &ctx) {
+  Stack stack{static_cast<char *>(ctx.sp) - ctx.size, ctx.size};
+  if (spare.size() < maxSpare)
+    spare.push_back(stack);
+  else
+    ::munmap(stack.limit, stack.size);
+}
+
+} /* RESTClient */
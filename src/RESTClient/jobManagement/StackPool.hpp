@@ -0,0 +1,120 @@
+/// Recycled coroutine stacks, and a spawn() that uses them.
+///
+/// asio::spawn gets a fresh stack from malloc for every coroutine, and frees
+/// it when the coroutine ends. A JobRunner spawning a worker per burst of jobs
+/// pays for that every time, and the heap grows and shrinks with it. A
+/// StackPool maps its stacks once, optionally with a guard page below each,
+/// and hands them out again when their coroutines end.
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/spawn.hpp>
+#include <boost/coroutine/attributes.hpp>
+#include <boost/coroutine/stack_context.hpp>
+#include <boost/version.hpp>
+
+namespace RESTClient {
+
+using namespace boost;
+
+/// Keeps the stacks of finished coroutines for the next ones. Not thread
+/// safe; use one per io_service thread, and keep it alive until all its
+/// coroutines have finished
+class StackPool {
+private:
+  struct Stack {
+    void *limit;
+    size_t size;
+  };
+  std::vector<Stack> spare;
+  /// Whole pages, plus the guard page if we're using them
+  size_t mappedSize(size_t usable) const;
+
+public:
+  /// Usable bytes of stack per coroutine. Rounded up to whole pages
+  size_t stackSize;
+  /// Leave an inaccessible page below each stack, so an overflow crashes
+  /// instead of quietly writing over whatever is mapped below it
+  bool guardPages = true;
+  /// The most stacks to keep; any more are given back to the OS
+  size_t maxSpare = 64;
+  explicit StackPool(size_t stackSize = 128 * 1024) : stackSize(stackSize) {}
+  StackPool(const StackPool &) = delete;
+  ~StackPool();
+  /// Boost.Coroutine's StackAllocator interface
+  void allocate(coroutines::stack_context &ctx, size_t size);
+  void deallocate(coroutines::stack_context &ctx);
+  /// Stacks waiting to be reused
+  size_t spareCount() const { return spare.size(); }
+  coroutines::attributes attributes() const {
+    return coroutines::attributes(stackSize);
+  }
+};
+
+/// Boost.Coroutine copies its stack allocator into each coroutine, so it gets
+/// this handle instead of the pool itself
+struct PooledStackAllocator {
+  StackPool *pool;
+  void allocate(coroutines::stack_context &ctx, size_t size) {
+    pool->allocate(ctx, size);
+  }
+  void deallocate(coroutines::stack_context &ctx) { pool->deallocate(ctx); }
+};
+
+namespace detail {
+
+template <typename Yield> struct YieldHandler;
+template <typename Handler>
+struct YieldHandler<asio::basic_yield_context<Handler>> {
+  using type = Handler;
+};
+
+/// asio's spawn_helper, but giving the coroutine a pooled stack
+template <typename Handler, typename Function> struct PooledSpawn {
+  using Data = asio::detail::spawn_data<Handler, Function>;
+  using Callee = typename asio::basic_yield_context<Handler>::callee_type;
+  asio::detail::shared_ptr<Data> data;
+  StackPool *pool;
+  void operator()() {
+    asio::detail::coro_entry_point<Handler, Function> entry = {data};
+    asio::detail::shared_ptr<Callee> coro(
+        new Callee(entry, pool->attributes(), PooledStackAllocator{pool}));
+    data->coro_ = coro;
+    (*coro)();
+  }
+};
+
+} /* detail */
+
+/// Like asio::spawn(io_service, function), running 'function' in a strand
+/// with an asio::yield_context, but on a stack from 'pool'
+template <typename Function>
+void spawnPooled(asio::io_service &io, StackPool &pool, Function &&function) {
+  using Handler = typename detail::YieldHandler<asio::yield_context>::type;
+  using FunctionType = typename std::decay<Function>::type;
+#if BOOST_VERSION >= 106600
+  Handler handler(asio::executor_arg,
+                  typename Handler::executor_type(asio::make_strand(io)),
+                  &asio::detail::default_spawn_handler);
+#else
+  Handler handler =
+      asio::io_service::strand(io).wrap(&asio::detail::default_spawn_handler);
+#endif
+  detail::PooledSpawn<Handler, FunctionType> helper{
+      asio::detail::shared_ptr<
+          typename detail::PooledSpawn<Handler, FunctionType>::Data>(
+          new typename detail::PooledSpawn<Handler, FunctionType>::Data(
+              std::move(handler), true, std::forward<Function>(function))),
+      &pool};
+#if BOOST_VERSION >= 106600
+  asio::dispatch(helper.data->handler_.get_executor(), std::move(helper));
+#else
+  boost_asio_handler_invoke_helpers::invoke(helper, helper.data->handler_);
+#endif
+}
+
+} /* RESTClient */
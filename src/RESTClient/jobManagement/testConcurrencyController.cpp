@@ -0,0 +1,97 @@
+#include <RESTClient/jobManagement/ConcurrencyController.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace RESTClient;
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+const auto window = std::chrono::milliseconds(50);
+
+/// Our own clock, so no window depends on how busy the machine is
+Clock::time_point now;
+
+ConcurrencyLimits limits(size_t initial) {
+  ConcurrencyLimits result;
+  result.initial = initial;
+  result.window = window;
+  return result;
+}
+
+/// Runs one window of as many jobs as the limit allows, all at once, each
+/// taking 'latency'. The last of them ends the window, exactly a window after
+/// the last one ended
+void runWindow(ConcurrencyController &controller,
+               std::chrono::milliseconds latency, bool throttled = false,
+               bool failed = false) {
+  size_t jobs = controller.limit();
+  for (size_t i = 0; i != jobs; ++i)
+    controller.started();
+  for (size_t i = 0; i + 1 != jobs; ++i)
+    controller.completed(latency, false, false, now);
+  now += window;
+  controller.completed(latency, throttled, failed, now);
+}
+
+void testAdditiveIncrease() {
+  ConcurrencyController controller(limits(4), now);
+  EQ(controller.limit(), 4);
+  runWindow(controller, std::chrono::milliseconds(10));
+  EQ(controller.limit(), 5);
+  runWindow(controller, std::chrono::milliseconds(10));
+  EQ(controller.limit(), 6);
+  // Not using them all, so no more
+  controller.started();
+  now += window;
+  controller.completed(std::chrono::milliseconds(10), false, false, now);
+  EQ(controller.limit(), 6);
+}
+
+void testMultiplicativeDecrease() {
+  ConcurrencyController controller(limits(12), now);
+  runWindow(controller, std::chrono::milliseconds(10), true);
+  EQ(controller.limit(), 6);
+  runWindow(controller, std::chrono::milliseconds(10), false, true);
+  EQ(controller.limit(), 3);
+  // Never below the minimum
+  runWindow(controller, std::chrono::milliseconds(10), true);
+  runWindow(controller, std::chrono::milliseconds(10), true);
+  EQ(controller.limit(), 1);
+}
+
+void testLatencyGradient() {
+  ConcurrencyController controller(limits(8), now);
+  runWindow(controller, std::chrono::milliseconds(10));
+  EQ(controller.limit(), 9);
+  // Within the tolerance, so it still grows
+  runWindow(controller, std::chrono::milliseconds(14));
+  EQ(controller.limit(), 10);
+  // Three times the best (near enough 10ms), so a third as many
+  runWindow(controller, std::chrono::milliseconds(30));
+  EQ(controller.limit(), 3);
+}
+
+int main(int argc, char *argv[]) {
+  int failures = 0;
+  auto check = [&failures](const char *name, void (*test)()) {
+    try {
+      test();
+    } catch (std::exception &e) {
+      std::cerr << name << " FAILED: " << e.what() << std::endl;
+      ++failures;
+    }
+  };
+  check("additive increase", testAdditiveIncrease);
+  check("multiplicative decrease", testMultiplicativeDecrease);
+  check("latency gradient", testLatencyGradient);
+  return failures;
+}
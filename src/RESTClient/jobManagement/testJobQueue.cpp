@@ -0,0 +1,73 @@
+#include <RESTClient/jobManagement/JobQueue.hpp>
+#include <RESTClient/base/logger.hpp>
+
+#include <sstream>
+#include <string>
+
+using namespace RESTClient;
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b       \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__;                 \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+QueuedJob makeJob(std::string name, Priority priority = Priority::normal,
+                  boost::optional<Clock::time_point> deadline = {}) {
+  QueuedJob result{name, HostInfo(), nullptr, priority, deadline};
+  return result;
+}
+
+void testFIFO() {
+  LOG_INFO("Test FIFO within a priority class");
+  JobQueue q;
+  for (int i = 0; i != 100; ++i)
+    q.push(makeJob(std::to_string(i)));
+  for (int i = 0; i != 100; ++i)
+    EQ(q.pop().name, std::to_string(i));
+  EQ(q.empty(), true);
+}
+
+void testPriority() {
+  LOG_INFO("Test priority classes");
+  JobQueue q;
+  q.push(makeJob("bulk 1", Priority::low));
+  q.push(makeJob("normal 1"));
+  q.push(makeJob("bulk 2", Priority::low));
+  q.push(makeJob("login", Priority::high));
+  q.push(makeJob("normal 2"));
+  EQ(q.pop().name, "login");
+  EQ(q.pop().name, "normal 1");
+  EQ(q.pop().name, "normal 2");
+  EQ(q.pop().name, "bulk 1");
+  EQ(q.pop().name, "bulk 2");
+}
+
+void testDeadlines() {
+  LOG_INFO("Test earliest deadline first");
+  JobQueue q;
+  auto now = Clock::now();
+  using std::chrono::seconds;
+  q.push(makeJob("no deadline"));
+  q.push(makeJob("late", Priority::normal, now + seconds(30)));
+  q.push(makeJob("soon", Priority::normal, now + seconds(1)));
+  q.push(makeJob("urgent", Priority::high));
+  q.push(makeJob("missed", Priority::normal, now - seconds(1)));
+  EQ(q.pop().name, "urgent");
+  QueuedJob missed = q.pop();
+  EQ(missed.name, "missed");
+  EQ(missed.pastDeadline(), true);
+  EQ(q.pop().name, "soon");
+  EQ(q.pop().name, "late");
+  EQ(q.pop().name, "no deadline");
+}
+
+int main(int, char **) {
+  testFIFO();
+  testPriority();
+  testDeadlines();
+  LOG_INFO("JobQueue tests PASSED");
+  return 0;
+}
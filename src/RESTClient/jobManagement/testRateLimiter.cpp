@@ -0,0 +1,78 @@
+#include <RESTClient/jobManagement/RateLimiter.hpp>
+
+#include <ctime>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace RESTClient;
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+long seconds(boost::optional<Clock::duration> howLong) {
+  if (!howLong)
+    return -1;
+  return std::chrono::duration_cast<std::chrono::seconds>(*howLong).count();
+}
+
+/// An HTTP-date 'offset' seconds from now
+std::string httpDate(long offset) {
+  std::time_t when = std::time(nullptr) + offset;
+  std::tm parts;
+  gmtime_r(&when, &parts);
+  char text[64];
+  std::strftime(text, sizeof(text), "%a, %d %b %Y %H:%M:%S GMT", &parts);
+  return text;
+}
+
+void testDeltaSeconds() {
+  EQ(seconds(parseRetryAfter("0")), 0);
+  EQ(seconds(parseRetryAfter("120")), 120);
+  // Too many digits for a long; capped, not thrown
+  EQ(seconds(parseRetryAfter("123456789012345678901234567890")),
+     std::chrono::duration_cast<std::chrono::seconds>(maxRetryAfter).count());
+}
+
+void testHTTPDate() {
+  // A second either way for the clock ticking between here and there
+  long inAMinute = seconds(parseRetryAfter(httpDate(60)));
+  EQ((inAMinute >= 58 && inAMinute <= 60), true);
+  EQ(seconds(parseRetryAfter(httpDate(-60))), 0);
+  EQ(seconds(parseRetryAfter(httpDate(24 * 60 * 60))),
+     std::chrono::duration_cast<std::chrono::seconds>(maxRetryAfter).count());
+}
+
+void testGarbage() {
+  EQ(seconds(parseRetryAfter("")), -1);
+  EQ(seconds(parseRetryAfter("soon")), -1);
+  EQ(seconds(parseRetryAfter("-5")), -1);
+  EQ(seconds(parseRetryAfter("12 seconds")), -1);
+  EQ(seconds(parseRetryAfter("\xb2\xb3")), -1);
+}
+
+/// A bad header mustn't fail the request it came with
+void testObserve() {
+  RateLimiter limiter;
+  HTTPResponse response;
+  response.code = 429;
+  response.headers.emplace("Retry-After", "99999999999999999999999");
+  limiter.observe(response);
+  auto wait = limiter.acquire();
+  EQ((wait > maxRetryAfter - std::chrono::minutes(1)), true);
+  EQ((wait <= maxRetryAfter), true);
+}
+
+int main(int argc, char *argv[]) {
+  testDeltaSeconds();
+  testHTTPDate();
+  testGarbage();
+  testObserve();
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include <RESTClient/base/allocations.hpp>
+#include <RESTClient/jobManagement/HandlerMemory.hpp>
+#include <RESTClient/jobManagement/StackPool.hpp>
+
+#include <csignal>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/coroutine/stack_traits.hpp>
+
+using namespace RESTClient;
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+void testReuse() {
+  asio::io_service io;
+  StackPool pool;
+  // One coroutine at a time always gets the same stack back
+  char *first = nullptr;
+  for (int i = 0; i != 100; ++i) {
+    spawnPooled(io, pool, [&](asio::yield_context yield) {
+      char local;
+      if (!first)
+        first = &local;
+      EQ((void *)&local, (void *)first);
+      io.post(yield);
+    });
+    io.run();
+    io.reset();
+  }
+  EQ(pool.spareCount(), 1);
+  // Coroutines running at the same time get a stack each
+  int running = 0;
+  for (int i = 0; i != 3; ++i)
+    spawnPooled(io, pool, [&](asio::yield_context yield) {
+      ++running;
+      io.post(yield);
+      EQ(running, 3);
+    });
+  io.run();
+  io.reset();
+  EQ(pool.spareCount(), 3);
+  // Changing the size means new stacks
+  pool.stackSize *= 2;
+  pool.maxSpare = 3;
+  spawnPooled(io, pool, [](asio::yield_context yield) {});
+  io.run();
+  EQ(pool.spareCount(), 3);
+}
+
+void testGuardPage() {
+  StackPool pool;
+  coroutines::stack_context ctx;
+  pool.allocate(ctx, pool.stackSize);
+  char *lowest = static_cast<char *>(ctx.sp) - ctx.size;
+  // The stack itself is writable, and the page below it isn't
+  const size_t page = coroutines::stack_traits::page_size();
+  lowest[page] = 1;
+  pid_t child = fork();
+  if (child == 0) {
+    *static_cast<volatile char *>(lowest) = 1;
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(child, &status, 0);
+  EQ(WIFSIGNALED(status), true);
+  EQ(WTERMSIG(status), SIGSEGV);
+  pool.deallocate(ctx);
+}
+
+void testHandlerMemory() {
+  asio::io_service io;
+  HandlerMemory memory;
+  int called = 0;
+  auto postOne = [&]() {
+    io.post(withMemory(memory, [&called]() { ++called; }));
+    io.run();
+    io.reset();
+  };
+  postOne();
+  AllocationScope scope;
+  for (int i = 0; i != 100; ++i)
+    postOne();
+  EQ(scope.counts().allocations, 0);
+  EQ(called, 101);
+}
+
+int main(int argc, char *argv[]) {
+  int failures = 0;
+  auto check = [&failures](const char *name, void (*test)()) {
+    try {
+      test();
+    } catch (std::exception &e) {
+      std::cerr << name << " FAILED: " << e.what() << std::endl;
+      ++failures;
+    }
+  };
+  check("reuse", testReuse);
+  check("guard page", testGuardPage);
+  check("handler memory", testHandlerMemory);
+  return failures;
+}
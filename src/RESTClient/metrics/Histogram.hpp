@@ -0,0 +1,66 @@
+/// HDR style log-linear histogram
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace RESTClient {
+
+/// Records values (we use nanoseconds) in log-linear buckets: each power of
+/// two is split into 16 linear sub buckets, so any value is within ~6% of its
+/// bucket's bounds, from 1 ns up to 2^41 ns (about 36 minutes).
+///
+/// Only one thread may record into a histogram, but any thread may read it.
+class Histogram {
+public:
+  static constexpr int subBucketBits = 4;
+  static constexpr int subBuckets = 1 << subBucketBits;
+  static constexpr int maxExponent = 40;
+  static constexpr int bucketCount =
+      (maxExponent - subBucketBits + 2) * subBuckets;
+
+  static int bucketFor(uint64_t value) {
+    if (value < subBuckets)
+      return static_cast<int>(value);
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent > maxExponent)
+      return bucketCount - 1;
+    int shift = exponent - subBucketBits;
+    int sub = static_cast<int>((value >> shift) & (subBuckets - 1));
+    return (shift + 1) * subBuckets + sub;
+  }
+  /// The highest value that falls in a bucket
+  static uint64_t upperBound(int bucket) {
+    if (bucket < subBuckets)
+      return bucket;
+    int shift = bucket / subBuckets - 1;
+    uint64_t sub = bucket % subBuckets;
+    return ((subBuckets + sub + 1) << shift) - 1;
+  }
+
+  /// Single writer only
+  void record(uint64_t value) {
+    bump(counts[bucketFor(value)], 1);
+    bump(total, 1);
+    bump(sum, value);
+  }
+  uint64_t count() const { return total.load(std::memory_order_relaxed); }
+  uint64_t valueSum() const { return sum.load(std::memory_order_relaxed); }
+  uint64_t bucket(int i) const {
+    return counts[i].load(std::memory_order_relaxed);
+  }
+
+private:
+  /// The owning thread is the only writer, so a plain load and store is enough
+  /// (and avoids a locked instruction)
+  static void bump(std::atomic<uint64_t> &counter, uint64_t by) {
+    counter.store(counter.load(std::memory_order_relaxed) + by,
+                  std::memory_order_relaxed);
+  }
+  std::array<std::atomic<uint64_t>, bucketCount> counts{};
+  std::atomic<uint64_t> total{0};
+  std::atomic<uint64_t> sum{0};
+};
+
+} /* RESTClient */
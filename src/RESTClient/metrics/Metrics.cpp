@@ -0,0 +1,172 @@
+#include "Metrics.hpp"
+
+#include <sstream>
+
+namespace RESTClient {
+
+Metrics &Metrics::instance() {
+  static Metrics metrics;
+  return metrics;
+}
+
+std::string Metrics::hostLabel(const HostInfo &hostInfo) {
+  // Never the username or password
+  return hostInfo.protocol + "://" + hostInfo.hostname + ":" +
+         std::to_string(hostInfo.getPort());
+}
+
+HostMetrics &Metrics::local(const std::string &host) {
+  thread_local std::map<std::string, HostMetrics *> mine;
+  auto found = mine.find(host);
+  if (found != mine.end())
+    return *found->second;
+  std::unique_ptr<Shard> shard(new Shard{host, {}});
+  HostMetrics *result = &shard->metrics;
+  {
+    std::lock_guard<std::mutex> lock(shardsLock);
+    shards.emplace_back(std::move(shard));
+  }
+  mine.emplace(host, result);
+  return *result;
+}
+
+uint64_t HostMetricsSnapshot::latencyPercentile(double quantile) const {
+  uint64_t wanted = static_cast<uint64_t>(quantile * latencyCount);
+  uint64_t seen = 0;
+  for (int i = 0; i != Histogram::bucketCount; ++i) {
+    seen += latency[i];
+    if ((seen > wanted) || ((seen == latencyCount) && (seen > 0)))
+      return Histogram::upperBound(i);
+  }
+  return 0;
+}
+
+std::map<std::string, HostMetricsSnapshot> Metrics::snapshot() const {
+  std::map<std::string, HostMetricsSnapshot> result;
+  std::lock_guard<std::mutex> lock(shardsLock);
+  for (const auto &shard : shards) {
+    const HostMetrics &in = shard->metrics;
+    HostMetricsSnapshot &out = result[shard->host];
+    for (int i = 0; i != static_cast<int>(in.statusCodes.size()); ++i) {
+      uint64_t count = in.statusCodes[i].get();
+      if (count != 0)
+        out.statusCodes[HostMetrics::minCode + i] += count;
+    }
+    out.bytesReceived += in.bytesReceived.get();
+    out.bytesSent += in.bytesSent.get();
+    out.connectionsOpened += in.connectionsOpened.get();
+    out.connectionsReused += in.connectionsReused.get();
+    out.connectionsClosed += in.connectionsClosed.get();
+    for (int i = 0; i != Histogram::bucketCount; ++i) {
+      out.latency[i] += in.latency.bucket(i);
+      out.poolWait[i] += in.poolWait.bucket(i);
+    }
+    out.latencyCount += in.latency.count();
+    out.latencySum += in.latency.valueSum();
+    out.poolWaitCount += in.poolWait.count();
+    out.poolWaitSum += in.poolWait.valueSum();
+  }
+  return result;
+}
+
+namespace {
+
+/// Escapes a Prometheus label value
+std::string label(const std::string &value) {
+  std::string result;
+  result.reserve(value.size());
+  for (char c : value) {
+    if ((c == '\\') || (c == '"'))
+      result.push_back('\\');
+    if (c == '\n') {
+      result += "\\n";
+      continue;
+    }
+    result.push_back(c);
+  }
+  return result;
+}
+
+/// Writes a histogram collected in nanoseconds as a Prometheus histogram in
+/// seconds
+void writeHistogram(std::ostream &out, const std::string &name,
+                    const std::string &host,
+                    const std::array<uint64_t, Histogram::bucketCount> &counts,
+                    uint64_t count, uint64_t sum) {
+  static const double boundaries[] = {0.0005, 0.001, 0.0025, 0.005, 0.01,
+                                      0.025,  0.05,  0.1,    0.25,  0.5,
+                                      1,      2.5,   5,      10,    30, 60};
+  uint64_t cumulative = 0;
+  int bucket = 0;
+  for (double le : boundaries) {
+    uint64_t leNanoseconds = static_cast<uint64_t>(le * 1e9);
+    while ((bucket != Histogram::bucketCount) &&
+           (Histogram::upperBound(bucket) <= leNanoseconds))
+      cumulative += counts[bucket++];
+    out << name << "_bucket{host=\"" << host << "\",le=\"" << le << "\"} "
+        << cumulative << '\n';
+  }
+  out << name << "_bucket{host=\"" << host << "\",le=\"+Inf\"} " << count
+      << '\n';
+  out << name << "_sum{host=\"" << host << "\"} " << (sum / 1e9) << '\n';
+  out << name << "_count{host=\"" << host << "\"} " << count << '\n';
+}
+
+} // anonymous namespace
+
+std::string Metrics::prometheus() const {
+  auto hosts = snapshot();
+  std::stringstream out;
+
+  out << "# HELP restclient_responses_total HTTP responses by status code\n"
+      << "# TYPE restclient_responses_total counter\n";
+  for (const auto &host : hosts)
+    for (const auto &code : host.second.statusCodes)
+      out << "restclient_responses_total{host=\"" << label(host.first)
+          << "\",code=\"" << code.first << "\"} " << code.second << '\n';
+
+  out << "# HELP restclient_bytes_received_total Bytes read from the net\n"
+      << "# TYPE restclient_bytes_received_total counter\n";
+  for (const auto &host : hosts)
+    out << "restclient_bytes_received_total{host=\"" << label(host.first)
+        << "\"} " << host.second.bytesReceived << '\n';
+
+  out << "# HELP restclient_bytes_sent_total Bytes written to the net\n"
+      << "# TYPE restclient_bytes_sent_total counter\n";
+  for (const auto &host : hosts)
+    out << "restclient_bytes_sent_total{host=\"" << label(host.first) << "\"} "
+        << host.second.bytesSent << '\n';
+
+  out << "# HELP restclient_connections_total Connections opened, reused for "
+         "a request, and closed\n"
+      << "# TYPE restclient_connections_total counter\n";
+  for (const auto &host : hosts) {
+    std::string name = label(host.first);
+    out << "restclient_connections_total{host=\"" << name
+        << "\",event=\"opened\"} " << host.second.connectionsOpened << '\n'
+        << "restclient_connections_total{host=\"" << name
+        << "\",event=\"reused\"} " << host.second.connectionsReused << '\n'
+        << "restclient_connections_total{host=\"" << name
+        << "\",event=\"closed\"} " << host.second.connectionsClosed << '\n';
+  }
+
+  out << "# HELP restclient_request_duration_seconds Time from sending a "
+         "request to the end of its response\n"
+      << "# TYPE restclient_request_duration_seconds histogram\n";
+  for (const auto &host : hosts)
+    writeHistogram(out, "restclient_request_duration_seconds",
+                   label(host.first), host.second.latency,
+                   host.second.latencyCount, host.second.latencySum);
+
+  out << "# HELP restclient_pool_wait_seconds Time jobs waited for a "
+         "connection\n"
+      << "# TYPE restclient_pool_wait_seconds histogram\n";
+  for (const auto &host : hosts)
+    writeHistogram(out, "restclient_pool_wait_seconds", label(host.first),
+                   host.second.poolWait, host.second.poolWaitCount,
+                   host.second.poolWaitSum);
+
+  return out.str();
+}
+
+} /* RESTClient */
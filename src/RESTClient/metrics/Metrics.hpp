@@ -0,0 +1,101 @@
+/// Counters and latency histograms for what HTTP and the JobRunner are doing
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <RESTClient/base/clock.hpp>
+#include <RESTClient/base/url.hpp>
+#include <RESTClient/metrics/Histogram.hpp>
+
+namespace RESTClient {
+
+/// A counter with one writer and any number of readers
+class Counter {
+private:
+  std::atomic<uint64_t> value{0};
+
+public:
+  void add(uint64_t by = 1) {
+    value.store(value.load(std::memory_order_relaxed) + by,
+                std::memory_order_relaxed);
+  }
+  uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+/// One thread's metrics for one host. Only the thread that got it from
+/// Metrics::local may write to it. Each one starts on its own cache line so
+/// threads never fight over them.
+struct alignas(64) HostMetrics {
+  static constexpr int minCode = 100;
+  static constexpr int maxCode = 599;
+  std::array<Counter, maxCode - minCode + 1> statusCodes;
+  Counter bytesReceived;
+  Counter bytesSent;
+  Counter connectionsOpened;
+  Counter connectionsReused;
+  Counter connectionsClosed;
+  /// Time from start of request to end of response (nanoseconds)
+  Histogram latency;
+  /// Time jobs waited in the JobRunner queue for a connection (nanoseconds)
+  Histogram poolWait;
+  void status(int code) {
+    if ((code >= minCode) && (code <= maxCode))
+      statusCodes[code - minCode].add();
+  }
+  static uint64_t nanoseconds(Clock::duration d) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    return ns > 0 ? ns : 0;
+  }
+};
+
+/// Sum of every thread's HostMetrics for one host
+struct HostMetricsSnapshot {
+  std::map<int, uint64_t> statusCodes;
+  uint64_t bytesReceived = 0;
+  uint64_t bytesSent = 0;
+  uint64_t connectionsOpened = 0;
+  uint64_t connectionsReused = 0;
+  uint64_t connectionsClosed = 0;
+  std::array<uint64_t, Histogram::bucketCount> latency{};
+  uint64_t latencyCount = 0;
+  uint64_t latencySum = 0;
+  std::array<uint64_t, Histogram::bucketCount> poolWait{};
+  uint64_t poolWaitCount = 0;
+  uint64_t poolWaitSum = 0;
+  /// Returns the latency (in nanoseconds) that 'quantile' (0 to 1) of
+  /// requests were faster than
+  uint64_t latencyPercentile(double quantile) const;
+};
+
+/// The global metrics registry
+class Metrics {
+private:
+  struct Shard {
+    std::string host;
+    HostMetrics metrics;
+  };
+  mutable std::mutex shardsLock; // Only taken to add a shard, or to snapshot
+  std::deque<std::unique_ptr<Shard>> shards;
+
+public:
+  static Metrics &instance();
+  /// The name we file a host's metrics under: protocol://hostname:port
+  static std::string hostLabel(const HostInfo &hostInfo);
+  /// Returns this thread's metrics for a host. Cache the result; it's good for
+  /// the life of the program. 'host' should be like 'https://example.com:443'
+  /// (no usernames or passwords)
+  HostMetrics &local(const std::string &host);
+  /// Adds up every thread's metrics
+  std::map<std::string, HostMetricsSnapshot> snapshot() const;
+  /// Renders a snapshot in the Prometheus text exposition format
+  std::string prometheus() const;
+};
+
+} /* RESTClient */
@@ -0,0 +1,140 @@
+#include <RESTClient/metrics/Metrics.hpp>
+
+#include <iostream>
+#include <map>
+#include <cstring>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+using namespace RESTClient;
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+/// Each value lands in the one bucket whose bounds hold it, and is within a
+/// sixteenth of that bucket's upper bound
+void checkBucket(uint64_t value) {
+  int bucket = Histogram::bucketFor(value);
+  uint64_t upper = Histogram::upperBound(bucket);
+  EQ((upper >= value), true);
+  if (bucket > 0)
+    EQ((Histogram::upperBound(bucket - 1) < value), true);
+  EQ((upper - value <= value / Histogram::subBuckets), true);
+}
+
+void testBuckets() {
+  for (uint64_t value = 0; value != 4096; ++value)
+    checkBucket(value);
+  for (int exponent = 4; exponent <= Histogram::maxExponent; ++exponent) {
+    uint64_t power = uint64_t(1) << exponent;
+    checkBucket(power - 1);
+    checkBucket(power);
+    checkBucket(power + 1);
+  }
+  std::mt19937_64 random(42);
+  for (int i = 0; i != 100000; ++i)
+    checkBucket(random() >> (64 - Histogram::maxExponent));
+  // Anything bigger goes in the last bucket
+  EQ(Histogram::bucketFor(~uint64_t(0)), Histogram::bucketCount - 1);
+  // Buckets are in order
+  for (int i = 1; i != Histogram::bucketCount; ++i)
+    EQ((Histogram::upperBound(i) > Histogram::upperBound(i - 1)), true);
+}
+
+void testPercentiles() {
+  HostMetrics &metrics = Metrics::instance().local("test://percentiles:1");
+  // 1 to 10000 microseconds
+  for (uint64_t i = 1; i <= 10000; ++i)
+    metrics.latency.record(i * 1000);
+  HostMetricsSnapshot snapshot =
+      Metrics::instance().snapshot()["test://percentiles:1"];
+  EQ(snapshot.latencyCount, 10000);
+  EQ(snapshot.latencySum, 1000 * 10000 * 10001ull / 2);
+  for (double quantile : {0.5, 0.9, 0.99, 0.999}) {
+    uint64_t exact = static_cast<uint64_t>(quantile * 10000) * 1000;
+    uint64_t found = snapshot.latencyPercentile(quantile);
+    EQ((found >= exact), true);
+    EQ((found - exact <= exact / Histogram::subBuckets), true);
+  }
+  EQ(snapshot.latencyPercentile(1), Histogram::upperBound(
+                                        Histogram::bucketFor(10000 * 1000)));
+}
+
+void testPrometheus() {
+  HostMetrics &metrics = Metrics::instance().local("test://we\"ird\\:1");
+  metrics.status(200);
+  metrics.status(200);
+  metrics.status(503);
+  metrics.bytesSent.add(10);
+  metrics.latency.record(3 * 1000 * 1000);
+  metrics.latency.record(20ull * 1000 * 1000 * 1000);
+  std::string text = Metrics::instance().prometheus();
+
+  const std::regex comment("# (HELP|TYPE) ([a-z_]+) .+");
+  const std::regex sample("([a-z_]+)\\{((?:[a-z_]+=\"(?:[^\"\\\\]|\\\\.)*\",?)+)"
+                          "\\} ([0-9.e+-]+)");
+  std::map<std::string, std::string> types;
+  std::map<std::string, std::string> values;
+  std::istringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line)) {
+    std::smatch match;
+    if (std::regex_match(line, match, comment)) {
+      if (match[1] == "TYPE")
+        types[match[2]] = line.substr(line.rfind(' ') + 1);
+      continue;
+    }
+    if (!std::regex_match(line, match, sample))
+      throw std::runtime_error("Not a Prometheus line: " + line);
+    // Every sample's family was declared first
+    std::string family = match[1];
+    for (const char *suffix : {"_bucket", "_sum", "_count"})
+      if (!types.count(family) && (family.size() > std::strlen(suffix)) &&
+          (family.compare(family.size() - std::strlen(suffix),
+                          std::string::npos, suffix) == 0))
+        family.resize(family.size() - std::strlen(suffix));
+    EQ(types.count(family), 1);
+    values[std::string(match[1]) + "{" + std::string(match[2]) + "}"] =
+        match[3];
+  }
+  EQ(types["restclient_responses_total"], "counter");
+  EQ(types["restclient_request_duration_seconds"], "histogram");
+  const std::string host = "host=\"test://we\\\"ird\\\\:1\"";
+  EQ(values["restclient_responses_total{" + host + ",code=\"200\"}"], "2");
+  EQ(values["restclient_responses_total{" + host + ",code=\"503\"}"], "1");
+  EQ(values["restclient_bytes_sent_total{" + host + "}"], "10");
+  const std::string duration = "restclient_request_duration_seconds";
+  EQ(values[duration + "_count{" + host + "}"], "2");
+  EQ(values[duration + "_sum{" + host + "}"], "20.003");
+  // Cumulative: the 3ms one by 5ms, both by 30s, and +Inf is the count
+  EQ(values[duration + "_bucket{" + host + ",le=\"0.0025\"}"], "0");
+  EQ(values[duration + "_bucket{" + host + ",le=\"0.005\"}"], "1");
+  EQ(values[duration + "_bucket{" + host + ",le=\"10\"}"], "1");
+  EQ(values[duration + "_bucket{" + host + ",le=\"30\"}"], "2");
+  EQ(values[duration + "_bucket{" + host + ",le=\"+Inf\"}"], "2");
+}
+
+int main(int argc, char *argv[]) {
+  int failures = 0;
+  auto check = [&failures](const char *name, void (*test)()) {
+    try {
+      test();
+    } catch (std::exception &e) {
+      std::cerr << name << " FAILED: " << e.what() << std::endl;
+      ++failures;
+    }
+  };
+  check("buckets", testBuckets);
+  check("percentiles", testPercentiles);
+  check("prometheus", testPrometheus);
+  return failures;
+}
@@ -0,0 +1,94 @@
+/// Checks that once a connection is warmed up, a keep-alive GET with a small
+/// body doesn't touch the heap, whether the response is reused or lives in the
+/// connection's arena
+#include <RESTClient/base/allocations.hpp>
+#include <RESTClient/http/HTTP.hpp>
+#include <RESTClient/http/Services.hpp>
+#include <testServer/TestServer.hpp>
+
+#include <iostream>
+#include <sstream>
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+using namespace RESTClient;
+
+void testCounting() {
+  AllocationScope scope;
+  // Calling operator new directly, as the compiler may drop a new expression
+  // and its delete
+  void *p = ::operator new(100);
+  EQ(scope.counts().allocations, 1);
+  EQ(scope.counts().bytes, 100);
+  ::operator delete(p);
+  EQ(scope.counts().deallocations, 1);
+}
+
+void testSteadyState(const HostInfo &host) {
+  const int warmup = 50;
+  const int count = 1000;
+  auto &io = Services::instance().io_service;
+  io.reset();
+  AllocationCounts counts, fetchCounts;
+  asio::spawn(io, [&](asio::yield_context yield) {
+    HTTP conn(host, yield);
+    HTTPResponse response;
+    const std::string path = "/bytes/64";
+    for (int i = 0; i != warmup; ++i)
+      conn.get(path, response);
+    AllocationScope scope;
+    for (int i = 0; i != count; ++i) {
+      conn.get(path, response);
+      EQ(response.code, 200);
+      EQ(response.timings.decodedBodyBytes, 64);
+    }
+    counts = scope.counts();
+    // fetch() keeps the headers in the connection's arena instead
+    HTTPRequest request("GET", path);
+    for (int i = 0; i != warmup; ++i)
+      conn.fetch(request);
+    AllocationScope fetchScope;
+    for (int i = 0; i != count; ++i)
+      EQ(conn.fetch(request).code, 200);
+    fetchCounts = fetchScope.counts();
+    // Copies go on the heap, and outlive the next request
+    HTTPResponse kept = conn.fetch(request).copy();
+    Arena *keptIn = kept.headers.get_allocator().outer_allocator().arena;
+    EQ((keptIn == nullptr), true);
+    conn.fetch(request);
+    EQ(kept.headers.at("Content-Length"), "64");
+    conn.close();
+  });
+  io.run();
+  std::cout << host.hostname << ":" << host.getPort() << " - "
+            << counts.allocations << " allocations (" << counts.bytes
+            << " bytes) in " << count << " requests, "
+            << fetchCounts.allocations << " with fetch()" << std::endl;
+  EQ(counts.allocations, 0);
+  EQ(fetchCounts.allocations, 0);
+}
+
+int main(int argc, char *argv[]) {
+  TestServer server;
+  Services::instance().trustCertificate(TestServer::certificateFile());
+  int failures = 0;
+  auto check = [&failures](const char *name, std::function<void()> test) {
+    try {
+      test();
+    } catch (std::exception &e) {
+      std::cerr << name << " FAILED: " << e.what() << std::endl;
+      ++failures;
+    }
+  };
+  check("counting", testCounting);
+  check("http", [&server] { testSteadyState(server.http()); });
+  check("https", [&server] { testSteadyState(server.https()); });
+  return failures;
+}
@@ -0,0 +1,140 @@
+/// Tests the co_await API (AsyncHTTP and AsyncJobRunner) against the local
+/// test server. Only built with the CO_AWAIT option
+#include <RESTClient/base/logger.hpp>
+#include <RESTClient/jobManagement/AsyncJobRunner.hpp>
+#include <testServer/TestServer.hpp>
+
+#include <iostream>
+#include <sstream>
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+using namespace RESTClient;
+
+asio::awaitable<bool> testGets(const std::string &name,
+                               const HostInfo &hostInfo, AsyncHTTP &server) {
+  HTTPResponse response = co_await server.get("/bytes/100");
+  EQ(std::string(response.body).size(), 100);
+  // Chunked
+  response = co_await server.get("/stream-bytes/100000");
+  EQ(std::string(response.body).substr(0, 4), "abcd");
+  EQ(response.timings.decodedBodyBytes, 100000);
+  // Gzipped
+  response = co_await server.get("/gzip");
+  EQ((std::string(response.body).find("\"gzipped\": true") !=
+      std::string::npos),
+     true);
+  // Errors throw
+  bool threw = false;
+  try {
+    co_await server.get("/status/404");
+  } catch (HTTPError &e) {
+    threw = true;
+    EQ(e.code, 404);
+  }
+  EQ(threw, true);
+  co_return true;
+}
+
+asio::awaitable<bool> testPost(const std::string &name,
+                               const HostInfo &hostInfo, AsyncHTTP &server) {
+  HTTPResponse response = co_await server.post("/post", "This is some data");
+  EQ((std::string(response.body).find("This is some data") !=
+      std::string::npos),
+     true);
+  co_return true;
+}
+
+/// A gzipped body handed over as it comes, with a pause that holds it up
+asio::awaitable<bool> testStreamed(const std::string &name,
+                                   const HostInfo &hostInfo,
+                                   AsyncHTTP &server) {
+  size_t received = 0;
+  size_t atPause = 0;
+  size_t atResume = 0;
+  StreamedBody *streamed = nullptr;
+  auto &io_service = Services::instance().io_service;
+  StreamedBody body(nullptr, [&](std::string_view data) {
+    received += data.size();
+    if (atPause != 0)
+      return;
+    atPause = received;
+    streamed->pause();
+    asio::co_spawn(
+        io_service,
+        [&]() -> asio::awaitable<void> {
+          asio::steady_timer wait(io_service);
+          wait.expires_from_now(std::chrono::milliseconds(50));
+          co_await wait.async_wait(asio::use_awaitable);
+          atResume = received;
+          streamed->resume();
+        },
+        asio::detached);
+  });
+  streamed = &body;
+  HTTPRequest request("GET", "/stream-bytes/500000?gzip=1");
+  HTTPResponse response;
+  co_await server.action(request, response, body);
+  EQ(received, 500000);
+  EQ(atResume, atPause);
+  co_return true;
+}
+
+int main(int argc, char *argv[]) {
+  TestServer server;
+  Services::instance().trustCertificate(TestServer::certificateFile());
+  HostInfo http = server.http();
+  HostInfo https = server.https();
+  AsyncJobRunner runner;
+  int passed = 0;
+  auto counted = [&passed](AsyncJobFunction test) -> AsyncJobFunction {
+    return [&passed, test](const std::string &name, const HostInfo &hostInfo,
+                           AsyncHTTP &server) -> asio::awaitable<bool> {
+      bool ok = co_await test(name, hostInfo, server);
+      LOG_INFO(name << " PASSED");
+      ++passed;
+      co_return ok;
+    };
+  };
+  runner.queue({"GETs - no ssl", http, counted(testGets)});
+  runner.queue({"GETs - ssl", https, counted(testGets)});
+  runner.queue({"POST - no ssl", http, counted(testPost)});
+  runner.queue({"POST - ssl", https, counted(testPost)});
+  runner.queue({"streamed - ssl", https, counted(testStreamed)});
+  // Lots of small requests over a few connections
+  const int small = 200;
+  for (int i = 0; i != small; ++i)
+    runner.queue({"small", http,
+                  counted([](const std::string &, const HostInfo &,
+                             AsyncHTTP &server) -> asio::awaitable<bool> {
+                    HTTPResponse response;
+                    co_await server.get("/bytes/64", response);
+                    EQ(response.timings.decodedBodyBytes, 64);
+                    co_return true;
+                  })});
+  // Queued from inside a job, for a host that had no jobs when we started
+  TestServer other;
+  HostInfo otherHost = other.http();
+  runner.queue(
+      {"queues another", http,
+       counted([&](const std::string &, const HostInfo &,
+                   AsyncHTTP &) -> asio::awaitable<bool> {
+         runner.queue({"queued while running", otherHost, counted(testGets)});
+         co_return true;
+       })});
+  runner.run(8);
+  const int total = small + 7;
+  std::cout << passed << " of " << total << " passed" << std::endl;
+  return passed == total ? 0 : 1;
+}
@@ -1,9 +1,19 @@
 #include <RESTClient/base/logger.hpp>
 #include <RESTClient/http/HTTP.hpp>
+#include <RESTClient/http/DiskCache.hpp>
+#include <RESTClient/http/RequestCoalescer.hpp>
+#include <RESTClient/http/RequestTemplate.hpp>
+#include <RESTClient/http/ResponseCache.hpp>
 #include <RESTClient/http/Services.hpp>
 #include <RESTClient/jobManagement/JobRunner.hpp>
+#include <testServer/TestServer.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 
 #include <boost/regex.hpp>
@@ -25,7 +35,7 @@ bool testGet(const std::string &name, const RESTClient::HostInfo &hostinfo,
     LOG_DEBUG("testGet - no file: ");
   }
   // Check it
-  std::string shouldContain("httpbin.org/get");
+  std::string shouldContain(hostinfo.hostHeader() + "/get");
   response.body.flush();
   std::string body = response.body;
   if (!boost::algorithm::contains(body, shouldContain)) {
@@ -122,7 +132,7 @@ bool testDelete(const std::string &name, const RESTClient::HostInfo &hostInfo,
                 RESTClient::HTTP &server, bool fromFile) {
   LOG_TRACE(name << " starting....")
   RESTClient::HTTPResponse response = server.del("/delete");
-  std::string shouldContain("httpbin.org/delete");
+  std::string shouldContain(hostInfo.hostHeader() + "/delete");
   std::string body = response.body;
   assert(boost::algorithm::contains(body, shouldContain));
   LOG_INFO(name << " PASSED");
@@ -142,11 +152,604 @@ bool testGZIPGet(const std::string &name, const RESTClient::HostInfo &hostInfo,
   response.body.flush();
   std::string body = response.body;
   if (!boost::algorithm::contains(body, shouldContain)) {
-    LOG_ERROR(name << " FAILED: "
-                   << "Expected repsonse to contain '" << shouldContain << "'"
-                   << std::endl << "This is what we got: '" << body << "'");
-    return false;
+    std::stringstream msg;
+    msg << name << " FAILED: "
+        << "Expected repsonse to contain '" << shouldContain << "'"
+        << std::endl << "This is what we got: '" << body << "'";
+    throw std::runtime_error(msg.str());
+  }
+  LOG_INFO(name << " PASSED");
+  return true;
+}
+
+/// Streams a big body without keeping it, pausing half way through to check
+/// nothing more arrives until it's resumed
+bool testStreamedGet(const std::string &name,
+                     const RESTClient::HostInfo &hostInfo,
+                     RESTClient::HTTP &server, bool gzip) {
+  LOG_TRACE(name << " starting....")
+  const size_t size = 4 * 1024 * 1024;
+  int code = 0;
+  size_t received = 0;
+  size_t atPause = 0;
+  size_t atResume = 0;
+  RESTClient::StreamedBody *streamed = nullptr;
+  auto &io_service = RESTClient::Services::instance().io_service;
+  RESTClient::StreamedBody body(
+      [&](const RESTClient::HTTPResponse &response) { code = response.code; },
+      [&](std::string_view data) {
+        if (code == 0)
+          throw std::runtime_error("Body before headers");
+        for (char c : data)
+          if (c != 'a' + (received++ % 26))
+            throw std::runtime_error("Wrong byte in the streamed body");
+        if ((atPause != 0) || (received < size / 2))
+          return;
+        // Let it sit for a while, then carry on
+        atPause = received;
+        streamed->pause();
+        asio::spawn(io_service, [&](asio::yield_context yield) {
+          asio::steady_timer wait(io_service);
+          wait.expires_from_now(std::chrono::milliseconds(100));
+          wait.async_wait(yield);
+          atResume = received;
+          streamed->resume();
+        });
+      });
+  streamed = &body;
+  RESTClient::HTTPRequest request(
+      "GET", "/stream-bytes/" + std::to_string(size) + (gzip ? "?gzip=1" : ""));
+  RESTClient::HTTPResponse response;
+  server.action(request, response, body);
+  if ((code != 200) || (received != size) || (atPause == 0) ||
+      (atResume != atPause) || (std::string(response.body).size() != 0) ||
+      (response.timings.decodedBodyBytes != size)) {
+    std::stringstream msg;
+    msg << name << " FAILED: code " << code << ", received " << received
+        << ", paused at " << atPause << ", resumed at " << atResume;
+    throw std::runtime_error(msg.str());
+  }
+  // The connection is still good for the next one
+  response = server.get("/get");
+  LOG_INFO(name << " PASSED");
+  return true;
+}
+
+/// POSTs a body that isn't a string of ours: someone else's memory, a mapped
+/// file, or bytes made as they're sent. A source of unknown size goes in
+/// chunks
+bool testPostBodyKinds(const std::string &name,
+                       const RESTClient::HostInfo &hostInfo,
+                       RESTClient::HTTP &server,
+                       RESTClient::HTTPBody::Kind kind) {
+  LOG_TRACE(name << " starting....")
+  using Kind = RESTClient::HTTPBody::Kind;
+  const std::string source(20 * 1000, 'x');
+  RESTClient::HTTPRequest request("POST", "/post");
+  if (kind == Kind::view) {
+    request.body.initWithView(source);
+  } else if (kind == Kind::mapped) {
+    {
+      std::ofstream f(name);
+      f << source;
+    }
+    request.body.initWithMappedFile(name);
+  } else {
+    size_t made = 0;
+    request.body.initWithGenerator([&](char *out, size_t size) {
+      size = std::min(size, source.size() - made);
+      std::fill(out, out + size, 'x');
+      made += size;
+      return size;
+    });
+  }
+  if ((kind != Kind::source) && (request.body.size() != (long)source.size()))
+    throw std::runtime_error("Wrong body size");
+  RESTClient::HTTPResponse response = server.action(request);
+  if (response.body.kind() != Kind::buffer)
+    throw std::runtime_error("Response isn't a buffer");
+  // Moves out, leaving the response empty
+  std::string body = response.body.take();
+  if ((body.find("\"data\": \"" + source + "\"") == std::string::npos) ||
+      (response.body.size() != 0)) {
+    std::stringstream msg;
+    msg << name << " FAILED. Response: " << body.substr(0, 500);
+    throw std::runtime_error(msg.str());
+  }
+  LOG_INFO(name << " PASSED");
+  return true;
+}
+
+/// A sized POST whose generator throws part way through the body. The server
+/// is still waiting for the rest, so the connection must go, and the next
+/// request on it must get its own response
+bool testAbandonedRequest(const std::string &name,
+                          const RESTClient::HostInfo &hostInfo,
+                          RESTClient::HTTP &server) {
+  LOG_TRACE(name << " starting....")
+  // Connected, so there's something to abandon
+  server.get("/get");
+  const size_t size = 200 * 1000;
+  size_t made = 0;
+  RESTClient::HTTPRequest request("POST", "/post");
+  request.body.initWithGenerator(
+      [&](char *out, size_t wanted) -> size_t {
+        if (made >= size / 2)
+          throw std::runtime_error("Generator gave up");
+        wanted = std::min(wanted, size - made);
+        std::fill(out, out + wanted, 'g');
+        made += wanted;
+        return wanted;
+      },
+      size);
+  bool threw = false;
+  try {
+    server.action(request);
+  } catch (std::runtime_error &) {
+    threw = true;
   }
+  if (!threw || server.is_open())
+    throw std::runtime_error(name + " FAILED. Half sent request left open");
+  RESTClient::HTTPResponse response = server.get("/get");
+  if (std::string(response.body).find(hostInfo.hostHeader() + "/get") ==
+      std::string::npos)
+    throw std::runtime_error(name + " FAILED. Next response: " +
+                             std::string(response.body));
+  LOG_INFO(name << " PASSED");
+  return true;
+}
+
+/// Requests made from a template: its headers and path prefix go with each,
+/// along with the request's own path, headers and body
+bool testTemplate(const std::string &name, const RESTClient::HostInfo &hostInfo,
+                  RESTClient::HTTP &server) {
+  LOG_TRACE(name << " starting....")
+  RESTClient::RequestTemplate account(hostInfo, "/anything/v1/account",
+                                      {{"X-Auth-Token", "secret"}});
+  for (const std::string &data : {"", "first", "second one"}) {
+    RESTClient::HTTPRequest request(account, "POST", "/container",
+                                    {{"X-Object-Meta-Test", data.c_str()}},
+                                    data);
+    RESTClient::HTTPResponse response = server.action(request);
+    std::string body = response.body;
+    std::vector<std::string> wanted{
+        "\"method\": \"POST\"",
+        "\"url\": \"" + hostInfo.protocol + "://" + hostInfo.hostHeader() +
+            "/anything/v1/account/container\"",
+        "\"X-Auth-Token\": \"secret\"",
+        "\"X-Object-Meta-Test\": \"" + data + "\"",
+        "\"Content-Length\": \"" + std::to_string(data.size()) + "\"",
+        "\"data\": \"" + data + "\""};
+    for (const std::string &expected : wanted)
+      if (body.find(expected) == std::string::npos) {
+        std::stringstream msg;
+        msg << name << " FAILED. Expected " << expected
+            << " in response: " << body;
+        throw std::runtime_error(msg.str());
+      }
+  }
+  LOG_INFO(name << " PASSED");
+  return true;
+}
+
+/// tryGet tells of every status, and of replies it couldn't read, without
+/// throwing. throwIfFailed throws for them as action() would
+bool testOutcomes(const std::string &name, const RESTClient::HostInfo &hostInfo,
+                  RESTClient::HTTP &server) {
+  LOG_TRACE(name << " starting....")
+  RESTClient::HTTPResponse response;
+  auto expect = [&](const char *path, int code, bool ok) {
+    RESTClient::HTTPOutcome outcome = server.tryGet(path, response);
+    if ((outcome.code != code) || (outcome.ok() != ok) ||
+        (bool(outcome) != ok) || (outcome.responded() != (code != 0)) ||
+        (outcome.response != &response)) {
+      std::stringstream msg;
+      msg << name << " FAILED. " << path << " came to " << outcome.code
+          << " (" << outcome.error << ")";
+      throw std::runtime_error(msg.str());
+    }
+    return outcome;
+  };
+  expect("/status/200", 200, true).throwIfFailed();
+  expect("/status/201", 201, true).throwIfFailed();
+  expect("/status/204", 204, true);
+  auto notFound = expect("/status/404", 404, false);
+  bool threw = false;
+  try {
+    notFound.throwIfFailed();
+  } catch (RESTClient::HTTPError &e) {
+    threw = e.code == 404;
+  }
+  // A reply we can't parse is no response at all
+  auto malformed = expect("/malformed", 0, false);
+  if (malformed.error.empty() || !malformed.failure)
+    throw std::runtime_error(name + " FAILED. No error for a bad reply");
+  try {
+    malformed.throwIfFailed();
+    threw = false;
+  } catch (RESTClient::HTTPError &) {
+    threw = false;
+  } catch (std::runtime_error &) {
+  }
+  // And the connection is good for the next one
+  expect("/status/200", 200, true);
+  if (!threw)
+    throw std::runtime_error(name + " FAILED. throwIfFailed didn't throw");
+  LOG_INFO(name << " PASSED");
+  return true;
+}
+
+/// GETs the /cached route twice with each of: a long max-age, no max-age but
+/// an ETag, and no caching headers at all
+bool testCache(const std::string &name, const RESTClient::HostInfo &hostInfo,
+               RESTClient::HTTP &server) {
+  LOG_TRACE(name << " starting....")
+  auto cache = std::make_shared<RESTClient::ResponseCache>();
+  server.useCache(cache);
+  RESTClient::HTTPResponse first;
+  RESTClient::HTTPResponse second;
+  auto twice = [&](const std::string &path, bool fromCache, bool onWire) {
+    server.get(path, first);
+    server.get(path, second);
+    if (first.timings.fromCache || (second.timings.fromCache != fromCache) ||
+        ((second.timings.wireBytesReceived != 0) != onWire) ||
+        (second.code != 200) ||
+        (std::string(first.body) != std::string(second.body))) {
+      std::stringstream msg;
+      msg << name << " FAILED. " << path << " came from the cache: "
+          << second.timings.fromCache << " with "
+          << second.timings.wireBytesReceived << " bytes read. First body: "
+          << first.body << " second body: " << second.body;
+      throw std::runtime_error(msg.str());
+    }
+  };
+  // Served without asking
+  twice("/cached/fresh?max_age=60", true, false);
+  // Asked about, and told it's Not Modified
+  twice("/cached/stale", true, true);
+  // Nothing to go on, so not kept
+  twice("/status/200", false, true);
+  server.useCache(nullptr);
+  RESTClient::CacheStats stats = cache->stats();
+  if ((stats.hits != 1) || (stats.revalidations != 1) || (stats.misses != 4) ||
+      (stats.entries != 2)) {
+    std::stringstream msg;
+    msg << name << " FAILED. Hits: " << stats.hits
+        << " revalidations: " << stats.revalidations
+        << " misses: " << stats.misses << " entries: " << stats.entries;
+    throw std::runtime_error(msg.str());
+  }
+  // Served from the cache's own copy
+  server.useCache(cache);
+  server.get("/cached/fresh?max_age=60", second);
+  server.useCache(nullptr);
+  if (second.body.kind() != RESTClient::HTTPBody::Kind::view)
+    throw std::runtime_error(name + " FAILED. Cached body was copied");
+  // Meant for one user only, so never kept
+  auto shared = std::make_shared<RESTClient::ResponseCache>();
+  server.useCache(shared);
+  server.get("/cached/private?max_age=60&private=1", first);
+  server.get("/cached/private?max_age=60&private=1", second);
+  if (second.timings.fromCache ||
+      (std::string(first.body) == std::string(second.body)))
+    throw std::runtime_error(name + " FAILED. A private response was kept");
+  // Each token gets its own copy
+  auto asUser = [&](const char *token, RESTClient::HTTPResponse &out) {
+    RESTClient::RequestTemplate user(hostInfo, "", {{"X-Auth-Token", token}});
+    RESTClient::HTTPRequest request(user, "GET", "/cached/tokens?max_age=60");
+    server.action(request, out);
+  };
+  RESTClient::HTTPResponse third;
+  asUser("a", first);
+  asUser("b", second);
+  asUser("a", third);
+  server.useCache(nullptr);
+  if (second.timings.fromCache || !third.timings.fromCache ||
+      (std::string(first.body) == std::string(second.body)) ||
+      (std::string(first.body) != std::string(third.body)) ||
+      (shared->stats().entries != 2)) {
+    std::stringstream msg;
+    msg << name << " FAILED. Token b came from the cache: "
+        << second.timings.fromCache << " with " << second.body
+        << ". Token a again came from the cache: " << third.timings.fromCache
+        << " with " << third.body << " after " << first.body;
+    throw std::runtime_error(msg.str());
+  }
+  // Room for two responses in one shard: a third evicts the least recently
+  // used
+  auto small = std::make_shared<RESTClient::ResponseCache>(3000, 1);
+  server.useCache(small);
+  auto get = [&](const std::string &which) {
+    server.get("/cached/lru-" + which + "?max_age=60&size=1000", first);
+    return first.timings.fromCache;
+  };
+  get("a");
+  get("b");
+  bool a = get("a");
+  get("c");
+  bool b = get("b");
+  server.useCache(nullptr);
+  stats = small->stats();
+  if (!a || b || (stats.evictions != 2) || (stats.entries != 2) ||
+      (stats.bytes > 3000)) {
+    std::stringstream msg;
+    msg << name << " FAILED. Kept a: " << a << " kept b: " << b
+        << " evictions: " << stats.evictions << " entries: " << stats.entries
+        << " bytes: " << stats.bytes;
+    throw std::runtime_error(msg.str());
+  }
+  LOG_INFO(name << " PASSED");
+  return true;
+}
+
+/// Like testCache, but into files through a DiskCache, which a new DiskCache
+/// on the same directory (as in a restarted process) carries on with
+bool testDiskCache(const std::string &name,
+                   const RESTClient::HostInfo &hostInfo,
+                   RESTClient::HTTP &server) {
+  LOG_TRACE(name << " starting....")
+  const std::string directory = name + " cache";
+  std::filesystem::remove_all(directory);
+  auto contents = [](const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), {});
+  };
+  auto twice = [&](const std::string &path, bool onWire) {
+    auto first = server.getToFile(path, name + " first");
+    auto second = server.getToFile(path, name + " second");
+    if (first.timings.fromCache || !second.timings.fromCache ||
+        ((second.timings.wireBytesReceived != 0) != onWire) ||
+        (second.code != 200) || (second.body.size() != 100 * 1000 + 20) ||
+        (contents(name + " first") != contents(name + " second"))) {
+      std::stringstream msg;
+      msg << name << " FAILED. " << path << " came from the cache: "
+          << second.timings.fromCache << " with "
+          << second.timings.wireBytesReceived
+          << " bytes read, and a body of " << second.body.size();
+      throw std::runtime_error(msg.str());
+    }
+  };
+  auto check = [&](const RESTClient::CacheStats &stats, uint64_t hits,
+                   uint64_t revalidations, uint64_t misses) {
+    if ((stats.hits != hits) || (stats.revalidations != revalidations) ||
+        (stats.misses != misses) || (stats.entries != 2)) {
+      std::stringstream msg;
+      msg << name << " FAILED. Hits: " << stats.hits
+          << " revalidations: " << stats.revalidations
+          << " misses: " << stats.misses << " entries: " << stats.entries;
+      throw std::runtime_error(msg.str());
+    }
+  };
+  // Padded so the bodies are all the same size
+  const std::string fresh = "/cached/disk-fresh?max_age=60&size=100000";
+  const std::string stale = "/cached/disk-stale?size=100000";
+  std::string kept;
+  {
+    auto cache = std::make_shared<RESTClient::DiskCache>(directory);
+    server.useDiskCache(cache);
+    twice(fresh, false);
+    kept = contents(name + " first");
+    twice(stale, true);
+    server.useDiskCache(nullptr);
+    check(cache->stats(), 1, 1, 2);
+  }
+  auto cache = std::make_shared<RESTClient::DiskCache>(directory);
+  server.useDiskCache(cache);
+  auto again = server.getToFile(fresh, name + " again");
+  server.useDiskCache(nullptr);
+  if (!again.timings.fromCache ||
+      (contents(name + " again") != kept))
+    throw std::runtime_error(name + " FAILED. Not kept for the next process");
+  check(cache->stats(), 1, 0, 0);
+  std::filesystem::remove_all(directory);
+  // Room for two bodies: a third evicts the least recently used
+  {
+    auto small = std::make_shared<RESTClient::DiskCache>(directory, 250000);
+    server.useDiskCache(small);
+    auto get = [&](const std::string &which) {
+      return server
+          .getToFile("/cached/disk-lru-" + which + "?max_age=60&size=100000",
+                     name + " lru")
+          .timings.fromCache;
+    };
+    get("a");
+    get("b");
+    bool a = get("a");
+    get("c");
+    bool b = get("b");
+    server.useDiskCache(nullptr);
+    RESTClient::CacheStats stats = small->stats();
+    if (!a || b || (stats.evictions != 2) || (stats.entries != 2) ||
+        (stats.bytes > 250000)) {
+      std::stringstream msg;
+      msg << name << " FAILED. Kept a: " << a << " kept b: " << b
+          << " evictions: " << stats.evictions
+          << " entries: " << stats.entries << " bytes: " << stats.bytes;
+      throw std::runtime_error(msg.str());
+    }
+  }
+  std::filesystem::remove_all(directory);
+  // Neither private responses, nor one token's response for another token
+  {
+    auto cache = std::make_shared<RESTClient::DiskCache>(directory);
+    server.useDiskCache(cache);
+    auto asUser = [&](const char *token, const std::string &path) {
+      RESTClient::RequestTemplate user(hostInfo, "",
+                                       {{"X-Auth-Token", token}});
+      RESTClient::HTTPRequest request(user, "GET", path);
+      return server.action(request, name + " user");
+    };
+    const std::string tokens = "/cached/disk-tokens?max_age=60";
+    const std::string mine = "/cached/disk-private?max_age=60&private=1";
+    bool a = asUser("a", tokens).timings.fromCache;
+    std::string aBody = contents(name + " user");
+    bool b = asUser("b", tokens).timings.fromCache;
+    std::string bBody = contents(name + " user");
+    bool again = asUser("a", tokens).timings.fromCache;
+    std::string againBody = contents(name + " user");
+    asUser("a", mine);
+    bool kept = asUser("a", mine).timings.fromCache;
+    server.useDiskCache(nullptr);
+    if (a || b || !again || kept || (aBody == bBody) ||
+        (aBody != againBody) || (cache->stats().entries != 2)) {
+      std::stringstream msg;
+      msg << name << " FAILED. Token b came from the cache: " << b
+          << " with " << bBody << ". Token a again came from the cache: "
+          << again << " with " << againBody << " after " << aBody
+          << ". Private kept: " << kept;
+      throw std::runtime_error(msg.str());
+    }
+  }
+  std::filesystem::remove_all(directory);
+  for (const char *file : {" first", " second", " again", " lru", " user"})
+    std::filesystem::remove(name + file);
+  LOG_INFO(name << " PASSED");
+  return true;
+}
+
+/// GETs a slow /cached path on several connections at once, through one
+/// coalescer. Only one should reach the server, and all should get its body
+bool testCoalesced(const std::string &name,
+                   const RESTClient::HostInfo &hostInfo,
+                   RESTClient::HTTP &server) {
+  LOG_TRACE(name << " starting....")
+  auto coalescer = std::make_shared<RESTClient::RequestCoalescer>();
+  const std::string path = "/cached/coalesced-" +
+                           std::string(hostInfo.is_ssl() ? "ssl" : "plain") +
+                           "?delay_ms=300";
+  // Never shared between different credentials
+  RESTClient::RequestTemplate account(hostInfo, "", {{"X-Auth-Token", "a"}});
+  RESTClient::HTTPRequest mine(account, "GET", path);
+  RESTClient::HTTPRequest theirs("GET", path, {{"X-Auth-Token", "b"}});
+  RESTClient::HTTPRequest anyone("GET", path);
+  if ((coalescer->key(hostInfo, mine) == coalescer->key(hostInfo, theirs)) ||
+      (coalescer->key(hostInfo, mine) == coalescer->key(hostInfo, anyone)))
+    throw std::runtime_error(name + " FAILED. Credentials not in the key");
+  const int others = 3;
+  std::vector<RESTClient::HTTPResponse> responses(others + 1);
+  std::vector<std::string> failures;
+  int done = 0;
+  auto &io_service = RESTClient::Services::instance().io_service;
+  for (int i = 0; i != others; ++i)
+    asio::spawn(io_service, [&, i](asio::yield_context yield) {
+      try {
+        RESTClient::HTTP other(hostInfo, yield);
+        other.useCoalescer(coalescer);
+        other.get(path, responses[i]);
+        other.close();
+      } catch (std::exception &e) {
+        failures.push_back(e.what());
+      }
+      ++done;
+    });
+  server.useCoalescer(coalescer);
+  server.get(path, responses[others]);
+  server.useCoalescer(nullptr);
+  // The one that made the flight may still be finishing; a slow request lets
+  // it, as we've no yield of our own to wait with
+  for (int waits = 0; (done != others) && (waits != 100); ++waits)
+    server.get("/status/200?delay_ms=10");
+  RESTClient::CoalescerStats stats = coalescer->stats();
+  int shared = 0;
+  for (const auto &response : responses)
+    if (response.timings.coalesced && (response.timings.wireBytesReceived == 0))
+      ++shared;
+  std::string body = responses.front().body;
+  bool same = std::all_of(responses.begin(), responses.end(),
+                          [&](const auto &response) {
+                            return (response.code == 200) &&
+                                   (std::string(response.body) == body);
+                          });
+  if (!failures.empty() || (done != others) || !same ||
+      (shared != others) || (stats.flights != 1) ||
+      (stats.joined != others)) {
+    std::stringstream msg;
+    msg << name << " FAILED. Failures: " << failures.size()
+        << " finished: " << done << " same bodies: " << same
+        << " shared: " << shared << " flights: " << stats.flights
+        << " joined: " << stats.joined;
+    throw std::runtime_error(msg.str());
+  }
+  LOG_INFO(name << " PASSED");
+  return true;
+}
+
+/// POSTs a header, a mapped file and a footer, with a pulled piece in the
+/// middle. With 'sized' pieces it has a Content-Length; without, it's chunked
+/// and bigger than a round, so it takes a few
+bool testPostGathered(const std::string &name,
+                      const RESTClient::HostInfo &hostInfo,
+                      RESTClient::HTTP &server, bool sized) {
+  LOG_TRACE(name << " starting....")
+  const std::string contents(100 * 1000, 'f');
+  {
+    std::ofstream f(name);
+    f << contents;
+  }
+  const size_t pulledSize = 70 * 1000;
+  size_t pulled = 0;
+  RESTClient::BodySource source;
+  source.add("<header>")
+      .addFile(name)
+      .add(
+          [&](char *out, size_t size) {
+            size = std::min(size, pulledSize - pulled);
+            std::fill(out, out + size, 'p');
+            pulled += size;
+            return size;
+          },
+          sized ? pulledSize : -1)
+      .addCopy(std::string("<footer>"));
+  RESTClient::HTTPRequest request("POST", "/post");
+  request.body.initWithSource(std::move(source));
+  long size = 8 + contents.size() + pulledSize + 8;
+  if (request.body.size() != (sized ? size : -1))
+    throw std::runtime_error("Wrong body size");
+  RESTClient::HTTPResponse response = server.action(request);
+  std::string expected = "\"data\": \"<header>" + contents +
+                         std::string(pulledSize, 'p') + "<footer>\"";
+  if (std::string(response.body).find(expected) == std::string::npos) {
+    std::stringstream msg;
+    msg << name << " FAILED. Response: "
+        << std::string(response.body).substr(0, 500);
+    throw std::runtime_error(msg.str());
+  }
+  LOG_INFO(name << " PASSED");
+  return true;
+}
+
+/// POSTs a pulled piece that says it's bigger than it turns out to be. The
+/// head has promised its size, so the request must fail rather than leave
+/// the server waiting
+bool testPostShortPiece(const std::string &name,
+                        const RESTClient::HostInfo &hostInfo,
+                        RESTClient::HTTP &server) {
+  LOG_TRACE(name << " starting....")
+  const size_t promised = 50 * 1000;
+  size_t pulled = 0;
+  RESTClient::BodySource source;
+  source.add("<header>")
+      .add(
+          [&](char *out, size_t size) {
+            size = std::min(size, promised / 2 - pulled);
+            std::fill(out, out + size, 'p');
+            pulled += size;
+            return size;
+          },
+          promised)
+      .add("<footer>");
+  RESTClient::HTTPRequest request("POST", "/post");
+  request.body.initWithSource(std::move(source));
+  std::string error;
+  try {
+    server.action(request);
+  } catch (std::runtime_error &e) {
+    error = e.what();
+  }
+  if (error.find("short") == std::string::npos)
+    throw std::runtime_error(name + " FAILED. Error: " + error);
+  // And the connection is good for the next one
+  server.get("/get");
   LOG_INFO(name << " PASSED");
   return true;
 }
@@ -155,8 +758,39 @@ int main(int argc, char *argv[]) {
 
   using namespace std::placeholders;
 
-  RESTClient::HostInfo http("http://httpbin.org");
-  RESTClient::HostInfo https("https://httpbin.org");
+  // Everything runs against a local stand in for httpbin.org
+  RESTClient::TestServer server;
+  RESTClient::Services::instance().trustCertificate(
+      RESTClient::TestServer::certificateFile());
+  // A reply with a header line that isn't one
+  server.route("/malformed", [](const RESTClient::TestRequest &,
+                                RESTClient::TestResponse &response) {
+    response.reason = "OK\r\nNot a header";
+  });
+  // Each GET has a new body, unless it's Not Modified
+  server.route("/cached", [](const RESTClient::TestRequest &request,
+                             RESTClient::TestResponse &response) {
+    static std::atomic<int> served{0};
+    std::string etag = "\"" + request.path + "\"";
+    response.headers["ETag"] = etag;
+    auto maxAge = request.query.find("max_age");
+    if (maxAge != request.query.end())
+      response.headers["Cache-Control"] = "max-age=" + maxAge->second;
+    if (request.query.count("private"))
+      response.headers["Cache-Control"].insert(0, "private, ");
+    auto condition = request.headers.find("If-None-Match");
+    if ((condition != request.headers.end()) && (condition->second == etag)) {
+      response.code = 304;
+      response.reason = "Not Modified";
+      return;
+    }
+    response.body = request.path + " " + std::to_string(++served);
+    auto size = request.query.find("size");
+    if (size != request.query.end())
+      response.body.resize(std::stoul(size->second) + 20, '.');
+  });
+  RESTClient::HostInfo http = server.http();
+  RESTClient::HostInfo https = server.https();
 
   std::vector<RESTClient::QueuedJob> tests(
       {// HTTP get
@@ -198,7 +832,47 @@ int main(int argc, char *argv[]) {
        {"GET gzip -Length - ssl - no file", https,
         std::bind(testGZIPGet, _1, _2, _3, false)},
        {"GET gzip -Length - ssl - file", https,
-        std::bind(testGZIPGet, _1, _2, _3, true)}});
+        std::bind(testGZIPGet, _1, _2, _3, true)},
+       // Bodies that aren't strings
+       {"POST view - no ssl", http,
+        std::bind(testPostBodyKinds, _1, _2, _3,
+                  RESTClient::HTTPBody::Kind::view)},
+       {"POST mapped file - ssl", https,
+        std::bind(testPostBodyKinds, _1, _2, _3,
+                  RESTClient::HTTPBody::Kind::mapped)},
+       {"POST generated - no ssl", http,
+        std::bind(testPostBodyKinds, _1, _2, _3,
+                  RESTClient::HTTPBody::Kind::source)},
+       {"POST generated - ssl", https,
+        std::bind(testPostBodyKinds, _1, _2, _3,
+                  RESTClient::HTTPBody::Kind::source)},
+       {"POST gathered - no ssl - sized", http,
+        std::bind(testPostGathered, _1, _2, _3, true)},
+       {"POST gathered - ssl - chunked", https,
+        std::bind(testPostGathered, _1, _2, _3, false)},
+       {"POST short piece - no ssl", http, testPostShortPiece},
+       {"POST short piece - ssl", https, testPostShortPiece},
+       // Outcomes instead of exceptions
+       {"Outcomes - no ssl", http, testOutcomes},
+       {"Outcomes - ssl", https, testOutcomes},
+       // A request that fails part way through being sent
+       {"Abandoned request - no ssl", http, testAbandonedRequest},
+       {"Abandoned request - ssl", https, testAbandonedRequest},
+       // Made from a template
+       {"Template - no ssl", http, testTemplate},
+       {"Template - ssl", https, testTemplate},
+       // In front of the server
+       {"Cache - no ssl", http, testCache},
+       {"Cache - ssl", https, testCache},
+       {"Disk cache - no ssl", http, testDiskCache},
+       {"Disk cache - ssl", https, testDiskCache},
+       {"Coalesced - no ssl", http, testCoalesced},
+       {"Coalesced - ssl", https, testCoalesced},
+       // Streamed to callbacks, with backpressure
+       {"GET streamed - no ssl", http,
+        std::bind(testStreamedGet, _1, _2, _3, false)},
+       {"GET streamed - ssl - gzip", https,
+        std::bind(testStreamedGet, _1, _2, _3, true)}});
 
   RESTClient::JobRunner jobs;
 
@@ -207,19 +881,31 @@ int main(int argc, char *argv[]) {
   for (int i = 1; i < argc; ++i)
     regexs.push_back(boost::regex(argv[i]));
 
-  if (regexs.size() != 0)
-    for (auto &job : tests) {
-      for (auto &regex : regexs)
-        if (boost::regex_search(job.name, regex)) {
-          jobs.queue(job.hostInfo).emplace(std::move(job));
-          break;
-        }
+  std::vector<std::pair<std::string, std::future<bool>>> results;
+  for (auto &job : tests) {
+    bool wanted = regexs.empty();
+    for (auto &regex : regexs)
+      if (boost::regex_search(job.name, regex)) {
+        wanted = true;
+        break;
+      }
+    if (wanted) {
+      std::string name = job.name;
+      results.emplace_back(name, jobs.submit(std::move(job)));
     }
-  else {
-    for (auto &job : tests)
-      jobs.queue(job.hostInfo).emplace(std::move(job));
   }
 
   jobs.run();
-  return 0;
+
+  int failures = 0;
+  for (auto &result : results) {
+    try {
+      if (!result.second.get())
+        ++failures;
+    } catch (std::exception &e) {
+      std::cerr << result.first << " FAILED: " << e.what() << std::endl;
+      ++failures;
+    }
+  }
+  return failures;
 }
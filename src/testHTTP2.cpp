@@ -0,0 +1,166 @@
+/// Tests JobRunner's HTTP/2 mode against the local test server: many requests
+/// in flight over one connection, and falling back to HTTP/1.1
+#include <RESTClient/base/logger.hpp>
+#include <RESTClient/http/RequestTemplate.hpp>
+#include <RESTClient/jobManagement/JobRunner.hpp>
+#include <testServer/TestServer.hpp>
+
+#include <iostream>
+#include <sstream>
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+using namespace RESTClient;
+
+bool testGets(const std::string &name, const HostInfo &hostInfo, HTTP &server) {
+  HTTPResponse response = server.get("/bytes/100");
+  EQ(std::string(response.body), std::string("abcdefghijklmnopqrstuvwxyz")
+                                     .append("abcdefghijklmnopqrstuvwxyz")
+                                     .append("abcdefghijklmnopqrstuvwxyz")
+                                     .append("abcdefghijklmnopqrstuv"));
+  // Lower case names come back title cased
+  EQ(response.headers.count("Content-Length"), 1);
+  // Sent in pieces, with a delay between them
+  response = server.get("/range/1000?chunk_size=100&duration=0.1");
+  EQ(response.timings.decodedBodyBytes, 1000);
+  response = server.get("/gzip");
+  EQ((std::string(response.body).find("\"gzipped\": true") !=
+      std::string::npos),
+     true);
+  // A template's headers and path prefix go too
+  RequestTemplate account(hostInfo, "/anything/v1", {{"X-Auth-Token", "t0k"}});
+  HTTPRequest request(account, "GET", "/container");
+  response = server.action(request);
+  std::string echoed = response.body;
+  EQ((echoed.find("/anything/v1/container\"") != std::string::npos), true);
+  EQ((echoed.find("\"t0k\"") != std::string::npos), true);
+  bool threw = false;
+  try {
+    server.get("/status/404");
+  } catch (HTTPError &e) {
+    threw = true;
+    EQ(e.code, 404);
+  }
+  EQ(threw, true);
+  return true;
+}
+
+bool testPost(const std::string &name, const HostInfo &hostInfo,
+              HTTP &server) {
+  // Bigger than the server's window, so we have to wait for WINDOW_UPDATEs
+  std::string data(300 * 1000, 'x');
+  data.append("the end");
+  HTTPResponse response = server.post("/post", data);
+  EQ((std::string(response.body).find("xxxthe end") != std::string::npos),
+     true);
+  return true;
+}
+
+/// A big body handed over as it comes, pausing part way. While it's paused
+/// nothing more is handed over, and the server runs out of window
+bool testStreamed(const std::string &name, const HostInfo &hostInfo,
+                  HTTP &server) {
+  const size_t size = 1024 * 1024;
+  size_t received = 0;
+  size_t atPause = 0;
+  size_t atResume = 0;
+  StreamedBody *streamed = nullptr;
+  auto &io_service = Services::instance().io_service;
+  StreamedBody body(nullptr, [&](std::string_view data) {
+    received += data.size();
+    if ((atPause != 0) || (received < size / 4))
+      return;
+    atPause = received;
+    streamed->pause();
+    asio::spawn(io_service, [&](asio::yield_context yield) {
+      asio::steady_timer wait(io_service);
+      wait.expires_from_now(std::chrono::milliseconds(100));
+      wait.async_wait(yield);
+      atResume = received;
+      streamed->resume();
+    });
+  });
+  streamed = &body;
+  HTTPRequest request("GET", "/stream-bytes/" + std::to_string(size));
+  HTTPResponse response;
+  server.action(request, response, body);
+  EQ(received, size);
+  EQ(atResume, atPause);
+  EQ(std::string(response.body).size(), 0);
+  return true;
+}
+
+/// A slow GET. If they're all in flight at once, they take no longer than one
+bool testSlow(const std::string &name, const HostInfo &hostInfo,
+              HTTP &server) {
+  HTTPResponse response;
+  server.get("/bytes/64?delay_ms=300", response);
+  EQ(response.timings.decodedBodyBytes, 64);
+  return true;
+}
+
+/// Runs 'slow' slow GETs and the other tests against 'hostInfo'. Returns the
+/// number that failed
+int run(const HostInfo &hostInfo, int slow, Clock::duration &took) {
+  JobRunner runner;
+  runner.http2 = true;
+  std::vector<std::future<bool>> results;
+  results.push_back(runner.submit({"GETs", hostInfo, testGets}));
+  results.push_back(runner.submit({"POST", hostInfo, testPost}));
+  results.push_back(runner.submit({"streamed", hostInfo, testStreamed}));
+  for (int i = 0; i != slow; ++i)
+    results.push_back(runner.submit({"slow", hostInfo, testSlow}));
+  auto start = Clock::now();
+  runner.run(slow);
+  took = Clock::now() - start;
+  int failures = 0;
+  for (auto &result : results) {
+    try {
+      if (!result.get())
+        ++failures;
+    } catch (std::exception &e) {
+      std::cerr << "FAILED: " << e.what() << std::endl;
+      ++failures;
+    }
+  }
+  return failures;
+}
+
+int main(int argc, char *argv[]) {
+  Services::instance().trustCertificate(TestServer::certificateFile());
+  int failures = 0;
+  auto check = [&failures](const char *name, bool ok) {
+    if (!ok) {
+      std::cerr << name << " FAILED" << std::endl;
+      ++failures;
+    }
+  };
+  const int slow = 40;
+  Clock::duration took;
+  {
+    TestServer server;
+    failures += run(server.https(), slow, took);
+    // One connection, and the slow requests all waited at the same time
+    check("one connection", server.connectionsAccepted() == 1);
+    check("concurrent streams", took < std::chrono::seconds(3));
+  }
+  {
+    // A server that only speaks HTTP/1.1
+    TestServerOptions options;
+    options.http2 = false;
+    TestServer server(options);
+    failures += run(server.https(), 4, took);
+    check("fallback", server.connectionsAccepted() > 1);
+    // HTTP/2 is never tried without TLS
+    failures += run(server.http(), 4, took);
+  }
+  std::cout << failures << " failures" << std::endl;
+  return failures;
+}
@@ -0,0 +1,199 @@
+/// Tests a running JobRunner fed from several threads at once: every future
+/// resolves with its job's result or exception, stop() drains whatever is
+/// still pending, queue waits count from submit() and rate limits count
+/// requests
+#include <RESTClient/jobManagement/JobRunner.hpp>
+#include <testServer/TestServer.hpp>
+
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#define EQ(a, b)                                                               \
+  if (a != b) {                                                                \
+    std::stringstream msg;                                                     \
+    msg << "Expected a == b, but it doesn't. a: " << a << " - b: " << b        \
+        << " - Line: " << __LINE__ << " - File: " << __FILE__                  \
+        << " - Function: " << __FUNCTION__;                                    \
+    throw std::runtime_error(msg.str());                                       \
+  }
+
+using namespace RESTClient;
+
+const int producers = 4;
+const int perProducer = 100;
+
+/// What job 'i' does: GETs and succeeds, returns false, or throws
+enum class Outcome { ok, no, thrown };
+
+Outcome outcomeOf(int i) {
+  if (i % 7 == 3)
+    return Outcome::thrown;
+  if (i % 5 == 1)
+    return Outcome::no;
+  return Outcome::ok;
+}
+
+/// A job that does a real GET, then acts out 'outcomeOf(i)'
+QueuedJob makeJob(const HostInfo &hostInfo, int i, std::atomic<int> &ran,
+                  const std::string &path = "/bytes/16") {
+  return {"job " + std::to_string(i), hostInfo,
+          [i, &ran, path](const std::string &name, const HostInfo &,
+                          HTTP &server) {
+            HTTPResponse response;
+            server.get(path, response);
+            EQ(response.timings.decodedBodyBytes, 16);
+            ++ran;
+            if (outcomeOf(i) == Outcome::thrown)
+              throw std::runtime_error(name);
+            return outcomeOf(i) == Outcome::ok;
+          }};
+}
+
+/// Submits 'perProducer' jobs from each of 'producers' threads, all at once,
+/// alternating between 'http' and 'https'. Returns the futures, indexed by job
+std::vector<std::future<bool>> submitAll(JobRunner &runner,
+                                         const HostInfo &http,
+                                         const HostInfo &https,
+                                         std::atomic<int> &ran,
+                                         const std::string &path) {
+  std::vector<std::future<bool>> results(producers * perProducer);
+  std::atomic<int> ready(0);
+  std::vector<std::thread> threads;
+  for (int p = 0; p != producers; ++p)
+    threads.emplace_back([&, p]() {
+      // Start together, so the submissions really do race
+      ++ready;
+      while (ready != producers)
+        std::this_thread::yield();
+      for (int j = 0; j != perProducer; ++j) {
+        int i = p * perProducer + j;
+        results[i] = runner.submit(
+            makeJob((i % 2) ? https : http, i, ran, path));
+      }
+    });
+  for (auto &thread : threads)
+    thread.join();
+  return results;
+}
+
+/// Checks each future against what its job was meant to do
+void checkResults(std::vector<std::future<bool>> &results) {
+  for (size_t i = 0; i != results.size(); ++i) {
+    Outcome expected = outcomeOf(i);
+    try {
+      bool result = results[i].get();
+      EQ(static_cast<int>(expected),
+         static_cast<int>(result ? Outcome::ok : Outcome::no));
+    } catch (std::runtime_error &e) {
+      EQ(static_cast<int>(expected), static_cast<int>(Outcome::thrown));
+      EQ(std::string(e.what()), "job " + std::to_string(i));
+    }
+  }
+}
+
+/// Futures resolve while the runner keeps going
+void testRunning(TestServer &server) {
+  JobRunner runner;
+  runner.start(4);
+  std::atomic<int> ran(0);
+  auto results =
+      submitAll(runner, server.http(), server.https(), ran, "/bytes/16");
+  checkResults(results);
+  EQ(ran, producers * perProducer);
+  // Still running; more work is taken after the first lot is done
+  auto again = runner.submit(makeJob(server.http(), 0, ran));
+  EQ(again.get(), true);
+  runner.stop();
+}
+
+/// stop() waits for everything already submitted, even slow jobs that
+/// haven't started yet
+void testStopDrains(TestServer &server) {
+  JobRunner runner;
+  runner.start(2);
+  std::atomic<int> ran(0);
+  auto results = submitAll(runner, server.http(), server.https(), ran,
+                           "/bytes/16?delay_ms=5");
+  runner.stop();
+  EQ(ran, producers * perProducer);
+  for (auto &result : results)
+    EQ((result.wait_for(std::chrono::seconds(0)) == std::future_status::ready),
+       true);
+  checkResults(results);
+}
+
+/// A job's queue wait counts from submit(), even while the io_service thread
+/// is too busy to sort it into its host's queue
+void testQueueWait(TestServer &server) {
+  JobRunner runner;
+  runner.start(2);
+  std::atomic<bool> busy(false);
+  auto blocker = runner.submit(
+      {"blocker", server.http(),
+       [&busy](const std::string &, const HostInfo &, HTTP &) {
+         busy = true;
+         // Holds up the io_service thread
+         std::this_thread::sleep_for(std::chrono::milliseconds(200));
+         return true;
+       }});
+  while (!busy)
+    std::this_thread::yield();
+  Clock::duration waited;
+  auto waiter = runner.submit(
+      {"waiter", server.https(),
+       [&waited](const std::string &, const HostInfo &, HTTP &server) {
+         HTTPResponse response;
+         server.get("/bytes/16", response);
+         waited = response.timings.queueWait;
+         return true;
+       }});
+  EQ(blocker.get(), true);
+  EQ(waiter.get(), true);
+  runner.stop();
+  EQ((waited >= std::chrono::milliseconds(100)), true);
+}
+
+/// A host's request rate counts every request, not every job
+void testRateLimit(TestServer &server) {
+  JobRunner runner;
+  RateLimit limits;
+  limits.requestsPerSecond = 20;
+  runner.limit(server.http(), limits);
+  runner.start(2);
+  const int requests = 10;
+  auto started = Clock::now();
+  auto done = runner.submit(
+      {"many requests", server.http(),
+       [](const std::string &, const HostInfo &, HTTP &server) {
+         for (int i = 0; i != requests; ++i)
+           server.get("/bytes/16");
+         return true;
+       }});
+  EQ(done.get(), true);
+  auto took = Clock::now() - started;
+  runner.stop();
+  // The first goes straight away, then one every 50 ms
+  EQ((took >= std::chrono::milliseconds(50 * (requests - 1) - 10)), true);
+}
+
+int main(int argc, char *argv[]) {
+  Services::instance().trustCertificate(TestServer::certificateFile());
+  TestServer server;
+  int failures = 0;
+  auto check = [&failures](const char *name, auto test) {
+    try {
+      test();
+    } catch (std::exception &e) {
+      std::cerr << name << " FAILED: " << e.what() << std::endl;
+      ++failures;
+    }
+  };
+  check("running", [&]() { testRunning(server); });
+  check("stop drains", [&]() { testStopDrains(server); });
+  check("queue wait", [&]() { testQueueWait(server); });
+  check("rate limit", [&]() { testRateLimit(server); });
+  std::cout << failures << " failures" << std::endl;
+  return failures;
+}
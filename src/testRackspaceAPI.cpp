@@ -5,8 +5,10 @@
 #include <RESTClient/base/logger.hpp>
 #include <RESTClient/base/url.hpp>
 #include <RESTClient/http/HTTP.hpp>
+#include <RESTClient/http/RequestTemplate.hpp>
 #include <RESTClient/http/Services.hpp>
 #include <RESTClient/jobManagement/JobRunner.hpp>
+#include <testServer/TestServer.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/range/algorithm/find.hpp>
 
@@ -14,50 +16,41 @@
 #include <json/io.hpp>
 #include <json/value.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <optional>
 #include <sstream>
 
 #include <boost/algorithm/string/predicate.hpp>
-#include <boost/coroutine2/all.hpp>
 #include <boost/iostreams/copy.hpp>
 #include <boost/regex.hpp>
 
 #define STRINGIFY2(X) #X
 #define STRINGIFY(X) STRINGIFY2(X)
 
-// Generates A-Z 0-9 over and over
+// Generates A-Z 0-9 over and over, as a BodySource::Pull. Fills the whole
+// buffer it's given each call, a pattern at a time
 class AlphabetoSource {
-public:
-  using char_type = char;
-  using category = boost::iostreams::source_tag;
-
 private:
-  using coro_t = boost::coroutines2::coroutine<char>;
-  static void _generator(coro_t::push_type &sink) {
-    while (true) {
-      for (char c = 'A'; c != 'Z' + 1; ++c)
-        sink(c);
-      sink(' ');
-      for (char c = '0'; c != '9' + 1; ++c)
-        sink(c);
-      sink(' ');
-    }
-  }
-  coro_t::pull_type generator;
-  std::streamsize limit;
-  std::streamsize transmitted;
+  static constexpr const char *pattern =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZ 0123456789 ";
+  static const size_t patternSize = 38;
+  size_t limit;
+  size_t transmitted = 0;
 
 public:
-  AlphabetoSource(size_t limit)
-      : generator(AlphabetoSource::_generator), limit(limit), transmitted(0) {}
-  std::streamsize read(char *s, std::streamsize n) {
-    size_t toSend = std::min(transmitted, n);
-    for (std::streamsize i = 0; i != toSend; ++i) {
-      *s++ = generator.get();
-      generator();
+  AlphabetoSource(size_t limit) : limit(limit) {}
+  size_t operator()(char *out, size_t size) {
+    size = std::min(size, limit - transmitted);
+    for (size_t done = 0; done != size;) {
+      size_t at = (transmitted + done) % patternSize;
+      size_t bytes = std::min(size - done, patternSize - at);
+      std::memcpy(out + done, pattern + at, bytes);
+      done += bytes;
     }
-    transmitted += toSend;
-    return toSend;
+    transmitted += size;
+    return size;
   }
 };
 
@@ -78,6 +71,8 @@ int main(int argc, char *argv[]) {
 
   RESTClient::URL syd_cf_url;
   std::string token;
+  // The account's path and token, sent with every cloud files request
+  std::optional<RESTClient::RequestTemplate> account;
 
   auto afterLogin = [&]() {
     // Now get the sydney cloud files URL
@@ -100,22 +95,20 @@ int main(int argc, char *argv[]) {
     LOG_TRACE("Syd URL: " << syd_cf_url)
 
     headers["X-Auth-Token"] = token;
-
-    auto &q = jobs.queue(syd_cf_url.protocol() + "://" + syd_cf_url.hostname());
-
-    LOG_TRACE("afterLogin: Queuing new job : "
-              << (syd_cf_url.protocol() + "://" + syd_cf_url.hostname()));
-    q.emplace(RESTClient::QueuedJob{
-        "Ensure container",
-        syd_cf_url.protocol() + "://" + syd_cf_url.hostname(),
-        [&token, &syd_cf_url, &headers](const std::string &name,
-                                        const std::string &hostname,
-                                        RESTClient::HTTP &conn) {
+    account.emplace(syd_cf_url.getHostInfo(), syd_cf_url.path(), headers);
+
+    LOG_TRACE("afterLogin: Queuing new job : " << syd_cf_url.getHostInfo());
+    // submit() starts it straight away, instead of waiting for the login
+    // worker to finish
+    jobs.submit(RESTClient::QueuedJob{
+        "Ensure container", syd_cf_url.getHostInfo(),
+        [&syd_cf_url, &account](const std::string &name,
+                                const std::string &hostname,
+                                RESTClient::HTTP &conn) {
           LOG_INFO("afterLogin: running listing containers.: " << (syd_cf_url));
-          // Add the token
           // List containers
-          auto response =
-              conn.get(syd_cf_url.path() + "/", {{"X-Auth-Token", token}});
+          RESTClient::HTTPRequest listing(*account, "GET", "/");
+          auto response = conn.action(listing);
           std::istream &b = response.body;
           std::vector<std::string> containers;
           while (b.good()) {
@@ -131,17 +124,24 @@ int main(int argc, char *argv[]) {
           auto found = boost::range::find(containers, container_name);
           if (found == containers.end()) {
             // If not found, create this container
-            RESTClient::HTTPRequest request{
-                "PUT", syd_cf_url.path() + "/" + container_name, headers};
+            RESTClient::HTTPRequest request(*account, "PUT",
+                                            "/" + container_name);
             RESTClient::HTTPResponse response = conn.action(request);
             LOG_INFO("Container created");
           }
           return true;
         }});
-    LOG_TRACE("afterLogin: New queue size: " << q.size());
   };
 
+#ifdef RS_LIVE
   RESTClient::HostInfo login_host("https://identity.api.rackspacecloud.com");
+#else
+  // A local stand in for the identity and cloud files APIs
+  RESTClient::TestServer server;
+  RESTClient::Services::instance().trustCertificate(
+      RESTClient::TestServer::certificateFile());
+  RESTClient::HostInfo login_host = server.https();
+#endif
   jobs.queue(login_host).emplace(RESTClient::QueuedJob{
       "Login", login_host,
       [&info, &headers, &afterLogin](const std::string &name,
@@ -163,14 +163,19 @@ int main(int argc, char *argv[]) {
         std::ostream &putter(request.body);
         putter << j;
         RESTClient::HTTPResponse response = conn.action(request);
-        if (!((response.code >= 200) && (response.code < 300)))
-          LOG_ERROR("Couldn't log in to RS: code("
-                    << response.code << ") message (" << response.body << ")");
+        if (!((response.code >= 200) && (response.code < 300))) {
+          std::stringstream msg;
+          msg << "Couldn't log in to RS: code(" << response.code
+              << ") message (" << response.body << ")";
+          throw std::runtime_error(msg.str());
+        }
         std::string data(response.body);
         json::construct(data, info, true);
         afterLogin();
         return true;
-      }});
+      },
+      // Don't queue up behind any bulk work
+      RESTClient::Priority::high});
 
   jobs.run();
 
@@ -178,11 +183,10 @@ int main(int argc, char *argv[]) {
   /*
     q.emplace({"Chunked Transmit", syd_cf_url.hostname(), [&token](const
     std::string& name, const std::string& hostname, RESTClient::HTTP& server){
-        // Upload
-        boost::iostreams::filtering_stream<char> s;
-        s.push(AlphabetoSource(1024 * 20));
+        // Upload, in chunks
         RESTClient::HTTPRequest r("POST", STRINGIFY(RS_CONTAINER_NAME)
     "/test1");
+        r.body.initWithGenerator(AlphabetoSource(1024 * 20));
         // Download
     });
     */
@@ -0,0 +1,964 @@
+#include "TestServer.hpp"
+
+#include <RESTClient/base/logger.hpp>
+#include <RESTClient/http/HPACK.hpp>
+#include <RESTClient/http/HTTP2Frames.hpp>
+#include <RESTClient/http/Scan.hpp>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <list>
+#include <memory>
+#include <sstream>
+
+#ifndef TEST_SERVER_CERTS
+#error "TEST_SERVER_CERTS should be set to the certs directory by cmake"
+#endif
+
+namespace RESTClient {
+
+namespace asio = boost::asio;
+namespace ssl = boost::asio::ssl;
+using tcp = boost::asio::ip::tcp;
+
+namespace {
+
+const std::string authToken = "test-token";
+
+std::string alphabet(size_t size) {
+  static const std::string block = "abcdefghijklmnopqrstuvwxyz";
+  std::string result;
+  result.reserve(size);
+  while (result.size() < size)
+    result.append(block, 0, std::min(block.size(), size - result.size()));
+  return result;
+}
+
+std::string jsonString(const std::string &in) {
+  std::stringstream out;
+  out << '"';
+  for (char c : in) {
+    switch (c) {
+    case '"':
+      out << "\\\"";
+      break;
+    case '\\':
+      out << "\\\\";
+      break;
+    case '\n':
+      out << "\\n";
+      break;
+    case '\r':
+      out << "\\r";
+      break;
+    case '\t':
+      out << "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+            << static_cast<int>(c) << std::dec;
+      else
+        out << c;
+    }
+  }
+  out << '"';
+  return out.str();
+}
+
+std::string gzip(const std::string &in) {
+  namespace io = boost::iostreams;
+  std::string result;
+  io::filtering_ostream out;
+  out.push(io::gzip_compressor());
+  out.push(io::back_inserter(result));
+  out << in;
+  out.reset();
+  return result;
+}
+
+std::string md5(const std::string &in) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int size = 0;
+  EVP_Digest(in.data(), in.size(), digest, &size, EVP_md5(), nullptr);
+  std::stringstream out;
+  for (unsigned int i = 0; i != size; ++i)
+    out << std::hex << std::setw(2) << std::setfill('0')
+        << static_cast<int>(digest[i]);
+  return out.str();
+}
+
+/// Un-escapes %XX (and '+' in a query)
+std::string decode(const std::string &in, bool query = true) {
+  std::string result;
+  for (size_t i = 0; i < in.size(); ++i) {
+    if ((in[i] == '%') && (i + 2 < in.size())) {
+      result.push_back(
+          static_cast<char>(std::stoi(in.substr(i + 1, 2), 0, 16)));
+      i += 2;
+    } else if (query && (in[i] == '+')) {
+      result.push_back(' ');
+    } else {
+      result.push_back(in[i]);
+    }
+  }
+  return result;
+}
+
+/// Splits a path into its parts, ignoring empty ones
+std::vector<std::string> split(const std::string &path) {
+  std::vector<std::string> result;
+  std::string part;
+  std::stringstream in(path);
+  while (std::getline(in, part, '/'))
+    if (!part.empty())
+      result.push_back(part);
+  return result;
+}
+
+size_t sizeFromPath(const std::string &path, const std::string &prefix) {
+  return std::stoul(path.substr(prefix.size()));
+}
+
+/// Serves 'Range: bytes=first-last' of 'body', if the request asks for it
+void applyRange(const TestRequest &request, TestResponse &response) {
+  auto found = request.headers.find("Range");
+  if ((found == request.headers.end()) ||
+      !boost::starts_with(found->second, "bytes="))
+    return;
+  std::string range = found->second.substr(6);
+  size_t dash = range.find('-');
+  size_t size = response.body.size();
+  size_t first, last;
+  if (dash == 0) {
+    // The last N bytes
+    size_t count = std::min<size_t>(std::stoul(range.substr(1)), size);
+    first = size - count;
+    last = size - 1;
+  } else {
+    first = std::stoul(range.substr(0, dash));
+    last = (dash + 1 < range.size()) ? std::stoul(range.substr(dash + 1))
+                                     : size - 1;
+  }
+  if ((first >= size) || (first > last)) {
+    response.code = 416;
+    response.reason = "Range Not Satisfiable";
+    response.headers["Content-Range"] = "bytes */" + std::to_string(size);
+    response.body.clear();
+    return;
+  }
+  last = std::min(last, size - 1);
+  response.code = 206;
+  response.reason = "Partial Content";
+  response.headers["Content-Range"] = "bytes " + std::to_string(first) + "-" +
+                                      std::to_string(last) + "/" +
+                                      std::to_string(size);
+  response.body = response.body.substr(first, last - first + 1);
+}
+
+void status(TestResponse &response, int code, const std::string &reason) {
+  response.code = code;
+  response.reason = reason;
+}
+
+std::string reasonFor(int code) {
+  static const std::map<int, std::string> reasons{
+      {200, "OK"},
+      {201, "Created"},
+      {202, "Accepted"},
+      {204, "No Content"},
+      {206, "Partial Content"},
+      {301, "Moved Permanently"},
+      {302, "Found"},
+      {304, "Not Modified"},
+      {400, "Bad Request"},
+      {401, "Unauthorized"},
+      {403, "Forbidden"},
+      {404, "Not Found"},
+      {409, "Conflict"},
+      {416, "Range Not Satisfiable"},
+      {429, "Too Many Requests"},
+      {500, "Internal Server Error"},
+      {502, "Bad Gateway"},
+      {503, "Service Unavailable"},
+      {504, "Gateway Timeout"}};
+  auto found = reasons.find(code);
+  return found == reasons.end() ? "Unknown" : found->second;
+}
+
+/// Fills in the path and query of 'request' from a request target
+void splitTarget(const std::string &target, TestRequest &request) {
+  size_t question = target.find('?');
+  request.path = decode(target.substr(0, question), false);
+  if (question != std::string::npos) {
+    std::stringstream query(target.substr(question + 1));
+    std::string pair;
+    while (std::getline(query, pair, '&')) {
+      size_t equals = pair.find('=');
+      if (equals == std::string::npos)
+        request.query[decode(pair)] = "";
+      else
+        request.query[decode(pair.substr(0, equals))] =
+            decode(pair.substr(equals + 1));
+    }
+  }
+}
+
+using BufferIterator =
+    asio::buffers_iterator<asio::streambuf::const_buffers_type>;
+
+/// For async_read_until: finds the blank line after a request's head. A
+/// streambuf's bytes are all in one piece, so it can scan them directly
+std::pair<BufferIterator, bool> headEnd(BufferIterator begin,
+                                        BufferIterator end) {
+  size_t size = end - begin;
+  if (size == 0)
+    return {end, false};
+  const char *first = &*begin;
+  const char *found = findHeadEnd(first, first + size);
+  if (found != first + size)
+    return {begin + (found + 1 - first), true};
+  // The next look starts where a blank line could have been cut off
+  return {begin + (size - std::min<size_t>(size, 3)), false};
+}
+
+/// Reads the whole request from the net. Returns false if the client hung up
+template <typename Stream>
+bool readRequest(Stream &stream, asio::streambuf &buf, TestRequest &request,
+                 asio::yield_context yield) {
+  boost::system::error_code ec;
+  asio::async_read_until(stream, buf, headEnd, yield[ec]);
+  if (ec)
+    return false;
+  std::istream in(&buf);
+  std::string target, version, line;
+  in >> request.verb >> target >> version;
+  std::getline(in, line);
+  while (std::getline(in, line) && (line != "\r")) {
+    size_t colon = line.find(':');
+    if (colon == std::string::npos)
+      continue;
+    std::string key = line.substr(0, colon);
+    std::string value = line.substr(colon + 1);
+    boost::trim(key);
+    boost::trim(value);
+    request.headers[key] = value;
+  }
+  splitTarget(target, request);
+  // Read the body
+  auto readAtLeast = [&](size_t size) {
+    if (buf.size() < size)
+      asio::async_read(stream, buf, asio::transfer_at_least(size - buf.size()),
+                       yield);
+  };
+  auto found = request.headers.find("Transfer-Encoding");
+  if ((found != request.headers.end()) && (found->second == "chunked")) {
+    while (true) {
+      asio::async_read_until(stream, buf, "\r\n", yield);
+      std::getline(in, line);
+      size_t size = std::stoul(line, 0, 16);
+      readAtLeast(size + 2);
+      std::string chunk(size, '\0');
+      in.read(&chunk[0], size);
+      request.body += chunk;
+      in.ignore(2);
+      if (size == 0)
+        break;
+    }
+  } else {
+    found = request.headers.find("Content-Length");
+    if (found != request.headers.end()) {
+      size_t size = std::stoul(found->second);
+      readAtLeast(size);
+      request.body.resize(size);
+      in.read(&request.body[0], size);
+    }
+  }
+  return true;
+}
+
+template <typename Stream>
+void writeResponse(asio::io_service &io_service, Stream &stream,
+                   TestResponse &response, asio::yield_context yield) {
+  if (response.delay.count() > 0) {
+    asio::steady_timer timer(io_service);
+    timer.expires_from_now(response.delay);
+    timer.async_wait(yield);
+  }
+  if (response.gzip) {
+    response.body = gzip(response.body);
+    response.headers["Content-Encoding"] = "gzip";
+  }
+  if (response.close)
+    response.headers["Connection"] = "close";
+  if (response.chunkSize == 0)
+    response.headers["Content-Length"] = std::to_string(response.body.size());
+  else
+    response.headers["Transfer-Encoding"] = "chunked";
+  std::stringstream head;
+  head << "HTTP/1.1 " << response.code << " " << response.reason << "\r\n";
+  for (const auto &header : response.headers)
+    head << header.first << ": " << header.second << "\r\n";
+  head << "\r\n";
+  std::string headText = head.str();
+  if (response.chunkSize == 0) {
+    std::vector<asio::const_buffer> buffers{asio::buffer(headText),
+                                            asio::buffer(response.body)};
+    asio::async_write(stream, buffers, yield);
+    return;
+  }
+  asio::async_write(stream, asio::buffer(headText), yield);
+  asio::steady_timer timer(io_service);
+  for (size_t sent = 0; sent < response.body.size();
+       sent += response.chunkSize) {
+    if ((sent != 0) && (response.chunkDelay.count() > 0)) {
+      timer.expires_from_now(response.chunkDelay);
+      timer.async_wait(yield);
+    }
+    size_t size = std::min(response.chunkSize, response.body.size() - sent);
+    std::stringstream sizeLine;
+    sizeLine << std::hex << size << "\r\n";
+    std::string sizeText = sizeLine.str();
+    std::vector<asio::const_buffer> buffers{
+        asio::buffer(sizeText), asio::buffer(&response.body[sent], size),
+        asio::buffer("\r\n", 2)};
+    asio::async_write(stream, buffers, yield);
+  }
+  asio::async_write(stream, asio::buffer("0\r\n\r\n", 5), yield);
+}
+
+/// Picks HTTP/2 if the client offers it
+int selectProtocol(SSL *, const unsigned char **out, unsigned char *outSize,
+                   const unsigned char *in, unsigned int inSize, void *) {
+  static const unsigned char ours[] = "\x02h2\x08http/1.1";
+  if (SSL_select_next_proto(const_cast<unsigned char **>(out), outSize, ours,
+                            sizeof(ours) - 1, in,
+                            inSize) != OPENSSL_NPN_NEGOTIATED)
+    return SSL_TLSEXT_ERR_NOACK;
+  return SSL_TLSEXT_ERR_OK;
+}
+
+void hangUp(tcp::socket &socket, asio::yield_context) {
+  boost::system::error_code ec;
+  socket.shutdown(tcp::socket::shutdown_both, ec);
+  socket.close(ec);
+}
+
+void hangUp(ssl::stream<tcp::socket> &stream, asio::yield_context yield) {
+  boost::system::error_code ec;
+  stream.async_shutdown(yield[ec]);
+  stream.lowest_layer().close(ec);
+}
+
+/// One HTTP/2 connection. Its coroutines (the reader, and one per response)
+/// all run on the reader's strand
+struct HTTP2Connection {
+  using Stream = ssl::stream<tcp::socket>;
+  std::shared_ptr<Stream> stream;
+  asio::io_service &io_service;
+  HPACKEncoder encoder;
+  HPACKDecoder decoder;
+  /// Requests still arriving, by stream
+  std::map<uint32_t, TestRequest> arriving;
+  /// The client's flow control windows for what we send
+  int64_t sendWindow = HTTP2::defaultWindowSize;
+  int64_t initialWindow = HTTP2::defaultWindowSize;
+  std::map<uint32_t, int64_t> streamWindows;
+  uint32_t maxFrameSize = HTTP2::defaultMaxFrameSize;
+  std::string outgoing;
+  std::string writing;
+  bool writerRunning = false;
+  bool closed = false;
+  /// Responses waiting for window
+  std::list<asio::steady_timer *> waiting;
+  HTTP2Connection(std::shared_ptr<Stream> stream, asio::io_service &io_service)
+      : stream(std::move(stream)), io_service(io_service) {}
+  void flush(asio::yield_context yield) {
+    if (writerRunning)
+      return;
+    writerRunning = true;
+    boost::system::error_code ec;
+    while (!outgoing.empty() && !ec) {
+      writing.swap(outgoing);
+      outgoing.clear();
+      asio::async_write(*stream, asio::buffer(writing), yield[ec]);
+    }
+    writerRunning = false;
+  }
+  void wait(asio::yield_context yield) {
+    asio::steady_timer timer(io_service);
+    timer.expires_from_now(std::chrono::hours(1));
+    waiting.push_back(&timer);
+    boost::system::error_code ec;
+    timer.async_wait(yield[ec]);
+    waiting.remove(&timer);
+  }
+  void wakeAll() {
+    std::list<asio::steady_timer *> waking;
+    waking.swap(waiting);
+    for (auto timer : waking)
+      timer->cancel();
+  }
+  /// Sends 'data' as DATA frames, as the client's windows allow
+  void sendData(uint32_t id, std::string_view data, bool last,
+                asio::yield_context yield) {
+    using namespace HTTP2;
+    do {
+      while (!closed && !data.empty() &&
+             ((sendWindow <= 0) || (streamWindows[id] <= 0)))
+        wait(yield);
+      if (closed)
+        return;
+      size_t size = std::min<int64_t>(
+          {int64_t(data.size()), sendWindow, streamWindows[id], maxFrameSize});
+      bool end = last && (size == data.size());
+      appendFrameHeader(outgoing, size, FrameType::data,
+                        end ? Flags::endStream : 0, id);
+      outgoing.append(data.data(), size);
+      data.remove_prefix(size);
+      sendWindow -= size;
+      streamWindows[id] -= size;
+      flush(yield);
+    } while (!data.empty());
+  }
+};
+
+} // anonymous namespace
+
+TestServer::TestServer(TestServerOptions options)
+    : ssl_context(ssl::context::sslv23),
+      httpAcceptor(io_service, tcp::endpoint(asio::ip::address_v4::loopback(),
+                                             options.httpPort)),
+      httpsAcceptor(io_service,
+                    tcp::endpoint(asio::ip::address_v4::loopback(),
+                                  options.httpsPort)) {
+  ssl_context.use_certificate_chain_file(certificateFile());
+  ssl_context.use_private_key_file(std::string(TEST_SERVER_CERTS) +
+                                       "/localhost.key",
+                                   ssl::context::pem);
+  if (options.http2)
+    SSL_CTX_set_alpn_select_cb(ssl_context.native_handle(), selectProtocol,
+                               nullptr);
+  asio::spawn(io_service, [this](asio::yield_context yield) {
+    acceptHTTP(yield);
+  });
+  asio::spawn(io_service, [this](asio::yield_context yield) {
+    acceptHTTPS(yield);
+  });
+  for (unsigned i = 0; i < std::max(1u, options.threads); ++i)
+    threads.emplace_back([this]() { io_service.run(); });
+}
+
+TestServer::~TestServer() {
+  io_service.stop();
+  for (auto &thread : threads)
+    thread.join();
+}
+
+std::string TestServer::certificateFile() {
+  return std::string(TEST_SERVER_CERTS) + "/localhost.crt";
+}
+
+HostInfo TestServer::http() const {
+  return HostInfo("http://127.0.0.1:" + std::to_string(httpPort()));
+}
+
+HostInfo TestServer::https() const {
+  return HostInfo("https://127.0.0.1:" + std::to_string(httpsPort()));
+}
+
+unsigned short TestServer::httpPort() const {
+  return httpAcceptor.local_endpoint().port();
+}
+
+unsigned short TestServer::httpsPort() const {
+  return httpsAcceptor.local_endpoint().port();
+}
+
+void TestServer::route(std::string prefix, TestHandler handler) {
+  routes.emplace_back(std::move(prefix), std::move(handler));
+}
+
+void TestServer::acceptHTTP(asio::yield_context yield) {
+  while (true) {
+    auto socket = std::make_shared<tcp::socket>(io_service);
+    boost::system::error_code ec;
+    httpAcceptor.async_accept(*socket, yield[ec]);
+    if (ec) {
+      LOG_WARN("TestServer accept failed: " << ec.message());
+      continue;
+    }
+    ++connections;
+    socket->set_option(tcp::no_delay(true));
+    asio::spawn(io_service, [this, socket](asio::yield_context yield) {
+      serve(*socket, "http", yield);
+    });
+  }
+}
+
+void TestServer::acceptHTTPS(asio::yield_context yield) {
+  using Stream = ssl::stream<tcp::socket>;
+  while (true) {
+    auto stream = std::make_shared<Stream>(io_service, ssl_context);
+    boost::system::error_code ec;
+    httpsAcceptor.async_accept(stream->lowest_layer(), yield[ec]);
+    if (ec) {
+      LOG_WARN("TestServer accept failed: " << ec.message());
+      continue;
+    }
+    ++connections;
+    stream->lowest_layer().set_option(tcp::no_delay(true));
+    asio::spawn(io_service, [this, stream](asio::yield_context yield) {
+      boost::system::error_code ec;
+      stream->async_handshake(Stream::server, yield[ec]);
+      if (ec) {
+        LOG_WARN("TestServer TLS handshake failed: " << ec.message());
+        return;
+      }
+      const unsigned char *chosen = nullptr;
+      unsigned int chosenSize = 0;
+      SSL_get0_alpn_selected(stream->native_handle(), &chosen, &chosenSize);
+      if ((chosenSize == 2) && (chosen[0] == 'h') && (chosen[1] == '2'))
+        serveHTTP2(stream, yield);
+      else
+        serve(*stream, "https", yield);
+    });
+  }
+}
+
+template <typename Stream>
+void TestServer::serve(Stream &stream, const std::string &protocol,
+                       asio::yield_context yield) {
+  asio::streambuf buf;
+  try {
+    while (true) {
+      TestRequest request;
+      request.protocol = protocol;
+      if (!readRequest(stream, buf, request, yield))
+        break;
+      ++requests;
+      TestResponse response;
+      handle(request, response);
+      auto found = request.headers.find("Connection");
+      if ((found != request.headers.end()) && (found->second == "close"))
+        response.close = true;
+      writeResponse(io_service, stream, response, yield);
+      if (response.close)
+        break;
+    }
+  } catch (std::exception &e) {
+    LOG_WARN("TestServer connection failed: " << e.what());
+  }
+  hangUp(stream, yield);
+}
+
+void TestServer::serveHTTP2(std::shared_ptr<ssl::stream<tcp::socket>> stream,
+                            asio::yield_context yield) {
+  using namespace HTTP2;
+  auto connection = std::make_shared<HTTP2Connection>(stream, io_service);
+  HTTP2Connection &conn = *connection;
+  // Answers a request on its own coroutine, so a slow one doesn't hold up
+  // the rest
+  auto respond = [this, connection, &yield](uint32_t id,
+                                            TestRequest request) {
+    asio::spawn(yield, [
+      this, connection, id, request = std::move(request)
+    ](asio::yield_context yield) {
+      HTTP2Connection &conn = *connection;
+      ++requests;
+      TestResponse response;
+      handle(request, response);
+      if (response.delay.count() > 0) {
+        asio::steady_timer timer(io_service);
+        timer.expires_from_now(response.delay);
+        timer.async_wait(yield);
+      }
+      if (response.gzip) {
+        response.body = gzip(response.body);
+        response.headers["Content-Encoding"] = "gzip";
+      }
+      response.headers["Content-Length"] = std::to_string(response.body.size());
+      std::string block;
+      conn.encoder.encode(block, ":status", std::to_string(response.code));
+      for (const auto &header : response.headers) {
+        std::string name = header.first;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        conn.encoder.encode(block, name, header.second);
+      }
+      appendHeaderBlock(conn.outgoing, id, block, response.body.empty(),
+                        conn.maxFrameSize);
+      conn.flush(yield);
+      size_t piece =
+          response.chunkSize ? response.chunkSize : response.body.size();
+      asio::steady_timer timer(io_service);
+      for (size_t sent = 0; sent < response.body.size(); sent += piece) {
+        if ((sent != 0) && (response.chunkDelay.count() > 0)) {
+          timer.expires_from_now(response.chunkDelay);
+          timer.async_wait(yield);
+        }
+        size_t size = std::min(piece, response.body.size() - sent);
+        conn.sendData(id, std::string_view(&response.body[sent], size),
+                      sent + size == response.body.size(), yield);
+      }
+      conn.streamWindows.erase(id);
+    });
+  };
+  asio::streambuf buf;
+  auto fill = [&](size_t size) {
+    if (buf.size() < size)
+      asio::async_read(*stream, buf, asio::transfer_at_least(size - buf.size()),
+                       yield);
+  };
+  // Set while a header block runs over CONTINUATION frames
+  std::string block;
+  uint32_t blockStream = 0;
+  bool blockEndsStream = false;
+  auto headers = [&](uint32_t id, bool endStream) {
+    TestRequest &request = conn.arriving[id];
+    request.protocol = "https";
+    conn.streamWindows[id] = conn.initialWindow;
+    const char *data = block.data();
+    std::string_view name, value;
+    while (conn.decoder.next(data, block.data() + block.size(), name, value)) {
+      if (name == ":method") {
+        request.verb = std::string(value);
+      } else if (name == ":path") {
+        splitTarget(std::string(value), request);
+      } else if (name == ":authority") {
+        request.headers["Host"] = std::string(value);
+      } else if (!name.empty() && (name[0] != ':')) {
+        std::string key(name);
+        titleCase(key);
+        request.headers[key] = std::string(value);
+      }
+    }
+    if (endStream) {
+      respond(id, std::move(request));
+      conn.arriving.erase(id);
+    }
+  };
+  try {
+    fill(preface.size());
+    if (std::string(asio::buffer_cast<const char *>(buf.data()),
+                    preface.size()) != preface)
+      throw std::runtime_error("Bad HTTP/2 preface");
+    buf.consume(preface.size());
+    appendFrameHeader(conn.outgoing, 6, FrameType::settings, 0, 0);
+    appendSetting(conn.outgoing, Setting::maxConcurrentStreams, 100);
+    conn.flush(yield);
+    while (true) {
+      fill(FrameHeader::size);
+      FrameHeader header =
+          readFrameHeader(asio::buffer_cast<const char *>(buf.data()));
+      if (header.length > defaultMaxFrameSize)
+        throw std::runtime_error("HTTP/2 frame too big");
+      fill(FrameHeader::size + header.length);
+      std::string_view payload(asio::buffer_cast<const char *>(buf.data()) +
+                                   FrameHeader::size,
+                               header.length);
+      if (header.type == FrameType::goAway)
+        break;
+      switch (header.type) {
+      case FrameType::headers:
+        block = std::string(unpadded(header, payload));
+        blockStream = header.stream;
+        blockEndsStream = header.has(Flags::endStream);
+        if (header.has(Flags::endHeaders))
+          headers(blockStream, blockEndsStream);
+        break;
+      case FrameType::continuation:
+        block.append(payload.data(), payload.size());
+        if (header.has(Flags::endHeaders))
+          headers(blockStream, blockEndsStream);
+        break;
+      case FrameType::data: {
+        auto found = conn.arriving.find(header.stream);
+        if (found != conn.arriving.end()) {
+          std::string_view data = unpadded(header, payload);
+          found->second.body.append(data.data(), data.size());
+          if (header.has(Flags::endStream)) {
+            respond(header.stream, std::move(found->second));
+            conn.arriving.erase(found);
+          } else if (header.length > 0) {
+            appendWindowUpdate(conn.outgoing, header.stream, header.length);
+          }
+        }
+        // Keep the client's window open
+        if (header.length > 0)
+          appendWindowUpdate(conn.outgoing, 0, header.length);
+        break;
+      }
+      case FrameType::settings:
+        if (header.has(Flags::ack))
+          break;
+        for (size_t i = 0; i + 6 <= payload.size(); i += 6) {
+          auto id = static_cast<Setting>((uint8_t(payload[i]) << 8) |
+                                         uint8_t(payload[i + 1]));
+          uint32_t value = readUint32(payload.data() + i + 2);
+          if (id == Setting::initialWindowSize) {
+            for (auto &window : conn.streamWindows)
+              window.second += int64_t(value) - conn.initialWindow;
+            conn.initialWindow = value;
+          } else if (id == Setting::maxFrameSize) {
+            conn.maxFrameSize = value;
+          } else if (id == Setting::headerTableSize) {
+            conn.encoder.setMaxTableSize(value);
+          }
+        }
+        appendFrameHeader(conn.outgoing, 0, FrameType::settings, Flags::ack,
+                          0);
+        conn.wakeAll();
+        break;
+      case FrameType::windowUpdate: {
+        uint32_t increment = readUint32(payload.data()) & 0x7fffffff;
+        if (header.stream == 0)
+          conn.sendWindow += increment;
+        else if (conn.streamWindows.count(header.stream))
+          conn.streamWindows[header.stream] += increment;
+        conn.wakeAll();
+        break;
+      }
+      case FrameType::ping:
+        if (!header.has(Flags::ack)) {
+          appendFrameHeader(conn.outgoing, 8, FrameType::ping, Flags::ack, 0);
+          conn.outgoing.append(payload.data(), payload.size());
+        }
+        break;
+      case FrameType::rstStream:
+        conn.arriving.erase(header.stream);
+        break;
+      default:
+        break;
+      }
+      buf.consume(FrameHeader::size + header.length);
+      conn.flush(yield);
+    }
+  } catch (std::exception &e) {
+    LOG_WARN("TestServer HTTP/2 connection failed: " << e.what());
+  }
+  conn.closed = true;
+  conn.wakeAll();
+  hangUp(*stream, yield);
+}
+
+void TestServer::handle(const TestRequest &request, TestResponse &response) {
+  LOG_DEBUG("TestServer: " << request.verb << " " << request.path);
+  // Modifiers that work on any route
+  auto param = [&](const std::string &name) -> const std::string * {
+    auto found = request.query.find(name);
+    return found == request.query.end() ? nullptr : &found->second;
+  };
+  if (auto value = param("chunk_size"))
+    response.chunkSize = std::stoul(*value);
+  if (auto value = param("delay_ms"))
+    response.delay = std::chrono::milliseconds(std::stol(*value));
+  if (auto value = param("gzip"))
+    response.gzip = (*value != "0");
+  if (auto value = param("close"))
+    response.close = (*value != "0");
+  if (auto value = param("retry_after"))
+    response.headers["Retry-After"] = *value;
+
+  for (const auto &route : routes)
+    if (boost::starts_with(request.path, route.first)) {
+      route.second(request, response);
+      return;
+    }
+
+  const std::string &path = request.path;
+  auto echo = [&]() {
+    std::string host = request.headers.count("Host")
+                           ? request.headers.at("Host")
+                           : "127.0.0.1";
+    std::stringstream body;
+    body << "{\n  \"method\": " << jsonString(request.verb) << ",\n  \"url\": "
+         << jsonString(request.protocol + "://" + host + path)
+         << ",\n  \"headers\": {";
+    bool first = true;
+    for (const auto &header : request.headers) {
+      body << (first ? "\n" : ",\n") << "    " << jsonString(header.first)
+           << ": " << jsonString(header.second);
+      first = false;
+    }
+    body << "\n  },\n  \"data\": " << jsonString(request.body);
+    if (response.gzip)
+      body << ",\n  \"gzipped\": true";
+    body << "\n}\n";
+    response.body = body.str();
+    response.headers["Content-Type"] = "application/json";
+  };
+
+  if ((path == "/get") || (path == "/put") || (path == "/post") ||
+      (path == "/patch") || (path == "/delete") ||
+      boost::starts_with(path, "/anything")) {
+    echo();
+  } else if (path == "/gzip") {
+    response.gzip = true;
+    echo();
+  } else if (boost::starts_with(path, "/bytes/")) {
+    response.body = alphabet(sizeFromPath(path, "/bytes/"));
+    applyRange(request, response);
+  } else if (boost::starts_with(path, "/stream-bytes/")) {
+    response.body = alphabet(sizeFromPath(path, "/stream-bytes/"));
+    if (response.chunkSize == 0)
+      response.chunkSize = 4096;
+    applyRange(request, response);
+  } else if (boost::starts_with(path, "/range/")) {
+    response.body = alphabet(sizeFromPath(path, "/range/"));
+    if (response.chunkSize == 0)
+      response.chunkSize = 10;
+    applyRange(request, response);
+    if (auto value = param("duration")) {
+      size_t chunks =
+          (response.body.size() + response.chunkSize - 1) / response.chunkSize;
+      if (chunks > 1)
+        response.chunkDelay = std::chrono::milliseconds(
+            static_cast<long>(std::stod(*value) * 1000 / (chunks - 1)));
+    }
+  } else if (boost::starts_with(path, "/status/")) {
+    int code = std::stoi(path.substr(8));
+    status(response, code, reasonFor(code));
+  } else if ((path == "/v2.0/tokens") || boost::starts_with(path, "/v1/")) {
+    cloudFiles(request, response);
+  } else {
+    status(response, 404, "Not Found");
+  }
+}
+
+void TestServer::cloudFiles(const TestRequest &request,
+                            TestResponse &response) {
+  std::string host = request.headers.count("Host") ? request.headers.at("Host")
+                                                   : "127.0.0.1";
+  // Login
+  if (request.path == "/v2.0/tokens") {
+    if (request.verb != "POST")
+      return status(response, 405, "Method Not Allowed");
+    std::string endpoint =
+        request.protocol + "://" + host + "/v1/MossoCloudFS_test";
+    std::stringstream body;
+    body << R"({"access":{"token":{"id":")" << authToken
+         << R"(","expires":"2100-01-01T00:00:00.000Z"},"serviceCatalog":[)"
+         << R"({"name":"cloudFiles","type":"object-store","endpoints":[)";
+    bool first = true;
+    for (const char *region : {"SYD", "DFW", "ORD", "IAD", "LON", "HKG"}) {
+      body << (first ? "" : ",") << R"({"region":")" << region
+           << R"(","publicURL":")" << endpoint << R"("})";
+      first = false;
+    }
+    body << "]}]}}";
+    response.body = body.str();
+    response.headers["Content-Type"] = "application/json";
+    return;
+  }
+
+  auto token = request.headers.find("X-Auth-Token");
+  if ((token == request.headers.end()) || (token->second != authToken))
+    return status(response, 401, "Unauthorized");
+
+  // /v1/{account}/{container}/{object}
+  std::vector<std::string> parts = split(request.path);
+  std::string containerName = parts.size() > 2 ? parts[2] : "";
+  std::string objectName;
+  for (size_t i = 3; i < parts.size(); ++i)
+    objectName += (i == 3 ? "" : "/") + parts[i];
+  const std::string &verb = request.verb;
+
+  std::lock_guard<std::mutex> lock(containersLock);
+  auto list = [&](const std::vector<std::string> &names) {
+    if (names.empty())
+      return status(response, 204, "No Content");
+    for (const auto &name : names)
+      response.body += name + "\n";
+    response.headers["Content-Type"] = "text/plain; charset=utf-8";
+  };
+
+  // The account
+  if (containerName.empty()) {
+    if (verb != "GET")
+      return status(response, 405, "Method Not Allowed");
+    std::vector<std::string> names;
+    for (const auto &container : containers)
+      names.push_back(container.first);
+    response.headers["X-Account-Container-Count"] =
+        std::to_string(names.size());
+    return list(names);
+  }
+
+  auto container = containers.find(containerName);
+  // A container
+  if (objectName.empty()) {
+    if (verb == "PUT") {
+      if (container != containers.end())
+        return status(response, 202, "Accepted");
+      containers[containerName];
+      return status(response, 201, "Created");
+    }
+    if (container == containers.end())
+      return status(response, 404, "Not Found");
+    if (verb == "DELETE") {
+      if (!container->second.empty())
+        return status(response, 409, "Conflict");
+      containers.erase(container);
+      return status(response, 204, "No Content");
+    }
+    response.headers["X-Container-Object-Count"] =
+        std::to_string(container->second.size());
+    if (verb == "HEAD")
+      return status(response, 204, "No Content");
+    if (verb != "GET")
+      return status(response, 405, "Method Not Allowed");
+    std::vector<std::string> names;
+    for (const auto &object : container->second)
+      names.push_back(object.first);
+    return list(names);
+  }
+
+  // An object
+  if (container == containers.end())
+    return status(response, 404, "Not Found");
+  Container &objects = container->second;
+  if (verb == "PUT") {
+    auto etag = request.headers.find("ETag");
+    std::string hash = md5(request.body);
+    if ((etag != request.headers.end()) && (etag->second != hash))
+      return status(response, 422, "Unprocessable Entity");
+    objects[objectName] = request.body;
+    response.headers["ETag"] = hash;
+    return status(response, 201, "Created");
+  }
+  auto object = objects.find(objectName);
+  if (object == objects.end())
+    return status(response, 404, "Not Found");
+  if (verb == "DELETE") {
+    objects.erase(object);
+    return status(response, 204, "No Content");
+  }
+  if ((verb != "GET") && (verb != "HEAD"))
+    return status(response, 405, "Method Not Allowed");
+  response.headers["ETag"] = md5(object->second);
+  response.headers["Content-Type"] = "application/octet-stream";
+  response.body = object->second;
+  applyRange(request, response);
+  if (verb == "HEAD") {
+    // No body, so our Content-Length will be 0; this holds the real size
+    response.headers["X-Object-Size"] = std::to_string(response.body.size());
+    response.body.clear();
+  }
+}
+
+} /* RESTClient */
@@ -0,0 +1,149 @@
+/// A stand in for httpbin.org and the Rackspace APIs, listening on the loopback
+/// interface, so tests and benchmarks need no internet and give repeatable
+/// numbers.
+///
+/// It serves HTTP and HTTPS (with the self signed certificate in certs/) on its
+/// own io_service and threads, so it can share a process with the client.
+///
+/// Built in routes:
+///
+///  * /get /put /post /patch /delete /anything... - echo the request as JSON
+///  * /gzip - like /get, gzip encoded
+///  * /bytes/N - N bytes of the alphabet with a Content-Length
+///  * /stream-bytes/N - the same, chunked (chunk_size defaults to 4096)
+///  * /range/N?duration=S - like /stream-bytes, spread over S seconds
+///  * /status/N - an empty reply with status code N
+///  * POST /v2.0/tokens - a Rackspace identity login; any credentials work
+///  * /v1/{account}/{container}/{object} - an in memory Cloud Files
+///
+/// And query parameters that work on any route:
+///
+///  * chunk_size=N - send the body chunked, N bytes at a time
+///  * gzip=1 - gzip the body
+///  * delay_ms=N - wait N milliseconds before replying
+///  * close=1 - reply with 'Connection: close', then hang up
+///  * retry_after=X - add a Retry-After header
+///
+/// GETs of /bytes, /range, /stream-bytes and Cloud Files objects honour
+/// 'Range: bytes=first-last'. A request with 'Connection: close' gets the same
+/// treatment as close=1.
+///
+/// HTTPS clients that offer HTTP/2 with ALPN get it, and their requests are
+/// answered concurrently, each on its own stream. Header names arrive title
+/// cased (Content-Type), as they would from HTTP/1.1 clients.
+#pragma once
+
+#include <RESTClient/base/url.hpp>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/spawn.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/stream.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace RESTClient {
+
+/// Plain strings; the server has no use for the client's arenas
+using TestHeaders = std::map<std::string, std::string, std::less<>>;
+
+/// A request as the TestServer sees it
+struct TestRequest {
+  std::string verb;
+  /// Without the query string
+  std::string path;
+  QueryParameters query;
+  TestHeaders headers;
+  /// Already un-chunked
+  std::string body;
+  /// "http" or "https"
+  std::string protocol;
+};
+
+/// What the TestServer should send back
+struct TestResponse {
+  int code = 200;
+  std::string reason = "OK";
+  TestHeaders headers;
+  std::string body;
+  /// If not 0, send the body in chunks of this size
+  size_t chunkSize = 0;
+  /// Wait this long between chunks
+  std::chrono::milliseconds chunkDelay{0};
+  /// Wait this long before replying at all
+  std::chrono::milliseconds delay{0};
+  bool gzip = false;
+  /// Hang up after replying
+  bool close = false;
+};
+
+using TestHandler =
+    std::function<void(const TestRequest &request, TestResponse &response)>;
+
+struct TestServerOptions {
+  /// 0 picks a free port
+  unsigned short httpPort = 0;
+  unsigned short httpsPort = 0;
+  /// How many threads run the server's io_service
+  unsigned threads = 1;
+  /// Agree to HTTP/2 when an HTTPS client asks for it
+  bool http2 = true;
+};
+
+class TestServer {
+private:
+  using tcp = boost::asio::ip::tcp;
+  /// One Cloud Files container: object name to contents
+  using Container = std::map<std::string, std::string>;
+
+  boost::asio::io_service io_service;
+  boost::asio::ssl::context ssl_context;
+  tcp::acceptor httpAcceptor;
+  tcp::acceptor httpsAcceptor;
+  std::vector<std::pair<std::string, TestHandler>> routes;
+  std::mutex containersLock;
+  std::map<std::string, Container> containers;
+  std::atomic<size_t> connections{0};
+  std::atomic<size_t> requests{0};
+  std::vector<std::thread> threads;
+
+  void acceptHTTP(boost::asio::yield_context yield);
+  void acceptHTTPS(boost::asio::yield_context yield);
+  template <typename Stream>
+  void serve(Stream &stream, const std::string &protocol,
+             boost::asio::yield_context yield);
+  void serveHTTP2(std::shared_ptr<boost::asio::ssl::stream<tcp::socket>> stream,
+                  boost::asio::yield_context yield);
+  void handle(const TestRequest &request, TestResponse &response);
+  void cloudFiles(const TestRequest &request, TestResponse &response);
+
+public:
+  TestServer(TestServerOptions options = {});
+  TestServer(const TestServer &) = delete;
+  ~TestServer();
+  /// eg. http://127.0.0.1:12345
+  HostInfo http() const;
+  HostInfo https() const;
+  unsigned short httpPort() const;
+  unsigned short httpsPort() const;
+  /// Serves requests whose path starts with 'prefix' with 'handler' instead of
+  /// the built in routes. Add routes before sending any requests
+  void route(std::string prefix, TestHandler handler);
+  /// The server's certificate, a PEM file. Clients need to trust it (see
+  /// Services::trustCertificate) to connect with https
+  static std::string certificateFile();
+  /// Totals since the server started
+  size_t connectionsAccepted() const { return connections; }
+  size_t requestsServed() const { return requests; }
+};
+
+} /* RESTClient */
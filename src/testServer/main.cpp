@@ -0,0 +1,25 @@
+/// Runs the TestServer on its own, for benchmarking against, or poking with
+/// curl. Prints its two base URLs, then serves until stdin is closed.
+///
+/// Usage: testServer [http port] [https port] [threads]
+
+#include "TestServer.hpp"
+
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[]) {
+  RESTClient::TestServerOptions options;
+  if (argc > 1)
+    options.httpPort = static_cast<unsigned short>(std::stoul(argv[1]));
+  if (argc > 2)
+    options.httpsPort = static_cast<unsigned short>(std::stoul(argv[2]));
+  if (argc > 3)
+    options.threads = std::stoul(argv[3]);
+  RESTClient::TestServer server(options);
+  std::cout << server.http() << std::endl << server.https() << std::endl;
+  std::string ignored;
+  while (std::getline(std::cin, ignored))
+    ;
+  return 0;
+}